@@ -1,11 +1,28 @@
 #include <Arduino.h>
 #include <WiFi.h>
+#include <esp_timer.h>
 
 #include "ptz_config.h"
+#include "ptz_deadline.h"
+#include "ptz_freed.h"
 #include "ptz_gamepad.h"
+#include "ptz_group.h"
 #include "ptz_log.h"
+#include "ptz_metrics.h"
 #include "ptz_motion.h"
+#include "ptz_ota.h"
 #include "ptz_owner.h"
+#include "ptz_planner.h"
+#include "ptz_presets.h"
+#include "ptz_profiles.h"
+#include "ptz_rates.h"
+#include "ptz_record.h"
+#include "ptz_resume.h"
+#include "ptz_samples.h"
+#include "ptz_schedule.h"
+#include "ptz_serial.h"
+#include "ptz_udp.h"
+#include "ptz_web.h"
 #include "ptz_wifi.h"
 #include "ptz_ws.h"
 
@@ -13,42 +30,34 @@ using ptz::Owner;
 
 namespace {
 
+ptz::PtzDeadline g_deadline;
+ptz::PtzFreed g_freed;
+ptz::PtzGroup g_group;
 ptz::PtzGamepad g_gamepad;
+ptz::PtzMetrics g_metrics;
 ptz::PtzMotion g_motion;
+ptz::PtzOta g_ota;
 ptz::PtzOwner g_owner;
+ptz::PtzPlanner g_planner;
+ptz::PtzPresets g_presets;
+ptz::PtzProfiles g_profiles;
+ptz::PtzRateGroups g_rates;
+ptz::PtzRecorder g_recorder;
+ptz::PtzResume g_resume;
+ptz::PtzSampleRing g_samples;
+ptz::PtzScheduler g_scheduler;
+ptz::PtzSerial g_serial;
+ptz::PtzUdp g_udp;
+ptz::PtzWeb g_web;
 ptz::PtzWifi g_wifi;
 ptz::PtzWebSocket g_ws;
 
 uint32_t g_lastMicros = 0;
-uint32_t g_lastStatusMs = 0;
-uint32_t g_idleStartMs = 0;
+uint32_t g_statusIntervalMs = ptz::kStatusIntervalMs;
+int8_t g_statusTask = -1;
+int g_wifiRssi = 0;
 Owner g_lastOwner = Owner::None;
 
-struct Preset {
-  float pan = 0.0f;
-  float tilt = 0.0f;
-  float zoom = 0.0f;
-  bool valid = false;
-};
-
-Preset g_presets[4];
-
-void handleSerialCommands() {
-  static String line;
-  while (Serial.available()) {
-    const char c = static_cast<char>(Serial.read());
-    if (c == '\n' || c == '\r') {
-      line.trim();
-      if (line.equalsIgnoreCase("WIFI RESET")) {
-        g_wifi.resetAndProvision();
-      }
-      line = "";
-    } else {
-      line += c;
-    }
-  }
-}
-
 float clampNorm(float x) {
   if (x > 1.0f) {
     return 1.0f;
@@ -59,42 +68,75 @@ float clampNorm(float x) {
   return x;
 }
 
-} // namespace
-
-void setup() {
-  Serial.begin(115200);
-  delay(200);
-  ptz::logInit();
-
-  PTZ_LOGI("BOOT", "PTZHead starting");
+uint32_t clockUs() {
+  return micros();
+}
 
-  g_owner.begin();
-  g_motion.begin();
-  g_gamepad.begin();
+// Fixed-step integration: dt no longer depends on how long the network
+// handling in loop() took.
+void motionTick(uint32_t dueUs) {
+  const uint32_t nowMs = millis();
+  g_planner.update(nowMs);
+  g_motion.update(ptz::kMotionTickUs * 1e-6f);
+  g_resume.tick(nowMs, g_presets.firstRecallMs());
+  // At motion rate so OTA flash writes pause as soon as the head moves.
+  g_ota.loop(nowMs, g_motion.isMoving(), WiFi.status() == WL_CONNECTED);
+}
 
-  g_wifi.begin(false);
-  g_ws.begin(&g_owner, &g_motion);
+// Applies an owner change: queued paths are dropped and the axes stop or
+// wake for the new owner. Returns whether the owner changed.
+bool updateOwner(uint32_t nowMs) {
+  g_owner.update(nowMs);
+  const Owner currentOwner = g_owner.owner();
+  if (currentOwner == g_lastOwner) {
+    return false;
+  }
+  PTZ_LOGI("OWNER", "Owner changed to %u", static_cast<unsigned>(currentOwner));
+  g_metrics.recordOwnerChange();
+  g_planner.flush();
+  if (currentOwner == Owner::None) {
+    g_motion.stop();
+  } else if (g_lastOwner == Owner::None) {
+    // Wake every driver as control is taken so the first command steps
+    // without waiting for kAxisWakeUs.
+    g_motion.setEnabled(true);
+  }
+  g_lastOwner = currentOwner;
+  return true;
+}
 
-  g_lastMicros = micros();
-  g_lastStatusMs = millis();
-  g_lastOwner = g_owner.owner();
+void applySticks(const ptz::GamepadCommands& commands) {
+  float velocity[ptz::kAxisCount] = {};
+  velocity[ptz::kAxisPan] = clampNorm(commands.pan);
+  velocity[ptz::kAxisTilt] = clampNorm(commands.tilt);
+  velocity[ptz::kAxisZoom] = clampNorm(commands.zoom);
+  g_motion.setVelocity(velocity);
+  if (commands.startMask != 0) {
+    g_motion.watchFirstStep(commands.startMask, commands.reportUs);
+  }
 }
 
-void loop() {
+// New controller report, pushed by g_gamepad.poll() in the loop() pass
+// that picked it up; sticks do not wait for the next gamepad tick.
+void gamepadReport(const ptz::GamepadCommands& commands) {
   const uint32_t nowMs = millis();
-  const uint32_t nowUs = micros();
-  float dt = (nowUs - g_lastMicros) * 1e-6f;
-  if (dt < 0.0f) {
-    dt = 0.0f;
-  } else if (dt > 0.05f) {
-    dt = 0.05f;
+  if (commands.hasInput) {
+    g_owner.setGamepadActive(nowMs);
+    if (g_owner.owner() == Owner::None) {
+      g_owner.requestGamepadControl(nowMs);
+    }
   }
-  g_lastMicros = nowUs;
-
-  g_gamepad.update();
-  g_ws.loop();
-  handleSerialCommands();
+  const bool ownerChanged = updateOwner(nowMs);
+  // Unchanged reports are skipped; the motion layer keeps the last velocity.
+  if (g_owner.owner() == Owner::Gamepad && (commands.sticksChanged || ownerChanged)) {
+    applySticks(commands);
+  }
+}
 
+// Button holds, held-stick activity and ownership arbitration; stick
+// changes arrive through gamepadReport().
+void gamepadTick(uint32_t dueUs) {
+  const uint32_t nowMs = millis();
   ptz::GamepadCommands commands = g_gamepad.readCommands(nowMs);
 
   if (commands.provisioning) {
@@ -106,7 +148,7 @@ void loop() {
     g_owner.requestGamepadControl(nowMs);
   }
 
-  if (commands.presetSave || commands.presetRecall) {
+  if (commands.presetSave || commands.presetRecall || commands.profileStep != 0) {
     g_owner.setGamepadActive(nowMs);
     if (g_owner.owner() == Owner::None) {
       g_owner.requestGamepadControl(nowMs);
@@ -124,69 +166,152 @@ void loop() {
     g_owner.clearGamepad();
   }
 
-  g_owner.update(nowMs);
-  const Owner currentOwner = g_owner.owner();
-  if (currentOwner != g_lastOwner) {
-    PTZ_LOGI("OWNER", "Owner changed to %u", static_cast<unsigned>(currentOwner));
-    if (currentOwner == Owner::None) {
-      g_motion.stop();
-    }
-    g_lastOwner = currentOwner;
-  }
+  const bool ownerChanged = updateOwner(nowMs);
 
   if (commands.presetSave) {
-    const ptz::MotionState state = g_motion.state();
-    Preset& preset = g_presets[commands.presetIndex];
-    preset.pan = state.panPos;
-    preset.tilt = state.tiltPos;
-    preset.zoom = state.zoomPos;
-    preset.valid = true;
+    g_presets.save(commands.presetIndex, g_motion.state());
     g_gamepad.rumblePresetSaved();
     PTZ_LOGI("PRESET", "Saved preset %u", static_cast<unsigned>(commands.presetIndex));
   }
 
   if (commands.presetRecall) {
-    const Preset& preset = g_presets[commands.presetIndex];
-    if (preset.valid) {
-      g_motion.moveTo(preset.pan, preset.tilt, preset.zoom);
+    const ptz::Preset* preset = g_presets.recall(commands.presetIndex);
+    if (preset) {
+      g_motion.moveTo(preset->pos);
       PTZ_LOGI("PRESET", "Recalled preset %u", static_cast<unsigned>(commands.presetIndex));
     } else {
       PTZ_LOGW("PRESET", "Preset %u not set", static_cast<unsigned>(commands.presetIndex));
     }
   }
 
-  if (currentOwner == Owner::Gamepad) {
-    g_motion.setVelocity(clampNorm(commands.pan), clampNorm(commands.tilt), clampNorm(commands.zoom));
+  if (commands.profileStep != 0 && !g_profiles.selectNext(commands.profileStep)) {
+    PTZ_LOGW("PROFILE", "No profile to switch to");
   }
 
-  g_motion.update(dt);
-  g_motion.run();
+  if (g_owner.owner() == Owner::Gamepad && (commands.sticksChanged || ownerChanged)) {
+    applySticks(commands);
+  }
+}
 
-  if (currentOwner != Owner::None) {
-    if (!g_motion.enabled()) {
-      g_motion.setEnabled(true);
-    }
-    g_idleStartMs = 0;
+// Record/playback runs on its own fixed tick so playback timing does not
+// depend on loop() either.
+void recordTick(uint32_t dueUs) {
+  g_recorder.tick(millis());
+}
+
+void statusTick(uint32_t dueUs) {
+  const uint32_t nowMs = millis();
+  // Under load the last RSSI reading is reused; the query goes through the
+  // WiFi driver and is not free.
+  if (g_deadline.rssiAllowed()) {
+    ptz::AllocScope scope(ptz::kAllocWifi);
+    g_wifiRssi = (WiFi.status() == WL_CONNECTED) ? WiFi.RSSI() : 0;
   }
+  ptz::PositionSample samples[ptz::kSampleRingSize];
+  uint32_t samplesLost = 0;
+  const size_t sampleCount = g_samples.drain(samples, ptz::kSampleRingSize, &samplesLost);
+  g_ws.broadcastStatus(nowMs, g_motion, g_owner, g_gamepad.isConnected(), g_motion.enabled(), g_wifiRssi, samples,
+                       sampleCount, samplesLost);
+  g_metrics.recordStatus(micros(), g_statusIntervalMs);
 
-  if (currentOwner == Owner::None && !g_motion.isMoving()) {
-    if (g_idleStartMs == 0) {
-      g_idleStartMs = nowMs;
-    }
-    if (ptz::kIdleDisableTimeoutMs > 0 &&
-        nowMs - g_idleStartMs >= ptz::kIdleDisableTimeoutMs) {
-      if (g_motion.enabled()) {
-        g_motion.setEnabled(false);
-        PTZ_LOGI("MOTION", "Idle timeout, outputs disabled");
-      }
-    }
-  } else {
-    g_idleStartMs = 0;
+  // Load shedding changes the status rate from the next frame on.
+  const uint32_t intervalMs = g_deadline.statusIntervalMs();
+  if (intervalMs != g_statusIntervalMs) {
+    g_statusIntervalMs = intervalMs;
+    g_rates.setPeriod(g_statusTask, intervalMs * 1000);
   }
+}
+
+void housekeepingTick(uint32_t dueUs) {
+  const uint32_t nowMs = millis();
+  g_motion.updatePower(nowMs, g_owner.owner() != Owner::None);
+  g_profiles.loop();
+  g_presets.loop(g_motion.isMoving());
+  g_resume.loop(nowMs);
+  g_metrics.update(nowMs);
+}
 
-  if (nowMs - g_lastStatusMs >= ptz::kStatusIntervalMs) {
-    const int wifiRssi = (WiFi.status() == WL_CONNECTED) ? WiFi.RSSI() : 0;
-    g_ws.broadcastStatus(nowMs, g_motion, g_owner, g_gamepad.isConnected(), g_motion.enabled(), wifiRssi);
-    g_lastStatusMs = nowMs;
+void motionStarting() {
+  g_resume.invalidate();
+}
+
+void supplyTick(uint32_t dueUs) {
+  g_resume.pollSupply();
+}
+
+} // namespace
+
+void setup() {
+  Serial.begin(115200);
+  delay(200);
+  ptz::logInit();
+  g_metrics.begin();
+
+  PTZ_LOGI("BOOT", "PTZHead starting");
+
+  g_owner.begin();
+  g_motion.begin();
+  // Before anything can command motion.
+  g_resume.begin(&g_motion);
+  g_motion.setStartHook(&motionStarting);
+  g_presets.begin();
+  g_profiles.begin(&g_motion);
+  g_gamepad.begin(&gamepadReport);
+
+  g_wifi.begin(false);
+  g_recorder.begin(&g_owner, &g_motion);
+  g_planner.begin(&g_owner, &g_motion);
+  g_scheduler.begin(&g_owner, &g_motion, &g_presets, &g_planner);
+  g_ws.begin(&g_owner, &g_motion, &g_recorder, &g_planner, &g_metrics, &g_profiles, &g_deadline, &g_ota,
+             &g_scheduler, &g_group, &g_rates, &g_resume, &g_serial, &g_udp,
+             &g_freed, &g_web);
+  g_serial.begin(&g_owner, &g_motion, &g_presets, &g_wifi);
+  g_udp.begin(&g_owner, &g_motion, &g_presets);
+  g_group.begin(&g_owner, &g_motion, &g_presets);
+  g_freed.begin();
+  g_ota.begin();
+  g_web.begin();
+
+  // Registration order breaks priority ties.
+  g_rates.begin(&clockUs);
+  g_rates.add("motion", ptz::kMotionTickUs, 0, ptz::kLoopClampUs / ptz::kMotionTickUs, &motionTick);
+  g_rates.add("gamepad", ptz::kGamepadTickUs, 1, 0, &gamepadTick);
+  g_rates.add("record", ptz::kRecordTickUs, 2, 4, &recordTick);
+  g_statusTask = g_rates.add("status", g_statusIntervalMs * 1000, 3, 0, &statusTick);
+  g_rates.add("housekeeping", ptz::kHousekeepingTickUs, 4, 0, &housekeepingTick);
+  if (ptz::kSupplySensePin >= 0) {
+    g_rates.add("supply", ptz::kSupplyPollUs, 1, 0, &supplyTick);
+  }
+
+  g_lastMicros = micros();
+  g_lastOwner = g_owner.owner();
+}
+
+void loop() {
+  const uint32_t nowMs = millis();
+  const uint32_t nowUs = micros();
+  g_metrics.recordLoop(nowUs - g_lastMicros);
+  g_deadline.update(nowUs - g_lastMicros, nowMs);
+  ptz::logSetDeferred(g_deadline.logsDeferred());
+  g_lastMicros = nowUs;
+
+  g_ws.loop();
+  g_serial.loop(nowMs);
+  g_udp.loop(nowMs);
+  g_group.loop(nowMs, WiFi.status() == WL_CONNECTED);
+  g_scheduler.poll(esp_timer_get_time());
+  g_gamepad.poll();
+
+  g_rates.poll();
+
+  // Stepping is not rate limited: AccelStepper needs a call per step.
+  g_motion.run();
+  g_samples.sample(micros(), g_motion);
+  g_freed.loop(micros(), g_motion);
+  uint32_t stickLatencyUs = 0;
+  if (g_motion.takeFirstStepLatency(&stickLatencyUs)) {
+    g_metrics.recordStickLatency(stickLatencyUs);
   }
+
+  ptz::logFlushDeferred();
 }
@@ -4,39 +4,134 @@
 
 namespace ptz {
 
-constexpr uint8_t kPanStepPin = 16;
-constexpr uint8_t kPanDirPin = 17;
-constexpr uint8_t kPanEnPin = 25; // active low
+// Driver hold rule once an axis has been idle for its idle timeout.
+enum class AxisHold : uint8_t {
+  Free,       // de-energize after the timeout (friction holds the axis)
+  WhileOwned, // de-energize after the timeout only while nobody owns the head
+  Always,     // never de-energize automatically (gravity-loaded axes)
+};
+
+// Axis table, one X(...) entry per axis:
+//   X(id, name, stepPin, dirPin, enPin (active low), maxSps, accel, slewSps2, idleMs, hold)
+// maxSps is steps/s, accel is the position-move acceleration and slewSps2 the
+// velocity-mode slew limit (both steps/s^2). idleMs is the idle time before
+// the driver is disabled under its hold rule (0 keeps it energized, the
+// default for every axis; zoom on friction is the usual candidate). The first
+// three entries must be Pan, Tilt and Zoom; further axes (focus, iris,
+// slider, ...) can be appended.
+#define PTZ_AXIS_LIST(X)                                                                   \
+  X(Pan, "pan", 16, 17, 25, 4000.0f, 20000.0f, 6000.0f, 0, AxisHold::WhileOwned)           \
+  X(Tilt, "tilt", 18, 19, 26, 4000.0f, 20000.0f, 6000.0f, 0, AxisHold::Always)             \
+  X(Zoom, "zoom", 22, 23, 27, 4000.0f, 15000.0f, 6000.0f, 0, AxisHold::Free)
+
+struct AxisConfig {
+  const char* name;
+  uint8_t stepPin;
+  uint8_t dirPin;
+  uint8_t enPin;
+  float maxSps;
+  float accel;
+  float slewSps2;
+  uint32_t idleMs;
+  AxisHold hold;
+};
 
-constexpr uint8_t kTiltStepPin = 18;
-constexpr uint8_t kTiltDirPin = 19;
-constexpr uint8_t kTiltEnPin = 26; // active low
+enum AxisId : uint8_t {
+#define PTZ_AXIS_ID(id, name, step, dir, en, maxSps, accel, slew, idleMs, hold) kAxis##id,
+  PTZ_AXIS_LIST(PTZ_AXIS_ID)
+#undef PTZ_AXIS_ID
+  kAxisCount
+};
+
+constexpr AxisConfig kAxes[kAxisCount] = {
+#define PTZ_AXIS_CONFIG(id, name, step, dir, en, maxSps, accel, slew, idleMs, hold) \
+  {name, step, dir, en, maxSps, accel, slew, idleMs, hold},
+    PTZ_AXIS_LIST(PTZ_AXIS_CONFIG)
+#undef PTZ_AXIS_CONFIG
+};
 
-constexpr uint8_t kZoomStepPin = 22;
-constexpr uint8_t kZoomDirPin = 23;
-constexpr uint8_t kZoomEnPin = 27; // active low
+static_assert(kAxisPan == 0 && kAxisTilt == 1 && kAxisZoom == 2, "Pan, Tilt, Zoom must lead PTZ_AXIS_LIST");
+static_assert(kAxisCount <= 7, "Recorder stream encoding supports at most 7 axes");
+
+// Per-axis loops are short and fixed; ask GCC to unroll them even at -Os.
+#define PTZ_UNROLL_AXES _Pragma("GCC unroll 8")
 
 constexpr float kDeadzone = 0.08f;
 constexpr bool kUseExpo = true;
 constexpr bool kInvertPan = true;
 
-constexpr float kPanMaxSps = 4000.0f;
-constexpr float kTiltMaxSps = 4000.0f;
-constexpr float kZoomMaxSps = 4000.0f;
+// Position targets are clamped to +-kMaxTargetSteps so every target fits
+// AccelStepper's long (32-bit on the ESP32).
+constexpr float kMaxTargetSteps = 1.0e9f;
+
+// Input shaping: the velocity stream is resampled every kShaperSampleUs into
+// a history long enough for the slowest shaper (kShaperMinHz at the highest
+// damping); EI keeps residual vibration below kShaperEiTolerance.
+constexpr uint32_t kShaperSampleUs = 2000;
+constexpr uint16_t kShaperHistory = 320;
+constexpr float kShaperMinHz = 2.0f;
+constexpr float kShaperMaxHz = 60.0f;
+constexpr float kShaperMaxDamping = 0.3f;
+constexpr float kShaperEiTolerance = 0.05f;
 
-constexpr float kPanAccel = 20000.0f;
-constexpr float kTiltAccel = 20000.0f;
-constexpr float kZoomAccel = 15000.0f;
+constexpr uint8_t kPathQueueSize = 16;
+constexpr float kPathDefaultBlendSteps = 20.0f; // corner deviation tolerance
+constexpr float kPathSettleSteps = 4.0f;
+constexpr float kPathAccelFraction = 0.8f; // headroom below the slew limit
 
-constexpr float kPanSlewSps2 = 6000.0f;
-constexpr float kTiltSlewSps2 = 6000.0f;
-constexpr float kZoomSlewSps2 = 6000.0f;
+// loopTask rate groups (ptz_rates.h). Motion integrates with a fixed
+// kMotionTickUs step; stepping itself still runs on every loop() pass.
+constexpr uint32_t kMotionTickUs = 1000;
+constexpr uint32_t kGamepadTickUs = 4000; // button holds and ownership; reports are pushed
+constexpr uint32_t kHousekeepingTickUs = 100000;
+constexpr uint8_t kRateMaxTasks = 8;
+constexpr uint8_t kRatePollBurst = 4; // runs of one task per poll()
 
 constexpr uint32_t kStatusIntervalMs = 50;
+constexpr uint32_t kStatusMaxIntervalMs = kStatusIntervalMs * 4; // ShedLevel::Minimal
+constexpr uint16_t kStatusFrameBytes = 2048;
+constexpr uint32_t kSampleIntervalUs = 4000;
+// One Minimal-level status interval of samples plus a late status tick.
+constexpr uint8_t kSampleRingSize = kStatusMaxIntervalMs * 1000 / kSampleIntervalUs + 4;
+constexpr uint32_t kRecordTickUs = 10000; // 100 Hz record/playback tick
+constexpr uint8_t kRecordSlots = 4;
+constexpr uint16_t kRecordSlotBytes = 4096;
+constexpr uint16_t kRecordExportChunkBytes = 256;
+constexpr float kRecordQuantization = 1024.0f; // steps per unit normalized velocity
+
 constexpr uint32_t kAppHeartbeatTimeoutMs = 750;
-constexpr uint32_t kIdleDisableTimeoutMs = 0;
+// Enable-to-first-step delay for a driver coming out of idle.
+constexpr uint32_t kAxisWakeUs = 2000;
+// A stick-to-first-step probe with no step after this long is dropped.
+constexpr uint32_t kStepProbeTimeoutUs = 500000;
 constexpr uint32_t kGamepadOwnerTimeoutMs = 1000;
 
+constexpr uint32_t kMetricsSampleMs = 1000;
+constexpr uint32_t kHeapWarnFreeBytes = 24 * 1024;
+constexpr uint32_t kHeapWarnBlockBytes = 8 * 1024;
+constexpr uint32_t kStackWarnBytes = 512;
+
+// Loop passes longer than this count as overruns. Sustained overruns shed
+// status rate, RSSI queries and info logging one level at a time; a level is
+// released after kShedRecoverWindows quiet windows.
+constexpr uint32_t kLoopDeadlineUs = 2000;
+constexpr uint32_t kLoopClampUs = 50000; // motion catch-up limit after a stall
+constexpr uint32_t kShedWindowMs = 500;
+constexpr uint16_t kShedEnterPermille = 50; // overrun share that raises the level
+constexpr uint16_t kShedExitPermille = 10;  // share below which a window is quiet
+constexpr uint8_t kShedRecoverWindows = 4;
+constexpr uint8_t kLogDeferredLines = 16;
+
+// OTA downloads run in a task on core 0 below the WiFi stack; loopTask stays
+// alone on core 1. A new image is confirmed after kOtaHealthyMs of uptime
+// with WiFi connected, otherwise the bootloader rolls back on the next reset.
+constexpr uint16_t kOtaChunkBytes = 2048;
+constexpr uint8_t kOtaUrlMaxLen = 160;
+constexpr uint32_t kOtaTaskStackBytes = 8192;
+constexpr uint8_t kOtaTaskPriority = 1;
+constexpr uint32_t kOtaStallTimeoutMs = 15000;
+constexpr uint32_t kOtaHealthyMs = 60000;
+
 constexpr uint32_t kWifiConnectTimeoutS = 20;
 constexpr uint32_t kWifiPortalTimeoutS = 180;
 constexpr const char* kWifiApName = "PTZHead Setup";
@@ -44,9 +139,100 @@ constexpr const char* kWifiApPass = "";
 
 constexpr uint16_t kWebsocketPort = 81;
 constexpr const char* kWebsocketPath = "/ws";
+// Text messages above this are rejected before parsing; the library drops
+// frames above WEBSOCKETS_MAX_DATA_SIZE (platformio.ini) before buffering.
+constexpr uint16_t kWebsocketMaxMessageBytes = 1024;
+constexpr uint8_t kWebsocketJsonNestingLimit = 4;
+constexpr uint32_t kWebsocketSlowCommandUs = 2000;
+// Replies wait in a queue of this many bytes, borrowed from a pool of
+// kWebsocketTxQueues while a client has replies outstanding. Status frames
+// are shared by all clients and only take a pending flag each, so observers
+// that just read status hold no queue.
+constexpr uint16_t kWebsocketTxQueueBytes = 3072;
+constexpr uint8_t kWebsocketTxQueues = 4;
+constexpr uint8_t kWebsocketMaxFramesPerFlush = 4; // per client
+constexpr uint32_t kWebsocketSlowClientMs = 3000;  // unwritable this long: drop
+
+// Static web UI (web/, gzipped into flash at build time), served by a task on
+// core 0 below the WiFi stack so page loads stay off the control loop.
+constexpr uint16_t kWebPort = 80;
+constexpr uint32_t kWebTaskStackBytes = 4096;
+constexpr uint8_t kWebTaskPriority = 1;
+constexpr uint32_t kWebPollMs = 5;
+
+constexpr uint16_t kUdpControlPort = 52381; // VISCA over IP and native datagrams
+constexpr uint8_t kUdpMaxPeers = 4;
+constexpr uint32_t kUdpPeerTimeoutMs = 5000;
+constexpr uint8_t kUdpMaxPacketsPerLoop = 4;
+constexpr uint32_t kViscaDriveHoldMs = 10000;
+constexpr float kViscaPanStepsPerUnit = 1.0f;
+constexpr float kViscaTiltStepsPerUnit = 1.0f;
+constexpr float kViscaZoomStepsPerUnit = 1.0f;
+
+// Multi-head group control. One multicast datagram drives every member; each
+// head picks its own entry by head id. Group 0 means not a member.
+constexpr const char* kGroupMulticastIp = "239.255.0.2";
+constexpr uint16_t kGroupPort = 52382;
+constexpr uint8_t kGroupDefaultId = 0;
+constexpr uint8_t kGroupDefaultHeadId = 0;
+constexpr uint8_t kGroupMaxEntries = 32; // per datagram
+
+// FreeD D1 pose output. A target in 224.0.0.0/4 is sent as multicast.
+constexpr bool kFreedEnabled = false; // true streams to kFreedTargetIp from boot
+constexpr const char* kFreedTargetIp = "239.255.0.1";
+constexpr uint16_t kFreedTargetPort = 40000;
+constexpr uint8_t kFreedCameraId = 1;
+constexpr uint16_t kFreedRateHz = 100;
+constexpr uint16_t kFreedMinRateHz = 50;
+constexpr uint16_t kFreedMaxRateHz = 200;
+constexpr float kPanStepsPerDegree = 100.0f;
+constexpr float kTiltStepsPerDegree = 100.0f;
+constexpr float kPanZeroDegrees = 0.0f;
+constexpr float kTiltZeroDegrees = 0.0f;
+constexpr float kZoomFreedScale = 1.0f; // FreeD zoom counts per zoom step
+
+// Clock sync: exchanges whose round trip exceeds the best seen by more than
+// the slack are ignored; an estimate is usable after kTimeSyncMinSamples.
+constexpr uint32_t kTimeSyncDelaySlackUs = 2000;
+constexpr uint8_t kTimeSyncMinSamples = 4;
+constexpr uint8_t kScheduleQueueSize = 8;
+constexpr uint32_t kScheduleMaxAheadMs = 60000;
 
 constexpr uint8_t kProtocolVersion = 1;
 
+constexpr uint8_t kPresetCount = 4;
+
+// Position resume (ptz_resume.h). Settled positions go to NVS after
+// kResumeSettleMs at rest, at most once per kResumeMinWriteMs; with the
+// NVS partition's wear levelling that is years of continuous use.
+constexpr uint32_t kResumeSettleMs = 500;
+constexpr uint32_t kResumeMinWriteMs = 10000;
+// Optional motor supply sense input (ADC pin behind a divider); -1 disables
+// it. Below kSupplyFailMv the position is saved once, above kSupplyOkMv
+// saving resumes.
+constexpr int8_t kSupplySensePin = -1;
+constexpr float kSupplySenseScale = 11.0f; // divider ratio
+constexpr uint32_t kSupplyFailMv = 10000;
+constexpr uint32_t kSupplyOkMv = 11000;
+constexpr uint32_t kSupplyPollUs = 2000;
+
+constexpr uint8_t kProfileCount = 4;
+constexpr uint8_t kProfileNameLen = 24; // including the terminator
+constexpr float kProfileMaxSpsLimit = 40000.0f;
+constexpr float kProfileAccelLimit = 200000.0f; // also caps slew
+
+// Owner client ids above the WebSocket range (0..255) identify other transports.
+constexpr uint32_t kSerialClientId = 0x100;
+
+constexpr uint32_t kUdpClientIdBase = 0x200; // + 1..255, allocated per sender address and port
+constexpr uint32_t kGroupClientIdBase = 0x300; // + group id
+
+constexpr uint8_t kSerialFrameSof = 0xA5;
+constexpr uint8_t kSerialMaxPayload = 32;
+constexpr uint32_t kSerialFrameTimeoutMs = 20;
+constexpr uint16_t kSerialMaxBytesPerLoop = 256;
+constexpr uint16_t kSerialMinStatusIntervalMs = 5;
+
 constexpr uint32_t kProvisionComboHoldMs = 2000;
 constexpr uint32_t kTakeControlHoldMs = 1000;
 constexpr uint32_t kPresetHoldMs = 2000;
@@ -60,13 +246,27 @@ enum class LogLevel : uint8_t {
 
 constexpr LogLevel kLogLevel = LogLevel::Info;
 
+// Tokenized log frames: kLogFrameSof, a 24-bit token, then the arguments,
+// which the decoder delimits from the token's format string. Token 0 marks
+// a line whose arguments did not fit kLogTokenMaxPayload (token included).
+constexpr uint8_t kLogFrameSof = 0xA6;
+constexpr uint32_t kLogTokenMask = 0xFFFFFF;
+constexpr uint32_t kLogTokenOverflow = 0;
+constexpr uint8_t kLogTokenMaxPayload = 64;
+constexpr uint8_t kLogTokenMaxString = 24;
+
 enum LogRateId : uint8_t {
   kLogRateWifiProgress = 0,
   kLogRateWsStatus = 1,
   kLogRateWsParseError = 2,
   kLogRateGamepadCombo = 3,
   kLogRateOwnerState = 4,
-  kLogRateCount = 8
+  kLogRateSerialError = 5,
+  kLogRateUdpReject = 6,
+  kLogRateFreedStats = 7,
+  kLogRateWsSlowCommand = 8,
+  kLogRateWsTxDrop = 9,
+  kLogRateCount = 10
 };
 
 } // namespace ptz
@@ -0,0 +1,98 @@
+#include "ptz_deadline.h"
+
+#include "ptz_log.h"
+
+namespace ptz {
+
+void PtzDeadline::update(uint32_t periodUs, uint32_t nowMs) {
+  ++stats_.loops;
+  ++windowLoops_;
+  if (periodUs > kLoopDeadlineUs) {
+    ++stats_.overruns;
+    ++windowOverruns_;
+  }
+  if (periodUs > kLoopClampUs) {
+    ++stats_.clamped;
+  }
+  if (periodUs > stats_.maxPeriodUs) {
+    stats_.maxPeriodUs = periodUs;
+  }
+
+  if (!windowOpen_) {
+    windowOpen_ = true;
+    windowStartMs_ = nowMs;
+  } else if (nowMs - windowStartMs_ >= kShedWindowMs) {
+    closeWindow(nowMs);
+  }
+}
+
+ShedLevel PtzDeadline::level() const {
+  return stats_.level;
+}
+
+uint32_t PtzDeadline::statusIntervalMs() const {
+  switch (stats_.level) {
+    case ShedLevel::Reduced:
+      return kStatusIntervalMs * 2;
+    case ShedLevel::Minimal:
+      return kStatusMaxIntervalMs;
+    case ShedLevel::Normal:
+      break;
+  }
+  return kStatusIntervalMs;
+}
+
+bool PtzDeadline::rssiAllowed() const {
+  return stats_.level == ShedLevel::Normal;
+}
+
+bool PtzDeadline::logsDeferred() const {
+  return stats_.level != ShedLevel::Normal;
+}
+
+DeadlineStats PtzDeadline::stats() const {
+  return stats_;
+}
+
+const char* PtzDeadline::levelName(ShedLevel level) {
+  switch (level) {
+    case ShedLevel::Reduced:
+      return "reduced";
+    case ShedLevel::Minimal:
+      return "minimal";
+    case ShedLevel::Normal:
+      break;
+  }
+  return "normal";
+}
+
+void PtzDeadline::closeWindow(uint32_t nowMs) {
+  const uint32_t permille = windowLoops_ ? windowOverruns_ * 1000 / windowLoops_ : 0;
+  const ShedLevel previous = stats_.level;
+
+  if (permille >= kShedEnterPermille) {
+    quietWindows_ = 0;
+    if (stats_.level != ShedLevel::Minimal) {
+      stats_.level = static_cast<ShedLevel>(static_cast<uint8_t>(stats_.level) + 1);
+      ++stats_.shedEvents;
+    }
+  } else if (permille < kShedExitPermille) {
+    if (stats_.level != ShedLevel::Normal && ++quietWindows_ >= kShedRecoverWindows) {
+      stats_.level = static_cast<ShedLevel>(static_cast<uint8_t>(stats_.level) - 1);
+      quietWindows_ = 0;
+    }
+  } else {
+    quietWindows_ = 0;
+  }
+
+  if (stats_.level != previous) {
+    PTZ_LOGW("LOAD", "Shed level %s -> %s (overruns %lu/%lu)", levelName(previous), levelName(stats_.level),
+             static_cast<unsigned long>(windowOverruns_), static_cast<unsigned long>(windowLoops_));
+  }
+
+  windowStartMs_ = nowMs;
+  windowLoops_ = 0;
+  windowOverruns_ = 0;
+}
+
+} // namespace ptz
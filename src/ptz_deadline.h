@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ptz_config.h"
+
+namespace ptz {
+
+enum class ShedLevel : uint8_t {
+  Normal,
+  Reduced, // status at half rate, no RSSI queries, info logs deferred
+  Minimal, // status at quarter rate
+};
+
+struct DeadlineStats {
+  uint32_t loops;
+  uint32_t overruns;   // periods above kLoopDeadlineUs
+  uint32_t clamped;    // periods above kLoopClampUs (motion ticks dropped)
+  uint32_t shedEvents; // level increases
+  uint32_t maxPeriodUs;
+  ShedLevel level;
+};
+
+// Watches the loop() period and sheds non-critical work while overruns
+// persist. Raising is immediate per busy window, lowering needs several
+// quiet windows in a row, so the level does not flap at the threshold.
+class PtzDeadline {
+ public:
+  void update(uint32_t periodUs, uint32_t nowMs);
+
+  ShedLevel level() const;
+  uint32_t statusIntervalMs() const;
+  bool rssiAllowed() const;
+  bool logsDeferred() const;
+
+  DeadlineStats stats() const;
+  static const char* levelName(ShedLevel level);
+
+ private:
+  void closeWindow(uint32_t nowMs);
+
+  DeadlineStats stats_ = {};
+  bool windowOpen_ = false;
+  uint32_t windowStartMs_ = 0;
+  uint32_t windowLoops_ = 0;
+  uint32_t windowOverruns_ = 0;
+  uint8_t quietWindows_ = 0;
+};
+
+} // namespace ptz
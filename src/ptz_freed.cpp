@@ -0,0 +1,158 @@
+#include "ptz_freed.h"
+
+#include <Arduino.h>
+#include <math.h>
+
+#include "ptz_config.h"
+#include "ptz_log.h"
+
+namespace ptz {
+
+static constexpr size_t kD1Size = 29;
+
+static uint8_t* writeS24(uint8_t* p, int32_t value) {
+  if (value > 0x7FFFFF) {
+    value = 0x7FFFFF;
+  } else if (value < -0x800000) {
+    value = -0x800000;
+  }
+  const uint32_t v = static_cast<uint32_t>(value);
+  p[0] = static_cast<uint8_t>(v >> 16);
+  p[1] = static_cast<uint8_t>(v >> 8);
+  p[2] = static_cast<uint8_t>(v);
+  return p + 3;
+}
+
+// FreeD angles are degrees * 32768, wrapped to [-180, 180).
+static int32_t angleToFreed(float degrees) {
+  degrees = fmodf(degrees + 180.0f, 360.0f);
+  if (degrees < 0.0f) {
+    degrees += 360.0f;
+  }
+  return static_cast<int32_t>(lroundf((degrees - 180.0f) * 32768.0f));
+}
+
+void PtzFreed::begin() {
+  enabled_ = kFreedEnabled && target_.fromString(kFreedTargetIp);
+  port_ = kFreedTargetPort;
+  setRate(kFreedRateHz);
+  nextUs_ = micros();
+  if (enabled_) {
+    PTZ_LOGI("FREED", "FreeD output to %s:%u at %u Hz", kFreedTargetIp, port_, kFreedRateHz);
+  }
+}
+
+void PtzFreed::loop(uint32_t nowUs, PtzMotion& motion) {
+  if (!enabled_ || static_cast<int32_t>(nowUs - nextUs_) < 0) {
+    return;
+  }
+
+  const uint32_t lateUs = nowUs - nextUs_;
+  if (lateUs >= periodUs_) {
+    // Resynchronise instead of bursting to catch up.
+    stats_.skipped += lateUs / periodUs_;
+    nextUs_ = nowUs + periodUs_;
+  } else {
+    nextUs_ += periodUs_;
+  }
+
+  jitter_.record(lateUs);
+
+  send(motion);
+
+  if (logShouldEmit(kLogRateFreedStats, 10000)) {
+    PTZ_LOGD("FREED", "sent=%lu skipped=%lu jitter p99=%luus max=%luus",
+             static_cast<unsigned long>(stats_.sent),
+             static_cast<unsigned long>(stats_.skipped),
+             static_cast<unsigned long>(jitter_.quantile(0.99f)),
+             static_cast<unsigned long>(jitter_.max()));
+  }
+}
+
+void PtzFreed::setRate(uint16_t hz) {
+  if (hz < kFreedMinRateHz) {
+    hz = kFreedMinRateHz;
+  } else if (hz > kFreedMaxRateHz) {
+    hz = kFreedMaxRateHz;
+  }
+  periodUs_ = 1000000UL / hz;
+}
+
+void PtzFreed::setTarget(const IPAddress& ip, uint16_t port) {
+  if (!enabled_) {
+    // The slot schedule went stale while stopped; start from now.
+    nextUs_ = micros();
+  }
+  target_ = ip;
+  port_ = port;
+  enabled_ = true;
+  PTZ_LOGI("FREED", "FreeD output to %s:%u at %lu Hz", target_.toString().c_str(), port_,
+           static_cast<unsigned long>(1000000UL / periodUs_));
+}
+
+void PtzFreed::disable() {
+  enabled_ = false;
+}
+
+bool PtzFreed::enabled() const {
+  return enabled_;
+}
+
+IPAddress PtzFreed::target() const {
+  return target_;
+}
+
+uint16_t PtzFreed::port() const {
+  return port_;
+}
+
+uint16_t PtzFreed::rateHz() const {
+  return static_cast<uint16_t>(1000000UL / periodUs_);
+}
+
+FreedStats PtzFreed::stats() const {
+  return stats_;
+}
+
+const LatencyHistogram& PtzFreed::jitter() const {
+  return jitter_;
+}
+
+void PtzFreed::resetStats() {
+  stats_ = {};
+  jitter_.reset();
+}
+
+void PtzFreed::send(PtzMotion& motion) {
+  const MotionState state = motion.state();
+
+  uint8_t packet[kD1Size] = {};
+  packet[0] = 0xD1;
+  packet[1] = kFreedCameraId;
+  uint8_t* p = &packet[2];
+  p = writeS24(p, angleToFreed(state.pos[kAxisPan] / kPanStepsPerDegree + kPanZeroDegrees));
+  p = writeS24(p, angleToFreed(state.pos[kAxisTilt] / kTiltStepsPerDegree + kTiltZeroDegrees));
+  p = writeS24(p, 0); // roll
+  p = writeS24(p, 0); // x
+  p = writeS24(p, 0); // y
+  p = writeS24(p, 0); // z
+  long zoom = lroundf(state.pos[kAxisZoom] * kZoomFreedScale);
+  if (zoom < 0) {
+    zoom = 0;
+  }
+  p = writeS24(p, static_cast<int32_t>(zoom));
+  writeS24(p, 0); // focus
+
+  uint8_t sum = 0x40;
+  for (size_t i = 0; i < kD1Size - 1; ++i) {
+    sum = static_cast<uint8_t>(sum - packet[i]);
+  }
+  packet[kD1Size - 1] = sum;
+
+  udp_.beginPacket(target_, port_);
+  udp_.write(packet, sizeof(packet));
+  udp_.endPacket();
+  ++stats_.sent;
+}
+
+} // namespace ptz
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <WiFiUdp.h>
+#include <stdint.h>
+
+#include "ptz_metrics.h"
+#include "ptz_motion.h"
+
+namespace ptz {
+
+struct FreedStats {
+  uint32_t sent;
+  uint32_t skipped; // send slots missed because the loop ran late
+};
+
+// Streams FreeD D1 camera pose packets derived from MotionState. Output
+// starts once a target is set, at boot when kFreedEnabled is true or later
+// with setTarget() (the WebSocket setFreed command).
+class PtzFreed {
+ public:
+  void begin();
+  void loop(uint32_t nowUs, PtzMotion& motion);
+
+  void setRate(uint16_t hz);
+  void setTarget(const IPAddress& ip, uint16_t port);
+  void disable();
+
+  bool enabled() const;
+  IPAddress target() const;
+  uint16_t port() const;
+  uint16_t rateHz() const;
+
+  FreedStats stats() const;
+  // Lateness of each packet against its send slot.
+  const LatencyHistogram& jitter() const;
+  void resetStats();
+
+ private:
+  void send(PtzMotion& motion);
+
+  WiFiUDP udp_;
+  IPAddress target_;
+  uint16_t port_ = 0;
+  bool enabled_ = false;
+
+  uint32_t periodUs_ = 0;
+  uint32_t nextUs_ = 0;
+
+  FreedStats stats_ = {};
+  LatencyHistogram jitter_;
+};
+
+} // namespace ptz
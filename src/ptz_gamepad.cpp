@@ -14,6 +14,7 @@ uint32_t PtzGamepad::takeControlStartMs_ = 0;
 uint32_t PtzGamepad::presetHoldStartMs_[4] = {0, 0, 0, 0};
 bool PtzGamepad::presetConsumed_[4] = {false, false, false, false};
 bool PtzGamepad::presetPrevPressed_[4] = {false, false, false, false};
+uint8_t PtzGamepad::profileDpadPrev_ = 0;
 
 static float int16ToNorm(int16_t value) {
   float x = static_cast<float>(value) / 512.0f;
@@ -42,12 +43,67 @@ static float applyDeadzone(float x) {
   return sign * applyExpo(scaled);
 }
 
-void PtzGamepad::begin() {
+void PtzGamepad::begin(GamepadReportHandler onReport) {
+  onReport_ = onReport;
   BP32.setup(&PtzGamepad::onConnect, &PtzGamepad::onDisconnect);
 }
 
-void PtzGamepad::update() {
-  BP32.update();
+bool PtzGamepad::poll() {
+  if (!BP32.update()) {
+    return false;
+  }
+  GamepadPtr gp = firstConnected();
+  if (!gp) {
+    return true;
+  }
+  GamepadCommands cmd;
+  takeReport(gp, cmd);
+  cmd.reportUs = micros();
+  if (onReport_) {
+    onReport_(cmd);
+  }
+  return true;
+}
+
+void PtzGamepad::takeReport(GamepadPtr gp, GamepadCommands& cmd) {
+  Snapshot next;
+  next.axisX = gp->axisX();
+  next.axisY = gp->axisY();
+  next.axisRY = gp->axisRY();
+  next.dpad = gp->dpad();
+  next.a = gp->a();
+  next.b = gp->b();
+  next.x = gp->x();
+  next.y = gp->y();
+  next.l1 = gp->l1();
+  next.r1 = gp->r1();
+  const bool sticksMoved = !snapshotValid_ || next.axisX != snapshot_.axisX || next.axisY != snapshot_.axisY ||
+                           next.axisRY != snapshot_.axisRY;
+  snapshot_ = next;
+  snapshotValid_ = true;
+
+  if (sticksMoved) {
+    float sticks[3];
+    sticks[kAxisPan] = applyDeadzone(int16ToNorm(snapshot_.axisX));
+    sticks[kAxisTilt] = applyDeadzone(-int16ToNorm(snapshot_.axisY));
+    sticks[kAxisZoom] = applyDeadzone(-int16ToNorm(snapshot_.axisRY));
+    if (kInvertPan) {
+      sticks[kAxisPan] = -sticks[kAxisPan];
+    }
+    for (uint8_t i = 0; i < 3; ++i) {
+      if (sticks[i] != sticks_[i]) {
+        cmd.sticksChanged = true;
+        if (sticks_[i] == 0.0f) {
+          cmd.startMask |= static_cast<uint8_t>(1u << i);
+        }
+        sticks_[i] = sticks[i];
+      }
+    }
+  }
+  cmd.pan = sticks_[kAxisPan];
+  cmd.tilt = sticks_[kAxisTilt];
+  cmd.zoom = sticks_[kAxisZoom];
+  cmd.hasInput = (cmd.pan != 0.0f) || (cmd.tilt != 0.0f) || (cmd.zoom != 0.0f);
 }
 
 GamepadCommands PtzGamepad::readCommands(uint32_t nowMs) {
@@ -61,18 +117,27 @@ GamepadCommands PtzGamepad::readCommands(uint32_t nowMs) {
       presetConsumed_[i] = false;
       presetPrevPressed_[i] = false;
     }
+    profileDpadPrev_ = 0;
+    snapshotValid_ = false;
+    for (float& stick : sticks_) {
+      stick = 0.0f;
+    }
     return cmd;
   }
 
-  cmd.pan = applyDeadzone(int16ToNorm(gp->axisX()));
-  cmd.tilt = applyDeadzone(-int16ToNorm(gp->axisY()));
-  cmd.zoom = applyDeadzone(-int16ToNorm(gp->axisRY()));
-  if (kInvertPan) {
-    cmd.pan = -cmd.pan;
+  // A controller that connected without sending a report yet.
+  if (!snapshotValid_) {
+    takeReport(gp, cmd);
+    cmd.reportUs = micros();
   }
+  const Snapshot& gs = snapshot_;
+
+  cmd.pan = sticks_[kAxisPan];
+  cmd.tilt = sticks_[kAxisTilt];
+  cmd.zoom = sticks_[kAxisZoom];
   cmd.hasInput = (cmd.pan != 0.0f) || (cmd.tilt != 0.0f) || (cmd.zoom != 0.0f);
 
-  const bool presetPressed[4] = {gp->a(), gp->b(), gp->x(), gp->y()};
+  const bool presetPressed[4] = {gs.a, gs.b, gs.x, gs.y};
   for (uint8_t i = 0; i < 4; ++i) {
     if (presetPressed[i]) {
       if (!presetPrevPressed_[i]) {
@@ -94,7 +159,17 @@ GamepadCommands PtzGamepad::readCommands(uint32_t nowMs) {
     presetPrevPressed_[i] = presetPressed[i];
   }
 
-  const bool provisioningCombo = gp->l1() && gp->r1() && gp->x() && gp->y();
+  // Edge-triggered so holding the combo steps one profile only.
+  const uint8_t profileDpad = (gs.l1 && !gs.r1) ? (gs.dpad & (DPAD_LEFT | DPAD_RIGHT)) : 0;
+  const uint8_t profilePressed = profileDpad & ~profileDpadPrev_;
+  if (profilePressed & DPAD_RIGHT) {
+    cmd.profileStep = 1;
+  } else if (profilePressed & DPAD_LEFT) {
+    cmd.profileStep = -1;
+  }
+  profileDpadPrev_ = profileDpad;
+
+  const bool provisioningCombo = gs.l1 && gs.r1 && gs.x && gs.y;
   if (provisioningCombo) {
     if (comboStartMs_ == 0) {
       comboStartMs_ = nowMs;
@@ -109,7 +184,7 @@ GamepadCommands PtzGamepad::readCommands(uint32_t nowMs) {
     comboStartMs_ = 0;
   }
 
-  const bool takeCombo = gp->l1() && gp->r1() && gp->a();
+  const bool takeCombo = gs.l1 && gs.r1 && gs.a;
   if (takeCombo) {
     if (takeControlStartMs_ == 0) {
       takeControlStartMs_ = nowMs;
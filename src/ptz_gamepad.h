@@ -15,12 +15,25 @@ struct GamepadCommands {
   bool presetSave = false;
   bool presetRecall = false;
   uint8_t presetIndex = 0;
+  int8_t profileStep = 0; // L1 + dpad left/right: -1 / +1
+  bool sticksChanged = false;
+  uint8_t startMask = 0; // axes whose stick just left the deadzone
+  uint32_t reportUs = 0; // micros() when the report was picked up
 };
 
+// Called with the sticks of each new report, change detection done.
+using GamepadReportHandler = void (*)(const GamepadCommands& commands);
+
+// Controller reports are pushed: poll() runs on every loop() pass and hands
+// a new report to the report handler in that same pass. Bluepad32's Arduino
+// API delivers reports only through BP32.update(), so that check stands in
+// for a data callback. readCommands() works from the cached snapshot, so
+// hold timers keep running without touching the controller.
 class PtzGamepad {
  public:
-  void begin();
-  void update();
+  void begin(GamepadReportHandler onReport);
+  // Returns true when Bluepad32 delivered a new report.
+  bool poll();
 
   GamepadCommands readCommands(uint32_t nowMs);
   bool isConnected() const;
@@ -30,6 +43,21 @@ class PtzGamepad {
   static void onConnect(GamepadPtr gp);
   static void onDisconnect(GamepadPtr gp);
   static GamepadPtr firstConnected();
+  // Caches the controller state and sets the stick fields of cmd.
+  void takeReport(GamepadPtr gp, GamepadCommands& cmd);
+
+  struct Snapshot {
+    int32_t axisX;
+    int32_t axisY;
+    int32_t axisRY;
+    uint8_t dpad;
+    bool a, b, x, y, l1, r1;
+  };
+
+  Snapshot snapshot_ = {};
+  bool snapshotValid_ = false;
+  GamepadReportHandler onReport_ = nullptr;
+  float sticks_[3] = {};
 
   static GamepadPtr gamepads_[BP32_MAX_GAMEPADS];
   static uint32_t comboStartMs_;
@@ -37,6 +65,7 @@ class PtzGamepad {
   static uint32_t presetHoldStartMs_[4];
   static bool presetConsumed_[4];
   static bool presetPrevPressed_[4];
+  static uint8_t profileDpadPrev_;
 };
 
 } // namespace ptz
@@ -0,0 +1,229 @@
+#include "ptz_group.h"
+
+#include "ptz_log.h"
+#include "ptz_serial.h"
+#include "ptz_wire.h"
+
+namespace ptz {
+
+static constexpr const char* kGroupNamespace = "ptzgroup";
+static constexpr uint8_t kGroupVersion = 1;
+static constexpr size_t kGroupHeaderSize = 10;
+static constexpr size_t kGroupMoveBaseSize = 12;
+static constexpr size_t kGroupMaxDatagram = kGroupHeaderSize + kGroupMoveBaseSize + kGroupMaxEntries * 7;
+
+void PtzGroup::begin(PtzOwner* owner, PtzMotion* motion, PtzPresets* presets) {
+  owner_ = owner;
+  motion_ = motion;
+  presets_ = presets;
+
+  prefs_.begin(kGroupNamespace, false);
+  groupId_ = prefs_.getUChar("group", kGroupDefaultId);
+  headId_ = prefs_.getUChar("head", kGroupDefaultHeadId);
+  if (!address_.fromString(kGroupMulticastIp)) {
+    PTZ_LOGW("GROUP", "Invalid group address %s", kGroupMulticastIp);
+    groupId_ = 0;
+  }
+  if (groupId_ != 0) {
+    PTZ_LOGI("GROUP", "Member of group %u as head %u", static_cast<unsigned>(groupId_),
+             static_cast<unsigned>(headId_));
+  }
+}
+
+void PtzGroup::loop(uint32_t nowMs, bool wifiConnected) {
+  const bool wanted = wifiConnected && groupId_ != 0;
+  if (!wanted) {
+    if (joined_) {
+      udp_.stop();
+      joined_ = false;
+    }
+    return;
+  }
+  if (!joined_) {
+    joined_ = udp_.beginMulticast(address_, kGroupPort) != 0;
+    if (!joined_) {
+      return;
+    }
+    PTZ_LOGI("GROUP", "Joined %s:%u", kGroupMulticastIp, kGroupPort);
+  }
+
+  for (uint8_t i = 0; i < kUdpMaxPacketsPerLoop; ++i) {
+    const int size = udp_.parsePacket();
+    if (size <= 0) {
+      break;
+    }
+    ++stats_.datagrams;
+
+    uint8_t packet[kGroupMaxDatagram];
+    if (static_cast<size_t>(size) > sizeof(packet)) {
+      ++stats_.malformed;
+      udp_.flush();
+      continue;
+    }
+    const int len = udp_.read(packet, sizeof(packet));
+    if (len < static_cast<int>(kGroupHeaderSize) || packet[0] != 'P' || packet[1] != 'G' ||
+        packet[2] != kGroupVersion) {
+      ++stats_.malformed;
+      continue;
+    }
+    handle(packet, static_cast<size_t>(len), nowMs);
+  }
+}
+
+bool PtzGroup::setMembership(uint8_t groupId, uint8_t headId) {
+  if (headId == kHeadAll) {
+    return false;
+  }
+  if (groupId != groupId_ || headId != headId_) {
+    groupId_ = groupId;
+    headId_ = headId;
+    prefs_.putUChar("group", groupId_);
+    prefs_.putUChar("head", headId_);
+    PTZ_LOGI("GROUP", "Membership group=%u head=%u", static_cast<unsigned>(groupId_),
+             static_cast<unsigned>(headId_));
+  }
+  return true;
+}
+
+uint8_t PtzGroup::groupId() const {
+  return groupId_;
+}
+
+uint8_t PtzGroup::headId() const {
+  return headId_;
+}
+
+bool PtzGroup::joined() const {
+  return joined_;
+}
+
+GroupStats PtzGroup::stats() const {
+  return stats_;
+}
+
+void PtzGroup::handle(const uint8_t* packet, size_t len, uint32_t nowMs) {
+  const uint8_t cmd = packet[3];
+  const uint32_t seq = readU32(packet + 4);
+  const uint8_t group = packet[8];
+  const uint8_t count = packet[9];
+  const uint8_t* body = packet + kGroupHeaderSize;
+  size_t bodyLen = len - kGroupHeaderSize;
+
+  if (group != groupId_) {
+    ++stats_.otherGroup;
+    return;
+  }
+
+  const uint8_t* base = nullptr;
+  size_t entrySize = 0;
+  switch (cmd) {
+    case kSerialCmdSetVelocity:
+      entrySize = 7;
+      break;
+    case kSerialCmdMoveTo:
+      if (bodyLen < kGroupMoveBaseSize) {
+        ++stats_.malformed;
+        return;
+      }
+      base = body;
+      body += kGroupMoveBaseSize;
+      bodyLen -= kGroupMoveBaseSize;
+      entrySize = 7;
+      break;
+    case kSerialCmdStop:
+      entrySize = 1;
+      break;
+    case kSerialCmdPresetRecall:
+      entrySize = 2;
+      break;
+    default:
+      ++stats_.malformed;
+      return;
+  }
+  if (count > kGroupMaxEntries || bodyLen != static_cast<size_t>(count) * entrySize) {
+    ++stats_.malformed;
+    return;
+  }
+
+  if (!seq_.accept(static_cast<uint32_t>(udp_.remoteIP()), seq, nowMs)) {
+    ++stats_.stale;
+    return;
+  }
+
+  const uint8_t* entry = findEntry(body, count, entrySize);
+  if (!entry) {
+    ++stats_.notAddressed;
+    return;
+  }
+
+  if (!claimControl(nowMs)) {
+    ++stats_.rejected;
+    if (logShouldEmit(kLogRateUdpReject, 1000)) {
+      PTZ_LOGW("GROUP", "Group %u ignored: head owned locally", static_cast<unsigned>(groupId_));
+    }
+    return;
+  }
+  ++stats_.applied;
+
+  const uint8_t* values = entry + 1;
+  switch (cmd) {
+    case kSerialCmdSetVelocity:
+      motion_->setAxisVelocity(kAxisPan, normFromI16(readI16(values)));
+      motion_->setAxisVelocity(kAxisTilt, normFromI16(readI16(values + 2)));
+      motion_->setAxisVelocity(kAxisZoom, normFromI16(readI16(values + 4)));
+      break;
+
+    case kSerialCmdMoveTo:
+      // Offsets let one recall-style move line every head up on a shared
+      // target despite differences in mounting.
+      motion_->moveAxisTo(kAxisPan, static_cast<float>(readI32(base) + readI16(values)));
+      motion_->moveAxisTo(kAxisTilt, static_cast<float>(readI32(base + 4) + readI16(values + 2)));
+      motion_->moveAxisTo(kAxisZoom, static_cast<float>(readI32(base + 8) + readI16(values + 4)));
+      break;
+
+    case kSerialCmdStop:
+      motion_->stop();
+      break;
+
+    case kSerialCmdPresetRecall: {
+      const Preset* preset = presets_->recall(values[0]);
+      if (!preset) {
+        PTZ_LOGW("PRESET", "Preset %u not set", static_cast<unsigned>(values[0]));
+        break;
+      }
+      motion_->moveTo(preset->pos);
+      break;
+    }
+  }
+}
+
+const uint8_t* PtzGroup::findEntry(const uint8_t* entries, uint8_t count, size_t entrySize) const {
+  const uint8_t* wildcard = nullptr;
+  for (uint8_t i = 0; i < count; ++i) {
+    const uint8_t* entry = entries + i * entrySize;
+    if (entry[0] == headId_) {
+      return entry;
+    }
+    if (entry[0] == kHeadAll && !wildcard) {
+      wildcard = entry;
+    }
+  }
+  return wildcard;
+}
+
+bool PtzGroup::claimControl(uint32_t nowMs) {
+  const uint32_t clientId = kGroupClientIdBase + groupId_;
+  const OwnerSnapshot snap = owner_->snapshot();
+  if (snap.owner == Owner::None) {
+    owner_->requestAppControl(clientId, nowMs);
+    PTZ_LOGI("OWNER", "Group %u took control", static_cast<unsigned>(groupId_));
+    return true;
+  }
+  if (snap.owner != Owner::App || snap.controlClientId != clientId) {
+    return false;
+  }
+  owner_->appHeartbeat(clientId, nowMs);
+  return true;
+}
+
+} // namespace ptz
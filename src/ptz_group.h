@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Preferences.h>
+#include <WiFiUdp.h>
+#include <stdint.h>
+
+#include "ptz_config.h"
+#include "ptz_motion.h"
+#include "ptz_owner.h"
+#include "ptz_presets.h"
+#include "ptz_udp.h"
+
+namespace ptz {
+
+struct GroupStats {
+  uint32_t datagrams;
+  uint32_t applied;
+  uint32_t stale;
+  uint32_t malformed;
+  uint32_t otherGroup;   // addressed to a group this head is not in
+  uint32_t notAddressed; // no entry for this head and no wildcard entry
+  uint32_t rejected;     // head owned by someone other than the group
+};
+
+// Multicast group control. Every member joins kGroupMulticastIp:kGroupPort
+// and a controller drives all of them with one datagram:
+//
+//   'P' 'G' | version | cmd | seq (uint32 LE) | group | count | [base] | entries
+//
+// cmd reuses the serial command table. Each entry starts with a head id; the
+// head applies the entry carrying its own id, else the wildcard entry
+// (kHeadAll) if present:
+//
+//   kSerialCmdSetVelocity  entry: head | int16 pan, tilt, zoom (normalized)
+//   kSerialCmdMoveTo       base: int32 pan, tilt, zoom (steps)
+//                          entry: head | int16 pan, tilt, zoom offset (steps)
+//   kSerialCmdStop         entry: head
+//   kSerialCmdPresetRecall entry: head | uint8 index
+//
+// The group acts as one app client (kGroupClientIdBase + group): it takes
+// control of a head nobody owns and keeps it with each datagram, but never
+// preempts a local app, serial or gamepad owner.
+class PtzGroup {
+ public:
+  static constexpr uint8_t kHeadAll = 0xFF;
+
+  void begin(PtzOwner* owner, PtzMotion* motion, PtzPresets* presets);
+  // Joins the multicast group once Wi-Fi is up and rejoins after a reconnect.
+  void loop(uint32_t nowMs, bool wifiConnected);
+
+  // Persists membership; group 0 leaves. headId kHeadAll is reserved.
+  bool setMembership(uint8_t groupId, uint8_t headId);
+  uint8_t groupId() const;
+  uint8_t headId() const;
+  bool joined() const;
+
+  GroupStats stats() const;
+
+ private:
+  void handle(const uint8_t* packet, size_t len, uint32_t nowMs);
+  const uint8_t* findEntry(const uint8_t* entries, uint8_t count, size_t entrySize) const;
+  bool claimControl(uint32_t nowMs);
+
+  WiFiUDP udp_;
+  Preferences prefs_;
+  PtzOwner* owner_ = nullptr;
+  PtzMotion* motion_ = nullptr;
+  PtzPresets* presets_ = nullptr;
+
+  IPAddress address_;
+  bool joined_ = false;
+  uint8_t groupId_ = kGroupDefaultId;
+  uint8_t headId_ = kGroupDefaultHeadId;
+
+  UdpSeqTracker seq_;
+  GroupStats stats_ = {};
+};
+
+} // namespace ptz
@@ -1,6 +1,9 @@
 #include "ptz_log.h"
 
 #include <stdarg.h>
+#include <string.h>
+
+#include "ptz_metrics.h"
 
 namespace ptz {
 
@@ -10,6 +13,36 @@ struct RateEntry {
 
 static RateEntry s_rateEntries[kLogRateCount];
 
+static uint8_t s_deferred[kLogDeferredLines][160];
+static uint8_t s_deferredLen[kLogDeferredLines];
+static uint8_t s_deferredHead = 0;
+static uint8_t s_deferredCount = 0;
+static uint32_t s_deferredDropped = 0;
+static bool s_deferring = false;
+
+static_assert(kLogTokenMaxPayload + 1 <= sizeof(s_deferred[0]), "Deferred slot must hold a token frame");
+
+// Holds an info/debug line while deferred; returns false when it should be
+// written now.
+static bool deferLine(LogLevel level, const uint8_t* data, size_t len) {
+  if (!s_deferring || level < LogLevel::Info) {
+    return false;
+  }
+  if (s_deferredCount == kLogDeferredLines) {
+    s_deferredHead = (s_deferredHead + 1) % kLogDeferredLines;
+    --s_deferredCount;
+    ++s_deferredDropped;
+  }
+  const uint8_t slot = (s_deferredHead + s_deferredCount) % kLogDeferredLines;
+  if (len > sizeof(s_deferred[0])) {
+    len = sizeof(s_deferred[0]);
+  }
+  memcpy(s_deferred[slot], data, len);
+  s_deferredLen[slot] = static_cast<uint8_t>(len);
+  ++s_deferredCount;
+  return true;
+}
+
 void logInit() {
   Serial.flush();
 }
@@ -34,13 +67,114 @@ void logMessage(LogLevel level, const char* tag, const char* fmt, ...) {
     return;
   }
 
+  AllocScope scope(kAllocLog);
   char buffer[256];
   va_list args;
   va_start(args, fmt);
   vsnprintf(buffer, sizeof(buffer), fmt, args);
   va_end(args);
 
+  if (s_deferring && level >= LogLevel::Info) {
+    char line[sizeof(s_deferred[0])];
+    const int len = snprintf(line, sizeof(line), "[%s] %s | %s\n", kLevelNames[levelIndex], tag, buffer);
+    if (len > 0) {
+      deferLine(level, reinterpret_cast<const uint8_t*>(line),
+                len < static_cast<int>(sizeof(line)) ? static_cast<size_t>(len) : sizeof(line) - 1);
+    }
+    return;
+  }
+
   Serial.printf("[%s] %s | %s\n", kLevelNames[levelIndex], tag, buffer);
 }
 
+void LogArgWriter::putInt(int64_t value) {
+  uint64_t zigzag = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+  uint8_t bytes[10];
+  uint8_t count = 0;
+  do {
+    const uint8_t byte = static_cast<uint8_t>(zigzag & 0x7F);
+    zigzag >>= 7;
+    bytes[count++] = zigzag ? static_cast<uint8_t>(byte | 0x80) : byte;
+  } while (zigzag);
+  if (overflowed_ || size_ + count > sizeof(buffer_)) {
+    overflowed_ = true;
+    return;
+  }
+  memcpy(&buffer_[size_], bytes, count);
+  size_ += count;
+}
+
+void LogArgWriter::putFloat(float value) {
+  if (overflowed_ || size_ + sizeof(value) > sizeof(buffer_)) {
+    overflowed_ = true;
+    return;
+  }
+  memcpy(&buffer_[size_], &value, sizeof(value));
+  size_ += sizeof(value);
+}
+
+void LogArgWriter::putString(const char* value) {
+  if (overflowed_ || size_ >= sizeof(buffer_)) {
+    overflowed_ = true;
+    return;
+  }
+  size_t len = value ? strlen(value) : 0;
+  if (len > kLogTokenMaxString) {
+    len = kLogTokenMaxString;
+  }
+  if (size_ + 1 + len > sizeof(buffer_)) {
+    len = sizeof(buffer_) - size_ - 1;
+  }
+  buffer_[size_++] = static_cast<uint8_t>(len);
+  memcpy(&buffer_[size_], value, len);
+  size_ += len;
+}
+
+static uint8_t* writeToken(uint8_t* p, uint32_t token) {
+  p[0] = static_cast<uint8_t>(token);
+  p[1] = static_cast<uint8_t>(token >> 8);
+  p[2] = static_cast<uint8_t>(token >> 16);
+  return p + 3;
+}
+
+// kLogFrameSof is not a valid first byte of UTF-8 text, and hosts parsing
+// serial control frames resynchronise on kSerialFrameSof and its CRC, so a
+// log frame costs them nothing but skipped bytes. An overflowed line is sent
+// as token 0 followed by its own token, without arguments.
+void logTokenFrame(LogLevel level, uint32_t token, LogArgWriter& writer) {
+  uint8_t frame[kLogTokenMaxPayload + 1];
+  frame[0] = kLogFrameSof;
+  uint8_t len = 0;
+  if (writer.overflowed()) {
+    writeToken(writeToken(&frame[1], kLogTokenOverflow), token);
+    len = 7;
+  } else {
+    writeToken(writer.data(), token);
+    memcpy(&frame[1], writer.data(), writer.size());
+    len = static_cast<uint8_t>(writer.size() + 1);
+  }
+
+  if (deferLine(level, frame, len)) {
+    return;
+  }
+  Serial.write(frame, len);
+}
+
+void logSetDeferred(bool deferred) {
+  s_deferring = deferred;
+}
+
+void logFlushDeferred() {
+  if (s_deferring || s_deferredCount == 0) {
+    return;
+  }
+  Serial.write(s_deferred[s_deferredHead], s_deferredLen[s_deferredHead]);
+  s_deferredHead = (s_deferredHead + 1) % kLogDeferredLines;
+  --s_deferredCount;
+}
+
+uint32_t logDeferredDropped() {
+  return s_deferredDropped;
+}
+
 } // namespace ptz
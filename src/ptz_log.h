@@ -1,6 +1,8 @@
 #pragma once
 
 #include <Arduino.h>
+#include <type_traits>
+
 #include "ptz_config.h"
 
 namespace ptz {
@@ -11,32 +13,104 @@ bool logShouldEmit(uint8_t id, uint32_t intervalMs);
 
 void logMessage(LogLevel level, const char* tag, const char* fmt, ...);
 
-#define PTZ_LOGE(tag, fmt, ...) \
-  do { \
-    if (ptz::kLogLevel >= ptz::LogLevel::Error) { \
-      ptz::logMessage(ptz::LogLevel::Error, tag, fmt, ##__VA_ARGS__); \
-    } \
-  } while (0)
+// While deferred, info and debug lines are held in a small ring (oldest
+// dropped when full) instead of blocking on the UART; errors and warnings
+// still print immediately. logFlushDeferred() prints one held line per call.
+void logSetDeferred(bool deferred);
+void logFlushDeferred();
+uint32_t logDeferredDropped();
 
-#define PTZ_LOGW(tag, fmt, ...) \
-  do { \
-    if (ptz::kLogLevel >= ptz::LogLevel::Warn) { \
-      ptz::logMessage(ptz::LogLevel::Warn, tag, fmt, ##__VA_ARGS__); \
-    } \
-  } while (0)
+// Tokenized builds (-DPTZ_LOG_TOKENIZED=1) keep no format strings in flash:
+// each call site is reduced at compile time to the low 24 bits of an FNV-1a
+// hash of "<level><tag>|<fmt>" and emits kLogFrameSof, the token and the
+// binary arguments, with no length, sequence or CRC: the format string tells
+// the decoder where the arguments end. tools/log_tokens.py builds the token
+// database from the sources (failing on collisions) and turns captured
+// frames back into text.
+#ifndef PTZ_LOG_TOKENIZED
+#define PTZ_LOG_TOKENIZED 0
+#endif
+
+constexpr uint32_t logHash(const char* s, uint32_t hash = 2166136261u) {
+  return *s ? logHash(s + 1, (hash ^ static_cast<uint8_t>(*s)) * 16777619u) : hash;
+}
+
+constexpr uint32_t logToken(const char* level, const char* tag, const char* fmt) {
+  return logHash(fmt, logHash("|", logHash(tag, logHash(level)))) & kLogTokenMask;
+}
+
+// Argument encoding: integers as zigzag varints (value-preserving, so the
+// decoder does not depend on signedness), floating point as float32,
+// strings as a length byte plus at most kLogTokenMaxString bytes. A string
+// is cut to the space left; any other argument that does not fit marks the
+// line as overflowed, since a partial varint could not be delimited.
+class LogArgWriter {
+ public:
+  void putInt(int64_t value);
+  void putFloat(float value);
+  void putString(const char* value);
+
+  uint8_t* data() { return buffer_; }
+  uint8_t size() const { return size_; }
+  bool overflowed() const { return overflowed_; }
 
-#define PTZ_LOGI(tag, fmt, ...) \
+ private:
+  uint8_t buffer_[kLogTokenMaxPayload];
+  uint8_t size_ = 3; // token
+  bool overflowed_ = false;
+};
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type logArg(
+    LogArgWriter& writer, T value) {
+  writer.putInt(static_cast<int64_t>(value));
+}
+
+inline void logArg(LogArgWriter& writer, double value) {
+  writer.putFloat(static_cast<float>(value));
+}
+
+inline void logArg(LogArgWriter& writer, const char* value) {
+  writer.putString(value);
+}
+
+inline void logArgs(LogArgWriter&) {}
+
+template <typename T, typename... Rest>
+inline void logArgs(LogArgWriter& writer, T value, Rest... rest) {
+  logArg(writer, value);
+  logArgs(writer, rest...);
+}
+
+void logTokenFrame(LogLevel level, uint32_t token, LogArgWriter& writer);
+
+template <typename... Args>
+inline void logTokenized(LogLevel level, uint32_t token, Args... args) {
+  LogArgWriter writer;
+  logArgs(writer, args...);
+  logTokenFrame(level, token, writer);
+}
+
+#if PTZ_LOG_TOKENIZED
+#define PTZ_LOG_AT(level, levelName, tag, fmt, ...) \
   do { \
-    if (ptz::kLogLevel >= ptz::LogLevel::Info) { \
-      ptz::logMessage(ptz::LogLevel::Info, tag, fmt, ##__VA_ARGS__); \
+    if (ptz::kLogLevel >= level) { \
+      constexpr uint32_t kLogToken = ptz::logToken(levelName, tag, fmt); \
+      ptz::logTokenized(level, kLogToken, ##__VA_ARGS__); \
     } \
   } while (0)
-
-#define PTZ_LOGD(tag, fmt, ...) \
+#else
+#define PTZ_LOG_AT(level, levelName, tag, fmt, ...) \
   do { \
-    if (ptz::kLogLevel >= ptz::LogLevel::Debug) { \
-      ptz::logMessage(ptz::LogLevel::Debug, tag, fmt, ##__VA_ARGS__); \
+    if (ptz::kLogLevel >= level) { \
+      ptz::logMessage(level, tag, fmt, ##__VA_ARGS__); \
     } \
   } while (0)
+#endif
+
+#define PTZ_LOGE(tag, fmt, ...) PTZ_LOG_AT(ptz::LogLevel::Error, "E", tag, fmt, ##__VA_ARGS__)
+#define PTZ_LOGW(tag, fmt, ...) PTZ_LOG_AT(ptz::LogLevel::Warn, "W", tag, fmt, ##__VA_ARGS__)
+#define PTZ_LOGI(tag, fmt, ...) PTZ_LOG_AT(ptz::LogLevel::Info, "I", tag, fmt, ##__VA_ARGS__)
+#define PTZ_LOGD(tag, fmt, ...) PTZ_LOG_AT(ptz::LogLevel::Debug, "D", tag, fmt, ##__VA_ARGS__)
 
 } // namespace ptz
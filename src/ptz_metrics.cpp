@@ -0,0 +1,249 @@
+#include "ptz_metrics.h"
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+#include "ptz_config.h"
+#include "ptz_log.h"
+
+namespace ptz {
+
+static const char* const kSubsystemNames[kAllocSubsystemCount] = {
+    "other", "websocket", "json", "log", "wifi", "tasks",
+};
+
+static const char* const kTaskNames[kStackTaskCount] = {
+    "loopTask", "tiT", "wifi", "sys_evt",
+};
+
+static volatile uint8_t s_allocSubsystem = kAllocOther;
+static TaskHandle_t s_loopTask = nullptr;
+static uint32_t s_allocCounts[kAllocSubsystemCount];
+
+AllocScope::AllocScope(AllocSubsystem subsystem) : previous_(s_allocSubsystem) {
+  s_allocSubsystem = subsystem;
+}
+
+AllocScope::~AllocScope() {
+  s_allocSubsystem = previous_;
+}
+
+// Bucket 4 * e + m holds values whose top set bit is e (bucket 0..3 take
+// 0..3 exactly) and whose next two bits are m.
+static uint8_t bucketIndex(uint32_t us) {
+  if (us < 4) {
+    return static_cast<uint8_t>(us);
+  }
+  const uint8_t exp = static_cast<uint8_t>(31 - __builtin_clz(us));
+  const uint8_t mantissa = static_cast<uint8_t>((us >> (exp - 2)) & 0x3);
+  return static_cast<uint8_t>(4 * (exp - 1) + mantissa);
+}
+
+static uint32_t bucketUpperBound(uint8_t index) {
+  if (index < 4) {
+    return index;
+  }
+  const uint8_t exp = static_cast<uint8_t>(index / 4 + 1);
+  const uint32_t mantissa = index % 4;
+  return ((4 + mantissa + 1) << (exp - 2)) - 1;
+}
+
+void LatencyHistogram::record(uint32_t us) {
+  uint8_t index = bucketIndex(us);
+  if (index >= kBucketCount) {
+    index = kBucketCount - 1;
+  }
+  ++buckets_[index];
+  ++count_;
+  if (us > max_) {
+    max_ = us;
+  }
+}
+
+void LatencyHistogram::reset() {
+  for (uint8_t i = 0; i < kBucketCount; ++i) {
+    buckets_[i] = 0;
+  }
+  count_ = 0;
+  max_ = 0;
+}
+
+uint32_t LatencyHistogram::quantile(float q) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  const uint32_t rank = static_cast<uint32_t>(q * (count_ - 1)) + 1;
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < kBucketCount; ++i) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      // The last bucket also holds everything past its range.
+      const uint32_t bound = i == kBucketCount - 1 ? max_ : bucketUpperBound(i);
+      return bound < max_ ? bound : max_;
+    }
+  }
+  return max_;
+}
+
+uint32_t LatencyHistogram::count() const {
+  return count_;
+}
+
+uint32_t LatencyHistogram::max() const {
+  return max_;
+}
+
+void PtzMetrics::begin() {
+  s_loopTask = xTaskGetCurrentTaskHandle();
+  sample();
+}
+
+void PtzMetrics::update(uint32_t nowMs) {
+  if (nowMs - lastSampleMs_ < kMetricsSampleMs) {
+    return;
+  }
+  lastSampleMs_ = nowMs;
+  sample();
+
+  // Warn once per threshold crossing; re-arm after recovery.
+  const bool heapLow = memory_.freeHeap < kHeapWarnFreeBytes;
+  if (heapLow && !heapWarned_) {
+    PTZ_LOGW("MEM", "Free heap low: %lu bytes (min %lu)",
+             static_cast<unsigned long>(memory_.freeHeap),
+             static_cast<unsigned long>(memory_.minFreeHeap));
+  }
+  heapWarned_ = heapLow;
+
+  const bool blockLow = memory_.largestFreeBlock < kHeapWarnBlockBytes;
+  if (blockLow && !blockWarned_) {
+    PTZ_LOGW("MEM", "Heap fragmented: largest block %lu bytes",
+             static_cast<unsigned long>(memory_.largestFreeBlock));
+  }
+  blockWarned_ = blockLow;
+
+  for (uint8_t i = 0; i < kStackTaskCount; ++i) {
+    const bool stackLow = tasks_[i] && memory_.stackFree[i] < kStackWarnBytes;
+    if (stackLow && !stackWarned_[i]) {
+      PTZ_LOGW("MEM", "Stack low in %s: %lu bytes free", kTaskNames[i],
+               static_cast<unsigned long>(memory_.stackFree[i]));
+    }
+    stackWarned_[i] = stackLow;
+  }
+}
+
+MemorySnapshot PtzMetrics::memory() const {
+  return memory_;
+}
+
+uint32_t PtzMetrics::allocCount(AllocSubsystem subsystem) const {
+  if (subsystem >= kAllocSubsystemCount) {
+    return 0;
+  }
+  return __atomic_load_n(&s_allocCounts[subsystem], __ATOMIC_RELAXED);
+}
+
+void PtzMetrics::recordLoop(uint32_t periodUs) {
+  loopPeriod_.record(periodUs);
+}
+
+void PtzMetrics::recordStatus(uint32_t nowUs, uint32_t intervalMs) {
+  if (lastStatusUs_ != 0) {
+    const int32_t deviation = static_cast<int32_t>(nowUs - lastStatusUs_ - intervalMs * 1000);
+    statusJitter_.record(static_cast<uint32_t>(deviation < 0 ? -deviation : deviation));
+  }
+  lastStatusUs_ = nowUs;
+}
+
+void PtzMetrics::recordStickLatency(uint32_t latencyUs) {
+  stickLatency_.record(latencyUs);
+}
+
+void PtzMetrics::recordOwnerChange() {
+  ++ownerChanges_;
+}
+
+void PtzMetrics::recordControlRejected() {
+  ++controlRejected_;
+}
+
+void PtzMetrics::resetTiming() {
+  loopPeriod_.reset();
+  statusJitter_.reset();
+  stickLatency_.reset();
+  ownerChanges_ = 0;
+  controlRejected_ = 0;
+}
+
+const LatencyHistogram& PtzMetrics::loopPeriod() const {
+  return loopPeriod_;
+}
+
+const LatencyHistogram& PtzMetrics::statusJitter() const {
+  return statusJitter_;
+}
+
+const LatencyHistogram& PtzMetrics::stickLatency() const {
+  return stickLatency_;
+}
+
+uint32_t PtzMetrics::ownerChanges() const {
+  return ownerChanges_;
+}
+
+uint32_t PtzMetrics::controlRejected() const {
+  return controlRejected_;
+}
+
+const char* PtzMetrics::subsystemName(uint8_t subsystem) {
+  return subsystem < kAllocSubsystemCount ? kSubsystemNames[subsystem] : "?";
+}
+
+const char* PtzMetrics::taskName(uint8_t index) {
+  return index < kStackTaskCount ? kTaskNames[index] : "?";
+}
+
+void PtzMetrics::sample() {
+  memory_.freeHeap = ESP.getFreeHeap();
+  memory_.minFreeHeap = ESP.getMinFreeHeap();
+  memory_.largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+  for (uint8_t i = 0; i < kStackTaskCount; ++i) {
+    if (!tasks_[i]) {
+      tasks_[i] = (i == 0) ? s_loopTask : xTaskGetHandle(kTaskNames[i]);
+    }
+    // ESP-IDF reports the high-water mark in bytes.
+    memory_.stackFree[i] = tasks_[i] ? uxTaskGetStackHighWaterMark(tasks_[i]) : 0;
+  }
+}
+
+} // namespace ptz
+
+namespace ptz {
+
+static void countAlloc() {
+  const uint8_t subsystem =
+      (xTaskGetCurrentTaskHandle() == s_loopTask) ? s_allocSubsystem : static_cast<uint8_t>(kAllocTasks);
+  __atomic_fetch_add(&s_allocCounts[subsystem], 1, __ATOMIC_RELAXED);
+}
+
+} // namespace ptz
+
+extern "C" void* __real_malloc(size_t size);
+extern "C" void* __real_calloc(size_t count, size_t size);
+extern "C" void* __real_realloc(void* ptr, size_t size);
+
+extern "C" void* __wrap_malloc(size_t size) {
+  ptz::countAlloc();
+  return __real_malloc(size);
+}
+
+extern "C" void* __wrap_calloc(size_t count, size_t size) {
+  ptz::countAlloc();
+  return __real_calloc(count, size);
+}
+
+// Every realloc counts: growing a block may move it.
+extern "C" void* __wrap_realloc(void* ptr, size_t size) {
+  ptz::countAlloc();
+  return __real_realloc(ptr, size);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdint.h>
+
+namespace ptz {
+
+enum AllocSubsystem : uint8_t {
+  kAllocOther = 0,
+  kAllocWebSocket,
+  kAllocJson,
+  kAllocLog,
+  kAllocWifi,
+  kAllocTasks, // allocations made by tasks other than loopTask
+  kAllocSubsystemCount,
+};
+
+constexpr uint8_t kStackTaskCount = 4;
+
+// Attributes heap allocations made by loopTask to a subsystem while in scope.
+// Counting relies on linking with --wrap for malloc, calloc and realloc
+// (see platformio.ini); free() is not tracked.
+class AllocScope {
+ public:
+  explicit AllocScope(AllocSubsystem subsystem);
+  ~AllocScope();
+
+ private:
+  uint8_t previous_;
+};
+
+struct MemorySnapshot {
+  uint32_t freeHeap;
+  uint32_t minFreeHeap;
+  uint32_t largestFreeBlock;
+  uint32_t stackFree[kStackTaskCount]; // bytes, 0 when the task is unknown
+};
+
+// Log-linear latency histogram: four buckets per power of two, so reported
+// quantiles are bucket upper bounds within 25% of the true value.
+class LatencyHistogram {
+ public:
+  void record(uint32_t us);
+  void reset();
+
+  uint32_t quantile(float q) const;
+  uint32_t count() const;
+  uint32_t max() const;
+
+ private:
+  static constexpr uint8_t kBucketCount = 4 * 24; // up to ~33 s
+
+  uint32_t buckets_[kBucketCount] = {};
+  uint32_t count_ = 0;
+  uint32_t max_ = 0;
+};
+
+class PtzMetrics {
+ public:
+  void begin();
+  void update(uint32_t nowMs);
+
+  MemorySnapshot memory() const;
+  uint32_t allocCount(AllocSubsystem subsystem) const;
+
+  // Time between successive loop() starts; this bounds step timing.
+  void recordLoop(uint32_t periodUs);
+  // Deviation of each status broadcast from the interval it was due at.
+  void recordStatus(uint32_t nowUs, uint32_t intervalMs);
+  // Gamepad report pickup to the first step it caused.
+  void recordStickLatency(uint32_t latencyUs);
+  void recordOwnerChange();
+  void recordControlRejected();
+  void resetTiming();
+
+  const LatencyHistogram& loopPeriod() const;
+  const LatencyHistogram& statusJitter() const;
+  const LatencyHistogram& stickLatency() const;
+  uint32_t ownerChanges() const;
+  uint32_t controlRejected() const;
+
+  static const char* subsystemName(uint8_t subsystem);
+  static const char* taskName(uint8_t index);
+
+ private:
+  void sample();
+
+  TaskHandle_t tasks_[kStackTaskCount] = {};
+  MemorySnapshot memory_ = {};
+  uint32_t lastSampleMs_ = 0;
+  bool heapWarned_ = false;
+  bool blockWarned_ = false;
+  bool stackWarned_[kStackTaskCount] = {};
+
+  LatencyHistogram loopPeriod_;
+  LatencyHistogram statusJitter_;
+  LatencyHistogram stickLatency_;
+  uint32_t lastStatusUs_ = 0;
+  uint32_t ownerChanges_ = 0;
+  uint32_t controlRejected_ = 0;
+};
+
+} // namespace ptz
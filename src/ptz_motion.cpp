@@ -3,146 +3,430 @@
 #include <Arduino.h>
 #include <math.h>
 
-#include "ptz_config.h"
+#include "ptz_log.h"
 
 namespace ptz {
 
-PtzMotion::PtzMotion()
-    : pan_(AccelStepper::DRIVER, kPanStepPin, kPanDirPin),
-      tilt_(AccelStepper::DRIVER, kTiltStepPin, kTiltDirPin),
-      zoom_(AccelStepper::DRIVER, kZoomStepPin, kZoomDirPin) {}
+#define PTZ_AXIS_STEPPER(id, name, step, dir, en, maxSps, accel, slew, idleMs, hold) AccelStepper(AccelStepper::DRIVER, step, dir),
 
-void PtzMotion::begin() {
-  pan_.setMaxSpeed(kPanMaxSps);
-  pan_.setAcceleration(kPanAccel);
-  pan_.setEnablePin(kPanEnPin);
-  pan_.setPinsInverted(false, false, true);
+PtzMotion::PtzMotion() : steppers_{PTZ_AXIS_LIST(PTZ_AXIS_STEPPER)} {
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    mode_[i] = AxisMode::Position;
+    target_[i] = 0.0f;
+    velocity_[i] = 0.0f;
+    output_[i] = 0.0f;
+    velocityCmd_[i] = 0.0f;
+    lastNorm_[i] = 0.0f;
+    braking_[i] = false;
+    pendingMove_[i] = false;
+    limits_[i].maxSps = kAxes[i].maxSps;
+    limits_[i].accel = kAxes[i].accel;
+    limits_[i].slewSps2 = kAxes[i].slewSps2;
+    maxSpeedPending_[i] = false;
+    shaperPending_[i] = false;
+    energized_[i] = false;
+    waking_[i] = false;
+    readyAtUs_[i] = 0;
+    idleSinceMs_[i] = 0;
+    idleMs_[i] = kAxes[i].idleMs;
+    hold_[i] = kAxes[i].hold;
+    energizedMs_[i] = 0;
+  }
+}
 
-  tilt_.setMaxSpeed(kTiltMaxSps);
-  tilt_.setAcceleration(kTiltAccel);
-  tilt_.setEnablePin(kTiltEnPin);
-  tilt_.setPinsInverted(false, false, true);
+#undef PTZ_AXIS_STEPPER
 
-  zoom_.setMaxSpeed(kZoomMaxSps);
-  zoom_.setAcceleration(kZoomAccel);
-  zoom_.setEnablePin(kZoomEnPin);
-  zoom_.setPinsInverted(false, false, true);
+void PtzMotion::begin() {
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    steppers_[i].setMaxSpeed(limits_[i].maxSps);
+    steppers_[i].setAcceleration(limits_[i].accel);
+    steppers_[i].setEnablePin(kAxes[i].enPin);
+    steppers_[i].setPinsInverted(false, false, true);
+  }
 
   setEnabled(false);
 }
 
 void PtzMotion::update(float dtSeconds) {
-  const float panMaxDelta = kPanSlewSps2 * dtSeconds;
-  const float tiltMaxDelta = kTiltSlewSps2 * dtSeconds;
-  const float zoomMaxDelta = kZoomSlewSps2 * dtSeconds;
-
-  const float panDelta = panVelocityCmd_ - panVelocity_;
-  const float tiltDelta = tiltVelocityCmd_ - tiltVelocity_;
-  const float zoomDelta = zoomVelocityCmd_ - zoomVelocity_;
-
-  if (panDelta > panMaxDelta) {
-    panVelocity_ += panMaxDelta;
-  } else if (panDelta < -panMaxDelta) {
-    panVelocity_ -= panMaxDelta;
-  } else {
-    panVelocity_ = panVelocityCmd_;
+  if (limitsPending_) {
+    applyLimits();
   }
-
-  if (tiltDelta > tiltMaxDelta) {
-    tiltVelocity_ += tiltMaxDelta;
-  } else if (tiltDelta < -tiltMaxDelta) {
-    tiltVelocity_ -= tiltMaxDelta;
-  } else {
-    tiltVelocity_ = tiltVelocityCmd_;
+  PTZ_UNROLL_AXES
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    updateAxis(i, dtSeconds);
   }
+}
 
-  if (zoomDelta > zoomMaxDelta) {
-    zoomVelocity_ += zoomMaxDelta;
-  } else if (zoomDelta < -zoomMaxDelta) {
-    zoomVelocity_ -= zoomMaxDelta;
-  } else {
-    zoomVelocity_ = zoomVelocityCmd_;
+void PtzMotion::run() {
+  PTZ_UNROLL_AXES
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    if (waking_[i]) {
+      if (static_cast<int32_t>(micros() - readyAtUs_[i]) < 0) {
+        continue;
+      }
+      waking_[i] = false;
+    }
+    if (mode_[i] == AxisMode::Velocity) {
+      steppers_[i].runSpeed();
+    } else {
+      steppers_[i].run();
+    }
+  }
+  if (probeMask_ != 0) {
+    checkStepProbe();
   }
+}
 
-  panTarget_ += panVelocity_ * dtSeconds;
-  tiltTarget_ += tiltVelocity_ * dtSeconds;
-  zoomTarget_ += zoomVelocity_ * dtSeconds;
+void PtzMotion::setVelocity(const float (&norm)[kAxisCount]) {
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    setAxisVelocity(i, norm[i]);
+  }
+}
 
-  pan_.moveTo(lroundf(panTarget_));
-  tilt_.moveTo(lroundf(tiltTarget_));
-  zoom_.moveTo(lroundf(zoomTarget_));
+void PtzMotion::setAxisVelocity(uint8_t axis, float norm) {
+  if (axis >= kAxisCount) {
+    return;
+  }
+  lastNorm_[axis] = norm;
+  if (norm != 0.0f) {
+    if (startHook_) {
+      startHook_();
+    }
+    wakeAxis(axis);
+  }
+  commandAxisVelocity(axis, norm * limits_[axis].maxSps);
 }
 
-void PtzMotion::run() {
-  pan_.run();
-  tilt_.run();
-  zoom_.run();
+void PtzMotion::moveTo(const float (&steps)[kAxisCount]) {
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    moveAxisTo(i, steps[i]);
+  }
 }
 
-void PtzMotion::setVelocity(float panNorm, float tiltNorm, float zoomNorm) {
-  panVelocityCmd_ = panNorm * kPanMaxSps;
-  tiltVelocityCmd_ = tiltNorm * kTiltMaxSps;
-  zoomVelocityCmd_ = zoomNorm * kZoomMaxSps;
+void PtzMotion::moveAxisTo(uint8_t axis, float steps) {
+  if (axis >= kAxisCount || !isfinite(steps)) {
+    return;
+  }
+  steps = constrain(steps, -kMaxTargetSteps, kMaxTargetSteps);
+  lastNorm_[axis] = 0.0f;
+  target_[axis] = steps;
+  if (startHook_ && lroundf(steps) != steppers_[axis].currentPosition()) {
+    startHook_();
+  }
+  wakeAxis(axis);
+  if (mode_[axis] == AxisMode::Velocity) {
+    velocityCmd_[axis] = 0.0f;
+    braking_[axis] = true;
+    pendingMove_[axis] = true;
+    return;
+  }
+  steppers_[axis].moveTo(lroundf(steps));
 }
 
-void PtzMotion::moveTo(float panSteps, float tiltSteps, float zoomSteps) {
-  panTarget_ = panSteps;
-  tiltTarget_ = tiltSteps;
-  zoomTarget_ = zoomSteps;
+void PtzMotion::stop() {
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    lastNorm_[i] = 0.0f;
+    stopAxis(i);
+  }
+}
 
-  pan_.moveTo(lroundf(panTarget_));
-  tilt_.moveTo(lroundf(tiltTarget_));
-  zoom_.moveTo(lroundf(zoomTarget_));
+void PtzMotion::setLimits(const MotionLimits& limits) {
+  pendingLimits_ = limits;
+  limitsPending_ = true;
 }
 
-void PtzMotion::stop() {
-  panTarget_ = static_cast<float>(pan_.currentPosition());
-  tiltTarget_ = static_cast<float>(tilt_.currentPosition());
-  zoomTarget_ = static_cast<float>(zoom_.currentPosition());
+const AxisLimits& PtzMotion::limits(uint8_t axis) const {
+  return limits_[axis < kAxisCount ? axis : 0];
+}
 
-  panVelocity_ = 0.0f;
-  tiltVelocity_ = 0.0f;
-  zoomVelocity_ = 0.0f;
-  panVelocityCmd_ = 0.0f;
-  tiltVelocityCmd_ = 0.0f;
-  zoomVelocityCmd_ = 0.0f;
+bool PtzMotion::setShaper(uint8_t axis, const ShaperConfig& config) {
+  float amplitude[InputShaper::kMaxImpulses];
+  float timeS[InputShaper::kMaxImpulses];
+  uint8_t count = 0;
+  if (axis >= kAxisCount || !InputShaper::impulses(config, amplitude, timeS, &count)) {
+    return false;
+  }
+  pendingShaper_[axis] = config;
+  shaperPending_[axis] = true;
+  return true;
+}
 
-  pan_.moveTo(lroundf(panTarget_));
-  tilt_.moveTo(lroundf(tiltTarget_));
-  zoom_.moveTo(lroundf(zoomTarget_));
+const ShaperConfig& PtzMotion::shaper(uint8_t axis) const {
+  axis = axis < kAxisCount ? axis : 0;
+  return shaperPending_[axis] ? pendingShaper_[axis] : shapers_[axis].config();
 }
 
 void PtzMotion::setEnabled(bool enabled) {
-  outputsEnabled_ = enabled;
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    setAxisEnabled(i, enabled);
+  }
+}
+
+void PtzMotion::setAxisEnabled(uint8_t axis, bool enabled) {
+  if (axis >= kAxisCount) {
+    return;
+  }
   if (enabled) {
-    pan_.enableOutputs();
-    tilt_.enableOutputs();
-    zoom_.enableOutputs();
-  } else {
-    pan_.disableOutputs();
-    tilt_.disableOutputs();
-    zoom_.disableOutputs();
+    wakeAxis(axis);
+    return;
   }
+  steppers_[axis].disableOutputs();
+  energized_[axis] = false;
+  waking_[axis] = false;
 }
 
 bool PtzMotion::enabled() const {
-  return outputsEnabled_;
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    if (energized_[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PtzMotion::axisEnabled(uint8_t axis) const {
+  return axis < kAxisCount && energized_[axis];
+}
+
+void PtzMotion::updatePower(uint32_t nowMs, bool owned) {
+  const uint32_t elapsedMs = nowMs - lastPowerMs_;
+  lastPowerMs_ = nowMs;
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    if (!energized_[i]) {
+      continue;
+    }
+    energizedMs_[i] += elapsedMs;
+
+    if (waking_[i] || axisMoving(i) || (hold_[i] == AxisHold::WhileOwned && owned)) {
+      idleSinceMs_[i] = nowMs;
+      continue;
+    }
+    if (idleMs_[i] == 0 || hold_[i] == AxisHold::Always || nowMs - idleSinceMs_[i] < idleMs_[i]) {
+      continue;
+    }
+    setAxisEnabled(i, false);
+    PTZ_LOGI("MOTION", "%s idle, driver disabled", kAxes[i].name);
+  }
+}
+
+uint32_t PtzMotion::energizedMs(uint8_t axis) const {
+  return axis < kAxisCount ? energizedMs_[axis] : 0;
+}
+
+void PtzMotion::setAxisPower(uint8_t axis, uint32_t idleMs, AxisHold hold) {
+  if (axis >= kAxisCount) {
+    return;
+  }
+  idleMs_[axis] = idleMs;
+  hold_[axis] = hold;
+}
+
+AxisHold PtzMotion::axisHold(uint8_t axis) const {
+  return axis < kAxisCount ? hold_[axis] : AxisHold::Free;
 }
 
 bool PtzMotion::isMoving() {
-  return pan_.distanceToGo() != 0 || tilt_.distanceToGo() != 0 || zoom_.distanceToGo() != 0;
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    if (axisMoving(i)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+float PtzMotion::stepRate(uint8_t axis) {
+  return axis < kAxisCount ? steppers_[axis].speed() : 0.0f;
 }
 
 MotionState PtzMotion::state() {
-  MotionState state{
-      static_cast<float>(pan_.currentPosition()),
-      static_cast<float>(tilt_.currentPosition()),
-      static_cast<float>(zoom_.currentPosition()),
-      panTarget_,
-      tiltTarget_,
-      zoomTarget_,
-  };
+  MotionState state;
+  PTZ_UNROLL_AXES
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    state.pos[i] = static_cast<float>(steppers_[i].currentPosition());
+    state.target[i] = target_[i];
+  }
   return state;
 }
 
+VelocityCommand PtzMotion::velocityCommand() const {
+  VelocityCommand cmd;
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    cmd.norm[i] = lastNorm_[i];
+  }
+  return cmd;
+}
+
+void PtzMotion::updateAxis(uint8_t axis, float dtSeconds) {
+  if (maxSpeedPending_[axis]) {
+    applyStepperMaxSpeed(axis);
+  }
+  // Hold the velocity ramp until the driver is awake so the first steps
+  // start from standstill.
+  if (waking_[axis]) {
+    return;
+  }
+  if (mode_[axis] != AxisMode::Velocity) {
+    if (shaperPending_[axis]) {
+      shapers_[axis].configure(pendingShaper_[axis]);
+      shaperPending_[axis] = false;
+    }
+    return;
+  }
+
+  AccelStepper& stepper = steppers_[axis];
+  const AxisLimits& limits = limits_[axis];
+  const float maxDelta = (braking_[axis] ? limits.accel : limits.slewSps2) * dtSeconds;
+  const float delta = velocityCmd_[axis] - velocity_[axis];
+  if (delta > maxDelta) {
+    velocity_[axis] += maxDelta;
+  } else if (delta < -maxDelta) {
+    velocity_[axis] -= maxDelta;
+  } else {
+    velocity_[axis] = velocityCmd_[axis];
+  }
+
+  output_[axis] = shapers_[axis].apply(velocity_[axis], dtSeconds);
+  stepper.setSpeed(output_[axis]);
+
+  if (velocity_[axis] != 0.0f || velocityCmd_[axis] != 0.0f || !shapers_[axis].settled()) {
+    // While braking into a queued move, target_ already holds its goal.
+    if (!pendingMove_[axis]) {
+      target_[axis] = static_cast<float>(stepper.currentPosition());
+    }
+    return;
+  }
+
+  // At rest with the shaper drained: hand over to position control.
+  // setCurrentPosition() clears AccelStepper's ramp state so the next move
+  // starts from standstill.
+  mode_[axis] = AxisMode::Position;
+  braking_[axis] = false;
+  stepper.setCurrentPosition(stepper.currentPosition());
+  if (!pendingMove_[axis]) {
+    target_[axis] = static_cast<float>(stepper.currentPosition());
+  }
+  pendingMove_[axis] = false;
+  stepper.moveTo(lroundf(target_[axis]));
+}
+
+void PtzMotion::applyLimits() {
+  limitsPending_ = false;
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    limits_[i] = pendingLimits_.axis[i];
+    // setAcceleration() rescales AccelStepper's ramp to keep the current speed.
+    steppers_[i].setAcceleration(limits_[i].accel);
+    maxSpeedPending_[i] = true;
+    applyStepperMaxSpeed(i);
+    if (mode_[i] == AxisMode::Velocity && !braking_[i]) {
+      velocityCmd_[i] = lastNorm_[i] * limits_[i].maxSps;
+    }
+  }
+}
+
+// AccelStepper clamps the running speed to a new maximum immediately, so a
+// lower cap is held back until the axis is already at or below it. In
+// position mode that is usually the deceleration at the end of the move.
+void PtzMotion::applyStepperMaxSpeed(uint8_t axis) {
+  const float speed = mode_[axis] == AxisMode::Velocity ? output_[axis] : steppers_[axis].speed();
+  if (fabsf(speed) > limits_[axis].maxSps) {
+    return;
+  }
+  steppers_[axis].setMaxSpeed(limits_[axis].maxSps);
+  maxSpeedPending_[axis] = false;
+}
+
+void PtzMotion::commandAxisVelocity(uint8_t axis, float velocitySps) {
+  if (mode_[axis] == AxisMode::Position) {
+    // A zero command must not cancel a position move in progress.
+    if (velocitySps == 0.0f) {
+      return;
+    }
+    mode_[axis] = AxisMode::Velocity;
+    velocity_[axis] = steppers_[axis].speed();
+    output_[axis] = velocity_[axis];
+    shapers_[axis].reset(velocity_[axis]);
+  }
+  velocityCmd_[axis] = velocitySps;
+  if (velocitySps != 0.0f) {
+    braking_[axis] = false;
+    pendingMove_[axis] = false;
+  }
+}
+
+void PtzMotion::stopAxis(uint8_t axis) {
+  if (mode_[axis] == AxisMode::Velocity) {
+    velocityCmd_[axis] = 0.0f;
+    braking_[axis] = true;
+    pendingMove_[axis] = false;
+    return;
+  }
+  steppers_[axis].stop();
+  target_[axis] = static_cast<float>(steppers_[axis].targetPosition());
+}
+
+bool PtzMotion::setPosition(uint8_t axis, long steps) {
+  if (axis >= kAxisCount || axisMoving(axis)) {
+    return false;
+  }
+  steppers_[axis].setCurrentPosition(steps);
+  mode_[axis] = AxisMode::Position;
+  target_[axis] = static_cast<float>(steps);
+  return true;
+}
+
+void PtzMotion::setStartHook(MotionStartFn hook) {
+  startHook_ = hook;
+}
+
+void PtzMotion::watchFirstStep(uint8_t axisMask, uint32_t sinceUs) {
+  probeMask_ = 0;
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    probeStart_[i] = steppers_[i].currentPosition();
+  }
+  probeSinceUs_ = sinceUs;
+  probeMask_ = axisMask;
+}
+
+bool PtzMotion::takeFirstStepLatency(uint32_t* latencyUs) {
+  if (!probeDone_) {
+    return false;
+  }
+  probeDone_ = false;
+  *latencyUs = probeLatencyUs_;
+  return true;
+}
+
+void PtzMotion::checkStepProbe() {
+  const uint32_t elapsedUs = micros() - probeSinceUs_;
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    if ((probeMask_ & (1u << i)) && steppers_[i].currentPosition() != probeStart_[i]) {
+      probeLatencyUs_ = elapsedUs;
+      probeDone_ = true;
+      probeMask_ = 0;
+      return;
+    }
+  }
+  if (elapsedUs > kStepProbeTimeoutUs) {
+    probeMask_ = 0;
+  }
+}
+
+void PtzMotion::wakeAxis(uint8_t axis) {
+  if (energized_[axis]) {
+    return;
+  }
+  steppers_[axis].enableOutputs();
+  energized_[axis] = true;
+  waking_[axis] = true;
+  readyAtUs_[axis] = micros() + kAxisWakeUs;
+  idleSinceMs_[axis] = millis();
+}
+
+bool PtzMotion::axisMoving(uint8_t axis) {
+  if (mode_[axis] == AxisMode::Velocity) {
+    return velocity_[axis] != 0.0f || velocityCmd_[axis] != 0.0f || !shapers_[axis].settled();
+  }
+  return steppers_[axis].distanceToGo() != 0;
+}
+
 } // namespace ptz
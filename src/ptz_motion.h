@@ -2,17 +2,33 @@
 
 #include <AccelStepper.h>
 
+#include "ptz_config.h"
+#include "ptz_shaper.h"
+
 namespace ptz {
 
 struct MotionState {
-  float panPos;
-  float tiltPos;
-  float zoomPos;
-  float panTarget;
-  float tiltTarget;
-  float zoomTarget;
+  float pos[kAxisCount];
+  float target[kAxisCount];
+};
+
+struct VelocityCommand {
+  float norm[kAxisCount];
+};
+
+struct AxisLimits {
+  float maxSps;
+  float accel;
+  float slewSps2;
+};
+
+struct MotionLimits {
+  AxisLimits axis[kAxisCount];
 };
 
+// Called from a motion command before it can release the first step.
+typedef void (*MotionStartFn)();
+
 class PtzMotion {
  public:
   PtzMotion();
@@ -21,34 +37,116 @@ class PtzMotion {
   void update(float dtSeconds);
   void run();
 
-  void setVelocity(float panNorm, float tiltNorm, float zoomNorm);
-  void moveTo(float panSteps, float tiltSteps, float zoomSteps);
+  void setVelocity(const float (&norm)[kAxisCount]);
+  void setAxisVelocity(uint8_t axis, float norm);
+  void moveTo(const float (&steps)[kAxisCount]);
+  void moveAxisTo(uint8_t axis, float steps);
   void stop();
+  // Sets the step count of an axis at rest without stepping (position
+  // resume at boot). Returns false while the axis moves.
+  bool setPosition(uint8_t axis, long steps);
+  // Runs on every command that may start an axis (a non-zero velocity or a
+  // move off the current step), inside the command, so whatever it does
+  // happens before that command's first step.
+  void setStartHook(MotionStartFn hook);
+
+  // Queues new per-axis limits; all axes switch together at the start of the
+  // next update(). Running velocity commands are rescaled and reached under
+  // the slew limit, and a stepper's speed cap is only lowered once the axis
+  // has slowed below it, so the switch never steps the velocity. A position
+  // move is not re-planned: it keeps its cruise speed and only decelerates
+  // at the end, so a lower maxSps normally takes effect from the next move.
+  void setLimits(const MotionLimits& limits);
+  const AxisLimits& limits(uint8_t axis) const;
 
+  // Per-axis input shaper on the velocity-mode stream (joystick drives and
+  // the braking that ends them). A new configuration is held until the axis
+  // leaves velocity mode so the shaped output never jumps. Position moves are
+  // not shaped: AccelStepper plans and times their steps itself.
+  bool setShaper(uint8_t axis, const ShaperConfig& config);
+  const ShaperConfig& shaper(uint8_t axis) const;
+
+  // Per-axis driver power. A motion command energizes its axis on demand and
+  // holds the first step for kAxisWakeUs while the driver wakes; enabling
+  // ahead of time (e.g. when control is taken) skips that wait.
   void setEnabled(bool enabled);
-  bool enabled() const;
+  void setAxisEnabled(uint8_t axis, bool enabled);
+  bool enabled() const; // any axis energized
+  bool axisEnabled(uint8_t axis) const;
+  // Applies each axis's idle timeout and hold rule and accounts energized
+  // time; owned tells whether anyone controls the head.
+  void updatePower(uint32_t nowMs, bool owned);
+  uint32_t energizedMs(uint8_t axis) const;
+  // Idle timeout and hold rule, kAxes unless overridden.
+  void setAxisPower(uint8_t axis, uint32_t idleMs, AxisHold hold);
+  AxisHold axisHold(uint8_t axis) const;
+
   bool isMoving();
+  // Step rate the axis's stepper is running at (steps/s, signed).
+  float stepRate(uint8_t axis);
+
+  // Latency probe: measures from sinceUs to the first step taken by any axis
+  // in axisMask (bit per AxisId). Arming again replaces a pending probe.
+  void watchFirstStep(uint8_t axisMask, uint32_t sinceUs);
+  bool takeFirstStepLatency(uint32_t* latencyUs);
 
   MotionState state();
+  VelocityCommand velocityCommand() const;
 
  private:
-  AccelStepper pan_;
-  AccelStepper tilt_;
-  AccelStepper zoom_;
+  enum class AxisMode : uint8_t {
+    Position, // AccelStepper ramps to a target via run()
+    Velocity, // step rate set directly via runSpeed()
+  };
+
+  // In velocity mode the step rate follows the commanded velocity under the
+  // slew limit; a moveTo or stop issued while moving first brakes to zero at
+  // the axis acceleration, then hands over to position control so AccelStepper
+  // never starts a ramp at non-zero speed.
+  void updateAxis(uint8_t axis, float dtSeconds);
+  void applyLimits();
+  void applyStepperMaxSpeed(uint8_t axis);
+  void commandAxisVelocity(uint8_t axis, float velocitySps);
+  void stopAxis(uint8_t axis);
+  bool axisMoving(uint8_t axis);
+  void wakeAxis(uint8_t axis);
+  void checkStepProbe();
+
+  // Struct-of-arrays axis state, indexed by AxisId.
+  AccelStepper steppers_[kAxisCount];
+  AxisMode mode_[kAxisCount];
+  float target_[kAxisCount];
+  float velocity_[kAxisCount]; // slew-limited, before shaping
+  float output_[kAxisCount];   // shaped step rate handed to the stepper
+  float velocityCmd_[kAxisCount];
+  float lastNorm_[kAxisCount];
+  bool braking_[kAxisCount];
+  bool pendingMove_[kAxisCount];
+  AxisLimits limits_[kAxisCount];
+  bool maxSpeedPending_[kAxisCount];
+  InputShaper shapers_[kAxisCount];
+  ShaperConfig pendingShaper_[kAxisCount];
+  bool shaperPending_[kAxisCount];
 
-  float panTarget_ = 0.0f;
-  float tiltTarget_ = 0.0f;
-  float zoomTarget_ = 0.0f;
+  MotionLimits pendingLimits_;
+  bool limitsPending_ = false;
 
-  float panVelocity_ = 0.0f;
-  float tiltVelocity_ = 0.0f;
-  float zoomVelocity_ = 0.0f;
+  bool energized_[kAxisCount];
+  bool waking_[kAxisCount];
+  uint32_t readyAtUs_[kAxisCount];
+  uint32_t idleSinceMs_[kAxisCount];
+  uint32_t idleMs_[kAxisCount];
+  AxisHold hold_[kAxisCount];
+  uint32_t energizedMs_[kAxisCount];
+  uint32_t lastPowerMs_ = 0;
 
-  float panVelocityCmd_ = 0.0f;
-  float tiltVelocityCmd_ = 0.0f;
-  float zoomVelocityCmd_ = 0.0f;
+  MotionStartFn startHook_ = nullptr;
 
-  bool outputsEnabled_ = false;
+  uint8_t probeMask_ = 0;
+  uint32_t probeSinceUs_ = 0;
+  long probeStart_[kAxisCount];
+  uint32_t probeLatencyUs_ = 0;
+  bool probeDone_ = false;
 };
 
 } // namespace ptz
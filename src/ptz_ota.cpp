@@ -0,0 +1,291 @@
+#include "ptz_ota.h"
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <Update.h>
+#include <esp_ota_ops.h>
+#include <mbedtls/sha256.h>
+#include <string.h>
+
+#include "ptz_log.h"
+
+// Called by the Arduino core at boot; returning true leaves a freshly
+// flashed image in PENDING_VERIFY until PtzOta confirms it.
+extern "C" bool verifyRollbackLater() {
+  return true;
+}
+
+namespace ptz {
+
+static int hexNibble(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+static bool parseSha256(const char* hex, uint8_t (&out)[32]) {
+  if (strlen(hex) != 64) {
+    return false;
+  }
+  for (uint8_t i = 0; i < 32; ++i) {
+    const int hi = hexNibble(hex[i * 2]);
+    const int lo = hexNibble(hex[i * 2 + 1]);
+    if (hi < 0 || lo < 0) {
+      return false;
+    }
+    out[i] = static_cast<uint8_t>((hi << 4) | lo);
+  }
+  return true;
+}
+
+void PtzOta::begin() {
+  esp_ota_img_states_t state;
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  if (running && esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY) {
+    pendingVerify_ = true;
+    PTZ_LOGW("OTA", "Running unconfirmed image from %s", running->label);
+  }
+}
+
+void PtzOta::loop(uint32_t nowMs, bool motionActive, bool wifiConnected) {
+  motionActive_ = motionActive;
+
+  if (pendingVerify_ && wifiConnected && nowMs >= kOtaHealthyMs) {
+    pendingVerify_ = false;
+    if (esp_ota_mark_app_valid_cancel_rollback() == ESP_OK) {
+      PTZ_LOGI("OTA", "Image confirmed");
+    } else {
+      PTZ_LOGE("OTA", "Failed to confirm image");
+    }
+  }
+
+  const OtaStatus current = status();
+  if (current.state != reportedState_) {
+    reportedState_ = current.state;
+    if (current.state == OtaState::Ready) {
+      const uint32_t kBps = current.activeMs ? current.bytes / current.activeMs : 0;
+      PTZ_LOGI("OTA", "Update verified %lu bytes at %lu kB/s (paused %lu ms)",
+               static_cast<unsigned long>(current.bytes), static_cast<unsigned long>(kBps),
+               static_cast<unsigned long>(current.pausedMs));
+    } else if (current.state == OtaState::Failed) {
+      PTZ_LOGW("OTA", "Update failed: %s after %lu bytes", current.error ? current.error : "?",
+               static_cast<unsigned long>(current.bytes));
+    }
+  }
+
+  if (rebootRequested_ && !motionActive) {
+    PTZ_LOGI("OTA", "Rebooting into new image");
+    Serial.flush();
+    ESP.restart();
+  }
+}
+
+bool PtzOta::start(const char* url, const char* sha256Hex) {
+  if (strlen(url) > kOtaUrlMaxLen || !parseSha256(sha256Hex, expectedSha_)) {
+    return false;
+  }
+
+  portENTER_CRITICAL(&lock_);
+  const bool busy = task_ != nullptr;
+  if (!busy) {
+    status_ = OtaStatus{};
+    status_.state = OtaState::Downloading;
+  }
+  portEXIT_CRITICAL(&lock_);
+  if (busy) {
+    return false;
+  }
+
+  strncpy(url_, url, sizeof(url_) - 1);
+  abort_ = false;
+  rebootRequested_ = false;
+
+  // Core 0 below the WiFi task: download work yields to the network stack and
+  // never competes with loopTask on core 1.
+  TaskHandle_t task = nullptr;
+  if (xTaskCreatePinnedToCore(&PtzOta::taskEntry, "ota", kOtaTaskStackBytes, this, kOtaTaskPriority, &task, 0) !=
+      pdPASS) {
+    finish(OtaState::Failed, "task");
+    return false;
+  }
+  portENTER_CRITICAL(&lock_);
+  if (status_.state == OtaState::Downloading) {
+    task_ = task;
+  }
+  portEXIT_CRITICAL(&lock_);
+  PTZ_LOGI("OTA", "Update started from %s", url_);
+  return true;
+}
+
+void PtzOta::abort() {
+  abort_ = true;
+}
+
+bool PtzOta::requestReboot() {
+  if (status().state != OtaState::Ready) {
+    return false;
+  }
+  rebootRequested_ = true;
+  return true;
+}
+
+OtaStatus PtzOta::status() const {
+  portENTER_CRITICAL(&lock_);
+  const OtaStatus status = status_;
+  portEXIT_CRITICAL(&lock_);
+  return status;
+}
+
+bool PtzOta::pendingVerify() const {
+  return pendingVerify_;
+}
+
+const char* PtzOta::stateName(OtaState state) {
+  switch (state) {
+    case OtaState::Downloading:
+      return "downloading";
+    case OtaState::Ready:
+      return "ready";
+    case OtaState::Failed:
+      return "failed";
+    case OtaState::Idle:
+      break;
+  }
+  return "idle";
+}
+
+void PtzOta::taskEntry(void* arg) {
+  static_cast<PtzOta*>(arg)->run();
+  vTaskDelete(nullptr);
+}
+
+void PtzOta::run() {
+  HTTPClient http;
+  http.setTimeout(kOtaStallTimeoutMs);
+  if (!http.begin(url_)) {
+    finish(OtaState::Failed, "url");
+    return;
+  }
+  const int code = http.GET();
+  if (code != HTTP_CODE_OK) {
+    http.end();
+    finish(OtaState::Failed, "http");
+    return;
+  }
+
+  const int size = http.getSize();
+  if (!Update.begin(size > 0 ? static_cast<size_t>(size) : UPDATE_SIZE_UNKNOWN)) {
+    http.end();
+    finish(OtaState::Failed, "no_space");
+    return;
+  }
+
+  portENTER_CRITICAL(&lock_);
+  status_.total = size > 0 ? static_cast<uint32_t>(size) : 0;
+  portEXIT_CRITICAL(&lock_);
+
+  mbedtls_sha256_context sha;
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts(&sha, 0);
+
+  uint8_t chunk[kOtaChunkBytes];
+  WiFiClient* stream = http.getStreamPtr();
+  uint32_t received = 0;
+  uint32_t lastDataMs = millis();
+  uint32_t lastTickMs = lastDataMs;
+  const char* error = nullptr;
+
+  while (size <= 0 || received < static_cast<uint32_t>(size)) {
+    const uint32_t nowMs = millis();
+    const uint32_t stepMs = nowMs - lastTickMs;
+    lastTickMs = nowMs;
+    if (abort_) {
+      error = "aborted";
+      break;
+    }
+
+    const bool paused = motionActive_;
+    portENTER_CRITICAL(&lock_);
+    if (paused) {
+      status_.pausedMs += stepMs;
+    } else {
+      status_.activeMs += stepMs;
+    }
+    status_.bytes = received;
+    portEXIT_CRITICAL(&lock_);
+
+    if (paused) {
+      lastDataMs = nowMs;
+      vTaskDelay(pdMS_TO_TICKS(20));
+      continue;
+    }
+
+    const int available = stream->available();
+    if (available <= 0) {
+      if (!http.connected()) {
+        if (size > 0) {
+          error = "truncated";
+        }
+        break;
+      }
+      if (nowMs - lastDataMs >= kOtaStallTimeoutMs) {
+        error = "timeout";
+        break;
+      }
+      vTaskDelay(pdMS_TO_TICKS(5));
+      continue;
+    }
+
+    const size_t want = static_cast<size_t>(available) < sizeof(chunk) ? available : sizeof(chunk);
+    const size_t count = stream->readBytes(chunk, want);
+    mbedtls_sha256_update(&sha, chunk, count);
+    if (Update.write(chunk, count) != count) {
+      error = "write";
+      break;
+    }
+    received += count;
+    lastDataMs = millis();
+  }
+  http.end();
+
+  portENTER_CRITICAL(&lock_);
+  status_.bytes = received;
+  portEXIT_CRITICAL(&lock_);
+
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&sha, digest);
+  mbedtls_sha256_free(&sha);
+
+  if (!error && memcmp(digest, expectedSha_, sizeof(digest)) != 0) {
+    error = "sha256";
+  }
+  if (error) {
+    Update.abort();
+    finish(OtaState::Failed, error);
+    return;
+  }
+  if (!Update.end(size <= 0)) {
+    finish(OtaState::Failed, "finalize");
+    return;
+  }
+  finish(OtaState::Ready, nullptr);
+}
+
+// Runs on the OTA task; reporting happens from loop() so the log module is
+// only ever used from loopTask.
+void PtzOta::finish(OtaState state, const char* error) {
+  portENTER_CRITICAL(&lock_);
+  status_.state = state;
+  status_.error = error;
+  task_ = nullptr;
+  portEXIT_CRITICAL(&lock_);
+}
+
+} // namespace ptz
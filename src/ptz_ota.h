@@ -0,0 +1,67 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdint.h>
+
+#include "ptz_config.h"
+
+namespace ptz {
+
+enum class OtaState : uint8_t {
+  Idle,
+  Downloading,
+  Ready, // image written and verified; takes effect on reboot
+  Failed,
+};
+
+struct OtaStatus {
+  OtaState state;
+  uint32_t bytes;
+  uint32_t total;     // 0 when the server sent no length
+  uint32_t activeMs;  // time spent receiving and writing
+  uint32_t pausedMs;  // time spent waiting for the head to stop
+  const char* error;  // static string, nullptr when none
+};
+
+// Pulls a firmware image over HTTP into the inactive OTA partition and checks
+// its SHA-256 before the partition is marked bootable.
+//
+// Flash erase/write stalls instruction fetch on both cores, so the task only
+// writes while the head is at rest and lets the TCP window hold the download
+// otherwise; a move starting mid-write waits for at most one chunk.
+class PtzOta {
+ public:
+  void begin();
+  // motionActive gates flash writes; also confirms a freshly booted image
+  // once it has proven healthy and performs a requested reboot at rest.
+  void loop(uint32_t nowMs, bool motionActive, bool wifiConnected);
+
+  bool start(const char* url, const char* sha256Hex);
+  void abort();
+  bool requestReboot();
+
+  OtaStatus status() const;
+  bool pendingVerify() const;
+  static const char* stateName(OtaState state);
+
+ private:
+  static void taskEntry(void* arg);
+  void run();
+  void finish(OtaState state, const char* error);
+
+  char url_[kOtaUrlMaxLen + 1] = {};
+  uint8_t expectedSha_[32] = {};
+
+  mutable portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;
+  OtaStatus status_ = {};
+  TaskHandle_t task_ = nullptr;
+  volatile bool motionActive_ = false;
+  volatile bool abort_ = false;
+
+  bool pendingVerify_ = false;
+  bool rebootRequested_ = false;
+  OtaState reportedState_ = OtaState::Idle;
+};
+
+} // namespace ptz
@@ -0,0 +1,193 @@
+#include "ptz_planner.h"
+
+#include <math.h>
+
+namespace ptz {
+
+static float minf(float a, float b) {
+  return a < b ? a : b;
+}
+
+void PtzPlanner::begin(PtzOwner* owner, PtzMotion* motion) {
+  owner_ = owner;
+  motion_ = motion;
+  flush();
+}
+
+void PtzPlanner::update(uint32_t nowMs) {
+  if (count_ == 0) {
+    return;
+  }
+
+  const OwnerSnapshot snap = owner_->snapshot();
+  if (snap.owner != Owner::App || snap.controlClientId != clientId_) {
+    flush();
+    return;
+  }
+  owner_->appHeartbeat(clientId_, nowMs);
+
+  const MotionState state = motion_->state();
+
+  while (count_ > 0) {
+    const Segment& seg = at(0);
+    float toTarget[kAxisCount];
+    float dist = 0.0f;
+    float along = 0.0f;
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      toTarget[i] = seg.target[i] - state.pos[i];
+      dist += toTarget[i] * toTarget[i];
+      along += toTarget[i] * seg.unit[i];
+    }
+    dist = sqrtf(dist);
+
+    if (count_ == 1 && (dist <= kPathSettleSteps || along <= 0.0f)) {
+      // Final waypoint: let position control settle exactly on it.
+      motion_->moveTo(seg.target);
+      flush();
+      return;
+    }
+
+    if (count_ > 1 && (dist <= blend_ || along <= 0.0f)) {
+      head_ = (head_ + 1) % kPathQueueSize;
+      --count_;
+      continue;
+    }
+
+    const float brake = sqrtf(seg.exitSpeed * seg.exitSpeed + 2.0f * seg.accel * (along > 0.0f ? along : 0.0f));
+    const float speed = minf(seg.speed, brake);
+    float velocity[kAxisCount];
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      // Clamped because queued feeds keep the limits they were planned with
+      // when a slower motion profile is selected mid-path.
+      const float norm = speed * toTarget[i] / dist / motion_->limits(i).maxSps;
+      velocity[i] = norm > 1.0f ? 1.0f : (norm < -1.0f ? -1.0f : norm);
+    }
+    motion_->setVelocity(velocity);
+    return;
+  }
+}
+
+bool PtzPlanner::append(const float (&target)[kAxisCount], float speedNorm, uint32_t clientId) {
+  if (count_ >= kPathQueueSize) {
+    return false;
+  }
+
+  float start[kAxisCount];
+  tail(start);
+
+  Segment seg;
+  float length = 0.0f;
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    seg.target[i] = target[i];
+    seg.unit[i] = seg.target[i] - start[i];
+    length += seg.unit[i] * seg.unit[i];
+  }
+  length = sqrtf(length);
+  if (length < 1.0f) {
+    return true;
+  }
+
+  // Feed and acceleration along the path, limited so no axis exceeds its own.
+  float maxSpeed = 1e9f;
+  float accel = 1e9f;
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    seg.unit[i] /= length;
+    const float share = fabsf(seg.unit[i]);
+    if (share > 1e-6f) {
+      maxSpeed = minf(maxSpeed, motion_->limits(i).maxSps / share);
+      accel = minf(accel, motion_->limits(i).slewSps2 * kPathAccelFraction / share);
+    }
+  }
+  if (speedNorm <= 0.0f || speedNorm > 1.0f) {
+    speedNorm = 1.0f;
+  }
+
+  seg.length = length;
+  seg.speed = maxSpeed * speedNorm;
+  seg.accel = accel;
+  seg.exitSpeed = 0.0f;
+
+  queue_[(head_ + count_) % kPathQueueSize] = seg;
+  ++count_;
+  clientId_ = clientId;
+  plan();
+  return true;
+}
+
+void PtzPlanner::tail(float (&out)[kAxisCount]) {
+  if (count_ > 0) {
+    const Segment& last = at(count_ - 1);
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      out[i] = last.target[i];
+    }
+    return;
+  }
+  const MotionState state = motion_->state();
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    out[i] = state.pos[i];
+  }
+}
+
+void PtzPlanner::flush() {
+  head_ = 0;
+  count_ = 0;
+}
+
+void PtzPlanner::setBlendTolerance(float steps) {
+  blend_ = steps < kPathSettleSteps ? kPathSettleSteps : steps;
+  plan();
+}
+
+float PtzPlanner::blendTolerance() const {
+  return blend_;
+}
+
+uint8_t PtzPlanner::depth() const {
+  return count_;
+}
+
+uint8_t PtzPlanner::space() const {
+  return kPathQueueSize - count_;
+}
+
+bool PtzPlanner::active() const {
+  return count_ > 0;
+}
+
+PtzPlanner::Segment& PtzPlanner::at(uint8_t index) {
+  return queue_[(head_ + index) % kPathQueueSize];
+}
+
+void PtzPlanner::plan() {
+  if (count_ == 0) {
+    return;
+  }
+
+  at(count_ - 1).exitSpeed = 0.0f;
+  for (int8_t k = static_cast<int8_t>(count_) - 2; k >= 0; --k) {
+    Segment& cur = at(k);
+    const Segment& next = at(k + 1);
+
+    // Junction deviation: the speed at which a circular arc tangent to both
+    // segments stays within blend_ of the corner under the path acceleration.
+    float cosTheta = 0.0f;
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      cosTheta -= cur.unit[i] * next.unit[i];
+    }
+    float junction;
+    if (cosTheta > 0.999999f) {
+      junction = 0.0f;
+    } else if (cosTheta < -0.999999f) {
+      junction = 1e9f;
+    } else {
+      const float sinHalf = sqrtf(0.5f * (1.0f - cosTheta));
+      junction = sqrtf(minf(cur.accel, next.accel) * blend_ * sinHalf / (1.0f - sinHalf));
+    }
+    junction = minf(junction, minf(cur.speed, next.speed));
+
+    const float reachable = sqrtf(next.exitSpeed * next.exitSpeed + 2.0f * next.accel * next.length);
+    cur.exitSpeed = minf(junction, reachable);
+  }
+}
+
+} // namespace ptz
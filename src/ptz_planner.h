@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ptz_config.h"
+#include "ptz_motion.h"
+#include "ptz_owner.h"
+
+namespace ptz {
+
+// Bounded queue of straight-line moves executed back to back.
+//
+// On every append a backward pass (as in grbl-style CNC planners) limits each
+// segment's exit speed to what the corner allows for the blend tolerance and
+// to what the remaining segments can still brake from. Execution steers the
+// velocity vector toward the active waypoint and switches to the next one
+// inside the blend radius, so corners are rounded instead of stopped at.
+class PtzPlanner {
+ public:
+  void begin(PtzOwner* owner, PtzMotion* motion);
+  void update(uint32_t nowMs);
+
+  // speedNorm scales the fastest feed the axis limits allow for the segment.
+  bool append(const float (&target)[kAxisCount], float speedNorm, uint32_t clientId);
+  // Target of the last queued segment, or the current position when empty.
+  void tail(float (&out)[kAxisCount]);
+  void flush();
+
+  void setBlendTolerance(float steps);
+  float blendTolerance() const;
+
+  uint8_t depth() const;
+  uint8_t space() const;
+  bool active() const;
+
+ private:
+  struct Segment {
+    float target[kAxisCount];
+    float unit[kAxisCount];
+    float length;
+    float speed;
+    float accel;
+    float exitSpeed;
+  };
+
+  Segment& at(uint8_t index);
+  void plan();
+
+  PtzOwner* owner_ = nullptr;
+  PtzMotion* motion_ = nullptr;
+
+  Segment queue_[kPathQueueSize];
+  uint8_t head_ = 0;
+  uint8_t count_ = 0;
+  uint32_t clientId_ = 0;
+  float blend_ = kPathDefaultBlendSteps;
+};
+
+} // namespace ptz
@@ -0,0 +1,100 @@
+#include "ptz_presets.h"
+
+#include <Arduino.h>
+
+#include "ptz_log.h"
+
+namespace ptz {
+
+static constexpr const char* kPresetNamespace = "ptzpreset";
+static constexpr uint8_t kPresetBlobVersion = 1;
+
+static_assert(kPresetCount <= 8, "PresetBlob holds one valid bit per preset");
+
+// A version or axis count mismatch discards every stored preset.
+struct PresetBlob {
+  uint8_t version;
+  uint8_t axisCount;
+  uint8_t validMask;
+  float pos[kPresetCount][kAxisCount];
+};
+
+void PtzPresets::begin() {
+  prefs_.begin(kPresetNamespace, false);
+  PresetBlob blob;
+  if (prefs_.getBytesLength("all") != sizeof(blob) || prefs_.getBytes("all", &blob, sizeof(blob)) != sizeof(blob)) {
+    return;
+  }
+  if (blob.version != kPresetBlobVersion || blob.axisCount != kAxisCount) {
+    PTZ_LOGW("PRESET", "Ignoring stored presets");
+    return;
+  }
+  uint8_t loaded = 0;
+  for (uint8_t i = 0; i < kPresetCount; ++i) {
+    if (!(blob.validMask & (1u << i))) {
+      continue;
+    }
+    for (uint8_t axis = 0; axis < kAxisCount; ++axis) {
+      presets_[i].pos[axis] = blob.pos[i][axis];
+    }
+    presets_[i].valid = true;
+    ++loaded;
+  }
+  PTZ_LOGI("PRESET", "Loaded %u presets", static_cast<unsigned>(loaded));
+}
+
+void PtzPresets::loop(bool moving) {
+  if (!dirty_ || moving) {
+    return;
+  }
+  PresetBlob blob = {};
+  blob.version = kPresetBlobVersion;
+  blob.axisCount = kAxisCount;
+  for (uint8_t i = 0; i < kPresetCount; ++i) {
+    if (!presets_[i].valid) {
+      continue;
+    }
+    blob.validMask |= static_cast<uint8_t>(1u << i);
+    for (uint8_t axis = 0; axis < kAxisCount; ++axis) {
+      blob.pos[i][axis] = presets_[i].pos[axis];
+    }
+  }
+  if (prefs_.putBytes("all", &blob, sizeof(blob)) != sizeof(blob)) {
+    PTZ_LOGW("PRESET", "Failed to store presets");
+  }
+  dirty_ = false;
+}
+
+bool PtzPresets::save(uint8_t index, const MotionState& state) {
+  if (index >= kPresetCount) {
+    return false;
+  }
+  Preset& preset = presets_[index];
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    preset.pos[i] = state.pos[i];
+  }
+  preset.valid = true;
+  dirty_ = true;
+  return true;
+}
+
+const Preset* PtzPresets::get(uint8_t index) const {
+  if (index >= kPresetCount || !presets_[index].valid) {
+    return nullptr;
+  }
+  return &presets_[index];
+}
+
+const Preset* PtzPresets::recall(uint8_t index) {
+  const Preset* preset = get(index);
+  if (preset && firstRecallMs_ == 0) {
+    firstRecallMs_ = millis() | 1;
+  }
+  return preset;
+}
+
+uint32_t PtzPresets::firstRecallMs() const {
+  return firstRecallMs_;
+}
+
+} // namespace ptz
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Preferences.h>
+#include <stdint.h>
+
+#include "ptz_config.h"
+#include "ptz_motion.h"
+
+namespace ptz {
+
+struct Preset {
+  float pos[kAxisCount] = {};
+  bool valid = false;
+};
+
+// Presets are kept in NVS so they stay meaningful once the position is
+// resumed after a reboot (ptz_resume.h). Like profiles, changes are written
+// only while the head is at rest.
+class PtzPresets {
+ public:
+  void begin();
+  void loop(bool moving);
+
+  bool save(uint8_t index, const MotionState& state);
+  const Preset* get(uint8_t index) const;
+  // get() for a recall; also notes the first recall since boot.
+  const Preset* recall(uint8_t index);
+  uint32_t firstRecallMs() const; // 0 until a preset has been recalled
+
+ private:
+  Preset presets_[kPresetCount];
+  Preferences prefs_;
+  bool dirty_ = false;
+  uint32_t firstRecallMs_ = 0;
+};
+
+} // namespace ptz
@@ -0,0 +1,209 @@
+#include "ptz_profiles.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ptz_log.h"
+
+namespace ptz {
+
+static constexpr const char* kProfileNamespace = "ptzprof";
+static constexpr uint8_t kProfileBlobVersion = 1;
+
+static_assert(kProfileCount >= 3, "Built-in profiles need three slots");
+static_assert(kProfileCount <= 8, "dirtyMask_ holds one bit per profile");
+
+// NVS record per profile; a version or axis count mismatch falls back to the
+// compiled-in default for that slot.
+struct ProfileBlob {
+  uint8_t version;
+  uint8_t axisCount;
+  MotionProfile profile;
+};
+
+struct ShaperBlob {
+  uint8_t version;
+  uint8_t axisCount;
+  ShaperConfig axis[kAxisCount];
+};
+
+static void scaledProfile(MotionProfile* profile, const char* name, float speedScale, float accelScale) {
+  strncpy(profile->name, name, kProfileNameLen - 1);
+  profile->name[kProfileNameLen - 1] = '\0';
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    profile->limits.axis[i].maxSps = kAxes[i].maxSps * speedScale;
+    profile->limits.axis[i].accel = kAxes[i].accel * accelScale;
+    profile->limits.axis[i].slewSps2 = kAxes[i].slewSps2 * accelScale;
+  }
+  profile->valid = true;
+}
+
+static void profileKey(char (&key)[4], uint8_t index) {
+  snprintf(key, sizeof(key), "p%u", static_cast<unsigned>(index));
+}
+
+void PtzProfiles::begin(PtzMotion* motion) {
+  motion_ = motion;
+  loadDefaults();
+
+  prefs_.begin(kProfileNamespace, false);
+  for (uint8_t i = 0; i < kProfileCount; ++i) {
+    char key[4];
+    profileKey(key, i);
+    ProfileBlob blob;
+    if (prefs_.getBytesLength(key) != sizeof(blob) || prefs_.getBytes(key, &blob, sizeof(blob)) != sizeof(blob)) {
+      continue;
+    }
+    if (blob.version != kProfileBlobVersion || blob.axisCount != kAxisCount || !limitsValid(blob.profile.limits)) {
+      PTZ_LOGW("PROFILE", "Ignoring stored profile %u", static_cast<unsigned>(i));
+      continue;
+    }
+    blob.profile.name[kProfileNameLen - 1] = '\0';
+    profiles_[i] = blob.profile;
+  }
+
+  ShaperBlob shapers;
+  if (prefs_.getBytesLength("shaper") == sizeof(shapers) &&
+      prefs_.getBytes("shaper", &shapers, sizeof(shapers)) == sizeof(shapers) &&
+      shapers.version == kProfileBlobVersion && shapers.axisCount == kAxisCount) {
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      if (!motion_->setShaper(i, shapers.axis[i])) {
+        PTZ_LOGW("PROFILE", "Ignoring stored shaper for %s", kAxes[i].name);
+      }
+    }
+  }
+
+  uint8_t active = prefs_.getUChar("active", 0);
+  if (active >= kProfileCount || !profiles_[active].valid) {
+    active = 0;
+  }
+  active_ = active;
+  motion_->setLimits(profiles_[active_].limits);
+  PTZ_LOGI("PROFILE", "Active profile %u (%s)", static_cast<unsigned>(active_), profiles_[active_].name);
+}
+
+void PtzProfiles::loop() {
+  if ((dirtyMask_ == 0 && !activeDirty_ && !shaperDirty_) || motion_->isMoving()) {
+    return;
+  }
+  persist();
+}
+
+bool PtzProfiles::select(uint8_t index) {
+  if (index >= kProfileCount || !profiles_[index].valid) {
+    return false;
+  }
+  motion_->setLimits(profiles_[index].limits);
+  if (index != active_) {
+    active_ = index;
+    activeDirty_ = true;
+  }
+  PTZ_LOGI("PROFILE", "Selected profile %u (%s)", static_cast<unsigned>(index), profiles_[index].name);
+  return true;
+}
+
+bool PtzProfiles::selectNext(int8_t direction) {
+  uint8_t index = active_;
+  for (uint8_t n = 0; n < kProfileCount; ++n) {
+    index = static_cast<uint8_t>((index + kProfileCount + (direction < 0 ? -1 : 1)) % kProfileCount);
+    if (profiles_[index].valid) {
+      return select(index);
+    }
+  }
+  return false;
+}
+
+bool PtzProfiles::save(uint8_t index, const MotionProfile& profile) {
+  if (index >= kProfileCount || !limitsValid(profile.limits)) {
+    return false;
+  }
+  MotionProfile& slot = profiles_[index];
+  slot = profile;
+  slot.name[kProfileNameLen - 1] = '\0';
+  slot.valid = true;
+  dirtyMask_ |= static_cast<uint8_t>(1u << index);
+  if (index == active_) {
+    motion_->setLimits(slot.limits);
+  }
+  PTZ_LOGI("PROFILE", "Saved profile %u (%s)", static_cast<unsigned>(index), slot.name);
+  return true;
+}
+
+bool PtzProfiles::saveShaper(uint8_t axis, const ShaperConfig& config) {
+  if (!motion_->setShaper(axis, config)) {
+    return false;
+  }
+  shaperDirty_ = true;
+  PTZ_LOGI("PROFILE", "Shaper %s: %s %.1f Hz damping %.2f", kAxes[axis].name, InputShaper::typeName(config.type),
+           config.freqHz, config.damping);
+  return true;
+}
+
+uint8_t PtzProfiles::active() const {
+  return active_;
+}
+
+const MotionProfile* PtzProfiles::get(uint8_t index) const {
+  if (index >= kProfileCount || !profiles_[index].valid) {
+    return nullptr;
+  }
+  return &profiles_[index];
+}
+
+bool PtzProfiles::limitsValid(const MotionLimits& limits) {
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    const AxisLimits& axis = limits.axis[i];
+    // Written as negated ranges so NaN fails too.
+    if (!(axis.maxSps > 0.0f && axis.maxSps <= kProfileMaxSpsLimit) ||
+        !(axis.accel > 0.0f && axis.accel <= kProfileAccelLimit) ||
+        !(axis.slewSps2 > 0.0f && axis.slewSps2 <= kProfileAccelLimit)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PtzProfiles::loadDefaults() {
+  memset(profiles_, 0, sizeof(profiles_));
+  scaledProfile(&profiles_[0], "default", 1.0f, 1.0f);
+  scaledProfile(&profiles_[1], "broadcast smooth", 0.5f, 0.25f);
+  scaledProfile(&profiles_[2], "sports fast", 1.0f, 1.5f);
+}
+
+void PtzProfiles::persist() {
+  for (uint8_t i = 0; i < kProfileCount; ++i) {
+    if (!(dirtyMask_ & (1u << i))) {
+      continue;
+    }
+    char key[4];
+    profileKey(key, i);
+    ProfileBlob blob;
+    blob.version = kProfileBlobVersion;
+    blob.axisCount = kAxisCount;
+    blob.profile = profiles_[i];
+    if (prefs_.putBytes(key, &blob, sizeof(blob)) != sizeof(blob)) {
+      PTZ_LOGW("PROFILE", "Failed to store profile %u", static_cast<unsigned>(i));
+    }
+  }
+  dirtyMask_ = 0;
+
+  if (activeDirty_) {
+    prefs_.putUChar("active", active_);
+    activeDirty_ = false;
+  }
+
+  if (shaperDirty_) {
+    ShaperBlob blob;
+    blob.version = kProfileBlobVersion;
+    blob.axisCount = kAxisCount;
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      blob.axis[i] = motion_->shaper(i);
+    }
+    if (prefs_.putBytes("shaper", &blob, sizeof(blob)) != sizeof(blob)) {
+      PTZ_LOGW("PROFILE", "Failed to store shapers");
+    }
+    shaperDirty_ = false;
+  }
+}
+
+} // namespace ptz
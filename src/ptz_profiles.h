@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Preferences.h>
+#include <stdint.h>
+
+#include "ptz_config.h"
+#include "ptz_motion.h"
+
+namespace ptz {
+
+struct MotionProfile {
+  char name[kProfileNameLen];
+  MotionLimits limits;
+  bool valid;
+};
+
+// Named speed/acceleration/slew sets kept in NVS. Selecting one hands its
+// limits block to PtzMotion, which switches all axes at the next tick.
+// The per-axis input shaper tuning is stored here too; it belongs to the rig,
+// so it is shared by every profile.
+class PtzProfiles {
+ public:
+  void begin(PtzMotion* motion);
+  // Writes pending changes to NVS once the head is at rest; flash writes
+  // stall cached code long enough to disturb step timing.
+  void loop();
+
+  bool select(uint8_t index);
+  // Steps to the next valid profile in the given direction, wrapping around.
+  bool selectNext(int8_t direction);
+  bool save(uint8_t index, const MotionProfile& profile);
+  bool saveShaper(uint8_t axis, const ShaperConfig& config);
+
+  uint8_t active() const;
+  const MotionProfile* get(uint8_t index) const;
+
+  static bool limitsValid(const MotionLimits& limits);
+
+ private:
+  void loadDefaults();
+  void persist();
+
+  PtzMotion* motion_ = nullptr;
+  Preferences prefs_;
+
+  MotionProfile profiles_[kProfileCount];
+  uint8_t active_ = 0;
+  uint8_t dirtyMask_ = 0; // bit n = profile n
+  bool activeDirty_ = false;
+  bool shaperDirty_ = false;
+};
+
+} // namespace ptz
@@ -0,0 +1,111 @@
+#include "ptz_rates.h"
+
+namespace ptz {
+
+void PtzRateGroups::begin(RateClock clock) {
+  clock_ = clock;
+}
+
+int8_t PtzRateGroups::add(const char* name,
+                          uint32_t periodUs,
+                          uint8_t priority,
+                          uint16_t maxCatchUp,
+                          RateTaskFn fn) {
+  if (count_ >= kRateMaxTasks || periodUs == 0 || !fn || !clock_) {
+    return -1;
+  }
+  Task& task = tasks_[count_];
+  task = Task();
+  task.name = name;
+  task.fn = fn;
+  task.periodUs = periodUs;
+  task.nextUs = clock_();
+  task.maxCatchUp = maxCatchUp;
+  task.priority = priority;
+  return static_cast<int8_t>(count_++);
+}
+
+void PtzRateGroups::setPeriod(int8_t id, uint32_t periodUs) {
+  if (id < 0 || id >= count_ || periodUs == 0) {
+    return;
+  }
+  tasks_[id].periodUs = periodUs;
+}
+
+uint16_t PtzRateGroups::poll() {
+  uint8_t burst[kRateMaxTasks] = {};
+  uint16_t ran = 0;
+  for (;;) {
+    const uint32_t nowUs = clock_();
+    int8_t next = -1;
+    for (uint8_t i = 0; i < count_; ++i) {
+      if (burst[i] >= kRatePollBurst || static_cast<int32_t>(nowUs - tasks_[i].nextUs) < 0) {
+        continue;
+      }
+      if (next < 0 || tasks_[i].priority < tasks_[next].priority) {
+        next = static_cast<int8_t>(i);
+      }
+    }
+    if (next < 0) {
+      return ran;
+    }
+    ++burst[next];
+    ++ran;
+    runTask(tasks_[next], nowUs);
+  }
+}
+
+void PtzRateGroups::runTask(Task& task, uint32_t nowUs) {
+  const uint32_t lateUs = nowUs - task.nextUs;
+  if (lateUs > task.stats.maxLateUs) {
+    task.stats.maxLateUs = lateUs;
+  }
+
+  task.fn(task.nextUs);
+
+  const uint32_t endUs = clock_();
+  const uint32_t runUs = endUs - nowUs;
+  ++task.stats.runs;
+  task.stats.totalRunUs += runUs;
+  if (runUs > task.stats.maxRunUs) {
+    task.stats.maxRunUs = runUs;
+  }
+  if (runUs > task.periodUs) {
+    ++task.stats.overruns;
+  }
+
+  // Periods still due after this one beyond maxCatchUp are dropped whole,
+  // so the phase is kept.
+  task.nextUs += task.periodUs;
+  if (static_cast<int32_t>(endUs - task.nextUs) >= 0) {
+    const uint32_t pending = (endUs - task.nextUs) / task.periodUs + 1;
+    if (pending > task.maxCatchUp) {
+      const uint32_t dropped = pending - task.maxCatchUp;
+      task.nextUs += dropped * task.periodUs;
+      task.stats.skipped += dropped;
+    }
+  }
+}
+
+uint8_t PtzRateGroups::count() const {
+  return count_;
+}
+
+RateTaskInfo PtzRateGroups::info(uint8_t id) const {
+  RateTaskInfo info = {};
+  if (id < count_) {
+    info.name = tasks_[id].name;
+    info.periodUs = tasks_[id].periodUs;
+    info.priority = tasks_[id].priority;
+    info.stats = tasks_[id].stats;
+  }
+  return info;
+}
+
+void PtzRateGroups::resetStats() {
+  for (uint8_t i = 0; i < count_; ++i) {
+    tasks_[i].stats = RateTaskStats();
+  }
+}
+
+} // namespace ptz
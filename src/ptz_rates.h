@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ptz_config.h"
+
+namespace ptz {
+
+// Called with the due time of the period being run, not the wall time.
+typedef void (*RateTaskFn)(uint32_t dueUs);
+typedef uint32_t (*RateClock)();
+
+struct RateTaskStats {
+  uint32_t runs;
+  uint32_t skipped;    // periods dropped beyond the catch-up limit
+  uint32_t overruns;   // runs that took longer than the period
+  uint32_t maxLateUs;  // start past the due time
+  uint32_t maxRunUs;
+  uint64_t totalRunUs;
+};
+
+struct RateTaskInfo {
+  const char* name;
+  uint32_t periodUs;
+  uint8_t priority;
+  RateTaskStats stats;
+};
+
+// Cooperative fixed-rate task groups for loopTask. poll() runs every task
+// that is due, highest priority (lowest number) first, re-checking after
+// each run so a due motion tick is never queued behind a slower group. Due
+// times advance by whole periods, so a task keeps its phase and a callback
+// can rely on a fixed dt. After a stall a task runs its oldest missed period,
+// then at most maxCatchUp of the latest ones; the periods between are dropped
+// and counted. No task runs more than kRatePollBurst times per poll, which
+// keeps the per-pass work in loop() (stepping, network) from being starved.
+//
+// Time comes only from the injected clock, so the same code runs in a host
+// build with virtual time: point the clock at a counter and advance it from
+// the callbacks to model their cost.
+class PtzRateGroups {
+ public:
+  void begin(RateClock clock);
+
+  // Returns the task id, or -1 when the table is full. The task is due
+  // immediately.
+  int8_t add(const char* name, uint32_t periodUs, uint8_t priority, uint16_t maxCatchUp, RateTaskFn fn);
+  // Takes effect from the next due time.
+  void setPeriod(int8_t id, uint32_t periodUs);
+
+  // Returns the number of callbacks run.
+  uint16_t poll();
+
+  uint8_t count() const;
+  RateTaskInfo info(uint8_t id) const;
+  void resetStats();
+
+ private:
+  struct Task {
+    const char* name;
+    RateTaskFn fn;
+    uint32_t periodUs;
+    uint32_t nextUs;
+    uint16_t maxCatchUp;
+    uint8_t priority;
+    RateTaskStats stats;
+  };
+
+  void runTask(Task& task, uint32_t nowUs);
+
+  RateClock clock_ = nullptr;
+  Task tasks_[kRateMaxTasks] = {};
+  uint8_t count_ = 0;
+};
+
+} // namespace ptz
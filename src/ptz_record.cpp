@@ -0,0 +1,249 @@
+#include "ptz_record.h"
+
+#include <math.h>
+
+#include "ptz_log.h"
+
+namespace ptz {
+
+// Worst case for one tick: a pending run byte, a tag and a 5-byte varint per axis.
+static constexpr uint16_t kMaxTickBytes = 2 + 5 * kAxisCount;
+
+static int32_t quantize(float norm) {
+  return static_cast<int32_t>(lroundf(norm * kRecordQuantization));
+}
+
+void PtzRecorder::begin(PtzOwner* owner, PtzMotion* motion) {
+  owner_ = owner;
+  motion_ = motion;
+  mode_ = RecorderMode::Idle;
+}
+
+void PtzRecorder::tick(uint32_t nowMs) {
+  switch (mode_) {
+    case RecorderMode::Recording:
+      recordTick();
+      break;
+
+    case RecorderMode::Preroll:
+    case RecorderMode::Playing:
+      playTick(nowMs);
+      break;
+
+    case RecorderMode::Idle:
+      break;
+  }
+}
+
+bool PtzRecorder::startRecording(uint8_t slot) {
+  if (slot >= kRecordSlots || mode_ != RecorderMode::Idle) {
+    return false;
+  }
+
+  const MotionState state = motion_->state();
+  RecordingInfo& info = slots_[slot].info;
+  info.ticks = 0;
+  info.bytes = 0;
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    info.start[i] = state.pos[i];
+    prev_[i] = 0;
+  }
+  info.valid = false;
+
+  slot_ = slot;
+  run_ = 0;
+  mode_ = RecorderMode::Recording;
+  PTZ_LOGI("RECORD", "Recording slot %u", static_cast<unsigned>(slot));
+  return true;
+}
+
+void PtzRecorder::stopRecording() {
+  if (mode_ != RecorderMode::Recording) {
+    return;
+  }
+  flushRun();
+  RecordingInfo& info = slots_[slot_].info;
+  info.valid = true;
+  mode_ = RecorderMode::Idle;
+  PTZ_LOGI("RECORD", "Recorded slot %u ticks=%lu bytes=%u",
+           static_cast<unsigned>(slot_),
+           static_cast<unsigned long>(info.ticks),
+           static_cast<unsigned>(info.bytes));
+}
+
+bool PtzRecorder::startPlayback(uint8_t slot, uint32_t clientId) {
+  if (slot >= kRecordSlots || !slots_[slot].info.valid || mode_ != RecorderMode::Idle) {
+    return false;
+  }
+
+  const RecordingInfo& info = slots_[slot].info;
+  slot_ = slot;
+  clientId_ = clientId;
+  mode_ = RecorderMode::Preroll;
+  motion_->moveTo(info.start);
+  PTZ_LOGI("RECORD", "Playback slot %u", static_cast<unsigned>(slot));
+  return true;
+}
+
+void PtzRecorder::stopPlayback() {
+  if (mode_ != RecorderMode::Preroll && mode_ != RecorderMode::Playing) {
+    return;
+  }
+  mode_ = RecorderMode::Idle;
+  motion_->stop();
+  PTZ_LOGI("RECORD", "Playback stopped");
+}
+
+RecorderMode PtzRecorder::mode() const {
+  return mode_;
+}
+
+RecordingInfo PtzRecorder::info(uint8_t slot) const {
+  if (slot >= kRecordSlots) {
+    return RecordingInfo{};
+  }
+  return slots_[slot].info;
+}
+
+const uint8_t* PtzRecorder::data(uint8_t slot) const {
+  if (slot >= kRecordSlots) {
+    return nullptr;
+  }
+  return slots_[slot].data;
+}
+
+void PtzRecorder::recordTick() {
+  RecordingInfo& info = slots_[slot_].info;
+  if (info.bytes + kMaxTickBytes > kRecordSlotBytes) {
+    PTZ_LOGW("RECORD", "Slot %u full", static_cast<unsigned>(slot_));
+    stopRecording();
+    return;
+  }
+
+  const VelocityCommand cmd = motion_->velocityCommand();
+  int32_t sample[kAxisCount];
+  uint8_t mask = 0;
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    sample[i] = quantize(cmd.norm[i]);
+    if (sample[i] != prev_[i]) {
+      mask |= static_cast<uint8_t>(1u << i);
+    }
+  }
+  ++info.ticks;
+
+  if (mask == 0) {
+    if (++run_ == 0x80) {
+      flushRun();
+    }
+    return;
+  }
+
+  flushRun();
+  emit(static_cast<uint8_t>(0x80 | mask));
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    if (mask & (1u << i)) {
+      emitVarint(sample[i] - prev_[i]);
+      prev_[i] = sample[i];
+    }
+  }
+}
+
+void PtzRecorder::playTick(uint32_t nowMs) {
+  const OwnerSnapshot snap = owner_->snapshot();
+  if (snap.owner != Owner::App || snap.controlClientId != clientId_) {
+    stopPlayback();
+    return;
+  }
+  owner_->appHeartbeat(clientId_, nowMs);
+
+  if (mode_ == RecorderMode::Preroll) {
+    if (motion_->isMoving()) {
+      return;
+    }
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      prev_[i] = 0;
+    }
+    run_ = 0;
+    cursor_ = 0;
+    ticksLeft_ = slots_[slot_].info.ticks;
+    mode_ = RecorderMode::Playing;
+  }
+
+  if (ticksLeft_ == 0) {
+    mode_ = RecorderMode::Idle;
+    const float zero[kAxisCount] = {};
+    motion_->setVelocity(zero);
+    PTZ_LOGI("RECORD", "Playback finished");
+    return;
+  }
+
+  if (run_ > 0) {
+    --run_;
+  } else if (cursor_ < slots_[slot_].info.bytes) {
+    const uint8_t tag = slots_[slot_].data[cursor_++];
+    if (tag < 0x80) {
+      run_ = tag;
+    } else {
+      for (uint8_t i = 0; i < kAxisCount; ++i) {
+        int32_t delta = 0;
+        if ((tag & (1u << i)) && readVarint(&delta)) {
+          prev_[i] += delta;
+        }
+      }
+    }
+  }
+  --ticksLeft_;
+
+  float velocity[kAxisCount];
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    velocity[i] = prev_[i] / kRecordQuantization;
+  }
+  motion_->setVelocity(velocity);
+}
+
+bool PtzRecorder::emit(uint8_t byte) {
+  RecordingInfo& info = slots_[slot_].info;
+  if (info.bytes >= kRecordSlotBytes) {
+    return false;
+  }
+  slots_[slot_].data[info.bytes++] = byte;
+  return true;
+}
+
+bool PtzRecorder::emitVarint(int32_t value) {
+  uint32_t zz = (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+  while (zz >= 0x80) {
+    if (!emit(static_cast<uint8_t>(zz | 0x80))) {
+      return false;
+    }
+    zz >>= 7;
+  }
+  return emit(static_cast<uint8_t>(zz));
+}
+
+bool PtzRecorder::flushRun() {
+  if (run_ == 0) {
+    return true;
+  }
+  const uint8_t repeat = static_cast<uint8_t>(run_ - 1);
+  run_ = 0;
+  return emit(repeat);
+}
+
+bool PtzRecorder::readVarint(int32_t* value) {
+  const Slot& slot = slots_[slot_];
+  uint32_t zz = 0;
+  uint8_t shift = 0;
+  while (cursor_ < slot.info.bytes && shift < 35) {
+    const uint8_t byte = slot.data[cursor_++];
+    zz |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      *value = static_cast<int32_t>(zz >> 1) ^ -static_cast<int32_t>(zz & 1);
+      return true;
+    }
+    shift += 7;
+  }
+  return false;
+}
+
+} // namespace ptz
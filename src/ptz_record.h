@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ptz_config.h"
+#include "ptz_motion.h"
+#include "ptz_owner.h"
+
+namespace ptz {
+
+enum class RecorderMode : uint8_t {
+  Idle,
+  Recording,
+  Preroll, // moving to the recorded start position
+  Playing,
+};
+
+struct RecordingInfo {
+  uint32_t ticks;
+  uint16_t bytes;
+  float start[kAxisCount];
+  bool valid;
+};
+
+// Records the velocity stream reaching PtzMotion::setVelocity at a fixed tick
+// and plays it back tick for tick.
+//
+// Stream encoding, one entry per tick (velocities quantized by
+// kRecordQuantization):
+//   0x00..0x7F  repeat the previous sample for (n + 1) ticks
+//   0x80 | mask delta record; a zigzag varint follows for each axis whose bit
+//               is set in mask (bit n = AxisId n)
+class PtzRecorder {
+ public:
+  void begin(PtzOwner* owner, PtzMotion* motion);
+
+  // Advances one fixed control tick; call once per kRecordTickUs.
+  void tick(uint32_t nowMs);
+
+  bool startRecording(uint8_t slot);
+  void stopRecording();
+  bool startPlayback(uint8_t slot, uint32_t clientId);
+  void stopPlayback();
+
+  RecorderMode mode() const;
+  RecordingInfo info(uint8_t slot) const;
+  const uint8_t* data(uint8_t slot) const;
+
+ private:
+  struct Slot {
+    RecordingInfo info;
+    uint8_t data[kRecordSlotBytes];
+  };
+
+  void recordTick();
+  void playTick(uint32_t nowMs);
+  bool emit(uint8_t byte);
+  bool emitVarint(int32_t value);
+  bool flushRun();
+  bool readVarint(int32_t* value);
+
+  PtzOwner* owner_ = nullptr;
+  PtzMotion* motion_ = nullptr;
+
+  Slot slots_[kRecordSlots];
+  RecorderMode mode_ = RecorderMode::Idle;
+  uint8_t slot_ = 0;
+  uint32_t clientId_ = 0;
+
+  int32_t prev_[kAxisCount] = {};
+  uint8_t run_ = 0;
+  uint16_t cursor_ = 0;
+  uint32_t ticksLeft_ = 0;
+};
+
+} // namespace ptz
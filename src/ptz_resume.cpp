@@ -0,0 +1,206 @@
+#include "ptz_resume.h"
+
+#include <Arduino.h>
+#include <esp_attr.h>
+#include <esp_system.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "ptz_log.h"
+#include "ptz_wire.h"
+
+namespace ptz {
+
+static constexpr const char* kResumeNamespace = "ptzpos";
+static constexpr uint8_t kResumeBlobVersion = 1;
+static constexpr uint32_t kResumeRtcMagic = 0x50545A52; // "PTZR"
+
+static_assert(kAxisCount <= 8, "ResumeStats masks hold one bit per axis");
+
+struct ResumeBlob {
+  uint8_t version;
+  uint8_t axisCount;
+  uint8_t clean; // written with the head at rest
+  int32_t pos[kAxisCount];
+};
+
+// Survives every reset except power loss and brownout.
+struct ResumeRtc {
+  uint32_t magic;
+  uint8_t moving;
+  int32_t pos[kAxisCount];
+  uint16_t crc;
+};
+
+RTC_NOINIT_ATTR static ResumeRtc s_rtc;
+
+static uint16_t rtcCrc(const ResumeRtc& rtc) {
+  return crc16(reinterpret_cast<const uint8_t*>(&rtc), offsetof(ResumeRtc, crc));
+}
+
+static bool warmReset() {
+  switch (esp_reset_reason()) {
+    case ESP_RST_SW:
+    case ESP_RST_PANIC:
+    case ESP_RST_INT_WDT:
+    case ESP_RST_TASK_WDT:
+    case ESP_RST_WDT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void PtzResume::begin(PtzMotion* motion) {
+  motion_ = motion;
+  prefs_.begin(kResumeNamespace, false);
+
+  ResumeBlob blob;
+  const bool stored = prefs_.getBytesLength("pos") == sizeof(blob) &&
+                      prefs_.getBytes("pos", &blob, sizeof(blob)) == sizeof(blob) &&
+                      blob.version == kResumeBlobVersion && blob.axisCount == kAxisCount;
+  if (stored) {
+    memcpy(written_, blob.pos, sizeof(written_));
+    haveWritten_ = blob.clean != 0;
+  }
+
+  const bool warm = warmReset() && s_rtc.magic == kResumeRtcMagic && s_rtc.crc == rtcCrc(s_rtc);
+  if (warm && !s_rtc.moving) {
+    stats_.source = ResumeSource::Warm;
+    memcpy(pos_, s_rtc.pos, sizeof(pos_));
+    stats_.restoredMask = static_cast<uint8_t>((1u << kAxisCount) - 1);
+  } else if (!warm && stored && blob.clean) {
+    stats_.source = ResumeSource::Stored;
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      if (motion_->axisHold(i) == AxisHold::Always) {
+        stats_.suspectMask |= static_cast<uint8_t>(1u << i);
+        continue;
+      }
+      pos_[i] = blob.pos[i];
+      stats_.restoredMask |= static_cast<uint8_t>(1u << i);
+    }
+  } else if (warm || stored) {
+    stats_.suspectMask = static_cast<uint8_t>((1u << kAxisCount) - 1);
+  }
+
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    motion_->setPosition(i, pos_[i]);
+  }
+  s_rtc.magic = 0; // rewritten by the first tick()
+
+  if (stats_.source != ResumeSource::None) {
+    PTZ_LOGI("RESUME", "Position restored from %s (axes 0x%02x)", sourceName(stats_.source),
+             static_cast<unsigned>(stats_.restoredMask));
+  }
+  if (stats_.suspectMask != 0) {
+    PTZ_LOGW("RESUME", "Position unknown for axes 0x%02x", static_cast<unsigned>(stats_.suspectMask));
+  }
+}
+
+void PtzResume::tick(uint32_t nowMs, uint32_t firstRecallMs) {
+  const MotionState state = motion_->state();
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    pos_[i] = static_cast<int32_t>(state.pos[i]);
+  }
+  moving_ = motion_->isMoving();
+
+  s_rtc.magic = kResumeRtcMagic;
+  s_rtc.moving = moving_ ? 1 : 0;
+  memcpy(s_rtc.pos, pos_, sizeof(s_rtc.pos));
+  s_rtc.crc = rtcCrc(s_rtc);
+
+  if (firstRecallMs != 0 && stats_.recallRequestMs == 0) {
+    stats_.recallRequestMs = firstRecallMs;
+  }
+  if (stats_.recallRequestMs != 0 && stats_.recallSettledMs == 0 && !moving_) {
+    stats_.recallSettledMs = nowMs;
+    PTZ_LOGI("RESUME", "Boot to preset recall settled in %lu ms (%lu ms after the recall)",
+             static_cast<unsigned long>(nowMs), static_cast<unsigned long>(nowMs - stats_.recallRequestMs));
+  }
+}
+
+// A write stalls step generation, so the record is written only at rest.
+void PtzResume::loop(uint32_t nowMs) {
+  if (moving_ || supplyFailed_) {
+    restSinceMs_ = 0;
+    return;
+  }
+  if (restSinceMs_ == 0) {
+    restSinceMs_ = nowMs ? nowMs : 1;
+    return;
+  }
+  if (nowMs - restSinceMs_ < kResumeSettleMs || (stats_.writes > 0 && nowMs - lastWriteMs_ < kResumeMinWriteMs)) {
+    return;
+  }
+  if (haveWritten_ && memcmp(pos_, written_, sizeof(pos_)) == 0) {
+    return;
+  }
+  write(true);
+  lastWriteMs_ = nowMs;
+}
+
+// Runs inside the command that starts a move, before its first step; once
+// the record is invalid, further commands of the move cost nothing.
+void PtzResume::invalidate() {
+  if (!haveWritten_ || supplyFailed_) {
+    return;
+  }
+  write(false);
+  restSinceMs_ = 0;
+}
+
+// The sense input watches the motor supply through a divider. The logic
+// supply outlives it on the bulk capacitance long enough for one record.
+void PtzResume::pollSupply() {
+  if (kSupplySensePin < 0) {
+    return;
+  }
+  const uint32_t mv = static_cast<uint32_t>(analogReadMilliVolts(kSupplySensePin) * kSupplySenseScale);
+  if (!supplyFailed_ && mv < kSupplyFailMv) {
+    supplyFailed_ = true;
+    ++stats_.supplyFails;
+    write(!moving_);
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      if (motion_->axisHold(i) == AxisHold::Always || moving_) {
+        stats_.suspectMask |= static_cast<uint8_t>(1u << i);
+      }
+    }
+    PTZ_LOGW("RESUME", "Motor supply low (%lu mV), position saved", static_cast<unsigned long>(mv));
+  } else if (supplyFailed_ && mv > kSupplyOkMv) {
+    supplyFailed_ = false;
+    PTZ_LOGI("RESUME", "Motor supply restored (%lu mV)", static_cast<unsigned long>(mv));
+  }
+}
+
+void PtzResume::write(bool clean) {
+  ResumeBlob blob;
+  blob.version = kResumeBlobVersion;
+  blob.axisCount = kAxisCount;
+  blob.clean = clean ? 1 : 0;
+  memcpy(blob.pos, pos_, sizeof(blob.pos));
+  if (prefs_.putBytes("pos", &blob, sizeof(blob)) != sizeof(blob)) {
+    PTZ_LOGW("RESUME", "Failed to store position");
+    return;
+  }
+  memcpy(written_, pos_, sizeof(written_));
+  haveWritten_ = clean;
+  ++stats_.writes;
+}
+
+ResumeStats PtzResume::stats() const {
+  return stats_;
+}
+
+const char* PtzResume::sourceName(ResumeSource source) {
+  switch (source) {
+    case ResumeSource::Warm:
+      return "warm";
+    case ResumeSource::Stored:
+      return "stored";
+    case ResumeSource::None:
+      break;
+  }
+  return "none";
+}
+
+} // namespace ptz
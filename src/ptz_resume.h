@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Preferences.h>
+#include <stdint.h>
+
+#include "ptz_config.h"
+#include "ptz_motion.h"
+
+namespace ptz {
+
+enum class ResumeSource : uint8_t {
+  None,   // nothing usable stored: axes start at 0
+  Warm,   // RTC copy after a software reset, panic or watchdog
+  Stored, // NVS record after a power cycle
+};
+
+struct ResumeStats {
+  ResumeSource source;
+  uint8_t restoredMask;     // axes whose step count was restored (bit per AxisId)
+  uint8_t suspectMask;      // axes that may have moved while unpowered
+  uint32_t writes;          // NVS records written since boot
+  uint32_t supplyFails;
+  uint32_t recallRequestMs; // first preset recall, ms since boot
+  uint32_t recallSettledMs; // head at rest after that recall, ms since boot
+};
+
+// Keeps the head's step counts across reboots. begin() restores them before
+// any motion:
+//  * After a software reset, panic or watchdog the RTC copy, refreshed every
+//    motion tick, is used if the head was at rest when it went down.
+//  * After a power cycle the NVS record is used if it was written at rest.
+//    Gravity-loaded axes (AxisHold::Always) may have dropped while the
+//    drivers were off and are left at 0.
+// NVS is written after kResumeSettleMs at rest with a changed position, at
+// most once per kResumeMinWriteMs. invalidate(), hooked to the motion start
+// (PtzMotion::setStartHook), marks that record unusable before the next
+// move's first step, so a power cut mid-move never restores a stale
+// position and no write stalls a moving axis: at most two small writes per
+// move cycle. Without supply sense this is the only way to tell. With it, a
+// failing motor supply also writes a record, marked unusable if the head
+// was moving.
+class PtzResume {
+ public:
+  void begin(PtzMotion* motion);
+  void tick(uint32_t nowMs, uint32_t firstRecallMs); // motion rate
+  void loop(uint32_t nowMs);                          // settle writes
+  void invalidate();                                  // a move is starting
+  void pollSupply();
+
+  ResumeStats stats() const;
+  static const char* sourceName(ResumeSource source);
+
+ private:
+  void write(bool clean);
+
+  PtzMotion* motion_ = nullptr;
+  Preferences prefs_;
+  ResumeStats stats_ = {};
+  int32_t pos_[kAxisCount] = {};
+  int32_t written_[kAxisCount] = {};
+  bool moving_ = false;
+  bool haveWritten_ = false;
+  bool supplyFailed_ = false;
+  uint32_t restSinceMs_ = 0;
+  uint32_t lastWriteMs_ = 0;
+};
+
+} // namespace ptz
@@ -0,0 +1,52 @@
+#include "ptz_samples.h"
+
+#include <math.h>
+
+namespace ptz {
+
+void PtzSampleRing::sample(uint32_t nowUs, PtzMotion& motion) {
+  if (!started_) {
+    nextUs_ = nowUs;
+    started_ = true;
+  }
+  if (static_cast<int32_t>(nowUs - nextUs_) < 0) {
+    return;
+  }
+
+  nextUs_ += kSampleIntervalUs;
+  if (static_cast<int32_t>(nowUs - nextUs_) >= 0) {
+    nextUs_ = nowUs + kSampleIntervalUs;
+  }
+
+  const MotionState state = motion.state();
+  PositionSample& s = samples_[(head_ + count_) % kSampleRingSize];
+  s.timeUs = nowUs;
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    s.pos[i] = static_cast<int32_t>(lroundf(state.pos[i]));
+  }
+
+  if (count_ < kSampleRingSize) {
+    ++count_;
+  } else {
+    head_ = (head_ + 1) % kSampleRingSize;
+    ++dropped_;
+  }
+}
+
+size_t PtzSampleRing::drain(PositionSample* out, size_t max, uint32_t* lost) {
+  *lost = dropped_ - drainedDropped_;
+  drainedDropped_ = dropped_;
+  size_t n = 0;
+  while (count_ > 0 && n < max) {
+    out[n++] = samples_[head_];
+    head_ = (head_ + 1) % kSampleRingSize;
+    --count_;
+  }
+  return n;
+}
+
+uint32_t PtzSampleRing::dropped() const {
+  return dropped_;
+}
+
+} // namespace ptz
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ptz_config.h"
+#include "ptz_motion.h"
+
+namespace ptz {
+
+static_assert(kSampleRingSize * kSampleIntervalUs >= kStatusMaxIntervalMs * 1000,
+              "the sample ring must hold a full status interval at the lowest status rate");
+
+struct PositionSample {
+  uint32_t timeUs;
+  int32_t pos[kAxisCount];
+};
+
+// Samples motor positions on a fixed kSampleIntervalUs grid so status frames
+// can carry every sample taken since the previous frame.
+class PtzSampleRing {
+ public:
+  void sample(uint32_t nowUs, PtzMotion& motion);
+
+  // Moves pending samples (oldest first) into out and returns the count.
+  // `lost` receives the samples overwritten since the previous drain; they
+  // fall just before out[0].
+  size_t drain(PositionSample* out, size_t max, uint32_t* lost);
+  uint32_t dropped() const;
+
+ private:
+  PositionSample samples_[kSampleRingSize];
+  uint8_t head_ = 0;
+  uint8_t count_ = 0;
+  uint32_t nextUs_ = 0;
+  bool started_ = false;
+  uint32_t dropped_ = 0;
+  uint32_t drainedDropped_ = 0;
+};
+
+} // namespace ptz
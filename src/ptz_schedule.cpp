@@ -0,0 +1,101 @@
+#include "ptz_schedule.h"
+
+#include <esp_timer.h>
+
+#include "ptz_log.h"
+
+namespace ptz {
+
+void PtzScheduler::begin(PtzOwner* owner, PtzMotion* motion, PtzPresets* presets, PtzPlanner* planner) {
+  owner_ = owner;
+  motion_ = motion;
+  presets_ = presets;
+  planner_ = planner;
+  count_ = 0;
+}
+
+void PtzScheduler::poll(int64_t nowUs) {
+  uint8_t due = 0;
+  while (due < count_ && queue_[due].atUs <= nowUs) {
+    const ScheduledCommand& command = queue_[due];
+    lateness_.record(static_cast<uint32_t>(nowUs - command.atUs));
+    const OwnerSnapshot snap = owner_->snapshot();
+    if (snap.owner == Owner::App && snap.controlClientId == command.clientId) {
+      execute(command);
+    } else {
+      ++discarded_;
+    }
+    ++due;
+  }
+  if (due == 0) {
+    return;
+  }
+  for (uint8_t i = due; i < count_; ++i) {
+    queue_[i - due] = queue_[i];
+  }
+  count_ -= due;
+}
+
+bool PtzScheduler::add(const ScheduledCommand& command) {
+  if (count_ >= kScheduleQueueSize ||
+      command.atUs > esp_timer_get_time() + static_cast<int64_t>(kScheduleMaxAheadMs) * 1000) {
+    return false;
+  }
+  uint8_t index = count_;
+  while (index > 0 && queue_[index - 1].atUs > command.atUs) {
+    queue_[index] = queue_[index - 1];
+    --index;
+  }
+  queue_[index] = command;
+  ++count_;
+  return true;
+}
+
+void PtzScheduler::cancel(uint32_t clientId) {
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < count_; ++i) {
+    if (queue_[i].clientId != clientId) {
+      queue_[kept++] = queue_[i];
+    }
+  }
+  count_ = kept;
+}
+
+uint8_t PtzScheduler::pending() const {
+  return count_;
+}
+
+uint32_t PtzScheduler::discarded() const {
+  return discarded_;
+}
+
+const LatencyHistogram& PtzScheduler::lateness() const {
+  return lateness_;
+}
+
+void PtzScheduler::execute(const ScheduledCommand& command) {
+  switch (command.action) {
+    case ScheduledAction::MoveTo:
+      planner_->flush();
+      motion_->moveTo(command.values);
+      break;
+
+    case ScheduledAction::SetVelocity:
+      planner_->flush();
+      motion_->setVelocity(command.values);
+      break;
+
+    case ScheduledAction::PresetRecall: {
+      const Preset* preset = presets_->recall(command.preset);
+      if (!preset) {
+        PTZ_LOGW("PRESET", "Preset %u not set", static_cast<unsigned>(command.preset));
+        break;
+      }
+      planner_->flush();
+      motion_->moveTo(preset->pos);
+      break;
+    }
+  }
+}
+
+} // namespace ptz
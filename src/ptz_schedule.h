@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ptz_config.h"
+#include "ptz_metrics.h"
+#include "ptz_motion.h"
+#include "ptz_owner.h"
+#include "ptz_planner.h"
+#include "ptz_presets.h"
+
+namespace ptz {
+
+enum class ScheduledAction : uint8_t {
+  MoveTo,
+  SetVelocity,
+  PresetRecall,
+};
+
+struct ScheduledCommand {
+  int64_t atUs; // esp_timer_get_time() deadline
+  uint32_t clientId;
+  ScheduledAction action;
+  uint8_t preset;
+  float values[kAxisCount];
+};
+
+// Holds motion commands until an esp_timer deadline. poll() runs right
+// before the motion step in loop(), so commands fire within one loop period
+// of their deadline; lateness is recorded to prove it.
+//
+// A command only fires while the client that scheduled it still owns the
+// head; otherwise it is discarded.
+class PtzScheduler {
+ public:
+  void begin(PtzOwner* owner, PtzMotion* motion, PtzPresets* presets, PtzPlanner* planner);
+  void poll(int64_t nowUs);
+
+  bool add(const ScheduledCommand& command);
+  void cancel(uint32_t clientId);
+
+  uint8_t pending() const;
+  uint32_t discarded() const;
+  const LatencyHistogram& lateness() const;
+
+ private:
+  void execute(const ScheduledCommand& command);
+
+  PtzOwner* owner_ = nullptr;
+  PtzMotion* motion_ = nullptr;
+  PtzPresets* presets_ = nullptr;
+  PtzPlanner* planner_ = nullptr;
+
+  ScheduledCommand queue_[kScheduleQueueSize]; // sorted by atUs
+  uint8_t count_ = 0;
+  uint32_t discarded_ = 0;
+  LatencyHistogram lateness_;
+};
+
+} // namespace ptz
@@ -0,0 +1,284 @@
+#include "ptz_serial.h"
+
+#include <Arduino.h>
+#include <math.h>
+#include <strings.h>
+
+#include "ptz_log.h"
+#include "ptz_wire.h"
+
+namespace ptz {
+
+void PtzSerial::begin(PtzOwner* owner, PtzMotion* motion, PtzPresets* presets, PtzWifi* wifi) {
+  owner_ = owner;
+  motion_ = motion;
+  presets_ = presets;
+  wifi_ = wifi;
+  rxState_ = RxState::Idle;
+  lineLen_ = 0;
+}
+
+void PtzSerial::loop(uint32_t nowMs) {
+  if (rxState_ == RxState::Frame && nowMs - rxStartMs_ > kSerialFrameTimeoutMs) {
+    ++stats_.timeouts;
+    rxState_ = RxState::Idle;
+  }
+
+  uint16_t budget = kSerialMaxBytesPerLoop;
+  while (budget > 0 && Serial.available()) {
+    feed(static_cast<uint8_t>(Serial.read()), nowMs);
+    --budget;
+  }
+
+  if (statusIntervalMs_ > 0 && nowMs - lastStatusMs_ >= statusIntervalMs_) {
+    sendStatus(nowMs);
+    lastStatusMs_ = nowMs;
+  }
+}
+
+SerialStats PtzSerial::stats() const {
+  return stats_;
+}
+
+void PtzSerial::feed(uint8_t byte, uint32_t nowMs) {
+  if (rxState_ == RxState::Idle) {
+    if (byte == kSerialFrameSof) {
+      rxState_ = RxState::Frame;
+      rxLen_ = 0;
+      rxStartMs_ = nowMs;
+    } else {
+      feedText(byte);
+    }
+    return;
+  }
+
+  rx_[rxLen_++] = byte;
+  if (rxLen_ == 1) {
+    if (byte > kSerialMaxPayload) {
+      ++stats_.overruns;
+      rxState_ = RxState::Idle;
+      return;
+    }
+    rxExpected_ = static_cast<uint8_t>(byte + 5);
+    return;
+  }
+
+  if (rxLen_ < rxExpected_) {
+    return;
+  }
+
+  rxState_ = RxState::Idle;
+  const uint8_t len = rx_[0];
+  const uint16_t expectedCrc = static_cast<uint16_t>(rx_[len + 3]) | (static_cast<uint16_t>(rx_[len + 4]) << 8);
+  if (crc16(rx_, len + 3) != expectedCrc) {
+    ++stats_.crcErrors;
+    if (logShouldEmit(kLogRateSerialError, 1000)) {
+      PTZ_LOGW("SERIAL", "CRC error (%lu total)", static_cast<unsigned long>(stats_.crcErrors));
+    }
+    return;
+  }
+
+  ++stats_.framesOk;
+  handleFrame(rx_[1], rx_[2], &rx_[3], len, nowMs);
+}
+
+void PtzSerial::feedText(uint8_t byte) {
+  if (byte == '\n' || byte == '\r') {
+    line_[lineLen_] = '\0';
+    const char* start = line_;
+    while (*start == ' ') {
+      ++start;
+    }
+    char* end = line_ + lineLen_;
+    while (end > start && end[-1] == ' ') {
+      *--end = '\0';
+    }
+    if (strcasecmp(start, "WIFI RESET") == 0) {
+      wifi_->resetAndProvision();
+    }
+    lineLen_ = 0;
+    return;
+  }
+
+  if (byte < 0x20 || byte > 0x7E) {
+    lineLen_ = 0;
+    return;
+  }
+
+  if (lineLen_ < sizeof(line_) - 1) {
+    line_[lineLen_++] = static_cast<char>(byte);
+  }
+}
+
+void PtzSerial::handleFrame(uint8_t cmd, uint8_t seq, const uint8_t* payload, uint8_t len, uint32_t nowMs) {
+  if (cmd == kSerialCmdRequestControl) {
+    owner_->requestAppControl(kSerialClientId, nowMs);
+    sendAck(cmd, seq);
+    PTZ_LOGI("OWNER", "Serial requested control");
+    return;
+  }
+
+  if (cmd == kSerialCmdReleaseControl) {
+    if (!owner_->releaseAppControl(kSerialClientId)) {
+      sendError(cmd, seq, kSerialErrNotOwner);
+      return;
+    }
+    sendAck(cmd, seq);
+    PTZ_LOGI("OWNER", "Serial released control");
+    return;
+  }
+
+  if (cmd == kSerialCmdStatusStream) {
+    if (len != 2) {
+      sendError(cmd, seq, kSerialErrBadLength);
+      return;
+    }
+    uint16_t interval = static_cast<uint16_t>(readI16(payload));
+    if (interval > 0 && interval < kSerialMinStatusIntervalMs) {
+      interval = kSerialMinStatusIntervalMs;
+    }
+    statusIntervalMs_ = interval;
+    lastStatusMs_ = nowMs;
+    sendAck(cmd, seq);
+    return;
+  }
+
+  if (cmd == kSerialCmdStatusRequest) {
+    sendStatus(nowMs);
+    return;
+  }
+
+  const OwnerSnapshot snap = owner_->snapshot();
+  if (snap.owner != Owner::App || snap.controlClientId != kSerialClientId) {
+    sendError(cmd, seq, kSerialErrNotOwner);
+    return;
+  }
+
+  owner_->appHeartbeat(kSerialClientId, nowMs);
+
+  switch (cmd) {
+    case kSerialCmdHeartbeat:
+      sendAck(cmd, seq);
+      return;
+
+    case kSerialCmdSetVelocity:
+      if (len != 6) {
+        sendError(cmd, seq, kSerialErrBadLength);
+        return;
+      }
+      motion_->setAxisVelocity(kAxisPan, normFromI16(readI16(payload)));
+      motion_->setAxisVelocity(kAxisTilt, normFromI16(readI16(payload + 2)));
+      motion_->setAxisVelocity(kAxisZoom, normFromI16(readI16(payload + 4)));
+      sendAck(cmd, seq);
+      return;
+
+    case kSerialCmdMoveTo:
+      if (len != 12) {
+        sendError(cmd, seq, kSerialErrBadLength);
+        return;
+      }
+      motion_->moveAxisTo(kAxisPan, static_cast<float>(readI32(payload)));
+      motion_->moveAxisTo(kAxisTilt, static_cast<float>(readI32(payload + 4)));
+      motion_->moveAxisTo(kAxisZoom, static_cast<float>(readI32(payload + 8)));
+      sendAck(cmd, seq);
+      return;
+
+    case kSerialCmdStop:
+      motion_->stop();
+      sendAck(cmd, seq);
+      return;
+
+    case kSerialCmdPresetSave:
+      if (len != 1) {
+        sendError(cmd, seq, kSerialErrBadLength);
+        return;
+      }
+      if (!presets_->save(payload[0], motion_->state())) {
+        sendError(cmd, seq, kSerialErrBadPreset);
+        return;
+      }
+      sendAck(cmd, seq);
+      PTZ_LOGI("PRESET", "Saved preset %u", static_cast<unsigned>(payload[0]));
+      return;
+
+    case kSerialCmdPresetRecall: {
+      if (len != 1) {
+        sendError(cmd, seq, kSerialErrBadLength);
+        return;
+      }
+      const Preset* preset = presets_->recall(payload[0]);
+      if (!preset) {
+        sendError(cmd, seq, kSerialErrBadPreset);
+        return;
+      }
+      motion_->moveTo(preset->pos);
+      sendAck(cmd, seq);
+      PTZ_LOGI("PRESET", "Recalled preset %u", static_cast<unsigned>(payload[0]));
+      return;
+    }
+
+    default:
+      sendError(cmd, seq, kSerialErrUnknownCmd);
+      return;
+  }
+}
+
+void PtzSerial::sendStatus(uint32_t nowMs) {
+  const MotionState state = motion_->state();
+  const OwnerSnapshot snap = owner_->snapshot();
+
+  uint8_t flags = 0;
+  if (motion_->enabled()) {
+    flags |= 0x01;
+  }
+  if (motion_->isMoving()) {
+    flags |= 0x02;
+  }
+  if (snap.owner == Owner::App && snap.controlClientId == kSerialClientId) {
+    flags |= 0x04;
+  }
+
+  uint8_t payload[30];
+  uint8_t* p = writeU32(payload, nowMs);
+  *p++ = static_cast<uint8_t>(snap.owner);
+  *p++ = flags;
+  for (uint8_t i = kAxisPan; i <= kAxisZoom; ++i) {
+    p = writeU32(p, static_cast<uint32_t>(lroundf(state.pos[i])));
+  }
+  for (uint8_t i = kAxisPan; i <= kAxisZoom; ++i) {
+    p = writeU32(p, static_cast<uint32_t>(lroundf(state.target[i])));
+  }
+
+  sendFrame(kSerialMsgStatus, txSeq_++, payload, sizeof(payload));
+}
+
+void PtzSerial::sendAck(uint8_t refCmd, uint8_t seq) {
+  sendFrame(kSerialMsgAck, seq, &refCmd, 1);
+}
+
+void PtzSerial::sendError(uint8_t refCmd, uint8_t seq, uint8_t code) {
+  const uint8_t payload[2] = {refCmd, code};
+  sendFrame(kSerialMsgError, seq, payload, sizeof(payload));
+}
+
+void PtzSerial::sendFrame(uint8_t cmd, uint8_t seq, const uint8_t* payload, uint8_t len) {
+  uint8_t frame[kSerialMaxPayload + 6];
+  frame[0] = kSerialFrameSof;
+  frame[1] = len;
+  frame[2] = cmd;
+  frame[3] = seq;
+  memcpy(&frame[4], payload, len);
+  const uint16_t crc = crc16(&frame[1], len + 3);
+  frame[len + 4] = static_cast<uint8_t>(crc);
+  frame[len + 5] = static_cast<uint8_t>(crc >> 8);
+
+  // Never block the control loop on a full UART buffer; the host tracks seq.
+  const size_t size = len + 6;
+  if (Serial.availableForWrite() < static_cast<int>(size)) {
+    ++stats_.txDropped;
+    return;
+  }
+  Serial.write(frame, size);
+}
+
+} // namespace ptz
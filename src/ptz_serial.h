@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ptz_config.h"
+#include "ptz_motion.h"
+#include "ptz_owner.h"
+#include "ptz_presets.h"
+#include "ptz_wifi.h"
+
+namespace ptz {
+
+// Binary control protocol over the USB/UART console.
+//
+// Frame: SOF(0xA5) | len | cmd | seq | payload[len] | crc16 (little endian)
+// The CRC is CRC-16/CCITT-FALSE over len..payload. Integers are little endian.
+// Bytes outside a frame are collected as a text line so `WIFI RESET` keeps working.
+enum SerialCmd : uint8_t {
+  kSerialCmdRequestControl = 0x01,
+  kSerialCmdReleaseControl = 0x02,
+  kSerialCmdHeartbeat = 0x03,
+  kSerialCmdSetVelocity = 0x10, // int16 pan, tilt, zoom (normalized * 32767)
+  kSerialCmdMoveTo = 0x11,      // int32 pan, tilt, zoom (steps)
+  kSerialCmdStop = 0x12,
+  kSerialCmdPresetSave = 0x20,   // uint8 index
+  kSerialCmdPresetRecall = 0x21, // uint8 index
+  kSerialCmdStatusStream = 0x30, // uint16 interval ms, 0 disables
+  kSerialCmdStatusRequest = 0x31,
+
+  kSerialMsgAck = 0x80,    // uint8 refCmd
+  kSerialMsgError = 0x81,  // uint8 refCmd, uint8 code
+  kSerialMsgStatus = 0x82, // uint32 ms, uint8 owner, uint8 flags, int32 pos[3], int32 target[3]
+};
+
+enum SerialError : uint8_t {
+  kSerialErrNotOwner = 1,
+  kSerialErrBadLength = 2,
+  kSerialErrUnknownCmd = 3,
+  kSerialErrBadPreset = 4,
+};
+
+struct SerialStats {
+  uint32_t framesOk;
+  uint32_t crcErrors;
+  uint32_t timeouts;
+  uint32_t overruns;
+  uint32_t txDropped;
+};
+
+class PtzSerial {
+ public:
+  void begin(PtzOwner* owner, PtzMotion* motion, PtzPresets* presets, PtzWifi* wifi);
+  void loop(uint32_t nowMs);
+
+  SerialStats stats() const;
+
+ private:
+  enum class RxState : uint8_t {
+    Idle,
+    Frame,
+  };
+
+  void feed(uint8_t byte, uint32_t nowMs);
+  void feedText(uint8_t byte);
+  void handleFrame(uint8_t cmd, uint8_t seq, const uint8_t* payload, uint8_t len, uint32_t nowMs);
+  void sendStatus(uint32_t nowMs);
+  void sendAck(uint8_t refCmd, uint8_t seq);
+  void sendError(uint8_t refCmd, uint8_t seq, uint8_t code);
+  void sendFrame(uint8_t cmd, uint8_t seq, const uint8_t* payload, uint8_t len);
+
+  PtzOwner* owner_ = nullptr;
+  PtzMotion* motion_ = nullptr;
+  PtzPresets* presets_ = nullptr;
+  PtzWifi* wifi_ = nullptr;
+
+  RxState rxState_ = RxState::Idle;
+  uint8_t rx_[kSerialMaxPayload + 5];
+  uint8_t rxLen_ = 0;
+  uint8_t rxExpected_ = 0;
+  uint32_t rxStartMs_ = 0;
+
+  char line_[32];
+  uint8_t lineLen_ = 0;
+
+  uint16_t statusIntervalMs_ = 0;
+  uint32_t lastStatusMs_ = 0;
+  uint8_t txSeq_ = 0;
+
+  SerialStats stats_ = {};
+};
+
+} // namespace ptz
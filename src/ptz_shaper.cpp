@@ -0,0 +1,172 @@
+#include "ptz_shaper.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace ptz {
+
+static constexpr float kSampleS = kShaperSampleUs * 1e-6f;
+static constexpr float kMaxDelayS = (kShaperHistory - 2) * kSampleS;
+static constexpr float kPi = 3.14159265f;
+
+static_assert(kShaperHistory >= 4, "Shaper history too short");
+
+bool InputShaper::configure(const ShaperConfig& config) {
+  float amplitude[kMaxImpulses];
+  float timeS[kMaxImpulses];
+  uint8_t count = 0;
+  if (!impulses(config, amplitude, timeS, &count)) {
+    return false;
+  }
+  config_ = config;
+  count_ = count;
+  for (uint8_t i = 0; i < count; ++i) {
+    amplitude_[i] = amplitude[i];
+    timeS_[i] = timeS[i];
+  }
+  return true;
+}
+
+const ShaperConfig& InputShaper::config() const {
+  return config_;
+}
+
+// Amplitudes and spacing follow the standard damped ZV/ZVD/EI forms
+// (Singhose); K is the decay of the mode over half a damped period.
+bool InputShaper::impulses(const ShaperConfig& config,
+                           float (&amplitude)[kMaxImpulses],
+                           float (&timeS)[kMaxImpulses],
+                           uint8_t* count) {
+  if (config.type == ShaperType::None) {
+    amplitude[0] = 1.0f;
+    timeS[0] = 0.0f;
+    *count = 1;
+    return true;
+  }
+  // Written as negated ranges so NaN fails too.
+  if (!(config.freqHz >= kShaperMinHz && config.freqHz <= kShaperMaxHz) ||
+      !(config.damping >= 0.0f && config.damping <= kShaperMaxDamping)) {
+    return false;
+  }
+
+  const float df = sqrtf(1.0f - config.damping * config.damping);
+  const float k = expf(-config.damping * kPi / df);
+  const float td = 1.0f / (config.freqHz * df);
+
+  switch (config.type) {
+    case ShaperType::Zv:
+      amplitude[0] = 1.0f;
+      amplitude[1] = k;
+      *count = 2;
+      break;
+    case ShaperType::Zvd:
+      amplitude[0] = 1.0f;
+      amplitude[1] = 2.0f * k;
+      amplitude[2] = k * k;
+      *count = 3;
+      break;
+    case ShaperType::Ei: {
+      const float edge = 0.25f * (1.0f + kShaperEiTolerance);
+      amplitude[0] = edge;
+      amplitude[1] = 0.5f * (1.0f - kShaperEiTolerance) * k;
+      amplitude[2] = edge * k * k;
+      *count = 3;
+      break;
+    }
+    default:
+      return false;
+  }
+
+  float sum = 0.0f;
+  for (uint8_t i = 0; i < *count; ++i) {
+    timeS[i] = 0.5f * td * static_cast<float>(i);
+    sum += amplitude[i];
+  }
+  for (uint8_t i = 0; i < *count; ++i) {
+    amplitude[i] /= sum;
+  }
+  return timeS[*count - 1] <= kMaxDelayS;
+}
+
+const char* InputShaper::typeName(ShaperType type) {
+  switch (type) {
+    case ShaperType::Zv:
+      return "zv";
+    case ShaperType::Zvd:
+      return "zvd";
+    case ShaperType::Ei:
+      return "ei";
+    default:
+      return "none";
+  }
+}
+
+bool InputShaper::typeFromName(const char* name, ShaperType* type) {
+  static const ShaperType kTypes[] = {ShaperType::None, ShaperType::Zv, ShaperType::Zvd, ShaperType::Ei};
+  for (ShaperType candidate : kTypes) {
+    if (strcmp(name, typeName(candidate)) == 0) {
+      *type = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+void InputShaper::reset(float value) {
+  for (uint16_t i = 0; i < kShaperHistory; ++i) {
+    history_[i] = value;
+  }
+  head_ = 0;
+  phaseS_ = 0.0f;
+  lastInput_ = value;
+  stableS_ = kMaxDelayS + kSampleS;
+}
+
+float InputShaper::apply(float input, float dtSeconds) {
+  if (input == lastInput_) {
+    if (stableS_ < kMaxDelayS + kSampleS) {
+      stableS_ += dtSeconds;
+    }
+  } else {
+    stableS_ = 0.0f;
+    lastInput_ = input;
+  }
+  if (count_ == 1) {
+    return input;
+  }
+
+  // A long loop stall fills the missed samples with the current input.
+  phaseS_ += dtSeconds;
+  while (phaseS_ >= kSampleS) {
+    phaseS_ -= kSampleS;
+    head_ = static_cast<uint16_t>((head_ + 1) % kShaperHistory);
+    history_[head_] = input;
+  }
+
+  float output = amplitude_[0] * input;
+  for (uint8_t i = 1; i < count_; ++i) {
+    output += amplitude_[i] * history(timeS_[i]);
+  }
+  return output;
+}
+
+bool InputShaper::settled() const {
+  return count_ == 1 || stableS_ > timeS_[count_ - 1] + kSampleS;
+}
+
+// Input value ageS ago, linearly interpolated between samples; the current
+// input stands in for age 0.
+float InputShaper::history(float ageS) const {
+  if (ageS < phaseS_) {
+    const float t = ageS / phaseS_;
+    return lastInput_ + (history_[head_] - lastInput_) * t;
+  }
+  const float samples = (ageS - phaseS_) / kSampleS;
+  const uint16_t back = static_cast<uint16_t>(samples);
+  const float t = samples - static_cast<float>(back);
+  const float newer = history_[(head_ + kShaperHistory - back) % kShaperHistory];
+  const float older = history_[(head_ + kShaperHistory - back - 1) % kShaperHistory];
+  return newer + (older - newer) * t;
+}
+
+} // namespace ptz
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ptz_config.h"
+
+namespace ptz {
+
+enum class ShaperType : uint8_t {
+  None,
+  Zv,  // two impulses; cancels the tuned mode exactly, least delay
+  Zvd, // three impulses; tolerates frequency error, one full period of delay
+  Ei,  // three impulses; widest tolerance for the same delay as ZVD
+};
+
+struct ShaperConfig {
+  ShaperType type;
+  float freqHz;  // natural frequency of the ringing mode
+  float damping; // damping ratio of that mode
+};
+
+// Input shaper for one axis: the output is the input convolved with a short
+// train of impulses (amplitudes summing to 1) spaced by half the damped period
+// of the rig's ringing mode, so the residual vibration of each impulse
+// cancels. Because the amplitudes are positive and sum to 1, the output never
+// exceeds the speed or slew limit already applied to the input.
+class InputShaper {
+ public:
+  static constexpr uint8_t kMaxImpulses = 3;
+
+  bool configure(const ShaperConfig& config);
+  const ShaperConfig& config() const;
+
+  // Impulse amplitudes and times (seconds) for a configuration; false when it
+  // is out of range. None yields a single unit impulse.
+  static bool impulses(const ShaperConfig& config,
+                       float (&amplitude)[kMaxImpulses],
+                       float (&timeS)[kMaxImpulses],
+                       uint8_t* count);
+  static const char* typeName(ShaperType type);
+  static bool typeFromName(const char* name, ShaperType* type);
+
+  // Fills the history with a constant, so the output starts at that value.
+  void reset(float value);
+  float apply(float input, float dtSeconds);
+  // True once the output equals the input, i.e. the input has been constant
+  // for longer than the last impulse delay.
+  bool settled() const;
+
+ private:
+  float history(float ageS) const;
+
+  ShaperConfig config_ = {ShaperType::None, 0.0f, 0.0f};
+  float amplitude_[kMaxImpulses] = {1.0f};
+  float timeS_[kMaxImpulses] = {0.0f};
+  uint8_t count_ = 1;
+
+  float history_[kShaperHistory] = {}; // history_[head_] is the newest sample
+  uint16_t head_ = 0;
+  float phaseS_ = 0.0f;                // time since the newest sample
+  float lastInput_ = 0.0f;
+  float stableS_ = 0.0f;               // how long the input has been constant
+};
+
+} // namespace ptz
@@ -0,0 +1,73 @@
+#include "ptz_timesync.h"
+
+namespace ptz {
+
+// The best round trip is forgotten slowly so a route change that makes every
+// exchange slower does not lock the estimate out for good.
+static constexpr int64_t kMinDelayForgetUs = 50;
+
+void ClockEstimate::reset() {
+  *this = ClockEstimate();
+}
+
+void ClockEstimate::addExchange(int64_t t0, int64_t t1, int64_t t2, int64_t t3) {
+  const int64_t delay = (t3 - t0) - (t2 - t1);
+  if (delay < 0) {
+    return;
+  }
+  if (samples_ == 0 || delay < minDelayUs_) {
+    minDelayUs_ = delay;
+  } else {
+    minDelayUs_ += kMinDelayForgetUs;
+  }
+  if (delay > minDelayUs_ + kTimeSyncDelaySlackUs) {
+    return;
+  }
+
+  const int64_t offset = ((t1 - t0) + (t2 - t3)) / 2;
+  lastDelayUs_ = delay;
+  if (samples_ == 0) {
+    anchorClientUs_ = t0;
+    anchorOffsetUs_ = offset;
+    samples_ = 1;
+    return;
+  }
+
+  const int64_t elapsed = t0 - anchorClientUs_;
+  if (elapsed <= 0) {
+    return;
+  }
+  // Converge quickly on the first exchanges, then filter harder.
+  const bool settling = samples_ < kTimeSyncMinSamples;
+  const int64_t predicted = anchorOffsetUs_ + static_cast<int64_t>(drift_ * static_cast<float>(elapsed));
+  const int64_t error = offset - predicted;
+  anchorOffsetUs_ = predicted + error / (settling ? 2 : 4);
+  drift_ += (settling ? 0.5f : 0.1f) * static_cast<float>(error) / static_cast<float>(elapsed);
+  anchorClientUs_ = t0;
+  if (samples_ < 255) {
+    ++samples_;
+  }
+}
+
+bool ClockEstimate::synced() const {
+  return samples_ >= kTimeSyncMinSamples;
+}
+
+int64_t ClockEstimate::toDevice(int64_t clientUs) const {
+  const int64_t sinceAnchor = clientUs - anchorClientUs_;
+  return clientUs + anchorOffsetUs_ + static_cast<int64_t>(drift_ * static_cast<float>(sinceAnchor));
+}
+
+int64_t ClockEstimate::offsetUs() const {
+  return anchorOffsetUs_;
+}
+
+float ClockEstimate::driftPpm() const {
+  return drift_ * 1e6f;
+}
+
+int64_t ClockEstimate::delayUs() const {
+  return lastDelayUs_;
+}
+
+} // namespace ptz
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ptz_config.h"
+
+namespace ptz {
+
+// Offset and drift between one client's clock and esp_timer_get_time(),
+// estimated from NTP-style exchanges: t0 client send, t1 device receive,
+// t2 device send, t3 client receive (all in microseconds).
+//
+// Only exchanges close to the best round trip seen are used, and each one
+// nudges offset and drift like a small PLL, so a single slow packet cannot
+// move the estimate far.
+class ClockEstimate {
+ public:
+  void reset();
+  void addExchange(int64_t t0, int64_t t1, int64_t t2, int64_t t3);
+
+  bool synced() const;
+  int64_t toDevice(int64_t clientUs) const;
+
+  int64_t offsetUs() const;  // device minus client at the last anchor
+  float driftPpm() const;    // device clock gain per client second, in ppm
+  int64_t delayUs() const;   // round trip of the last accepted exchange
+
+ private:
+  int64_t anchorClientUs_ = 0;
+  int64_t anchorOffsetUs_ = 0;
+  int64_t minDelayUs_ = 0;
+  int64_t lastDelayUs_ = 0;
+  float drift_ = 0.0f;
+  uint8_t samples_ = 0;
+};
+
+} // namespace ptz
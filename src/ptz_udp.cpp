@@ -0,0 +1,468 @@
+#include "ptz_udp.h"
+
+#include <Arduino.h>
+#include <math.h>
+
+#include "ptz_log.h"
+#include "ptz_serial.h"
+#include "ptz_wire.h"
+
+namespace ptz {
+
+static constexpr uint16_t kViscaTypeCommand = 0x0100;
+static constexpr uint16_t kViscaTypeInquiry = 0x0110;
+static constexpr uint16_t kViscaTypeReply = 0x0111;
+static constexpr uint16_t kViscaTypeControl = 0x0200;
+static constexpr uint16_t kViscaTypeControlReply = 0x0201;
+
+static constexpr uint8_t kViscaAck[] = {0x90, 0x41, 0xFF};
+static constexpr uint8_t kViscaCompletion[] = {0x90, 0x51, 0xFF};
+static constexpr uint8_t kViscaSyntaxError[] = {0x90, 0x60, 0x02, 0xFF};
+static constexpr uint8_t kViscaNotExecutable[] = {0x90, 0x61, 0x41, 0xFF};
+
+static constexpr uint8_t kNativeVersion = 1;
+static constexpr size_t kMaxDatagram = 64;
+
+static uint16_t readBe16(const uint8_t* p) {
+  return static_cast<uint16_t>((static_cast<uint16_t>(p[0]) << 8) | p[1]);
+}
+
+static uint32_t readBe32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+// VISCA packs 16-bit values as four low nibbles (0p 0q 0r 0s).
+static int16_t readNibbles(const uint8_t* p) {
+  return static_cast<int16_t>(((p[0] & 0x0F) << 12) | ((p[1] & 0x0F) << 8) | ((p[2] & 0x0F) << 4) | (p[3] & 0x0F));
+}
+
+static uint8_t* writeNibbles(uint8_t* p, int16_t value) {
+  const uint16_t v = static_cast<uint16_t>(value);
+  p[0] = (v >> 12) & 0x0F;
+  p[1] = (v >> 8) & 0x0F;
+  p[2] = (v >> 4) & 0x0F;
+  p[3] = v & 0x0F;
+  return p + 4;
+}
+
+static int16_t toViscaUnits(float steps, float stepsPerUnit) {
+  const long units = lroundf(steps / stepsPerUnit);
+  if (units > 32767) {
+    return 32767;
+  }
+  if (units < -32768) {
+    return -32768;
+  }
+  return static_cast<int16_t>(units);
+}
+
+static float speedToNorm(uint8_t speed, uint8_t maxSpeed) {
+  const float x = static_cast<float>(speed) / static_cast<float>(maxSpeed);
+  return x > 1.0f ? 1.0f : x;
+}
+
+bool UdpSeqTracker::accept(uint32_t peer, uint32_t seq, uint32_t nowMs) {
+  Peer* slot = nullptr;
+  for (uint8_t i = 0; i < kUdpMaxPeers; ++i) {
+    if (peers_[i].addr == peer) {
+      slot = &peers_[i];
+      break;
+    }
+  }
+
+  if (!slot) {
+    slot = &peers_[0];
+    for (uint8_t i = 1; i < kUdpMaxPeers; ++i) {
+      if (nowMs - peers_[i].lastMs > nowMs - slot->lastMs) {
+        slot = &peers_[i];
+      }
+    }
+    slot->addr = peer;
+    slot->valid = false;
+  }
+
+  if (slot->valid && nowMs - slot->lastMs <= kUdpPeerTimeoutMs &&
+      static_cast<int32_t>(seq - slot->lastSeq) <= 0) {
+    return false;
+  }
+
+  slot->lastSeq = seq;
+  slot->lastMs = nowMs;
+  slot->valid = true;
+  return true;
+}
+
+void UdpSeqTracker::reset(uint32_t peer) {
+  for (uint8_t i = 0; i < kUdpMaxPeers; ++i) {
+    if (peers_[i].addr == peer) {
+      peers_[i].valid = false;
+    }
+  }
+}
+
+uint32_t UdpPeerTable::clientId(uint32_t addr, uint16_t port, uint32_t nowMs, uint32_t keepId) {
+  Peer* free = nullptr;
+  Peer* oldest = nullptr;
+  for (Peer& peer : peers_) {
+    if (!peer.valid) {
+      free = free ? free : &peer;
+    } else if (peer.addr == addr && peer.port == port) {
+      peer.lastMs = nowMs;
+      return kUdpClientIdBase + peer.id;
+    } else if (kUdpClientIdBase + peer.id != keepId && (!oldest || nowMs - peer.lastMs > nowMs - oldest->lastMs)) {
+      oldest = &peer;
+    }
+  }
+  Peer* slot = free ? free : oldest ? oldest : &peers_[0];
+
+  do {
+    ++nextId_;
+  } while (nextId_ == 0 || idInUse(nextId_));
+  slot->addr = addr;
+  slot->port = port;
+  slot->id = nextId_;
+  slot->valid = true;
+  slot->lastMs = nowMs;
+  return kUdpClientIdBase + slot->id;
+}
+
+bool UdpPeerTable::idInUse(uint8_t id) const {
+  for (const Peer& peer : peers_) {
+    if (peer.valid && peer.id == id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PtzUdp::begin(PtzOwner* owner, PtzMotion* motion, PtzPresets* presets) {
+  owner_ = owner;
+  motion_ = motion;
+  presets_ = presets;
+  started_ = udp_.begin(kUdpControlPort) != 0;
+  if (started_) {
+    PTZ_LOGI("UDP", "UDP control listening on port %u", kUdpControlPort);
+  } else {
+    PTZ_LOGW("UDP", "Failed to open UDP port %u", kUdpControlPort);
+  }
+}
+
+void PtzUdp::loop(uint32_t nowMs) {
+  if (!started_) {
+    return;
+  }
+
+  for (uint8_t i = 0; i < kUdpMaxPacketsPerLoop; ++i) {
+    const int size = udp_.parsePacket();
+    if (size <= 0) {
+      break;
+    }
+    ++stats_.datagrams;
+
+    uint8_t packet[kMaxDatagram];
+    if (static_cast<size_t>(size) > sizeof(packet)) {
+      ++stats_.malformed;
+      udp_.flush();
+      continue;
+    }
+    const int len = udp_.read(packet, sizeof(packet));
+    if (len <= 0) {
+      continue;
+    }
+
+    remoteIp_ = udp_.remoteIP();
+    remotePort_ = udp_.remotePort();
+    const OwnerSnapshot snap = owner_->snapshot();
+    clientId_ = peers_.clientId(static_cast<uint32_t>(remoteIp_), remotePort_, nowMs,
+                                snap.owner == Owner::App ? snap.controlClientId : 0);
+
+    if (len >= 8 && packet[0] == 'P' && packet[1] == 'Z') {
+      handleNative(packet, static_cast<size_t>(len), nowMs);
+    } else if (len >= 8) {
+      handleVisca(packet, static_cast<size_t>(len), nowMs);
+    } else {
+      ++stats_.malformed;
+    }
+  }
+
+  // Keep a latched VISCA drive alive; the controller only resends on change.
+  if (viscaClientId_ != 0 && (viscaPan_ != 0.0f || viscaTilt_ != 0.0f || viscaZoom_ != 0.0f)) {
+    const OwnerSnapshot snap = owner_->snapshot();
+    if (snap.owner == Owner::App && snap.controlClientId == viscaClientId_ &&
+        nowMs - viscaLastRxMs_ < kViscaDriveHoldMs) {
+      owner_->appHeartbeat(viscaClientId_, nowMs);
+    } else {
+      viscaPan_ = 0.0f;
+      viscaTilt_ = 0.0f;
+      viscaZoom_ = 0.0f;
+    }
+  }
+}
+
+UdpStats PtzUdp::stats() const {
+  return stats_;
+}
+
+void PtzUdp::handleVisca(const uint8_t* packet, size_t len, uint32_t nowMs) {
+  const uint16_t type = readBe16(packet);
+  const uint16_t payloadLen = readBe16(packet + 2);
+  const uint32_t seq = readBe32(packet + 4);
+  const uint8_t* payload = packet + 8;
+
+  if (payloadLen != len - 8 || payloadLen == 0) {
+    ++stats_.malformed;
+    return;
+  }
+
+  if (type == kViscaTypeControl) {
+    if (payload[0] == 0x01) {
+      seq_.reset(clientId_);
+      const uint8_t reply = 0x01;
+      sendVisca(kViscaTypeControlReply, seq, &reply, 1);
+    }
+    return;
+  }
+
+  if (!seq_.accept(clientId_, seq, nowMs)) {
+    ++stats_.stale;
+    if (logShouldEmit(kLogRateUdpReject, 1000)) {
+      PTZ_LOGW("UDP", "Stale VISCA seq=%lu", static_cast<unsigned long>(seq));
+    }
+    return;
+  }
+
+  if (payload[0] != 0x81 || payload[payloadLen - 1] != 0xFF) {
+    sendVisca(kViscaTypeReply, seq, kViscaSyntaxError, sizeof(kViscaSyntaxError));
+    return;
+  }
+
+  if (type == kViscaTypeCommand) {
+    handleViscaCommand(seq, payload, payloadLen, nowMs);
+  } else if (type == kViscaTypeInquiry) {
+    handleViscaInquiry(seq, payload, payloadLen);
+  } else {
+    ++stats_.malformed;
+  }
+}
+
+void PtzUdp::handleViscaCommand(uint32_t seq, const uint8_t* cmd, size_t len, uint32_t nowMs) {
+  const bool panTilt = cmd[1] == 0x01 && cmd[2] == 0x06;
+  const bool camera = cmd[1] == 0x01 && cmd[2] == 0x04;
+  const bool known = (panTilt && cmd[3] == 0x01 && len == 9) ||
+                     (panTilt && cmd[3] == 0x02 && len == 15) ||
+                     (panTilt && cmd[3] == 0x04 && len == 5) ||
+                     (camera && cmd[3] == 0x07 && len == 6) ||
+                     (camera && cmd[3] == 0x47 && len == 9) ||
+                     (camera && cmd[3] == 0x3F && len == 7);
+  if (!known) {
+    sendVisca(kViscaTypeReply, seq, kViscaSyntaxError, sizeof(kViscaSyntaxError));
+    return;
+  }
+
+  if (!claimControl(clientId_, nowMs)) {
+    sendVisca(kViscaTypeReply, seq, kViscaNotExecutable, sizeof(kViscaNotExecutable));
+    return;
+  }
+  sendVisca(kViscaTypeReply, seq, kViscaAck, sizeof(kViscaAck));
+  viscaClientId_ = clientId_;
+  viscaLastRxMs_ = nowMs;
+
+  const MotionState state = motion_->state();
+
+  if (panTilt && cmd[3] == 0x01) {
+    // Pan-tilt drive: VV WW PP TT with PP 01=left 02=right, TT 01=up 02=down, 03=stop.
+    const float panDir = kInvertPan ? -1.0f : 1.0f;
+    const float panSpeed = speedToNorm(cmd[4], 0x18);
+    const float tiltSpeed = speedToNorm(cmd[5], 0x14);
+    viscaPan_ = (cmd[6] == 0x01) ? -panDir * panSpeed : (cmd[6] == 0x02) ? panDir * panSpeed : 0.0f;
+    viscaTilt_ = (cmd[7] == 0x01) ? tiltSpeed : (cmd[7] == 0x02) ? -tiltSpeed : 0.0f;
+    motion_->setAxisVelocity(kAxisPan, viscaPan_);
+    motion_->setAxisVelocity(kAxisTilt, viscaTilt_);
+  } else if (panTilt && cmd[3] == 0x02) {
+    viscaPan_ = 0.0f;
+    viscaTilt_ = 0.0f;
+    motion_->moveAxisTo(kAxisPan, readNibbles(&cmd[6]) * kViscaPanStepsPerUnit);
+    motion_->moveAxisTo(kAxisTilt, readNibbles(&cmd[10]) * kViscaTiltStepsPerUnit);
+  } else if (panTilt && cmd[3] == 0x04) {
+    viscaPan_ = 0.0f;
+    viscaTilt_ = 0.0f;
+    motion_->moveAxisTo(kAxisPan, 0.0f);
+    motion_->moveAxisTo(kAxisTilt, 0.0f);
+  } else if (camera && cmd[3] == 0x07) {
+    // Zoom: 00 stop, 02/03 tele/wide standard, 2p/3p tele/wide variable speed p=0..7.
+    const uint8_t dir = cmd[4] >> 4;
+    const uint8_t op = cmd[4];
+    if (op == 0x02) {
+      viscaZoom_ = 0.5f;
+    } else if (op == 0x03) {
+      viscaZoom_ = -0.5f;
+    } else if (dir == 0x2 || dir == 0x3) {
+      const float speed = static_cast<float>((cmd[4] & 0x0F) + 1) / 8.0f;
+      viscaZoom_ = (dir == 0x2) ? speed : -speed;
+    } else {
+      viscaZoom_ = 0.0f;
+    }
+    motion_->setAxisVelocity(kAxisZoom, viscaZoom_);
+  } else if (camera && cmd[3] == 0x47) {
+    viscaZoom_ = 0.0f;
+    motion_->moveAxisTo(kAxisZoom, static_cast<uint16_t>(readNibbles(&cmd[4])) * kViscaZoomStepsPerUnit);
+  } else if (camera && cmd[3] == 0x3F) {
+    const uint8_t op = cmd[4];
+    const uint8_t index = cmd[5];
+    if (op == 0x01) {
+      if (!presets_->save(index, state)) {
+        sendVisca(kViscaTypeReply, seq, kViscaNotExecutable, sizeof(kViscaNotExecutable));
+        return;
+      }
+    } else if (op == 0x02) {
+      const Preset* preset = presets_->recall(index);
+      if (!preset) {
+        sendVisca(kViscaTypeReply, seq, kViscaNotExecutable, sizeof(kViscaNotExecutable));
+        return;
+      }
+      viscaPan_ = 0.0f;
+      viscaTilt_ = 0.0f;
+      viscaZoom_ = 0.0f;
+      motion_->moveTo(preset->pos);
+    }
+  }
+
+  // Completion is reported on acceptance; clients poll position inquiries for arrival.
+  sendVisca(kViscaTypeReply, seq, kViscaCompletion, sizeof(kViscaCompletion));
+}
+
+void PtzUdp::handleViscaInquiry(uint32_t seq, const uint8_t* cmd, size_t len) {
+  const MotionState state = motion_->state();
+  uint8_t reply[11];
+  reply[0] = 0x90;
+  reply[1] = 0x50;
+
+  if (len == 5 && cmd[1] == 0x09 && cmd[2] == 0x06 && cmd[3] == 0x12) {
+    uint8_t* p = writeNibbles(&reply[2], toViscaUnits(state.pos[kAxisPan], kViscaPanStepsPerUnit));
+    p = writeNibbles(p, toViscaUnits(state.pos[kAxisTilt], kViscaTiltStepsPerUnit));
+    *p = 0xFF;
+    sendVisca(kViscaTypeReply, seq, reply, 11);
+    return;
+  }
+
+  if (len == 5 && cmd[1] == 0x09 && cmd[2] == 0x04 && cmd[3] == 0x47) {
+    uint8_t* p = writeNibbles(&reply[2], toViscaUnits(state.pos[kAxisZoom], kViscaZoomStepsPerUnit));
+    *p = 0xFF;
+    sendVisca(kViscaTypeReply, seq, reply, 7);
+    return;
+  }
+
+  sendVisca(kViscaTypeReply, seq, kViscaSyntaxError, sizeof(kViscaSyntaxError));
+}
+
+void PtzUdp::handleNative(const uint8_t* packet, size_t len, uint32_t nowMs) {
+  if (packet[2] != kNativeVersion) {
+    ++stats_.malformed;
+    return;
+  }
+
+  const uint8_t cmd = packet[3];
+  const uint32_t seq = readU32(packet + 4);
+  const uint8_t* payload = packet + 8;
+  const size_t payloadLen = len - 8;
+
+  if (!seq_.accept(clientId_, seq, nowMs)) {
+    ++stats_.stale;
+    if (logShouldEmit(kLogRateUdpReject, 1000)) {
+      PTZ_LOGW("UDP", "Stale datagram seq=%lu", static_cast<unsigned long>(seq));
+    }
+    return;
+  }
+
+  if (cmd == kSerialCmdRequestControl) {
+    owner_->requestAppControl(clientId_, nowMs);
+    sendNative(kSerialMsgAck, seq, cmd, 0);
+    PTZ_LOGI("OWNER", "UDP requested control client=%lu", static_cast<unsigned long>(clientId_));
+    return;
+  }
+
+  if (cmd == kSerialCmdReleaseControl) {
+    if (!owner_->releaseAppControl(clientId_)) {
+      sendNative(kSerialMsgError, seq, cmd, kSerialErrNotOwner);
+      return;
+    }
+    sendNative(kSerialMsgAck, seq, cmd, 0);
+    return;
+  }
+
+  const OwnerSnapshot snap = owner_->snapshot();
+  if (snap.owner != Owner::App || snap.controlClientId != clientId_) {
+    sendNative(kSerialMsgError, seq, cmd, kSerialErrNotOwner);
+    return;
+  }
+
+  owner_->appHeartbeat(clientId_, nowMs);
+
+  if (cmd == kSerialCmdHeartbeat) {
+    return;
+  }
+
+  // Velocity datagrams are fire-and-forget; the next one supersedes a lost one.
+  if (cmd == kSerialCmdSetVelocity && payloadLen == 6) {
+    motion_->setAxisVelocity(kAxisPan, normFromI16(readI16(payload)));
+    motion_->setAxisVelocity(kAxisTilt, normFromI16(readI16(payload + 2)));
+    motion_->setAxisVelocity(kAxisZoom, normFromI16(readI16(payload + 4)));
+    return;
+  }
+
+  if (cmd == kSerialCmdMoveTo && payloadLen == 12) {
+    motion_->moveAxisTo(kAxisPan, static_cast<float>(readI32(payload)));
+    motion_->moveAxisTo(kAxisTilt, static_cast<float>(readI32(payload + 4)));
+    motion_->moveAxisTo(kAxisZoom, static_cast<float>(readI32(payload + 8)));
+    sendNative(kSerialMsgAck, seq, cmd, 0);
+    return;
+  }
+
+  if (cmd == kSerialCmdStop) {
+    motion_->stop();
+    sendNative(kSerialMsgAck, seq, cmd, 0);
+    return;
+  }
+
+  sendNative(kSerialMsgError, seq, cmd, kSerialErrUnknownCmd);
+}
+
+bool PtzUdp::claimControl(uint32_t clientId, uint32_t nowMs) {
+  const OwnerSnapshot snap = owner_->snapshot();
+  if (snap.owner == Owner::None) {
+    owner_->requestAppControl(clientId, nowMs);
+    PTZ_LOGI("OWNER", "VISCA took control client=%lu", static_cast<unsigned long>(clientId));
+    return true;
+  }
+  if (snap.owner == Owner::App && snap.controlClientId == clientId) {
+    owner_->appHeartbeat(clientId, nowMs);
+    return true;
+  }
+  return false;
+}
+
+void PtzUdp::sendVisca(uint16_t type, uint32_t seq, const uint8_t* payload, size_t len) {
+  uint8_t header[8] = {
+      static_cast<uint8_t>(type >> 8), static_cast<uint8_t>(type),
+      static_cast<uint8_t>(len >> 8), static_cast<uint8_t>(len),
+      static_cast<uint8_t>(seq >> 24), static_cast<uint8_t>(seq >> 16),
+      static_cast<uint8_t>(seq >> 8), static_cast<uint8_t>(seq),
+  };
+  udp_.beginPacket(remoteIp_, remotePort_);
+  udp_.write(header, sizeof(header));
+  udp_.write(payload, len);
+  udp_.endPacket();
+}
+
+void PtzUdp::sendNative(uint8_t cmd, uint32_t seq, uint8_t refCmd, uint8_t code) {
+  uint8_t packet[10] = {'P', 'Z', kNativeVersion, cmd};
+  writeU32(&packet[4], seq);
+  packet[8] = refCmd;
+  packet[9] = code;
+  udp_.beginPacket(remoteIp_, remotePort_);
+  udp_.write(packet, (cmd == kSerialMsgError) ? 10 : 9);
+  udp_.endPacket();
+}
+
+} // namespace ptz
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <WiFiUdp.h>
+#include <stdint.h>
+
+#include "ptz_config.h"
+#include "ptz_motion.h"
+#include "ptz_owner.h"
+#include "ptz_presets.h"
+
+namespace ptz {
+
+// Tracks the last sequence number per sender so stale or duplicated datagrams
+// are dropped. Peers that stay silent for kUdpPeerTimeoutMs start afresh.
+class UdpSeqTracker {
+ public:
+  bool accept(uint32_t peer, uint32_t seq, uint32_t nowMs);
+  void reset(uint32_t peer);
+
+ private:
+  struct Peer {
+    uint32_t addr;
+    uint32_t lastSeq;
+    uint32_t lastMs;
+    bool valid;
+  };
+
+  Peer peers_[kUdpMaxPeers] = {};
+};
+
+// Owner client ids for UDP senders, one per address and port. Ids come from
+// a rolling counter, so a peer reusing a freed slot never inherits another
+// sender's control. The least recently heard peer is evicted, never `keepId`.
+class UdpPeerTable {
+ public:
+  uint32_t clientId(uint32_t addr, uint16_t port, uint32_t nowMs, uint32_t keepId);
+
+ private:
+  struct Peer {
+    uint32_t addr;
+    uint16_t port;
+    uint8_t id;
+    bool valid;
+    uint32_t lastMs;
+  };
+
+  bool idInUse(uint8_t id) const;
+
+  Peer peers_[kUdpMaxPeers] = {};
+  uint8_t nextId_ = 0;
+};
+
+struct UdpStats {
+  uint32_t datagrams;
+  uint32_t stale;
+  uint32_t malformed;
+};
+
+// UDP control listener. Datagrams starting with the VISCA-over-IP header are
+// handled as Sony VISCA commands; datagrams starting with "PZ" use the native
+// format, which reuses the serial command table (SerialCmd):
+//
+//   'P' 'Z' | version | cmd | seq (uint32 LE) | payload
+class PtzUdp {
+ public:
+  void begin(PtzOwner* owner, PtzMotion* motion, PtzPresets* presets);
+  void loop(uint32_t nowMs);
+
+  UdpStats stats() const;
+
+ private:
+  void handleVisca(const uint8_t* packet, size_t len, uint32_t nowMs);
+  void handleViscaCommand(uint32_t seq, const uint8_t* cmd, size_t len, uint32_t nowMs);
+  void handleViscaInquiry(uint32_t seq, const uint8_t* cmd, size_t len);
+  void handleNative(const uint8_t* packet, size_t len, uint32_t nowMs);
+
+  bool claimControl(uint32_t clientId, uint32_t nowMs);
+  void sendVisca(uint16_t type, uint32_t seq, const uint8_t* payload, size_t len);
+  void sendNative(uint8_t cmd, uint32_t seq, uint8_t refCmd, uint8_t code);
+
+  WiFiUDP udp_;
+  PtzOwner* owner_ = nullptr;
+  PtzMotion* motion_ = nullptr;
+  PtzPresets* presets_ = nullptr;
+  bool started_ = false;
+
+  UdpPeerTable peers_;
+  UdpSeqTracker seq_; // keyed on the peer's client id
+  UdpStats stats_ = {};
+
+  IPAddress remoteIp_;
+  uint16_t remotePort_ = 0;
+  uint32_t clientId_ = 0;
+
+  // VISCA drive commands are latched until the next drive/stop command.
+  uint32_t viscaClientId_ = 0;
+  uint32_t viscaLastRxMs_ = 0;
+  float viscaPan_ = 0.0f;
+  float viscaTilt_ = 0.0f;
+  float viscaZoom_ = 0.0f;
+};
+
+} // namespace ptz
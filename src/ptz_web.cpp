@@ -0,0 +1,79 @@
+#include "ptz_web.h"
+
+#include <string.h>
+
+#include "ptz_log.h"
+#include "ptz_web_assets.h"
+
+namespace ptz {
+
+static const char* kCollectedHeaders[] = {"If-None-Match"};
+
+PtzWeb::PtzWeb() : server_(kWebPort) {}
+
+void PtzWeb::begin() {
+  server_.collectHeaders(kCollectedHeaders, 1);
+  server_.onNotFound([this]() { handleRequest(); });
+  server_.begin();
+  if (xTaskCreatePinnedToCore(&PtzWeb::taskEntry, "web", kWebTaskStackBytes, this, kWebTaskPriority, &task_, 0) !=
+      pdPASS) {
+    PTZ_LOGW("WEB", "Failed to start web task");
+    return;
+  }
+  PTZ_LOGI("WEB", "Web UI on port %u (%u files)", kWebPort, static_cast<unsigned>(kWebAssetCount));
+}
+
+WebStats PtzWeb::stats() const {
+  WebStats stats;
+  stats.requests = __atomic_load_n(&requests_, __ATOMIC_RELAXED);
+  stats.notModified = __atomic_load_n(&notModified_, __ATOMIC_RELAXED);
+  stats.notFound = __atomic_load_n(&notFound_, __ATOMIC_RELAXED);
+  stats.bytes = __atomic_load_n(&bytes_, __ATOMIC_RELAXED);
+  return stats;
+}
+
+void PtzWeb::taskEntry(void* arg) {
+  static_cast<PtzWeb*>(arg)->run();
+}
+
+// The task never logs: the log path is not safe to share with loopTask.
+void PtzWeb::run() {
+  for (;;) {
+    server_.handleClient();
+    vTaskDelay(pdMS_TO_TICKS(kWebPollMs));
+  }
+}
+
+void PtzWeb::handleRequest() {
+  __atomic_fetch_add(&requests_, 1, __ATOMIC_RELAXED);
+  const String& uri = server_.uri();
+  const char* path = uri == "/" ? "/index.html" : uri.c_str();
+
+  const WebAsset* asset = nullptr;
+  for (size_t i = 0; i < kWebAssetCount; ++i) {
+    if (strcmp(path, kWebAssets[i].path) == 0) {
+      asset = &kWebAssets[i];
+      break;
+    }
+  }
+  if (!asset) {
+    __atomic_fetch_add(&notFound_, 1, __ATOMIC_RELAXED);
+    server_.send(404, "text/plain", "Not found");
+    return;
+  }
+
+  // no-cache still lets the browser keep the file; it only has to confirm
+  // the ETag, which costs a 304 with no body.
+  server_.sendHeader("Cache-Control", "no-cache");
+  server_.sendHeader("ETag", asset->etag);
+  if (server_.header("If-None-Match") == asset->etag) {
+    __atomic_fetch_add(&notModified_, 1, __ATOMIC_RELAXED);
+    server_.send(304);
+    return;
+  }
+  server_.sendHeader("Content-Encoding", "gzip");
+  server_.send_P(200, asset->contentType, reinterpret_cast<const char*>(asset->data), asset->size);
+  __atomic_fetch_add(&bytes_, static_cast<uint32_t>(asset->size), __ATOMIC_RELAXED);
+}
+
+} // namespace ptz
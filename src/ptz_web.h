@@ -0,0 +1,54 @@
+#pragma once
+
+#include <WebServer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ptz_config.h"
+
+namespace ptz {
+
+// One gzipped file from web/, generated into ptz_web_assets.h at build time.
+struct WebAsset {
+  const char* path;
+  const char* contentType;
+  const uint8_t* data; // flash
+  size_t size;
+  const char* etag;    // quoted, derived from the content
+};
+
+struct WebStats {
+  uint32_t requests;
+  uint32_t notModified;
+  uint32_t notFound;
+  uint32_t bytes;
+};
+
+// Serves the control UI. Responses are written straight from the flash
+// arrays with Content-Encoding: gzip and an ETag; browsers revalidate with
+// If-None-Match and get a bodiless 304 until the firmware changes. The
+// server runs in its own task and touches no motion state.
+class PtzWeb {
+ public:
+  PtzWeb();
+
+  void begin();
+  WebStats stats() const;
+
+ private:
+  static void taskEntry(void* arg);
+  void run();
+  void handleRequest();
+
+  WebServer server_;
+  TaskHandle_t task_ = nullptr;
+  // Written by the web task on core 0, read by metrics on the loop task.
+  uint32_t requests_ = 0;
+  uint32_t notModified_ = 0;
+  uint32_t notFound_ = 0;
+  uint32_t bytes_ = 0;
+};
+
+} // namespace ptz
@@ -6,6 +6,7 @@
 
 #include "ptz_config.h"
 #include "ptz_log.h"
+#include "ptz_metrics.h"
 
 namespace ptz {
 
@@ -79,6 +80,7 @@ static bool tryStoredCredentials() {
 }
 
 void PtzWifi::begin(bool forcePortal) {
+  AllocScope scope(kAllocWifi);
   WiFiManager wm;
   wm.setDebugOutput(false);
 
@@ -95,6 +97,7 @@ void PtzWifi::begin(bool forcePortal) {
 }
 
 void PtzWifi::resetAndProvision() {
+  AllocScope scope(kAllocWifi);
   PTZ_LOGW("WIFI", "Resetting credentials");
   WiFiManager wm;
   wm.setDebugOutput(false);
@@ -1,12 +1,21 @@
 #include "ptz_ws.h"
 
 #include <ArduinoJson.h>
+#include <esp_timer.h>
+#include <lwip/sockets.h>
+#include <math.h>
+#include <string.h>
+
 #include "ptz_config.h"
 #include "ptz_log.h"
+#include "ptz_wire.h"
 
 namespace ptz {
 
 static float clampNorm(float value) {
+  if (!isfinite(value)) {
+    return 0.0f;
+  }
   if (value > 1.0f) {
     return 1.0f;
   }
@@ -16,11 +25,135 @@ static float clampNorm(float value) {
   return value;
 }
 
-PtzWebSocket::PtzWebSocket() : ws_(kWebsocketPort, kWebsocketPath) {}
+// commandStats_ slots; the first two collect messages that never reach a
+// known command.
+static const char* const kCommandNames[] = {
+    "invalid",        "unknown",       "metrics",      "commandStats",   "listRecordings", "listProfiles",
+    "exportRecording", "requestControl", "releaseControl", "setVelocity",  "moveTo",         "stop",
+    "queueMove",      "queueFlush",    "queueStatus",  "recordStart",    "recordStop",     "playStart",
+    "playStop",       "selectProfile", "saveProfile",  "otaStatus",      "otaStart",       "otaAbort",
+    "otaReboot",      "timeSync",      "recallPreset", "scheduleCancel", "groupStatus",    "groupJoin",
+    "listShapers",    "setShaper",     "observe",      "txStats",
+    "setFreed",       "setRole",
+};
+static constexpr uint8_t kCommandInvalid = 0;
+static constexpr uint8_t kCommandUnknown = 1;
+
+static_assert(sizeof(kCommandNames) / sizeof(kCommandNames[0]) == PtzWebSocket::kCommandStatCount,
+              "kCommandNames must cover every commandStats_ slot");
+// The largest fixed-size reply; queueJson drops anything that does not fit.
+static_assert(kRecordExportChunkBytes * 2 + 320 <= kWebsocketTxQueueBytes,
+              "a recording chunk must fit an empty TX queue");
+
+static uint8_t commandIndex(const char* type) {
+  for (uint8_t i = kCommandUnknown + 1; i < sizeof(kCommandNames) / sizeof(kCommandNames[0]); ++i) {
+    if (strcmp(type, kCommandNames[i]) == 0) {
+      return i;
+    }
+  }
+  return kCommandUnknown;
+}
+
+// A JSON number that is finite as a float (1e39 parses, but overflows).
+static bool isFiniteFloat(JsonVariantConst value) {
+  return value.is<float>() && isfinite(value.as<float>());
+}
+
+// Reads a preset, profile or recording slot number: -1 unless it is an
+// integer below count ("index": 256 must not wrap to slot 0).
+static int readIndex(JsonVariantConst value, uint8_t count) {
+  const int index = value | -1;
+  return index >= 0 && index < count ? index : -1;
+}
 
-void PtzWebSocket::begin(PtzOwner* owner, PtzMotion* motion) {
+// Reads doc[<axis name>] for every axis into out. Pan, tilt and zoom are
+// required; additional axes keep the value already in out when absent.
+static bool readAxisValues(const JsonDocument& doc, float (&out)[kAxisCount]) {
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    if (isFiniteFloat(doc[kAxes[i].name])) {
+      out[i] = doc[kAxes[i].name].as<float>();
+    } else if (i <= kAxisZoom) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static const char* recorderLabel(RecorderMode mode) {
+  switch (mode) {
+    case RecorderMode::Recording:
+      return "recording";
+    case RecorderMode::Preroll:
+      return "preroll";
+    case RecorderMode::Playing:
+      return "playing";
+    case RecorderMode::Idle:
+      break;
+  }
+  return "idle";
+}
+
+bool PtzWsServer::clientWritable(uint8_t num) {
+  if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || !_clients[num].tcp) {
+    return false;
+  }
+  const int fd = _clients[num].tcp->fd();
+  if (fd < 0) {
+    return false;
+  }
+  // lwIP reports a socket writable once the send buffer has at least
+  // TCP_SNDLOWAT free, which is larger than any frame we send.
+  fd_set writeSet;
+  FD_ZERO(&writeSet);
+  FD_SET(fd, &writeSet);
+  timeval timeout = {0, 0};
+  return select(fd + 1, nullptr, &writeSet, nullptr, &timeout) > 0;
+}
+
+void PtzWsServer::dropClient(uint8_t num) {
+  if (num < WEBSOCKETS_SERVER_CLIENT_MAX) {
+    clientDisconnect(&_clients[num]);
+  }
+}
+
+PtzWebSocket::PtzWebSocket() : ws_(kWebsocketPort, kWebsocketPath) {
+  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; ++i) {
+    tx_[i].queue = -1;
+  }
+}
+
+void PtzWebSocket::begin(PtzOwner* owner,
+                         PtzMotion* motion,
+                         PtzRecorder* recorder,
+                         PtzPlanner* planner,
+                         PtzMetrics* metrics,
+                         PtzProfiles* profiles,
+                         PtzDeadline* deadline,
+                         PtzOta* ota,
+                         PtzScheduler* scheduler,
+                         PtzGroup* group,
+                         PtzRateGroups* rates,
+                         const PtzResume* resume,
+                         const PtzSerial* serial,
+                         const PtzUdp* udp,
+                         PtzFreed* freed,
+                         const PtzWeb* web) {
   owner_ = owner;
   motion_ = motion;
+  recorder_ = recorder;
+  planner_ = planner;
+  metrics_ = metrics;
+  profiles_ = profiles;
+  deadline_ = deadline;
+  ota_ = ota;
+  scheduler_ = scheduler;
+  group_ = group;
+  rates_ = rates;
+  resume_ = resume;
+  serial_ = serial;
+  udp_ = udp;
+  freed_ = freed;
+  web_ = web;
 
   ws_.begin();
   ws_.onEvent([this](uint8_t clientNum,
@@ -31,7 +164,51 @@ void PtzWebSocket::begin(PtzOwner* owner, PtzMotion* motion) {
 }
 
 void PtzWebSocket::loop() {
+  AllocScope scope(kAllocWebSocket);
   ws_.loop();
+  flush(millis());
+}
+
+ClientTxStats PtzWebSocket::txStats(uint8_t clientNum) const {
+  ClientTxStats stats = {};
+  if (clientNum < WEBSOCKETS_SERVER_CLIENT_MAX) {
+    const ClientTx& tx = tx_[clientNum];
+    stats.dropped = tx.dropped;
+    stats.replaced = tx.replaced;
+    stats.queued = tx.used;
+    stats.connected = tx.connected;
+    stats.observer = tx.observer;
+  }
+  return stats;
+}
+
+uint32_t PtzWebSocket::slowDisconnects() const {
+  return slowDisconnects_;
+}
+
+// Samples since the previous frame: absolute first sample (t0, p0 per axis),
+// then flat [dtUs, dAxis0, dAxis1, ...] deltas against the preceding sample.
+// `lost` counts samples missing just before t0.
+static void addSampleBatch(JsonDocument& doc, const PositionSample* samples, size_t count, uint32_t lost) {
+  if (count == 0) {
+    return;
+  }
+  JsonObject batch = doc["samples"].to<JsonObject>();
+  batch["t0"] = samples[0].timeUs;
+  if (lost > 0) {
+    batch["lost"] = lost;
+  }
+  JsonArray p0 = batch["p0"].to<JsonArray>();
+  for (uint8_t axis = 0; axis < kAxisCount; ++axis) {
+    p0.add(samples[0].pos[axis]);
+  }
+  JsonArray deltas = batch["d"].to<JsonArray>();
+  for (size_t i = 1; i < count; ++i) {
+    deltas.add(samples[i].timeUs - samples[i - 1].timeUs);
+    for (uint8_t axis = 0; axis < kAxisCount; ++axis) {
+      deltas.add(samples[i].pos[axis] - samples[i - 1].pos[axis]);
+    }
+  }
 }
 
 void PtzWebSocket::broadcastStatus(uint32_t nowMs,
@@ -39,7 +216,11 @@ void PtzWebSocket::broadcastStatus(uint32_t nowMs,
                                    const PtzOwner& owner,
                                    bool gamepadConnected,
                                    bool motorsEnabled,
-                                   int wifiRssi) {
+                                   int wifiRssi,
+                                   const PositionSample* samples,
+                                   size_t sampleCount,
+                                   uint32_t samplesLost) {
+  AllocScope scope(kAllocJson);
   JsonDocument doc;
   doc["v"] = kProtocolVersion;
   doc["type"] = "status";
@@ -48,7 +229,15 @@ void PtzWebSocket::broadcastStatus(uint32_t nowMs,
   const OwnerSnapshot snap = owner.snapshot();
   const char* ownerLabel = "none";
   if (snap.owner == Owner::App) {
-    ownerLabel = "app";
+    if (snap.controlClientId >= kGroupClientIdBase) {
+      ownerLabel = "group";
+    } else if (snap.controlClientId >= kUdpClientIdBase) {
+      ownerLabel = "udp";
+    } else if (snap.controlClientId == kSerialClientId) {
+      ownerLabel = "serial";
+    } else {
+      ownerLabel = "app";
+    }
   } else if (snap.owner == Owner::Gamepad) {
     ownerLabel = "gamepad";
   }
@@ -56,46 +245,230 @@ void PtzWebSocket::broadcastStatus(uint32_t nowMs,
   doc["wifiRssi"] = wifiRssi;
   doc["gamepadConnected"] = gamepadConnected;
   doc["motorsEnabled"] = motorsEnabled;
+  doc["record"] = recorderLabel(recorder_->mode());
+  doc["queueDepth"] = planner_->depth();
+  doc["profile"] = profiles_->active();
 
   const MotionState state = motion.state();
-  JsonObject pan = doc["pan"].to<JsonObject>();
-  pan["pos"] = state.panPos;
-  pan["target"] = state.panTarget;
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    JsonObject axis = doc[kAxes[i].name].to<JsonObject>();
+    axis["pos"] = state.pos[i];
+    axis["target"] = state.target[i];
+  }
 
-  JsonObject tilt = doc["tilt"].to<JsonObject>();
-  tilt["pos"] = state.tiltPos;
-  tilt["target"] = state.tiltTarget;
+  addSampleBatch(doc, samples, sampleCount, samplesLost);
 
-  JsonObject zoom = doc["zoom"].to<JsonObject>();
-  zoom["pos"] = state.zoomPos;
-  zoom["target"] = state.zoomTarget;
+  // A fast move at the lowest status rate carries the most samples. Should
+  // the frame outgrow status_, the oldest samples go, a quarter of the batch
+  // at a time, and are reported as lost rather than the frame being cut short.
+  size_t first = 0;
+  size_t size = measureJson(doc);
+  while (size >= sizeof(status_) && first < sampleCount) {
+    first += (sampleCount - first + 3) / 4;
+    doc.remove("samples");
+    addSampleBatch(doc, samples + first, sampleCount - first, samplesLost + first);
+    size = measureJson(doc);
+  }
+  samplesTrimmed_ += first;
+  samplesLost_ += samplesLost + first;
+  if (size >= sizeof(status_)) {
+    ++statusOversized_;
+    if (logShouldEmit(kLogRateWsStatus, 1000)) {
+      PTZ_LOGW("WS", "Status frame of %u bytes exceeds buffer", static_cast<unsigned>(size));
+    }
+    return;
+  }
 
-  char buffer[512];
-  const size_t size = serializeJson(doc, buffer, sizeof(buffer));
-  ws_.broadcastTXT(buffer, size);
+  // One shared frame; each client only holds a pending flag, so a client
+  // that has not taken the previous frame simply gets the newer one.
+  statusSize_ = serializeJson(doc, status_, sizeof(status_));
+  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; ++i) {
+    ClientTx& tx = tx_[i];
+    if (!tx.connected) {
+      continue;
+    }
+    if (tx.statusPending) {
+      ++tx.replaced;
+    }
+    tx.statusPending = true;
+  }
+  flush(nowMs);
 
   if (logShouldEmit(kLogRateWsStatus, 1000)) {
-    PTZ_LOGD("WS", "Status broadcast %u bytes", static_cast<unsigned>(size));
+    PTZ_LOGD("WS", "Status broadcast %u bytes", static_cast<unsigned>(statusSize_));
   }
 }
 
+// Serializes a reply straight into the client's queue as a [len u16][text]
+// frame. measureJson sizes it first, so a reply is either queued whole or
+// dropped and counted, never truncated. One spare byte is kept for the
+// terminator serializeJson writes.
+void PtzWebSocket::queueJson(uint8_t clientNum, const JsonDocument& doc) {
+  if (clientNum >= WEBSOCKETS_SERVER_CLIENT_MAX || !tx_[clientNum].connected) {
+    return;
+  }
+  ClientTx& tx = tx_[clientNum];
+  const size_t size = measureJson(doc);
+  if (size + 3 > kWebsocketTxQueueBytes) {
+    ++tx.dropped;
+    ++txTooLarge_;
+    if (logShouldEmit(kLogRateWsTxDrop, 1000)) {
+      PTZ_LOGW("WS", "Reply of %u bytes exceeds TX queue client=%u", static_cast<unsigned>(size), clientNum);
+    }
+    return;
+  }
+  if (tx.queue < 0) {
+    for (uint8_t i = 0; i < kWebsocketTxQueues; ++i) {
+      if (!txQueueUsed_[i]) {
+        txQueueUsed_[i] = true;
+        tx.queue = static_cast<int8_t>(i);
+        break;
+      }
+    }
+    if (tx.queue < 0) {
+      ++tx.dropped;
+      ++txQueueStarved_;
+      if (logShouldEmit(kLogRateWsTxDrop, 1000)) {
+        PTZ_LOGW("WS", "No TX queue free client=%u starved=%lu", clientNum,
+                 static_cast<unsigned long>(txQueueStarved_));
+      }
+      return;
+    }
+  }
+  if (size + 3 > static_cast<size_t>(kWebsocketTxQueueBytes - tx.used)) {
+    ++tx.dropped;
+    if (logShouldEmit(kLogRateWsTxDrop, 1000)) {
+      PTZ_LOGW("WS", "TX queue full client=%u dropped=%lu", clientNum, static_cast<unsigned long>(tx.dropped));
+    }
+    return;
+  }
+  uint8_t* frame = &txQueues_[tx.queue][tx.used];
+  writeU16(frame, static_cast<uint16_t>(size));
+  serializeJson(doc, reinterpret_cast<char*>(&frame[2]), size + 1);
+  tx.used += static_cast<uint16_t>(size + 2);
+}
+
+void PtzWebSocket::releaseQueue(ClientTx& tx) {
+  if (tx.queue >= 0) {
+    txQueueUsed_[tx.queue] = false;
+    tx.queue = -1;
+  }
+  tx.used = 0;
+}
+
+// Sends what each client's socket can take without blocking. Step generation
+// runs between frames because every write still costs a few hundred us.
+void PtzWebSocket::flush(uint32_t nowMs) {
+  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; ++i) {
+    ClientTx& tx = tx_[i];
+    if (!tx.connected || (tx.used == 0 && !tx.statusPending)) {
+      continue;
+    }
+    if (flushClient(i)) {
+      tx.stalledSinceMs = 0;
+      continue;
+    }
+    if (tx.stalledSinceMs == 0) {
+      tx.stalledSinceMs = nowMs ? nowMs : 1;
+    } else if (nowMs - tx.stalledSinceMs >= kWebsocketSlowClientMs) {
+      PTZ_LOGW("WS", "Dropping slow client id=%u queued=%u dropped=%lu replaced=%lu", i,
+               static_cast<unsigned>(tx.used), static_cast<unsigned long>(tx.dropped),
+               static_cast<unsigned long>(tx.replaced));
+      ++slowDisconnects_;
+      ws_.dropClient(i);
+    }
+  }
+}
+
+// Returns false when the socket could not take a single frame.
+bool PtzWebSocket::flushClient(uint8_t clientNum) {
+  ClientTx& tx = tx_[clientNum];
+  uint8_t sent = 0;
+  while (sent < kWebsocketMaxFramesPerFlush && (tx.used > 0 || tx.statusPending)) {
+    if (!ws_.clientWritable(clientNum)) {
+      break;
+    }
+    // Queued replies go first so acks never trail the status they caused.
+    if (tx.used > 0) {
+      uint8_t* queue = txQueues_[tx.queue];
+      const uint16_t size = readU16(queue);
+      ws_.sendTXT(clientNum, reinterpret_cast<const char*>(&queue[2]), size);
+      tx.used -= static_cast<uint16_t>(size + 2);
+      memmove(queue, &queue[size + 2], tx.used);
+      if (tx.used == 0) {
+        releaseQueue(tx);
+      }
+    } else {
+      ws_.sendTXT(clientNum, status_, statusSize_);
+      tx.statusPending = false;
+    }
+    ++sent;
+    motion_->run();
+  }
+  return sent > 0;
+}
+
 void PtzWebSocket::onEvent(uint8_t clientNum,
                            WStype_t type,
                            uint8_t* payload,
                            size_t length) {
   if (type == WStype_CONNECTED) {
-    PTZ_LOGI("WS", "Client connected id=%u", clientNum);
+    // The payload is the request URL; "?role=observer" connects read-only.
+    const bool observer = payload && strstr(reinterpret_cast<const char*>(payload), "role=observer") != nullptr;
+    PTZ_LOGI("WS", "Client connected id=%u%s", clientNum, observer ? " (observer)" : "");
+    if (clientNum < WEBSOCKETS_SERVER_CLIENT_MAX) {
+      releaseQueue(tx_[clientNum]);
+      memset(&tx_[clientNum], 0, sizeof(tx_[clientNum]));
+      tx_[clientNum].queue = -1;
+      tx_[clientNum].connected = true;
+      tx_[clientNum].observer = observer;
+      clocks_[clientNum].reset();
+      sync_[clientNum].valid = false;
+    }
   } else if (type == WStype_DISCONNECTED) {
     PTZ_LOGI("WS", "Client disconnected id=%u", clientNum);
+    if (clientNum < WEBSOCKETS_SERVER_CLIENT_MAX) {
+      tx_[clientNum].connected = false;
+      releaseQueue(tx_[clientNum]);
+      tx_[clientNum].statusPending = false;
+    }
+    // The slot is reused by the next client to connect, which must not
+    // inherit control.
+    if (owner_->releaseAppControl(clientNum)) {
+      PTZ_LOGI("OWNER", "App released control client=%u (disconnected)", clientNum);
+    }
   } else if (type == WStype_TEXT) {
+    const uint32_t startUs = micros();
+    command_ = kCommandInvalid;
     handleText(clientNum, reinterpret_cast<char*>(payload), length);
+    const uint32_t elapsedUs = micros() - startUs;
+
+    CommandStats& stats = commandStats_[command_];
+    ++stats.count;
+    stats.totalUs += elapsedUs;
+    if (elapsedUs > stats.maxUs) {
+      stats.maxUs = elapsedUs;
+    }
+    if (elapsedUs > kWebsocketSlowCommandUs && logShouldEmit(kLogRateWsSlowCommand, 1000)) {
+      PTZ_LOGW("WS", "Slow %s: %lu us len=%u", kCommandNames[command_], static_cast<unsigned long>(elapsedUs),
+               static_cast<unsigned>(length));
+    }
   }
 }
 
 void PtzWebSocket::handleText(uint8_t clientNum, const char* payload, size_t len) {
-  JsonDocument doc;
-  DeserializationError err = deserializeJson(doc, payload, len);
+  const int64_t rxUs = esp_timer_get_time();
   const uint32_t nowMs = millis();
+  if (len > kWebsocketMaxMessageBytes) {
+    ++oversized_;
+    sendError(clientNum, "too_large", "Message too large", nowMs);
+    return;
+  }
+
+  AllocScope scope(kAllocJson);
+  JsonDocument doc;
+  DeserializationError err =
+      deserializeJson(doc, payload, len, DeserializationOption::NestingLimit(kWebsocketJsonNestingLimit));
 
   if (err) {
     if (logShouldEmit(kLogRateWsParseError, 500)) {
@@ -120,6 +493,112 @@ void PtzWebSocket::handleText(uint8_t clientNum, const char* payload, size_t len
   }
 
   const uint32_t clientId = clientNum;
+  command_ = commandIndex(type);
+
+  if (strcmp(type, "metrics") == 0) {
+    sendMetrics(clientNum, nowMs);
+    if (doc["reset"] | false) {
+      metrics_->resetTiming();
+      rates_->resetStats();
+      freed_->resetStats();
+    }
+    return;
+  }
+
+  if (strcmp(type, "commandStats") == 0) {
+    sendCommandStats(clientNum, nowMs);
+    if (doc["reset"] | false) {
+      memset(commandStats_, 0, sizeof(commandStats_));
+      oversized_ = 0;
+    }
+    return;
+  }
+
+  if (strcmp(type, "txStats") == 0) {
+    sendTxStats(clientNum, nowMs);
+    return;
+  }
+
+  if (strcmp(type, "listRecordings") == 0) {
+    sendRecordings(clientNum, nowMs);
+    return;
+  }
+
+  if (strcmp(type, "listProfiles") == 0) {
+    sendProfiles(clientNum, nowMs);
+    return;
+  }
+
+  if (strcmp(type, "listShapers") == 0) {
+    sendShapers(clientNum, nowMs);
+    return;
+  }
+
+  if (strcmp(type, "timeSync") == 0) {
+    handleTimeSync(clientNum, doc, rxUs, nowMs);
+    return;
+  }
+
+  if (strcmp(type, "otaStatus") == 0) {
+    sendOta(clientNum, nowMs);
+    return;
+  }
+
+  if (strcmp(type, "groupStatus") == 0) {
+    sendGroup(clientNum, nowMs);
+    return;
+  }
+
+  if (strcmp(type, "exportRecording") == 0) {
+    if (!doc["slot"].is<uint8_t>()) {
+      sendError(clientNum, "invalid_payload", "Missing slot", nowMs);
+      return;
+    }
+    const uint8_t slot = doc["slot"].as<uint8_t>();
+    if (slot >= kRecordSlots || !recorder_->info(slot).valid) {
+      sendError(clientNum, "invalid_slot", "No recording in slot", nowMs);
+      return;
+    }
+    uint16_t offset = 0;
+    if (!doc["offset"].isNull()) {
+      if (!doc["offset"].is<uint16_t>() || doc["offset"].as<uint16_t>() > recorder_->info(slot).bytes) {
+        sendError(clientNum, "invalid_payload", "offset must be 0..size", nowMs);
+        return;
+      }
+      offset = doc["offset"].as<uint16_t>();
+    }
+    sendRecordingChunk(clientNum, slot, offset, nowMs);
+    return;
+  }
+
+  // setRole switches an open connection between "observer" and
+  // "controller"; observe is the older spelling of setRole observer.
+  if (strcmp(type, "observe") == 0 || strcmp(type, "setRole") == 0) {
+    const char* role = strcmp(type, "observe") == 0 ? "observer" : doc["role"] | "";
+    bool observer = false;
+    if (strcmp(role, "observer") == 0) {
+      observer = true;
+    } else if (strcmp(role, "controller") != 0) {
+      sendError(clientNum, "invalid_payload", "role must be observer or controller", nowMs);
+      return;
+    }
+    if (observer != tx_[clientNum].observer) {
+      tx_[clientNum].observer = observer;
+      PTZ_LOGI("WS", "Client %u is now %s", clientNum, role);
+      if (observer && owner_->releaseAppControl(clientId)) {
+        PTZ_LOGI("OWNER", "App released control client=%u", clientId);
+      }
+    }
+    sendAck(clientNum, type, nowMs);
+    return;
+  }
+
+  // Observers get status and the queries above; everything from here on
+  // concerns control and is refused without counting as a rejection.
+  if (tx_[clientNum].observer) {
+    sendError(clientNum, "observer", "Observer clients are read-only", nowMs);
+    return;
+  }
 
   if (strcmp(type, "requestControl") == 0) {
     owner_->requestAppControl(clientId, nowMs);
@@ -140,6 +619,7 @@ void PtzWebSocket::handleText(uint8_t clientNum, const char* payload, size_t len
 
   const OwnerSnapshot snap = owner_->snapshot();
   if (snap.owner != Owner::App || snap.controlClientId != clientId) {
+    metrics_->recordControlRejected();
     sendError(clientNum, "not_owner", "Client is not the active owner", nowMs);
     return;
   }
@@ -147,40 +627,416 @@ void PtzWebSocket::handleText(uint8_t clientNum, const char* payload, size_t len
   owner_->appHeartbeat(clientId, nowMs);
 
   if (strcmp(type, "setVelocity") == 0) {
-    if (!doc["pan"].is<float>() || !doc["tilt"].is<float>() || !doc["zoom"].is<float>()) {
+    float velocity[kAxisCount] = {};
+    if (!readAxisValues(doc, velocity)) {
       sendError(clientNum, "invalid_payload", "Missing velocity fields", nowMs);
       return;
     }
-    const float pan = clampNorm(doc["pan"].as<float>());
-    const float tilt = clampNorm(doc["tilt"].as<float>());
-    const float zoom = clampNorm(doc["zoom"].as<float>());
-    motion_->setVelocity(pan, tilt, zoom);
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      velocity[i] = clampNorm(velocity[i]);
+    }
+    ScheduledCommand command = {};
+    const ScheduleTime when = scheduleTime(clientNum, doc, &command.atUs);
+    if (when == ScheduleTime::Unsynced) {
+      sendError(clientNum, "not_synced", "Clock not synchronized", nowMs);
+      return;
+    }
+    if (when == ScheduleTime::At) {
+      command.clientId = clientId;
+      command.action = ScheduledAction::SetVelocity;
+      memcpy(command.values, velocity, sizeof(velocity));
+      if (!scheduler_->add(command)) {
+        sendError(clientNum, "schedule_rejected", "Schedule full or too far ahead", nowMs);
+        return;
+      }
+    } else {
+      planner_->flush();
+      motion_->setVelocity(velocity);
+    }
     sendAck(clientNum, "setVelocity", nowMs);
     return;
   }
 
   if (strcmp(type, "moveTo") == 0) {
-    if (!doc["pan"].is<float>() || !doc["tilt"].is<float>() || !doc["zoom"].is<float>()) {
+    float target[kAxisCount];
+    const MotionState state = motion_->state();
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      target[i] = state.target[i];
+    }
+    if (!readAxisValues(doc, target)) {
       sendError(clientNum, "invalid_payload", "Missing target fields", nowMs);
       return;
     }
-    const float pan = doc["pan"].as<float>();
-    const float tilt = doc["tilt"].as<float>();
-    const float zoom = doc["zoom"].as<float>();
-    motion_->moveTo(pan, tilt, zoom);
+    ScheduledCommand command = {};
+    const ScheduleTime when = scheduleTime(clientNum, doc, &command.atUs);
+    if (when == ScheduleTime::Unsynced) {
+      sendError(clientNum, "not_synced", "Clock not synchronized", nowMs);
+      return;
+    }
+    if (when == ScheduleTime::At) {
+      command.clientId = clientId;
+      command.action = ScheduledAction::MoveTo;
+      memcpy(command.values, target, sizeof(target));
+      if (!scheduler_->add(command)) {
+        sendError(clientNum, "schedule_rejected", "Schedule full or too far ahead", nowMs);
+        return;
+      }
+    } else {
+      planner_->flush();
+      motion_->moveTo(target);
+    }
     sendAck(clientNum, "moveTo", nowMs);
     return;
   }
 
+  // recallPreset always goes through the scheduler; without a time it fires
+  // on the next poll in this loop pass.
+  if (strcmp(type, "recallPreset") == 0) {
+    ScheduledCommand command = {};
+    const ScheduleTime when = scheduleTime(clientNum, doc, &command.atUs);
+    if (when == ScheduleTime::Unsynced) {
+      sendError(clientNum, "not_synced", "Clock not synchronized", nowMs);
+      return;
+    }
+    if (when == ScheduleTime::Immediate) {
+      command.atUs = rxUs;
+    }
+    command.clientId = clientId;
+    command.action = ScheduledAction::PresetRecall;
+    const int preset = readIndex(doc["index"], kPresetCount);
+    if (preset < 0) {
+      sendError(clientNum, "invalid_payload", "Invalid preset index", nowMs);
+      return;
+    }
+    command.preset = static_cast<uint8_t>(preset);
+    if (!scheduler_->add(command)) {
+      sendError(clientNum, "schedule_rejected", "Schedule full or too far ahead", nowMs);
+      return;
+    }
+    sendAck(clientNum, "recallPreset", nowMs);
+    return;
+  }
+
+  if (strcmp(type, "scheduleCancel") == 0) {
+    scheduler_->cancel(clientId);
+    sendAck(clientNum, "scheduleCancel", nowMs);
+    return;
+  }
+
   if (strcmp(type, "stop") == 0) {
+    planner_->flush();
     motion_->stop();
     sendAck(clientNum, "stop", nowMs);
     return;
   }
 
+  // queueMove appends one waypoint (pan/tilt/zoom) or a whole path
+  // ("points": [[pan, tilt, zoom, ...], ...] in axis order); "speed" is 0..1
+  // of the axis limits.
+  if (strcmp(type, "queueMove") == 0) {
+    // Validate everything first: a rejected path leaves playback, the blend
+    // tolerance and the queue untouched.
+    JsonArray points = doc["points"];
+    if (!points.isNull()) {
+      for (JsonArray point : points) {
+        bool valid = point.size() > kAxisZoom && point.size() <= kAxisCount;
+        for (size_t i = 0; valid && i < point.size(); ++i) {
+          valid = isFiniteFloat(point[i]);
+        }
+        if (!valid) {
+          sendError(clientNum, "invalid_payload", "Points must be [pan, tilt, zoom, ...]", nowMs);
+          return;
+        }
+      }
+      if (points.size() > planner_->space()) {
+        sendError(clientNum, "queue_full", "Not enough queue space for path", nowMs);
+        return;
+      }
+    } else {
+      float scratch[kAxisCount] = {};
+      if (!readAxisValues(doc, scratch)) {
+        sendError(clientNum, "invalid_payload", "Missing target fields", nowMs);
+        return;
+      }
+      if (planner_->space() == 0) {
+        sendError(clientNum, "queue_full", "Motion queue is full", nowMs);
+        return;
+      }
+    }
+
+    recorder_->stopPlayback();
+    if (isFiniteFloat(doc["tolerance"])) {
+      planner_->setBlendTolerance(doc["tolerance"].as<float>());
+    }
+    const float speed = doc["speed"] | 1.0f;
+    if (!points.isNull()) {
+      for (JsonArray point : points) {
+        float target[kAxisCount];
+        planner_->tail(target);
+        for (size_t i = 0; i < point.size(); ++i) {
+          target[i] = point[i].as<float>();
+        }
+        planner_->append(target, speed, clientId);
+      }
+    } else {
+      float target[kAxisCount];
+      planner_->tail(target);
+      readAxisValues(doc, target);
+      planner_->append(target, speed, clientId);
+    }
+    sendQueue(clientNum, nowMs);
+    return;
+  }
+
+  if (strcmp(type, "queueFlush") == 0) {
+    planner_->flush();
+    motion_->stop();
+    sendQueue(clientNum, nowMs);
+    return;
+  }
+
+  if (strcmp(type, "queueStatus") == 0) {
+    sendQueue(clientNum, nowMs);
+    return;
+  }
+
+  if (strcmp(type, "recordStart") == 0) {
+    const int slot = readIndex(doc["slot"], kRecordSlots);
+    if (slot < 0) {
+      sendError(clientNum, "invalid_slot", "Invalid slot", nowMs);
+      return;
+    }
+    if (!recorder_->startRecording(static_cast<uint8_t>(slot))) {
+      sendError(clientNum, "record_failed", "Recorder busy", nowMs);
+      return;
+    }
+    sendAck(clientNum, "recordStart", nowMs);
+    return;
+  }
+
+  if (strcmp(type, "recordStop") == 0) {
+    recorder_->stopRecording();
+    sendAck(clientNum, "recordStop", nowMs);
+    return;
+  }
+
+  if (strcmp(type, "playStart") == 0) {
+    const int slot = readIndex(doc["slot"], kRecordSlots);
+    if (slot < 0) {
+      sendError(clientNum, "invalid_slot", "Invalid slot", nowMs);
+      return;
+    }
+    planner_->flush();
+    if (!recorder_->startPlayback(static_cast<uint8_t>(slot), clientId)) {
+      sendError(clientNum, "play_failed", "Empty slot or recorder busy", nowMs);
+      return;
+    }
+    sendAck(clientNum, "playStart", nowMs);
+    return;
+  }
+
+  if (strcmp(type, "playStop") == 0) {
+    recorder_->stopPlayback();
+    sendAck(clientNum, "playStop", nowMs);
+    return;
+  }
+
+  if (strcmp(type, "selectProfile") == 0) {
+    const int index = readIndex(doc["index"], kProfileCount);
+    if (index < 0 || !profiles_->select(static_cast<uint8_t>(index))) {
+      sendError(clientNum, "invalid_profile", "No profile at index", nowMs);
+      return;
+    }
+    sendAck(clientNum, "selectProfile", nowMs);
+    return;
+  }
+
+  // saveProfile stores {"index", "name", "<axis>": {"maxSps", "accel",
+  // "slew"}}; omitted fields keep the slot's current values (or the active
+  // profile's for an empty slot).
+  if (strcmp(type, "saveProfile") == 0) {
+    const int index = readIndex(doc["index"], kProfileCount);
+    if (index < 0) {
+      sendError(clientNum, "invalid_profile", "Invalid profile index", nowMs);
+      return;
+    }
+    const MotionProfile* base = profiles_->get(static_cast<uint8_t>(index));
+    if (!base) {
+      base = profiles_->get(profiles_->active());
+    }
+    MotionProfile profile = *base;
+    const char* name = doc["name"] | "";
+    if (name[0] != '\0') {
+      strncpy(profile.name, name, kProfileNameLen - 1);
+      profile.name[kProfileNameLen - 1] = '\0';
+    }
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      AxisLimits& axis = profile.limits.axis[i];
+      JsonObject fields = doc[kAxes[i].name];
+      axis.maxSps = fields["maxSps"] | axis.maxSps;
+      axis.accel = fields["accel"] | axis.accel;
+      axis.slewSps2 = fields["slew"] | axis.slewSps2;
+    }
+    if (!profiles_->save(static_cast<uint8_t>(index), profile)) {
+      sendError(clientNum, "invalid_profile", "Invalid limits", nowMs);
+      return;
+    }
+    sendAck(clientNum, "saveProfile", nowMs);
+    return;
+  }
+
+  // setShaper takes per-axis objects {"shaper": "none|zv|zvd|ei", "freqHz",
+  // "damping"}; omitted axes and fields keep their current values. All axes
+  // are validated before any changes.
+  if (strcmp(type, "setShaper") == 0) {
+    ShaperConfig configs[kAxisCount];
+    bool changed[kAxisCount] = {};
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      configs[i] = motion_->shaper(i);
+      JsonObject fields = doc[kAxes[i].name];
+      if (fields.isNull()) {
+        continue;
+      }
+      const char* name = fields["shaper"] | InputShaper::typeName(configs[i].type);
+      float amplitude[InputShaper::kMaxImpulses];
+      float timeS[InputShaper::kMaxImpulses];
+      uint8_t count = 0;
+      configs[i].freqHz = fields["freqHz"] | configs[i].freqHz;
+      configs[i].damping = fields["damping"] | configs[i].damping;
+      if (!InputShaper::typeFromName(name, &configs[i].type) ||
+          !InputShaper::impulses(configs[i], amplitude, timeS, &count)) {
+        sendError(clientNum, "invalid_shaper", "Unknown shaper or frequency/damping out of range", nowMs);
+        return;
+      }
+      changed[i] = true;
+    }
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      if (changed[i]) {
+        profiles_->saveShaper(i, configs[i]);
+      }
+    }
+    sendShapers(clientNum, nowMs);
+    return;
+  }
+
+  // otaStart pulls "url" (plain HTTP) into the inactive partition; "sha256"
+  // is the hex digest of the image. Progress is polled with otaStatus.
+  if (strcmp(type, "otaStart") == 0) {
+    const char* url = doc["url"] | "";
+    const char* sha256 = doc["sha256"] | "";
+    if (url[0] == '\0' || !ota_->start(url, sha256)) {
+      sendError(clientNum, "ota_failed", "Update busy or invalid url/sha256", nowMs);
+      return;
+    }
+    sendAck(clientNum, "otaStart", nowMs);
+    return;
+  }
+
+  if (strcmp(type, "otaAbort") == 0) {
+    ota_->abort();
+    sendAck(clientNum, "otaAbort", nowMs);
+    return;
+  }
+
+  // groupJoin sets this head's multicast group ("group", 0 leaves) and its
+  // id within the group ("head"); both persist across reboots.
+  if (strcmp(type, "groupJoin") == 0) {
+    if (!doc["group"].is<uint8_t>() || !doc["head"].is<uint8_t>() ||
+        !group_->setMembership(doc["group"].as<uint8_t>(), doc["head"].as<uint8_t>())) {
+      sendError(clientNum, "invalid_payload", "Invalid group or head", nowMs);
+      return;
+    }
+    sendGroup(clientNum, nowMs);
+    return;
+  }
+
+  // setFreed starts FreeD output to "ip" (and "port", default
+  // kFreedTargetPort) at "rateHz"; "enabled": false stops it.
+  if (strcmp(type, "setFreed") == 0) {
+    if (doc["enabled"].is<bool>() && !doc["enabled"].as<bool>()) {
+      freed_->disable();
+      sendFreed(clientNum, nowMs);
+      return;
+    }
+    IPAddress ip;
+    const int port = doc["port"] | static_cast<int>(kFreedTargetPort);
+    const int rateHz = doc["rateHz"] | static_cast<int>(freed_->rateHz());
+    if (!ip.fromString(doc["ip"] | "") || port < 1 || port > 65535 || rateHz < kFreedMinRateHz ||
+        rateHz > kFreedMaxRateHz) {
+      sendError(clientNum, "invalid_payload", "Invalid ip, port or rateHz", nowMs);
+      return;
+    }
+    freed_->setRate(static_cast<uint16_t>(rateHz));
+    freed_->setTarget(ip, static_cast<uint16_t>(port));
+    sendFreed(clientNum, nowMs);
+    return;
+  }
+
+  if (strcmp(type, "otaReboot") == 0) {
+    if (!ota_->requestReboot()) {
+      sendError(clientNum, "ota_not_ready", "No verified image to boot", nowMs);
+      return;
+    }
+    sendAck(clientNum, "otaReboot", nowMs);
+    return;
+  }
+
   sendError(clientNum, "unknown_type", "Unknown command type", nowMs);
 }
 
+// timeSync carries the client's send time "t0" and, from the second request
+// on, "prevT3": when the client received the previous reply. That closes the
+// previous exchange for the device-side estimate; the reply returns t1/t2 so
+// clients can also run their own estimate.
+void PtzWebSocket::handleTimeSync(uint8_t clientNum, JsonDocument& doc, int64_t rxUs, uint32_t nowMs) {
+  if (clientNum >= WEBSOCKETS_SERVER_CLIENT_MAX || !doc["t0"].is<int64_t>()) {
+    sendError(clientNum, "invalid_payload", "Missing t0", nowMs);
+    return;
+  }
+  SyncExchange& last = sync_[clientNum];
+  ClockEstimate& clock = clocks_[clientNum];
+  if (last.valid && doc["prevT3"].is<int64_t>()) {
+    clock.addExchange(last.t0, last.t1, last.t2, doc["prevT3"].as<int64_t>());
+  }
+
+  JsonDocument reply;
+  reply["v"] = kProtocolVersion;
+  reply["type"] = "timeSync";
+  reply["timestampMs"] = nowMs;
+  reply["t0"] = doc["t0"].as<int64_t>();
+  reply["t1"] = rxUs;
+  reply["synced"] = clock.synced();
+  reply["offsetUs"] = clock.offsetUs();
+  reply["driftPpm"] = clock.driftPpm();
+  reply["delayUs"] = clock.delayUs();
+
+  last.t0 = doc["t0"].as<int64_t>();
+  last.t1 = rxUs;
+  last.t2 = esp_timer_get_time();
+  last.valid = true;
+  reply["t2"] = last.t2;
+
+  queueJson(clientNum, reply);
+}
+
+// "at" is a device time (esp_timer microseconds); "atClient" is in the
+// client's own clock and needs a synced estimate. Heads sharing a controller
+// clock start together when given the same atClient.
+PtzWebSocket::ScheduleTime PtzWebSocket::scheduleTime(uint8_t clientNum, JsonDocument& doc, int64_t* atUs) const {
+  if (doc["at"].is<int64_t>()) {
+    *atUs = doc["at"].as<int64_t>();
+    return ScheduleTime::At;
+  }
+  if (!doc["atClient"].is<int64_t>()) {
+    return ScheduleTime::Immediate;
+  }
+  if (clientNum >= WEBSOCKETS_SERVER_CLIENT_MAX || !clocks_[clientNum].synced()) {
+    return ScheduleTime::Unsynced;
+  }
+  *atUs = clocks_[clientNum].toDevice(doc["atClient"].as<int64_t>());
+  return ScheduleTime::At;
+}
+
 void PtzWebSocket::sendAck(uint8_t clientNum, const char* refType, uint32_t nowMs) {
   JsonDocument doc;
   doc["v"] = kProtocolVersion;
@@ -188,9 +1044,7 @@ void PtzWebSocket::sendAck(uint8_t clientNum, const char* refType, uint32_t nowM
   doc["timestampMs"] = nowMs;
   doc["refType"] = refType;
 
-  char buffer[192];
-  const size_t size = serializeJson(doc, buffer, sizeof(buffer));
-  ws_.sendTXT(clientNum, buffer, size);
+  queueJson(clientNum, doc);
 }
 
 void PtzWebSocket::sendError(uint8_t clientNum,
@@ -204,9 +1058,383 @@ void PtzWebSocket::sendError(uint8_t clientNum,
   doc["code"] = code;
   doc["message"] = message;
 
-  char buffer[256];
-  const size_t size = serializeJson(doc, buffer, sizeof(buffer));
-  ws_.sendTXT(clientNum, buffer, size);
+  queueJson(clientNum, doc);
+}
+
+void PtzWebSocket::sendQueue(uint8_t clientNum, uint32_t nowMs) {
+  JsonDocument doc;
+  doc["v"] = kProtocolVersion;
+  doc["type"] = "queue";
+  doc["timestampMs"] = nowMs;
+  doc["depth"] = planner_->depth();
+  doc["free"] = planner_->space();
+  doc["tolerance"] = planner_->blendTolerance();
+
+  queueJson(clientNum, doc);
+}
+
+void PtzWebSocket::sendMetrics(uint8_t clientNum, uint32_t nowMs) {
+  JsonDocument doc;
+  doc["v"] = kProtocolVersion;
+  doc["type"] = "metrics";
+  doc["timestampMs"] = nowMs;
+
+  const MemorySnapshot mem = metrics_->memory();
+  JsonObject heap = doc["heap"].to<JsonObject>();
+  heap["free"] = mem.freeHeap;
+  heap["minFree"] = mem.minFreeHeap;
+  heap["largestBlock"] = mem.largestFreeBlock;
+
+  JsonObject stacks = doc["stackFree"].to<JsonObject>();
+  for (uint8_t i = 0; i < kStackTaskCount; ++i) {
+    if (mem.stackFree[i] > 0) {
+      stacks[PtzMetrics::taskName(i)] = mem.stackFree[i];
+    }
+  }
+
+  JsonObject allocs = doc["allocs"].to<JsonObject>();
+  for (uint8_t i = 0; i < kAllocSubsystemCount; ++i) {
+    allocs[PtzMetrics::subsystemName(i)] = metrics_->allocCount(static_cast<AllocSubsystem>(i));
+  }
+
+  const LatencyHistogram& loopPeriod = metrics_->loopPeriod();
+  JsonObject loop = doc["loopUs"].to<JsonObject>();
+  loop["n"] = loopPeriod.count();
+  loop["p50"] = loopPeriod.quantile(0.5f);
+  loop["p99"] = loopPeriod.quantile(0.99f);
+  loop["p999"] = loopPeriod.quantile(0.999f);
+  loop["max"] = loopPeriod.max();
+
+  const LatencyHistogram& statusJitter = metrics_->statusJitter();
+  JsonObject jitter = doc["statusJitterUs"].to<JsonObject>();
+  jitter["n"] = statusJitter.count();
+  jitter["p50"] = statusJitter.quantile(0.5f);
+  jitter["p99"] = statusJitter.quantile(0.99f);
+  jitter["max"] = statusJitter.max();
+
+  const LatencyHistogram& stickLatency = metrics_->stickLatency();
+  JsonObject stick = doc["stickToStepUs"].to<JsonObject>();
+  stick["n"] = stickLatency.count();
+  stick["p50"] = stickLatency.quantile(0.5f);
+  stick["p99"] = stickLatency.quantile(0.99f);
+  stick["max"] = stickLatency.max();
+
+  JsonObject owner = doc["owner"].to<JsonObject>();
+  owner["changes"] = metrics_->ownerChanges();
+  owner["rejected"] = metrics_->controlRejected();
+
+  const LatencyHistogram& lateness = scheduler_->lateness();
+  JsonObject schedule = doc["schedule"].to<JsonObject>();
+  schedule["pending"] = scheduler_->pending();
+  schedule["discarded"] = scheduler_->discarded();
+  schedule["fired"] = lateness.count();
+  schedule["lateP99Us"] = lateness.quantile(0.99f);
+  schedule["lateMaxUs"] = lateness.max();
+
+  const DeadlineStats load = deadline_->stats();
+  JsonObject status = doc["status"].to<JsonObject>();
+  status["bytes"] = statusSize_;
+  status["samplesLost"] = samplesLost_;
+  status["samplesTrimmed"] = samplesTrimmed_;
+  status["oversized"] = statusOversized_;
+
+  JsonObject deadline = doc["deadline"].to<JsonObject>();
+  deadline["level"] = PtzDeadline::levelName(load.level);
+  deadline["overruns"] = load.overruns;
+  deadline["clamped"] = load.clamped;
+  deadline["shedEvents"] = load.shedEvents;
+  deadline["maxPeriodUs"] = load.maxPeriodUs;
+  deadline["logsDropped"] = logDeferredDropped();
+
+  JsonArray rates = doc["rates"].to<JsonArray>();
+  for (uint8_t i = 0; i < rates_->count(); ++i) {
+    const RateTaskInfo task = rates_->info(i);
+    JsonObject entry = rates.add<JsonObject>();
+    entry["name"] = task.name;
+    entry["periodUs"] = task.periodUs;
+    entry["runs"] = task.stats.runs;
+    entry["skipped"] = task.stats.skipped;
+    entry["overruns"] = task.stats.overruns;
+    entry["maxLateUs"] = task.stats.maxLateUs;
+    entry["avgRunUs"] = task.stats.runs ? static_cast<uint32_t>(task.stats.totalRunUs / task.stats.runs) : 0;
+    entry["maxRunUs"] = task.stats.maxRunUs;
+  }
+
+  const ResumeStats resumed = resume_->stats();
+  JsonObject resume = doc["resume"].to<JsonObject>();
+  resume["source"] = PtzResume::sourceName(resumed.source);
+  resume["restored"] = resumed.restoredMask;
+  resume["suspect"] = resumed.suspectMask;
+  resume["writes"] = resumed.writes;
+  resume["supplyFails"] = resumed.supplyFails;
+  resume["recallMs"] = resumed.recallRequestMs;
+  resume["recallSettledMs"] = resumed.recallSettledMs;
+  resume["recallDurationMs"] = resumed.recallSettledMs != 0 ? resumed.recallSettledMs - resumed.recallRequestMs : 0;
+
+  const SerialStats link = serial_->stats();
+  JsonObject serial = doc["serial"].to<JsonObject>();
+  serial["framesOk"] = link.framesOk;
+  serial["crcErrors"] = link.crcErrors;
+  serial["timeouts"] = link.timeouts;
+  serial["overruns"] = link.overruns;
+  serial["txDropped"] = link.txDropped;
+
+  const UdpStats datagrams = udp_->stats();
+  JsonObject udp = doc["udp"].to<JsonObject>();
+  udp["datagrams"] = datagrams.datagrams;
+  udp["stale"] = datagrams.stale;
+  udp["malformed"] = datagrams.malformed;
+
+  const FreedStats poses = freed_->stats();
+  const LatencyHistogram& freedJitter = freed_->jitter();
+  JsonObject freed = doc["freed"].to<JsonObject>();
+  freed["enabled"] = freed_->enabled();
+  freed["sent"] = poses.sent;
+  freed["skipped"] = poses.skipped;
+  freed["jitterP50Us"] = freedJitter.quantile(0.5f);
+  freed["jitterP99Us"] = freedJitter.quantile(0.99f);
+  freed["jitterMaxUs"] = freedJitter.max();
+
+  const WebStats pages = web_->stats();
+  JsonObject web = doc["web"].to<JsonObject>();
+  web["requests"] = pages.requests;
+  web["notModified"] = pages.notModified;
+  web["notFound"] = pages.notFound;
+  web["bytes"] = pages.bytes;
+
+  JsonObject power = doc["power"].to<JsonObject>();
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    JsonObject axis = power[kAxes[i].name].to<JsonObject>();
+    axis["on"] = motion_->axisEnabled(i);
+    axis["energizedMs"] = motion_->energizedMs(i);
+  }
+
+  queueJson(clientNum, doc);
+}
+
+// Per-client queue state; separate from metrics because its size grows with
+// the number of connected clients.
+void PtzWebSocket::sendTxStats(uint8_t clientNum, uint32_t nowMs) {
+  JsonDocument doc;
+  doc["v"] = kProtocolVersion;
+  doc["type"] = "txStats";
+  doc["timestampMs"] = nowMs;
+  doc["slowDisconnects"] = slowDisconnects_;
+  doc["queueStarved"] = txQueueStarved_;
+  doc["tooLarge"] = txTooLarge_;
+  uint8_t observers = 0;
+  JsonArray clients = doc["clients"].to<JsonArray>();
+  for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; ++i) {
+    const ClientTxStats stats = txStats(i);
+    if (!stats.connected) {
+      continue;
+    }
+    JsonObject entry = clients.add<JsonObject>();
+    entry["id"] = i;
+    entry["queued"] = stats.queued;
+    entry["dropped"] = stats.dropped;
+    entry["replaced"] = stats.replaced;
+    if (stats.observer) {
+      entry["observer"] = true;
+      ++observers;
+    }
+  }
+  doc["observers"] = observers;
+
+  queueJson(clientNum, doc);
+}
+
+void PtzWebSocket::sendRecordings(uint8_t clientNum, uint32_t nowMs) {
+  JsonDocument doc;
+  doc["v"] = kProtocolVersion;
+  doc["type"] = "recordings";
+  doc["timestampMs"] = nowMs;
+  doc["tickUs"] = kRecordTickUs;
+
+  JsonArray slots = doc["slots"].to<JsonArray>();
+  for (uint8_t i = 0; i < kRecordSlots; ++i) {
+    const RecordingInfo info = recorder_->info(i);
+    if (!info.valid) {
+      continue;
+    }
+    JsonObject entry = slots.add<JsonObject>();
+    entry["slot"] = i;
+    entry["ticks"] = info.ticks;
+    entry["bytes"] = info.bytes;
+  }
+
+  queueJson(clientNum, doc);
+}
+
+void PtzWebSocket::sendProfiles(uint8_t clientNum, uint32_t nowMs) {
+  JsonDocument doc;
+  doc["v"] = kProtocolVersion;
+  doc["type"] = "profiles";
+  doc["timestampMs"] = nowMs;
+  doc["active"] = profiles_->active();
+
+  JsonArray list = doc["profiles"].to<JsonArray>();
+  for (uint8_t i = 0; i < kProfileCount; ++i) {
+    const MotionProfile* profile = profiles_->get(i);
+    if (!profile) {
+      continue;
+    }
+    JsonObject entry = list.add<JsonObject>();
+    entry["index"] = i;
+    entry["name"] = static_cast<const char*>(profile->name);
+    for (uint8_t axis = 0; axis < kAxisCount; ++axis) {
+      JsonObject limits = entry[kAxes[axis].name].to<JsonObject>();
+      limits["maxSps"] = profile->limits.axis[axis].maxSps;
+      limits["accel"] = profile->limits.axis[axis].accel;
+      limits["slew"] = profile->limits.axis[axis].slewSps2;
+    }
+  }
+
+  queueJson(clientNum, doc);
+}
+
+// Reports each axis's shaper with its impulse train so a tuning tool can
+// check it against reference responses.
+void PtzWebSocket::sendShapers(uint8_t clientNum, uint32_t nowMs) {
+  JsonDocument doc;
+  doc["v"] = kProtocolVersion;
+  doc["type"] = "shapers";
+  doc["timestampMs"] = nowMs;
+
+  for (uint8_t axis = 0; axis < kAxisCount; ++axis) {
+    const ShaperConfig& config = motion_->shaper(axis);
+    JsonObject entry = doc[kAxes[axis].name].to<JsonObject>();
+    entry["shaper"] = InputShaper::typeName(config.type);
+    entry["freqHz"] = config.freqHz;
+    entry["damping"] = config.damping;
+
+    float amplitude[InputShaper::kMaxImpulses];
+    float timeS[InputShaper::kMaxImpulses];
+    uint8_t count = 0;
+    InputShaper::impulses(config, amplitude, timeS, &count);
+    JsonArray impulses = entry["impulses"].to<JsonArray>();
+    for (uint8_t i = 0; i < count; ++i) {
+      JsonArray impulse = impulses.add<JsonArray>();
+      impulse.add(amplitude[i]);
+      impulse.add(timeS[i] * 1000.0f);
+    }
+  }
+
+  queueJson(clientNum, doc);
+}
+
+void PtzWebSocket::sendCommandStats(uint8_t clientNum, uint32_t nowMs) {
+  JsonDocument doc;
+  doc["v"] = kProtocolVersion;
+  doc["type"] = "commandStats";
+  doc["timestampMs"] = nowMs;
+  doc["oversized"] = oversized_;
+
+  JsonObject commands = doc["commands"].to<JsonObject>();
+  for (uint8_t i = 0; i < kCommandStatCount; ++i) {
+    const CommandStats& stats = commandStats_[i];
+    if (stats.count == 0) {
+      continue;
+    }
+    JsonObject entry = commands[kCommandNames[i]].to<JsonObject>();
+    entry["n"] = stats.count;
+    entry["avgUs"] = stats.totalUs / stats.count;
+    entry["maxUs"] = stats.maxUs;
+  }
+
+  queueJson(clientNum, doc);
+}
+
+void PtzWebSocket::sendOta(uint8_t clientNum, uint32_t nowMs) {
+  const OtaStatus status = ota_->status();
+  JsonDocument doc;
+  doc["v"] = kProtocolVersion;
+  doc["type"] = "ota";
+  doc["timestampMs"] = nowMs;
+  doc["state"] = PtzOta::stateName(status.state);
+  doc["bytes"] = status.bytes;
+  doc["total"] = status.total;
+  doc["activeMs"] = status.activeMs;
+  doc["pausedMs"] = status.pausedMs;
+  doc["kBps"] = status.activeMs ? status.bytes / status.activeMs : 0;
+  if (status.error) {
+    doc["error"] = status.error;
+  }
+  doc["pendingVerify"] = ota_->pendingVerify();
+
+  queueJson(clientNum, doc);
+}
+
+void PtzWebSocket::sendGroup(uint8_t clientNum, uint32_t nowMs) {
+  const GroupStats stats = group_->stats();
+  JsonDocument doc;
+  doc["v"] = kProtocolVersion;
+  doc["type"] = "group";
+  doc["timestampMs"] = nowMs;
+  doc["group"] = group_->groupId();
+  doc["head"] = group_->headId();
+  doc["joined"] = group_->joined();
+  doc["datagrams"] = stats.datagrams;
+  doc["applied"] = stats.applied;
+  doc["stale"] = stats.stale;
+  doc["malformed"] = stats.malformed;
+  doc["otherGroup"] = stats.otherGroup;
+  doc["notAddressed"] = stats.notAddressed;
+  doc["rejected"] = stats.rejected;
+
+  queueJson(clientNum, doc);
+}
+
+void PtzWebSocket::sendFreed(uint8_t clientNum, uint32_t nowMs) {
+  const String ip = freed_->target().toString();
+  JsonDocument doc;
+  doc["v"] = kProtocolVersion;
+  doc["type"] = "freed";
+  doc["timestampMs"] = nowMs;
+  doc["enabled"] = freed_->enabled();
+  doc["ip"] = ip.c_str();
+  doc["port"] = freed_->port();
+  doc["rateHz"] = freed_->rateHz();
+
+  queueJson(clientNum, doc);
+}
+
+// Recordings export as hex chunks of the encoded stream (see PtzRecorder) so
+// hosts can replay them (tools/record_export.py); the client requests
+// successive offsets until done. The caller has checked offset <= size.
+void PtzWebSocket::sendRecordingChunk(uint8_t clientNum, uint8_t slot, uint16_t offset, uint32_t nowMs) {
+  static const char kHex[] = "0123456789abcdef";
+  const RecordingInfo info = recorder_->info(slot);
+  uint16_t count = info.bytes - offset;
+  if (count > kRecordExportChunkBytes) {
+    count = kRecordExportChunkBytes;
+  }
+
+  char hex[kRecordExportChunkBytes * 2 + 1];
+  const uint8_t* data = recorder_->data(slot) + offset;
+  for (uint16_t i = 0; i < count; ++i) {
+    hex[i * 2] = kHex[data[i] >> 4];
+    hex[i * 2 + 1] = kHex[data[i] & 0x0F];
+  }
+  hex[count * 2] = '\0';
+
+  JsonDocument doc;
+  doc["v"] = kProtocolVersion;
+  doc["type"] = "recording";
+  doc["timestampMs"] = nowMs;
+  doc["slot"] = slot;
+  doc["tickUs"] = kRecordTickUs;
+  doc["quantization"] = kRecordQuantization;
+  doc["ticks"] = info.ticks;
+  JsonArray start = doc["start"].to<JsonArray>();
+  for (uint8_t i = 0; i < kAxisCount; ++i) {
+    start.add(info.start[i]);
+  }
+  doc["size"] = info.bytes;
+  doc["offset"] = offset;
+  doc["data"] = static_cast<const char*>(hex);
+
+  queueJson(clientNum, doc);
 }
 
 } // namespace ptz
@@ -1,25 +1,92 @@
 #pragma once
 
+#include <ArduinoJson.h>
 #include <WebSocketsServer.h>
 
+#include "ptz_deadline.h"
+#include "ptz_freed.h"
+#include "ptz_group.h"
+#include "ptz_metrics.h"
+#include "ptz_ota.h"
 #include "ptz_motion.h"
 #include "ptz_owner.h"
+#include "ptz_planner.h"
+#include "ptz_profiles.h"
+#include "ptz_rates.h"
+#include "ptz_record.h"
+#include "ptz_resume.h"
+#include "ptz_samples.h"
+#include "ptz_schedule.h"
+#include "ptz_serial.h"
+#include "ptz_timesync.h"
+#include "ptz_udp.h"
+#include "ptz_web.h"
 
 namespace ptz {
 
+// WebSocketsServer writes block until the TCP send buffer drains. This adds
+// a non-blocking writability probe and a disconnect that skips the close
+// handshake, so a stuck client can neither stall nor be waited on.
+class PtzWsServer : public WebSocketsServer {
+ public:
+  using WebSocketsServer::WebSocketsServer;
+
+  bool clientWritable(uint8_t num);
+  void dropClient(uint8_t num);
+};
+
+struct ClientTxStats {
+  uint32_t dropped;   // replies that did not fit the queue
+  uint32_t replaced;  // status frames superseded before they were sent
+  uint16_t queued;    // bytes waiting
+  bool connected;
+  bool observer;
+};
+
+// Handling cost per command type, measured around handleText() including
+// the reply.
+struct CommandStats {
+  uint32_t count;
+  uint32_t totalUs;
+  uint32_t maxUs;
+};
+
 class PtzWebSocket {
  public:
+  static constexpr uint8_t kCommandStatCount = 36;
+
   PtzWebSocket();
 
-  void begin(PtzOwner* owner, PtzMotion* motion);
+  void begin(PtzOwner* owner,
+             PtzMotion* motion,
+             PtzRecorder* recorder,
+             PtzPlanner* planner,
+             PtzMetrics* metrics,
+             PtzProfiles* profiles,
+             PtzDeadline* deadline,
+             PtzOta* ota,
+             PtzScheduler* scheduler,
+             PtzGroup* group,
+             PtzRateGroups* rates,
+             const PtzResume* resume,
+             const PtzSerial* serial,
+             const PtzUdp* udp,
+             PtzFreed* freed,
+             const PtzWeb* web);
   void loop();
 
+  ClientTxStats txStats(uint8_t clientNum) const;
+  uint32_t slowDisconnects() const;
+
   void broadcastStatus(uint32_t nowMs,
                        PtzMotion& motion,
                        const PtzOwner& owner,
                        bool gamepadConnected,
                        bool motorsEnabled,
-                       int wifiRssi);
+                       int wifiRssi,
+                       const PositionSample* samples,
+                       size_t sampleCount,
+                       uint32_t samplesLost);
 
  private:
   void onEvent(uint8_t clientNum,
@@ -27,16 +94,90 @@ class PtzWebSocket {
                uint8_t* payload,
                size_t length);
 
+  // Last timeSync reply per client; the next request closes the exchange.
+  struct SyncExchange {
+    int64_t t0;
+    int64_t t1;
+    int64_t t2;
+    bool valid;
+  };
+
+  enum class ScheduleTime : uint8_t {
+    Immediate,
+    At,
+    Unsynced,
+  };
+
+  struct ClientTx {
+    int8_t queue; // txQueues_ slot while replies are outstanding, else -1
+    uint16_t used;
+    bool connected;
+    bool observer; // read-only, never takes part in control arbitration
+    bool statusPending;
+    uint32_t stalledSinceMs;
+    uint32_t dropped;
+    uint32_t replaced;
+  };
+
   void handleText(uint8_t clientNum, const char* payload, size_t len);
+  void handleTimeSync(uint8_t clientNum, JsonDocument& doc, int64_t rxUs, uint32_t nowMs);
+  ScheduleTime scheduleTime(uint8_t clientNum, JsonDocument& doc, int64_t* atUs) const;
+  void queueJson(uint8_t clientNum, const JsonDocument& doc);
+  void releaseQueue(ClientTx& tx);
+  void flush(uint32_t nowMs);
+  bool flushClient(uint8_t clientNum);
   void sendAck(uint8_t clientNum, const char* refType, uint32_t nowMs);
   void sendError(uint8_t clientNum,
                  const char* code,
                  const char* message,
                  uint32_t nowMs);
+  void sendQueue(uint8_t clientNum, uint32_t nowMs);
+  void sendMetrics(uint8_t clientNum, uint32_t nowMs);
+  void sendTxStats(uint8_t clientNum, uint32_t nowMs);
+  void sendRecordings(uint8_t clientNum, uint32_t nowMs);
+  void sendProfiles(uint8_t clientNum, uint32_t nowMs);
+  void sendShapers(uint8_t clientNum, uint32_t nowMs);
+  void sendCommandStats(uint8_t clientNum, uint32_t nowMs);
+  void sendOta(uint8_t clientNum, uint32_t nowMs);
+  void sendGroup(uint8_t clientNum, uint32_t nowMs);
+  void sendFreed(uint8_t clientNum, uint32_t nowMs);
+  void sendRecordingChunk(uint8_t clientNum, uint8_t slot, uint16_t offset, uint32_t nowMs);
 
-  WebSocketsServer ws_;
+  PtzWsServer ws_;
   PtzOwner* owner_ = nullptr;
   PtzMotion* motion_ = nullptr;
+  PtzRecorder* recorder_ = nullptr;
+  PtzPlanner* planner_ = nullptr;
+  PtzMetrics* metrics_ = nullptr;
+  PtzProfiles* profiles_ = nullptr;
+  PtzDeadline* deadline_ = nullptr;
+  PtzOta* ota_ = nullptr;
+  PtzScheduler* scheduler_ = nullptr;
+  PtzGroup* group_ = nullptr;
+  PtzRateGroups* rates_ = nullptr;
+  const PtzResume* resume_ = nullptr;
+  const PtzSerial* serial_ = nullptr;
+  const PtzUdp* udp_ = nullptr;
+  PtzFreed* freed_ = nullptr;
+  const PtzWeb* web_ = nullptr;
+
+  CommandStats commandStats_[kCommandStatCount] = {};
+  uint8_t command_ = 0; // commandStats_ slot of the message being handled
+  uint32_t oversized_ = 0;
+
+  ClientTx tx_[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+  uint8_t txQueues_[kWebsocketTxQueues][kWebsocketTxQueueBytes]; // [len u16 LE][text] frames
+  bool txQueueUsed_[kWebsocketTxQueues] = {};
+  uint32_t txQueueStarved_ = 0; // replies dropped because every queue was taken
+  uint32_t txTooLarge_ = 0;     // replies larger than an empty queue
+  ClockEstimate clocks_[WEBSOCKETS_SERVER_CLIENT_MAX];
+  SyncExchange sync_[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+  char status_[kStatusFrameBytes];
+  size_t statusSize_ = 0;
+  uint32_t samplesLost_ = 0;    // overwritten in the ring or trimmed from a frame
+  uint32_t samplesTrimmed_ = 0; // trimmed so the frame fits status_
+  uint32_t statusOversized_ = 0; // frames not sent: too large even without samples
+  uint32_t slowDisconnects_ = 0;
 };
 
 } // namespace ptz
@@ -0,0 +1,76 @@
+// Whole-head rig for host tests: pulls in src/main.cpp (excluded from the
+// native build) so a suite drives the real setup()/loop() wiring, and steps
+// virtual time one loop() pass at a time.
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WebSocketsServer.h>
+
+#include <string>
+
+#include "../../src/main.cpp"
+
+namespace rig {
+
+// Virtual time one loop() pass costs by default.
+inline uint32_t passUs = 100;
+
+inline void boot() {
+  static bool booted = false;
+  if (booted) {
+    return;
+  }
+  booted = true;
+  host::setTimeUs(1000000);
+  setup();
+}
+
+inline void pass(uint32_t costUs = passUs) {
+  loop();
+  host::advanceUs(costUs);
+}
+
+inline void runForMs(uint32_t ms, uint32_t costUs = passUs) {
+  const uint64_t endUs = host::nowUs + static_cast<uint64_t>(ms) * 1000;
+  while (host::nowUs < endUs) {
+    pass(costUs);
+  }
+}
+
+inline WebSocketsServer& ws() {
+  return *host::wsServer(ptz::kWebsocketPort);
+}
+
+// Sends an app command; `body` is the JSON members after "v"/"source".
+inline void send(uint8_t client, const std::string& body) {
+  ws().hostSend(client, "{\"v\":1,\"source\":\"app\"," + body + "}");
+}
+
+// Runs passes until a reply of `type` reaches the client, or `ms` of
+// virtual time pass. Returns false on timeout; status frames are skipped.
+inline bool await(uint8_t client, const char* type, JsonDocument& out, uint32_t ms = 100) {
+  const uint64_t endUs = host::nowUs + static_cast<uint64_t>(ms) * 1000;
+  while (host::nowUs < endUs) {
+    pass();
+    ws().hostDrain(client);
+    for (const std::string& text : ws().hostTake(client)) {
+      JsonDocument doc;
+      if (deserializeJson(doc, text)) {
+        continue;
+      }
+      if (strcmp(doc["type"] | "", type) == 0) {
+        out = doc;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+inline bool request(uint8_t client, const std::string& body, const char* type, JsonDocument& out) {
+  send(client, body);
+  return await(client, type, out);
+}
+
+} // namespace rig
@@ -0,0 +1,65 @@
+// One fuzz iteration against the whole head: the input is delivered as a
+// WebSocket text frame from the controlling client, then the head runs a
+// loop pass so replies, motion and persistence act on whatever it parsed.
+// Shared by tools/fuzz/ws_fuzz.cpp (libFuzzer/AFL) and the test_ws_fuzz
+// replay suite.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+
+#include "head_rig.h"
+
+namespace fuzz {
+
+inline int client = -1;
+
+inline void deliver(const std::string& text) {
+  rig::ws().hostDeliver(static_cast<uint8_t>(client), reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+// Connects the fuzzing client, or reconnects it after an input turned it
+// into an observer or dropped it.
+inline void ensureClient() {
+  rig::boot();
+  if (client >= 0 && rig::ws().hostConnected(static_cast<uint8_t>(client)) &&
+      !g_ws.txStats(static_cast<uint8_t>(client)).observer) {
+    return;
+  }
+  if (client >= 0) {
+    rig::ws().hostClose(static_cast<uint8_t>(client));
+    rig::pass();
+  }
+  client = rig::ws().hostConnect("/ws");
+  rig::pass();
+}
+
+// Runs passes, reading like a client that keeps up, until the client's
+// replies are all out.
+inline void settle() {
+  for (int i = 0; i < 200; ++i) {
+    rig::pass();
+    rig::ws().hostDrain(static_cast<uint8_t>(client));
+    if (g_ws.txStats(static_cast<uint8_t>(client)).queued == 0) {
+      return;
+    }
+  }
+}
+
+// Returns the replies the input produced, oldest first.
+inline std::deque<std::string> runOne(const uint8_t* data, size_t size) {
+  ensureClient();
+  // Hold control so the input reaches the control commands, not just the
+  // ownership check.
+  deliver("{\"v\":1,\"source\":\"app\",\"type\":\"requestControl\"}");
+  settle();
+  rig::ws().hostTake(static_cast<uint8_t>(client));
+  rig::ws().hostDeliver(static_cast<uint8_t>(client), data, size);
+  settle();
+  return rig::ws().hostTake(static_cast<uint8_t>(client));
+}
+
+} // namespace fuzz
@@ -0,0 +1,238 @@
+// Host stand-in for AccelStepper 1.64: the same speed and ramp arithmetic,
+// stepping against the virtual micros() clock, with no pin output beyond
+// the enable line.
+#pragma once
+
+#include <Arduino.h>
+
+class AccelStepper {
+ public:
+  enum MotorInterfaceType {
+    FUNCTION = 0,
+    DRIVER = 1,
+    FULL2WIRE = 2,
+    FULL3WIRE = 3,
+    FULL4WIRE = 4,
+    HALF3WIRE = 6,
+    HALF4WIRE = 8,
+  };
+
+  AccelStepper(uint8_t interface = FULL4WIRE,
+               uint8_t pin1 = 2,
+               uint8_t pin2 = 3,
+               uint8_t pin3 = 4,
+               uint8_t pin4 = 5,
+               bool enable = true)
+      : interface_(interface) {
+    (void)pin1;
+    (void)pin2;
+    (void)pin3;
+    (void)pin4;
+    if (enable) {
+      enableOutputs();
+    }
+    setAcceleration(1);
+    setMaxSpeed(1);
+  }
+  virtual ~AccelStepper() {}
+
+  void moveTo(long absolute) {
+    if (targetPos_ != absolute) {
+      targetPos_ = absolute;
+      computeNewSpeed();
+    }
+  }
+  void move(long relative) { moveTo(currentPos_ + relative); }
+
+  bool run() {
+    if (runSpeed()) {
+      computeNewSpeed();
+    }
+    return speed_ != 0.0f || distanceToGo() != 0;
+  }
+
+  bool runSpeed() {
+    if (!stepInterval_) {
+      return false;
+    }
+    const unsigned long time = micros();
+    if (time - lastStepTime_ >= stepInterval_) {
+      currentPos_ += direction_ == kDirectionCw ? 1 : -1;
+      ++steps_;
+      lastStepTime_ = time;
+      return true;
+    }
+    return false;
+  }
+
+  void setMaxSpeed(float speed) {
+    if (speed < 0.0f) {
+      speed = -speed;
+    }
+    if (maxSpeed_ != speed) {
+      maxSpeed_ = speed;
+      cmin_ = 1000000.0f / speed;
+      if (n_ > 0) {
+        n_ = static_cast<long>((speed_ * speed_) / (2.0f * acceleration_));
+        computeNewSpeed();
+      }
+    }
+  }
+  float maxSpeed() { return maxSpeed_; }
+
+  void setAcceleration(float acceleration) {
+    if (acceleration == 0.0f) {
+      return;
+    }
+    if (acceleration < 0.0f) {
+      acceleration = -acceleration;
+    }
+    if (acceleration_ != acceleration) {
+      n_ = static_cast<long>(n_ * (acceleration_ / acceleration));
+      c0_ = 0.676f * sqrtf(2.0f / acceleration) * 1000000.0f;
+      acceleration_ = acceleration;
+      computeNewSpeed();
+    }
+  }
+  float acceleration() { return acceleration_; }
+
+  void setSpeed(float speed) {
+    if (speed == speed_) {
+      return;
+    }
+    speed = constrain(speed, -maxSpeed_, maxSpeed_);
+    if (speed == 0.0f) {
+      stepInterval_ = 0;
+    } else {
+      stepInterval_ = static_cast<unsigned long>(fabsf(1000000.0f / speed));
+      direction_ = speed > 0.0f ? kDirectionCw : kDirectionCcw;
+    }
+    speed_ = speed;
+  }
+  float speed() { return speed_; }
+
+  long distanceToGo() { return targetPos_ - currentPos_; }
+  long targetPosition() { return targetPos_; }
+  long currentPosition() { return currentPos_; }
+
+  void setCurrentPosition(long position) {
+    targetPos_ = currentPos_ = position;
+    n_ = 0;
+    stepInterval_ = 0;
+    speed_ = 0.0f;
+  }
+
+  void runToPosition() {
+    while (run()) {
+      host::advanceUs(stepInterval_ ? stepInterval_ : 1);
+    }
+  }
+
+  void stop() {
+    if (speed_ != 0.0f) {
+      const long stepsToStop = static_cast<long>((speed_ * speed_) / (2.0f * acceleration_)) + 1;
+      move(speed_ > 0 ? stepsToStop : -stepsToStop);
+    }
+  }
+
+  virtual void disableOutputs() {
+    outputsEnabled_ = false;
+    if (enablePin_ != 0xFF) {
+      digitalWrite(enablePin_, LOW ^ enableInverted_);
+    }
+  }
+  virtual void enableOutputs() {
+    outputsEnabled_ = true;
+    if (enablePin_ != 0xFF) {
+      digitalWrite(enablePin_, HIGH ^ enableInverted_);
+    }
+  }
+
+  void setMinPulseWidth(unsigned int) {}
+  void setEnablePin(uint8_t enablePin = 0xFF) {
+    enablePin_ = enablePin;
+    if (enablePin_ != 0xFF) {
+      pinMode(enablePin_, OUTPUT);
+      digitalWrite(enablePin_, HIGH ^ enableInverted_);
+    }
+  }
+  void setPinsInverted(bool directionInvert = false, bool stepInvert = false, bool enableInvert = false) {
+    (void)directionInvert;
+    (void)stepInvert;
+    enableInverted_ = enableInvert;
+  }
+  bool isRunning() { return !(speed_ == 0.0f && targetPos_ == currentPos_); }
+
+  // Host-only observers.
+  bool hostOutputsEnabled() const { return outputsEnabled_; }
+  unsigned long hostSteps() const { return steps_; }
+
+ protected:
+  unsigned long computeNewSpeed() {
+    const long distanceTo = distanceToGo();
+    const long stepsToStop = static_cast<long>((speed_ * speed_) / (2.0f * acceleration_));
+    if (distanceTo == 0 && stepsToStop <= 1) {
+      stepInterval_ = 0;
+      speed_ = 0.0f;
+      n_ = 0;
+      return stepInterval_;
+    }
+    if (distanceTo > 0) {
+      if (n_ > 0) {
+        if (stepsToStop >= distanceTo || direction_ == kDirectionCcw) {
+          n_ = -stepsToStop;
+        }
+      } else if (n_ < 0) {
+        if (stepsToStop < distanceTo && direction_ == kDirectionCw) {
+          n_ = -n_;
+        }
+      }
+    } else if (distanceTo < 0) {
+      if (n_ > 0) {
+        if (stepsToStop >= -distanceTo || direction_ == kDirectionCw) {
+          n_ = -stepsToStop;
+        }
+      } else if (n_ < 0) {
+        if (stepsToStop < -distanceTo && direction_ == kDirectionCcw) {
+          n_ = -n_;
+        }
+      }
+    }
+    if (n_ == 0) {
+      cn_ = c0_;
+      direction_ = distanceTo > 0 ? kDirectionCw : kDirectionCcw;
+    } else {
+      cn_ = cn_ - ((2.0f * cn_) / ((4.0f * n_) + 1));
+      cn_ = cn_ > cmin_ ? cn_ : cmin_;
+    }
+    ++n_;
+    stepInterval_ = static_cast<unsigned long>(cn_);
+    speed_ = 1000000.0f / cn_;
+    if (direction_ == kDirectionCcw) {
+      speed_ = -speed_;
+    }
+    return stepInterval_;
+  }
+
+ private:
+  static constexpr bool kDirectionCcw = false;
+  static constexpr bool kDirectionCw = true;
+
+  uint8_t interface_;
+  long currentPos_ = 0;
+  long targetPos_ = 0;
+  float speed_ = 0.0f;
+  float maxSpeed_ = 0.0f;
+  float acceleration_ = 0.0f;
+  unsigned long stepInterval_ = 0;
+  unsigned long lastStepTime_ = 0;
+  long n_ = 0;
+  float c0_ = 0.0f;
+  float cn_ = 0.0f;
+  float cmin_ = 1.0f;
+  bool direction_ = kDirectionCcw;
+  uint8_t enablePin_ = 0xFF;
+  bool enableInverted_ = false;
+  bool outputsEnabled_ = false;
+  unsigned long steps_ = 0;
+};
@@ -0,0 +1,373 @@
+// Host stand-in for the Arduino core, used by the native test environment.
+//
+// Time is virtual: millis(), micros() and esp_timer_get_time() read
+// host::nowUs, which only moves when a test (or delay()) advances it, so a
+// test decides exactly how much time every loop pass and callback costs.
+// Serial buffers in memory and can be attached to a pseudo terminal.
+#pragma once
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+
+#define PROGMEM
+#define PGM_P const char*
+#define IRAM_ATTR
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define HIGH 0x1
+#define LOW 0x0
+
+typedef uint8_t byte;
+
+using std::max;
+using std::min;
+
+namespace host {
+
+inline std::atomic<uint64_t> nowUs{0};
+
+inline void advanceUs(uint64_t us) {
+  nowUs.fetch_add(us);
+}
+
+inline void setTimeUs(uint64_t us) {
+  nowUs.store(us);
+}
+
+// Device whose NVS partition and network address the next Preferences or
+// WiFiUDP object binds to; multi-head tests switch it between heads.
+inline int device = 0;
+
+inline uint8_t pinLevel[64] = {};
+inline uint8_t pinModes[64] = {};
+inline uint32_t analogMv[64] = {};
+
+} // namespace host
+
+inline uint32_t millis() {
+  return static_cast<uint32_t>(host::nowUs.load() / 1000);
+}
+
+inline uint32_t micros() {
+  return static_cast<uint32_t>(host::nowUs.load());
+}
+
+inline void delay(uint32_t ms) {
+  host::advanceUs(static_cast<uint64_t>(ms) * 1000);
+}
+
+inline void delayMicroseconds(uint32_t us) {
+  host::advanceUs(us);
+}
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+  host::pinModes[pin & 63] = mode;
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value) {
+  host::pinLevel[pin & 63] = value;
+}
+
+inline uint32_t analogReadMilliVolts(uint8_t pin) {
+  return host::analogMv[pin & 63];
+}
+
+template <typename T>
+inline T constrain(T value, T low, T high) {
+  return value < low ? low : (value > high ? high : value);
+}
+
+class String {
+ public:
+  String() {}
+  String(const char* text) : s_(text ? text : "") {}
+  String(const std::string& text) : s_(text) {}
+  explicit String(int value) : s_(std::to_string(value)) {}
+
+  const char* c_str() const { return s_.c_str(); }
+  size_t length() const { return s_.size(); }
+  void trim() {
+    const size_t start = s_.find_first_not_of(" \t\r\n");
+    const size_t end = s_.find_last_not_of(" \t\r\n");
+    s_ = start == std::string::npos ? std::string() : s_.substr(start, end - start + 1);
+  }
+  bool equalsIgnoreCase(const String& other) const { return strcasecmp(s_.c_str(), other.c_str()) == 0; }
+  String& operator+=(char c) {
+    s_ += c;
+    return *this;
+  }
+  String& operator+=(const String& other) {
+    s_ += other.s_;
+    return *this;
+  }
+  String operator+(const String& other) const { return String(s_ + other.s_); }
+  bool operator==(const String& other) const { return s_ == other.s_; }
+  bool operator==(const char* other) const { return s_ == (other ? other : ""); }
+  bool operator!=(const String& other) const { return s_ != other.s_; }
+
+ private:
+  std::string s_;
+};
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t byte) = 0;
+  virtual size_t write(const uint8_t* data, size_t size) {
+    size_t n = 0;
+    while (n < size && write(data[n])) {
+      ++n;
+    }
+    return n;
+  }
+  size_t write(const char* text) { return write(reinterpret_cast<const uint8_t*>(text), strlen(text)); }
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char buffer[512];
+    va_list args;
+    va_start(args, fmt);
+    const int len = vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+    if (len <= 0) {
+      return 0;
+    }
+    return write(reinterpret_cast<const uint8_t*>(buffer), std::min(static_cast<size_t>(len), sizeof(buffer) - 1));
+  }
+  size_t print(const char* text) { return write(text); }
+  size_t println(const char* text) { return write(text) + write("\r\n"); }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() { return -1; }
+  virtual size_t readBytes(uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (n < size) {
+      const int c = read();
+      if (c < 0) {
+        break;
+      }
+      buffer[n++] = static_cast<uint8_t>(c);
+    }
+    return n;
+  }
+  void setTimeout(uint32_t ms) { timeoutMs_ = ms; }
+
+ protected:
+  uint32_t timeoutMs_ = 1000;
+};
+
+// Console UART. Without a terminal attached, received bytes come from
+// hostInject() and transmitted bytes collect in an in-memory buffer (capped,
+// oldest half dropped) that hostTakeOutput() drains. attachPty() opens a
+// pseudo terminal instead, so a test can talk to the firmware through a real
+// tty the same way a host tool does.
+class HardwareSerial : public Stream {
+ public:
+  ~HardwareSerial() override { detachPty(); }
+
+  void begin(uint32_t baud) { baud_ = baud; }
+  void end() {}
+  void flush() {}
+  void setTxBufferSize(size_t size) { txCapacity_ = static_cast<int>(size); }
+  void setRxBufferSize(size_t) {}
+
+  int available() override {
+    pollPty();
+    return static_cast<int>(rx_.size());
+  }
+  int read() override {
+    pollPty();
+    if (rx_.empty()) {
+      return -1;
+    }
+    const uint8_t c = rx_.front();
+    rx_.pop_front();
+    return c;
+  }
+  int peek() override {
+    pollPty();
+    return rx_.empty() ? -1 : rx_.front();
+  }
+
+  size_t write(uint8_t byte) override { return write(&byte, 1); }
+  size_t write(const uint8_t* data, size_t size) override {
+    if (ptyMaster_ >= 0) {
+      size_t sent = 0;
+      while (sent < size) {
+        const ssize_t n = ::write(ptySlave_, data + sent, size - sent);
+        if (n <= 0) {
+          break;
+        }
+        sent += static_cast<size_t>(n);
+      }
+      return sent;
+    }
+    if (echo_) {
+      fwrite(data, 1, size, stderr);
+    }
+    if (tx_.size() + size > kOutputCap) {
+      tx_.erase(tx_.begin(), tx_.begin() + tx_.size() / 2);
+    }
+    tx_.insert(tx_.end(), data, data + size);
+    return size;
+  }
+  using Print::write;
+
+  // Free space in the UART TX FIFO/buffer; settable to model a busy port.
+  int availableForWrite() { return txCapacity_; }
+
+  void hostInject(const uint8_t* data, size_t size) { rx_.insert(rx_.end(), data, data + size); }
+  void hostInject(const char* text) { hostInject(reinterpret_cast<const uint8_t*>(text), strlen(text)); }
+  std::vector<uint8_t> hostTakeOutput() {
+    std::vector<uint8_t> out;
+    out.swap(tx_);
+    return out;
+  }
+  void hostSetEcho(bool echo) { echo_ = echo; }
+  void hostSetTxSpace(int bytes) { txCapacity_ = bytes; }
+
+  // Returns the master side of a new raw-mode pseudo terminal; the firmware
+  // reads and writes the slave side. -1 on failure.
+  int attachPty() {
+    detachPty();
+    const int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+      if (master >= 0) {
+        close(master);
+      }
+      return -1;
+    }
+    const int slave = open(ptsname(master), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (slave < 0) {
+      close(master);
+      return -1;
+    }
+    termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+    ptyMaster_ = master;
+    ptySlave_ = slave;
+    return master;
+  }
+  void detachPty() {
+    if (ptySlave_ >= 0) {
+      close(ptySlave_);
+    }
+    if (ptyMaster_ >= 0) {
+      close(ptyMaster_);
+    }
+    ptyMaster_ = ptySlave_ = -1;
+  }
+
+ private:
+  static constexpr size_t kOutputCap = 64 * 1024;
+
+  void pollPty() {
+    if (ptySlave_ < 0) {
+      return;
+    }
+    uint8_t buffer[256];
+    for (;;) {
+      const ssize_t n = ::read(ptySlave_, buffer, sizeof(buffer));
+      if (n <= 0) {
+        return;
+      }
+      rx_.insert(rx_.end(), buffer, buffer + n);
+    }
+  }
+
+  uint32_t baud_ = 0;
+  int txCapacity_ = 128;
+  bool echo_ = getenv("PTZ_HOST_ECHO_SERIAL") != nullptr;
+  std::deque<uint8_t> rx_;
+  std::vector<uint8_t> tx_;
+  int ptyMaster_ = -1;
+  int ptySlave_ = -1;
+};
+
+inline HardwareSerial Serial;
+
+class IPAddress {
+ public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes_{a, b, c, d} {}
+  IPAddress(uint32_t address) { memcpy(bytes_, &address, sizeof(bytes_)); }
+
+  // First octet in the lowest byte, as on the ESP32.
+  operator uint32_t() const {
+    uint32_t address;
+    memcpy(&address, bytes_, sizeof(address));
+    return address;
+  }
+  uint8_t operator[](int index) const { return bytes_[index & 3]; }
+  uint8_t& operator[](int index) { return bytes_[index & 3]; }
+  bool operator==(const IPAddress& other) const { return memcmp(bytes_, other.bytes_, sizeof(bytes_)) == 0; }
+  bool operator!=(const IPAddress& other) const { return !(*this == other); }
+
+  bool fromString(const char* text) {
+    unsigned a, b, c, d;
+    char extra;
+    if (!text || sscanf(text, "%u.%u.%u.%u%c", &a, &b, &c, &d, &extra) != 4 || a > 255 || b > 255 || c > 255 ||
+        d > 255) {
+      return false;
+    }
+    bytes_[0] = static_cast<uint8_t>(a);
+    bytes_[1] = static_cast<uint8_t>(b);
+    bytes_[2] = static_cast<uint8_t>(c);
+    bytes_[3] = static_cast<uint8_t>(d);
+    return true;
+  }
+  String toString() const {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", bytes_[0], bytes_[1], bytes_[2], bytes_[3]);
+    return String(text);
+  }
+
+ private:
+  uint8_t bytes_[4] = {};
+};
+
+namespace host {
+
+inline std::atomic<uint32_t> freeHeap{200 * 1024};
+inline std::atomic<uint32_t> minFreeHeap{180 * 1024};
+inline std::atomic<uint32_t> largestBlock{100 * 1024};
+inline std::atomic<uint32_t> restarts{0};
+
+} // namespace host
+
+class EspClass {
+ public:
+  uint32_t getFreeHeap() { return host::freeHeap; }
+  uint32_t getMinFreeHeap() { return host::minFreeHeap; }
+  uint32_t getMaxAllocHeap() { return host::largestBlock; }
+  uint32_t getHeapSize() { return 320 * 1024; }
+  uint32_t getSketchSize() { return 1024 * 1024; }
+  uint32_t getFreeSketchSpace() { return 1536 * 1024; }
+  // Counted instead of performed so a test can observe it.
+  void restart() { ++host::restarts; }
+};
+
+inline EspClass ESP;
@@ -0,0 +1,81 @@
+// Host stand-in for Bluepad32: a test connects a Gamepad, sets its sticks
+// and buttons, and marks new data for the next BP32.update().
+#pragma once
+
+#include <Arduino.h>
+
+#define BP32_MAX_GAMEPADS 4
+
+enum {
+  DPAD_UP = 1 << 0,
+  DPAD_DOWN = 1 << 1,
+  DPAD_RIGHT = 1 << 2,
+  DPAD_LEFT = 1 << 3,
+};
+
+class Gamepad {
+ public:
+  bool isConnected() const { return connected; }
+  int32_t axisX() const { return lx; }
+  int32_t axisY() const { return ly; }
+  int32_t axisRX() const { return rx; }
+  int32_t axisRY() const { return ry; }
+  uint8_t dpad() const { return dpadBits; }
+  bool a() const { return buttonA; }
+  bool b() const { return buttonB; }
+  bool x() const { return buttonX; }
+  bool y() const { return buttonY; }
+  bool l1() const { return buttonL1; }
+  bool r1() const { return buttonR1; }
+  void setRumble(uint8_t force, uint8_t duration) {
+    rumbleForce = force;
+    rumbleDuration = duration;
+  }
+
+  bool connected = false;
+  int32_t lx = 0, ly = 0, rx = 0, ry = 0;
+  uint8_t dpadBits = 0;
+  bool buttonA = false, buttonB = false, buttonX = false, buttonY = false, buttonL1 = false, buttonR1 = false;
+  uint8_t rumbleForce = 0;
+  uint8_t rumbleDuration = 0;
+};
+
+typedef Gamepad* GamepadPtr;
+typedef void (*GamepadCallback)(GamepadPtr gp);
+
+class Bluepad32 {
+ public:
+  void setup(GamepadCallback onConnect, GamepadCallback onDisconnect) {
+    onConnect_ = onConnect;
+    onDisconnect_ = onDisconnect;
+  }
+  bool update() {
+    const bool fresh = fresh_;
+    fresh_ = false;
+    return fresh;
+  }
+  void forgetBluetoothKeys() {}
+  void enableVirtualDevice(bool) {}
+
+  // Host side.
+  void hostConnect(Gamepad* gp) {
+    gp->connected = true;
+    if (onConnect_) {
+      onConnect_(gp);
+    }
+  }
+  void hostDisconnect(Gamepad* gp) {
+    gp->connected = false;
+    if (onDisconnect_) {
+      onDisconnect_(gp);
+    }
+  }
+  void hostMarkUpdated() { fresh_ = true; }
+
+ private:
+  GamepadCallback onConnect_ = nullptr;
+  GamepadCallback onDisconnect_ = nullptr;
+  bool fresh_ = false;
+};
+
+inline Bluepad32 BP32;
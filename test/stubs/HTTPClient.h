@@ -0,0 +1,119 @@
+// Host stand-in for the ESP32 HTTPClient: GET requests are answered from a
+// table a test fills with host::httpServe(), so OTA downloads run against a
+// local stand-in server that can truncate, stall or refuse.
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_NOT_FOUND 404
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+
+namespace host {
+
+struct HttpResponse {
+  int code = HTTP_CODE_OK;
+  std::vector<uint8_t> body;
+  size_t chunkBytes = 1024;            // most bytes one available() reports
+  size_t closeAfter = SIZE_MAX;        // connection drops after this many bytes
+  bool unknownLength = false;          // no Content-Length header
+};
+
+// Bytes of the body the server has sent so far; a test lowers it to hold a
+// download mid-stream and raises it to let the rest through.
+inline std::atomic<size_t> httpSentBytes{SIZE_MAX};
+
+inline std::mutex& httpLock() {
+  // Never destroyed: globals that outlive it use it from their destructors.
+  static std::mutex* lock = new std::mutex;
+  return *lock;
+}
+
+inline std::map<std::string, HttpResponse>& httpRoutes() {
+  static std::map<std::string, HttpResponse>* routes = new std::map<std::string, HttpResponse>;
+  return *routes;
+}
+
+inline void httpServe(const std::string& url, const HttpResponse& response) {
+  std::lock_guard<std::mutex> guard(httpLock());
+  httpRoutes()[url] = response;
+}
+
+inline void httpReset() {
+  std::lock_guard<std::mutex> guard(httpLock());
+  httpRoutes().clear();
+}
+
+class HttpBodyStream : public WiFiClient {
+ public:
+  void reset(const HttpResponse& response) {
+    response_ = response;
+    pos_ = 0;
+  }
+  uint8_t connected() override { return pos_ < limit(); }
+  int available() override {
+    const size_t sent = std::min(limit(), host::httpSentBytes.load());
+    const size_t left = sent > pos_ ? sent - pos_ : 0;
+    return static_cast<int>(left < response_.chunkBytes ? left : response_.chunkBytes);
+  }
+  int read() override {
+    if (pos_ >= limit()) {
+      return -1;
+    }
+    return response_.body[pos_++];
+  }
+  size_t readBytes(uint8_t* buffer, size_t size) override {
+    const size_t left = limit() - pos_;
+    const size_t n = size < left ? size : left;
+    memcpy(buffer, response_.body.data() + pos_, n);
+    pos_ += n;
+    return n;
+  }
+
+ private:
+  size_t limit() const {
+    return response_.closeAfter < response_.body.size() ? response_.closeAfter : response_.body.size();
+  }
+
+  HttpResponse response_;
+  size_t pos_ = 0;
+};
+
+} // namespace host
+
+class HTTPClient {
+ public:
+  void setTimeout(uint16_t ms) { timeoutMs_ = ms; }
+  bool begin(const String& url) {
+    url_ = url.c_str();
+    return url_.compare(0, 7, "http://") == 0 || url_.compare(0, 8, "https://") == 0;
+  }
+  int GET() {
+    std::lock_guard<std::mutex> guard(host::httpLock());
+    auto it = host::httpRoutes().find(url_);
+    if (it == host::httpRoutes().end()) {
+      return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    response_ = it->second;
+    stream_.reset(response_);
+    return response_.code;
+  }
+  int getSize() { return response_.unknownLength ? -1 : static_cast<int>(response_.body.size()); }
+  WiFiClient* getStreamPtr() { return &stream_; }
+  WiFiClient& getStream() { return stream_; }
+  bool connected() { return stream_.connected(); }
+  void end() { stream_.reset(host::HttpResponse()); }
+
+ private:
+  std::string url_;
+  uint16_t timeoutMs_ = 5000;
+  host::HttpResponse response_;
+  host::HttpBodyStream stream_;
+};
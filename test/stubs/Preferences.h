@@ -0,0 +1,133 @@
+// Host stand-in for the ESP32 Preferences (NVS) library. Storage is one
+// process-wide map, split per host::device so several simulated heads keep
+// separate flash, and it survives object destruction the way NVS survives a
+// reboot.
+#pragma once
+
+#include <Arduino.h>
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace host {
+
+typedef std::tuple<int, std::string, std::string> NvsKey;
+
+inline std::map<NvsKey, std::vector<uint8_t>>& nvs() {
+  // Never destroyed: globals that outlive it use it from their destructors.
+  static std::map<NvsKey, std::vector<uint8_t>>* store = new std::map<NvsKey, std::vector<uint8_t>>;
+  return *store;
+}
+
+inline uint32_t nvsWrites = 0;
+
+// Wipes every device's storage (a fresh flash).
+inline void nvsErase() {
+  nvs().clear();
+  nvsWrites = 0;
+}
+
+} // namespace host
+
+class Preferences {
+ public:
+  Preferences() : device_(host::device) {}
+
+  bool begin(const char* name, bool readOnly = false, const char* partition = nullptr) {
+    (void)partition;
+    namespace_ = name ? name : "";
+    readOnly_ = readOnly;
+    open_ = true;
+    return true;
+  }
+  void end() { open_ = false; }
+
+  bool clear() {
+    if (!writable()) {
+      return false;
+    }
+    auto& store = host::nvs();
+    for (auto it = store.begin(); it != store.end();) {
+      if (std::get<0>(it->first) == device_ && std::get<1>(it->first) == namespace_) {
+        it = store.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    ++host::nvsWrites;
+    return true;
+  }
+  bool remove(const char* key) {
+    if (!writable()) {
+      return false;
+    }
+    ++host::nvsWrites;
+    return host::nvs().erase(keyFor(key)) > 0;
+  }
+  bool isKey(const char* key) { return open_ && host::nvs().count(keyFor(key)) > 0; }
+
+  size_t putBytes(const char* key, const void* value, size_t len) {
+    if (!writable() || !value) {
+      return 0;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    host::nvs()[keyFor(key)].assign(bytes, bytes + len);
+    ++host::nvsWrites;
+    return len;
+  }
+  size_t getBytesLength(const char* key) {
+    const std::vector<uint8_t>* stored = find(key);
+    return stored ? stored->size() : 0;
+  }
+  size_t getBytes(const char* key, void* buf, size_t maxLen) {
+    const std::vector<uint8_t>* stored = find(key);
+    if (!stored || !buf || stored->size() > maxLen) {
+      return 0;
+    }
+    memcpy(buf, stored->data(), stored->size());
+    return stored->size();
+  }
+
+  size_t putUChar(const char* key, uint8_t value) { return putBytes(key, &value, sizeof(value)); }
+  uint8_t getUChar(const char* key, uint8_t defaultValue = 0) { return get(key, defaultValue); }
+  size_t putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+  size_t putBool(const char* key, bool value) { return putUChar(key, value ? 1 : 0); }
+  bool getBool(const char* key, bool defaultValue = false) { return getUChar(key, defaultValue ? 1 : 0) != 0; }
+  size_t putString(const char* key, const char* value) { return putBytes(key, value, strlen(value) + 1); }
+  String getString(const char* key, const String& defaultValue = String()) {
+    const std::vector<uint8_t>* stored = find(key);
+    if (!stored || stored->empty()) {
+      return defaultValue;
+    }
+    return String(reinterpret_cast<const char*>(stored->data()));
+  }
+
+ private:
+  host::NvsKey keyFor(const char* key) const { return host::NvsKey(device_, namespace_, key ? key : ""); }
+  bool writable() const { return open_ && !readOnly_; }
+  const std::vector<uint8_t>* find(const char* key) const {
+    if (!open_) {
+      return nullptr;
+    }
+    auto it = host::nvs().find(keyFor(key));
+    return it == host::nvs().end() ? nullptr : &it->second;
+  }
+  template <typename T>
+  T get(const char* key, T defaultValue) {
+    const std::vector<uint8_t>* stored = find(key);
+    if (!stored || stored->size() != sizeof(T)) {
+      return defaultValue;
+    }
+    T value;
+    memcpy(&value, stored->data(), sizeof(T));
+    return value;
+  }
+
+  int device_;
+  std::string namespace_;
+  bool readOnly_ = false;
+  bool open_ = false;
+};
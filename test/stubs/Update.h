@@ -0,0 +1,84 @@
+// Host stand-in for the ESP32 Update library: the image goes to memory and
+// the outcome of the last update stays readable by the test.
+#pragma once
+
+#include <Arduino.h>
+
+#include <mutex>
+#include <vector>
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+
+namespace host {
+
+struct UpdateState {
+  std::vector<uint8_t> image;
+  size_t expected = 0;
+  bool running = false;
+  bool finished = false;  // end() accepted an image
+  bool aborted = false;
+  size_t space = 1536 * 1024;  // free OTA partition bytes
+};
+
+inline std::mutex& updateLock() {
+  // Never destroyed: globals that outlive it use it from their destructors.
+  static std::mutex* lock = new std::mutex;
+  return *lock;
+}
+
+inline UpdateState& updateState() {
+  static UpdateState state;
+  return state;
+}
+
+} // namespace host
+
+class UpdateClass {
+ public:
+  bool begin(size_t size = UPDATE_SIZE_UNKNOWN) {
+    std::lock_guard<std::mutex> guard(host::updateLock());
+    host::UpdateState& state = host::updateState();
+    if (size != UPDATE_SIZE_UNKNOWN && size > state.space) {
+      return false;
+    }
+    state.image.clear();
+    state.expected = size;
+    state.running = true;
+    state.finished = false;
+    state.aborted = false;
+    return true;
+  }
+  size_t write(uint8_t* data, size_t len) {
+    std::lock_guard<std::mutex> guard(host::updateLock());
+    host::UpdateState& state = host::updateState();
+    if (!state.running || state.image.size() + len > state.space) {
+      return 0;
+    }
+    state.image.insert(state.image.end(), data, data + len);
+    return len;
+  }
+  bool end(bool evenIfRemaining = false) {
+    std::lock_guard<std::mutex> guard(host::updateLock());
+    host::UpdateState& state = host::updateState();
+    if (!state.running) {
+      return false;
+    }
+    if (!evenIfRemaining && state.expected != UPDATE_SIZE_UNKNOWN && state.image.size() != state.expected) {
+      return false;
+    }
+    state.running = false;
+    state.finished = !state.image.empty();
+    return state.finished;
+  }
+  void abort() {
+    std::lock_guard<std::mutex> guard(host::updateLock());
+    host::updateState().running = false;
+    host::updateState().aborted = true;
+  }
+  bool isRunning() {
+    std::lock_guard<std::mutex> guard(host::updateLock());
+    return host::updateState().running;
+  }
+};
+
+inline UpdateClass Update;
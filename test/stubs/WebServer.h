@@ -0,0 +1,148 @@
+// Host stand-in for the ESP32 WebServer. Requests are queued by the test
+// with hostRequest() and served one per handleClient() call on whatever
+// thread polls the server; responses are kept for hostTakeResponses().
+#pragma once
+
+#include <Arduino.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class WebServer;
+
+namespace host {
+
+struct HttpRequest {
+  std::string uri;
+  std::map<std::string, std::string> headers;
+};
+
+struct ServedResponse {
+  int code = 0;
+  std::string contentType;
+  std::map<std::string, std::string> headers;
+  size_t bodyBytes = 0;
+};
+
+inline std::mutex& webLock() {
+  // Never destroyed: globals that outlive it use it from their destructors.
+  static std::mutex* lock = new std::mutex;
+  return *lock;
+}
+
+inline std::map<uint16_t, WebServer*>& webServers() {
+  static std::map<uint16_t, WebServer*>* servers = new std::map<uint16_t, WebServer*>;
+  return *servers;
+}
+
+inline WebServer* webServer(uint16_t port) {
+  std::lock_guard<std::mutex> guard(webLock());
+  auto it = webServers().find(port);
+  return it == webServers().end() ? nullptr : it->second;
+}
+
+} // namespace host
+
+class WebServer {
+ public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit WebServer(int port = 80) : port_(static_cast<uint16_t>(port)) {}
+  ~WebServer() {
+    std::lock_guard<std::mutex> guard(host::webLock());
+    auto it = host::webServers().find(port_);
+    if (it != host::webServers().end() && it->second == this) {
+      host::webServers().erase(it);
+    }
+  }
+
+  void begin() {
+    std::lock_guard<std::mutex> guard(host::webLock());
+    host::webServers()[port_] = this;
+  }
+  void collectHeaders(const char* headerKeys[], size_t count) { collected_.assign(headerKeys, headerKeys + count); }
+  void onNotFound(THandlerFunction fn) { notFound_ = fn; }
+  void on(const String& uri, THandlerFunction fn) { routes_[uri.c_str()] = fn; }
+
+  void handleClient() {
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      if (requests_.empty()) {
+        return;
+      }
+      current_ = requests_.front();
+      requests_.pop_front();
+    }
+    uri_ = String(current_.uri);
+    response_ = host::ServedResponse();
+    auto route = routes_.find(current_.uri);
+    if (route != routes_.end()) {
+      route->second();
+    } else if (notFound_) {
+      notFound_();
+    } else {
+      send(404);
+    }
+    std::lock_guard<std::mutex> guard(lock_);
+    responses_.push_back(response_);
+    served_.notify_all();
+  }
+
+  const String& uri() const { return uri_; }
+  String header(const char* name) {
+    for (const std::string& key : collected_) {
+      if (strcasecmp(key.c_str(), name) == 0) {
+        auto it = current_.headers.find(key);
+        return it == current_.headers.end() ? String() : String(it->second);
+      }
+    }
+    return String();
+  }
+  void sendHeader(const String& name, const String& value, bool = false) {
+    response_.headers[name.c_str()] = value.c_str();
+  }
+  void send(int code, const char* contentType = nullptr, const String& content = String()) {
+    response_.code = code;
+    response_.contentType = contentType ? contentType : "";
+    response_.bodyBytes = content.length();
+  }
+  void send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength) {
+    (void)content;
+    response_.code = code;
+    response_.contentType = contentType ? contentType : "";
+    response_.bodyBytes = contentLength;
+  }
+
+  // Host side; safe to call from the test thread.
+  void hostRequest(const std::string& uri, const std::map<std::string, std::string>& headers = {}) {
+    std::lock_guard<std::mutex> guard(lock_);
+    requests_.push_back(host::HttpRequest{uri, headers});
+  }
+  // Waits (in real time) until `count` responses are available or the
+  // timeout passes, then takes them all.
+  std::vector<host::ServedResponse> hostTakeResponses(size_t count, uint32_t timeoutMs = 2000) {
+    std::unique_lock<std::mutex> guard(lock_);
+    served_.wait_for(guard, std::chrono::milliseconds(timeoutMs), [&]() { return responses_.size() >= count; });
+    std::vector<host::ServedResponse> out(responses_.begin(), responses_.end());
+    responses_.clear();
+    return out;
+  }
+
+ private:
+  uint16_t port_;
+  std::vector<std::string> collected_;
+  THandlerFunction notFound_;
+  std::map<std::string, THandlerFunction> routes_;
+  std::mutex lock_;
+  std::condition_variable served_;
+  std::deque<host::HttpRequest> requests_;
+  std::deque<host::ServedResponse> responses_;
+  host::HttpRequest current_;
+  String uri_;
+  host::ServedResponse response_;
+};
@@ -0,0 +1,328 @@
+// Host stand-in for links2004 WebSocketsServer. Each client is a Unix
+// socketpair with a small send buffer: the firmware writes frames to its end
+// without blocking, and a test decides whether the peer reads them (a slow
+// client simply never calls hostDrain). Events queue up and fire from loop()
+// like the real library; texts sent to a client are also kept for the test.
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <sys/socket.h>
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+#ifndef WEBSOCKETS_SERVER_CLIENT_MAX
+#define WEBSOCKETS_SERVER_CLIENT_MAX 8
+#endif
+
+typedef enum {
+  WStype_ERROR,
+  WStype_DISCONNECTED,
+  WStype_CONNECTED,
+  WStype_TEXT,
+  WStype_BIN,
+  WStype_FRAGMENT_TEXT_START,
+  WStype_FRAGMENT_BIN_START,
+  WStype_FRAGMENT,
+  WStype_FRAGMENT_FIN,
+  WStype_PING,
+  WStype_PONG,
+} WStype_t;
+
+typedef enum {
+  WSC_NOT_CONNECTED,
+  WSC_HEADER,
+  WSC_BODY,
+  WSC_CONNECTED,
+} WSclientsStatus_t;
+
+class WebSocketsServer;
+
+namespace host {
+
+// Virtual time charged per sendTXT, to model the cost of a socket write.
+inline uint32_t wsSendCostUs = 0;
+// Virtual time charged per text frame the server's loop() hands over.
+inline uint32_t wsReceiveCostUs = 0;
+// Texts kept per client for hostTake(); older ones are discarded.
+inline size_t wsKeepTexts = 256;
+
+inline std::map<uint16_t, WebSocketsServer*>& wsServers() {
+  // Never destroyed: globals that outlive it use it from their destructors.
+  static std::map<uint16_t, WebSocketsServer*>* servers = new std::map<uint16_t, WebSocketsServer*>;
+  return *servers;
+}
+
+// The server that last called begin() on the port.
+inline WebSocketsServer* wsServer(uint16_t port) {
+  auto it = wsServers().find(port);
+  return it == wsServers().end() ? nullptr : it->second;
+}
+
+// Firmware end of one client's socketpair.
+class WsSocket : public WiFiClient {
+ public:
+  WsSocket(int fd, int peer) : fd_(fd), peer_(peer) {}
+  ~WsSocket() override { stop(); }
+
+  uint8_t connected() override { return fd_ >= 0; }
+  void stop() override {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+    if (peer_ >= 0) {
+      close(peer_);
+    }
+    fd_ = peer_ = -1;
+  }
+  int fd() const override { return fd_; }
+  int peer() const { return peer_; }
+
+ private:
+  int fd_;
+  int peer_;
+};
+
+} // namespace host
+
+typedef struct {
+  uint8_t num;
+  WSclientsStatus_t status;
+  WiFiClient* tcp;
+} WSclient_t;
+
+class WebSocketsServer {
+ public:
+  typedef std::function<void(uint8_t num, WStype_t type, uint8_t* payload, size_t length)> WebSocketServerEvent;
+
+  WebSocketsServer(uint16_t port, const String& origin = "", const String& protocol = "arduino") : port_(port) {
+    (void)origin;
+    (void)protocol;
+    for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; ++i) {
+      _clients[i].num = i;
+      _clients[i].status = WSC_NOT_CONNECTED;
+      _clients[i].tcp = nullptr;
+    }
+  }
+  virtual ~WebSocketsServer() {
+    for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; ++i) {
+      delete _clients[i].tcp;
+      _clients[i].tcp = nullptr;
+    }
+    if (host::wsServer(port_) == this) {
+      host::wsServers().erase(port_);
+    }
+  }
+
+  void begin() { host::wsServers()[port_] = this; }
+  void close() {}
+  void onEvent(WebSocketServerEvent cbEvent) { cbEvent_ = cbEvent; }
+
+  void loop() {
+    // Only the events queued before this pass run, like one poll of the
+    // real server.
+    size_t pending = events_.size();
+    while (pending-- > 0 && !events_.empty()) {
+      Event event = events_.front();
+      events_.pop_front();
+      Client& client = _clients[event.num];
+      if (client.status == WSC_NOT_CONNECTED || client.generation != event.generation) {
+        continue;
+      }
+      if (event.type == WStype_CONNECTED) {
+        client.status = WSC_CONNECTED;
+      } else if (event.type == WStype_DISCONNECTED) {
+        clientDisconnect(&_clients[event.num]);
+        continue;
+      } else if (client.status != WSC_CONNECTED) {
+        continue;
+      }
+      if (event.type == WStype_TEXT) {
+        host::advanceUs(host::wsReceiveCostUs);
+      }
+      std::string payload = event.payload;
+      runCbEvent(event.num, event.type, reinterpret_cast<uint8_t*>(&payload[0]), event.payload.size());
+    }
+  }
+
+  bool sendTXT(uint8_t num, const char* payload, size_t length = 0) {
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || _clients[num].status != WSC_CONNECTED) {
+      return false;
+    }
+    if (length == 0) {
+      length = strlen(payload);
+    }
+    host::advanceUs(host::wsSendCostUs);
+    ++sends_;
+    HostClient& client = host_[num];
+    client.texts.push_back(std::string(payload, length));
+    if (client.texts.size() > host::wsKeepTexts) {
+      client.texts.pop_front();
+    }
+    // Two-byte length prefix stands in for the frame header.
+    uint8_t header[2] = {static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)};
+    const int fd = _clients[num].tcp->fd();
+    if (::send(fd, header, sizeof(header), MSG_DONTWAIT | MSG_NOSIGNAL) != sizeof(header) ||
+        ::send(fd, payload, length, MSG_DONTWAIT | MSG_NOSIGNAL) != static_cast<ssize_t>(length)) {
+      // The real library would block here until the peer read.
+      ++wouldBlock_;
+    }
+    return true;
+  }
+  bool sendTXT(uint8_t num, const String& payload) { return sendTXT(num, payload.c_str(), payload.length()); }
+  bool broadcastTXT(const char* payload, size_t length = 0) {
+    bool ok = true;
+    for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; ++i) {
+      if (_clients[i].status == WSC_CONNECTED) {
+        ok = sendTXT(i, payload, length) && ok;
+      }
+    }
+    return ok;
+  }
+  void disconnect(uint8_t num) {
+    if (num < WEBSOCKETS_SERVER_CLIENT_MAX) {
+      clientDisconnect(&_clients[num]);
+    }
+  }
+  int connectedClients(bool = false) {
+    int count = 0;
+    for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; ++i) {
+      count += _clients[i].status == WSC_CONNECTED;
+    }
+    return count;
+  }
+
+  // Host side. hostConnect returns the client number, or -1 when every slot
+  // is taken (the real server refuses the connection).
+  int hostConnect(const char* url = "/") {
+    for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; ++i) {
+      if (_clients[i].status != WSC_NOT_CONNECTED) {
+        continue;
+      }
+      int fds[2];
+      if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        return -1;
+      }
+      const int sndbuf = 4096;
+      setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+      setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &sndbuf, sizeof(sndbuf));
+      fcntl(fds[0], F_SETFL, O_NONBLOCK);
+      fcntl(fds[1], F_SETFL, O_NONBLOCK);
+      _clients[i].tcp = new host::WsSocket(fds[0], fds[1]);
+      _clients[i].status = WSC_HEADER;
+      _clients[i].generation = ++generation_[i];
+      host_[i] = HostClient();
+      events_.push_back(Event{i, WStype_CONNECTED, url ? url : "/", _clients[i].generation});
+      return i;
+    }
+    return -1;
+  }
+  void hostSend(uint8_t num, const std::string& text) {
+    events_.push_back(Event{num, WStype_TEXT, text, _clients[num].generation});
+  }
+  // Runs the TEXT callback now, as the server's loop would for a frame that
+  // just arrived; fuzzers and benchmarks time the handler alone this way.
+  // The payload is copied to an exactly sized, NUL-terminated buffer like
+  // the library's, so a sanitizer sees any read past the frame.
+  bool hostDeliver(uint8_t num, const uint8_t* data, size_t size) {
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || _clients[num].status != WSC_CONNECTED) {
+      return false;
+    }
+    std::unique_ptr<uint8_t[]> payload(new uint8_t[size + 1]);
+    if (size) {
+      memcpy(payload.get(), data, size);
+    }
+    payload[size] = 0;
+    runCbEvent(num, WStype_TEXT, payload.get(), size);
+    return true;
+  }
+  void hostClose(uint8_t num) { events_.push_back(Event{num, WStype_DISCONNECTED, std::string(), _clients[num].generation}); }
+  bool hostConnected(uint8_t num) const {
+    return num < WEBSOCKETS_SERVER_CLIENT_MAX && _clients[num].status == WSC_CONNECTED;
+  }
+  // Texts sent to the client since the last call, oldest first.
+  std::deque<std::string> hostTake(uint8_t num) {
+    std::deque<std::string> texts;
+    texts.swap(host_[num].texts);
+    return texts;
+  }
+  // Reads whatever the socket holds, as a client keeping up would.
+  size_t hostDrain(uint8_t num) {
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || !_clients[num].tcp) {
+      return 0;
+    }
+    const int peer = static_cast<host::WsSocket*>(_clients[num].tcp)->peer();
+    size_t total = 0;
+    uint8_t buffer[4096];
+    for (;;) {
+      const ssize_t n = ::recv(peer, buffer, sizeof(buffer), MSG_DONTWAIT);
+      if (n <= 0) {
+        break;
+      }
+      total += static_cast<size_t>(n);
+    }
+    return total;
+  }
+  // Fills the socket as a client that stopped reading would: until the next
+  // hostDrain the server cannot write to it.
+  void hostStall(uint8_t num) {
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || !_clients[num].tcp) {
+      return;
+    }
+    const uint8_t filler[512] = {};
+    while (::send(_clients[num].tcp->fd(), filler, sizeof(filler), MSG_DONTWAIT | MSG_NOSIGNAL) > 0) {
+    }
+  }
+  uint32_t hostSends() const { return sends_; }
+  uint32_t hostWouldBlock() const { return wouldBlock_; }
+  uint32_t hostDisconnects() const { return disconnects_; }
+
+ protected:
+  struct Event {
+    uint8_t num;
+    WStype_t type;
+    std::string payload;
+    uint32_t generation;
+  };
+  struct HostClient {
+    std::deque<std::string> texts;
+  };
+
+  virtual void clientDisconnect(WSclient_t* client) {
+    if (client->status == WSC_NOT_CONNECTED) {
+      return;
+    }
+    const bool wasConnected = client->status == WSC_CONNECTED;
+    delete client->tcp;
+    client->tcp = nullptr;
+    client->status = WSC_NOT_CONNECTED;
+    ++disconnects_;
+    if (wasConnected) {
+      runCbEvent(client->num, WStype_DISCONNECTED, nullptr, 0);
+    }
+  }
+  void runCbEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
+    if (cbEvent_) {
+      cbEvent_(num, type, payload, length);
+    }
+  }
+
+  struct Client : WSclient_t {
+    uint32_t generation;
+  };
+  Client _clients[WEBSOCKETS_SERVER_CLIENT_MAX];
+
+ private:
+  uint16_t port_;
+  WebSocketServerEvent cbEvent_;
+  std::deque<Event> events_;
+  HostClient host_[WEBSOCKETS_SERVER_CLIENT_MAX];
+  uint32_t generation_[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+  uint32_t sends_ = 0;
+  uint32_t wouldBlock_ = 0;
+  uint32_t disconnects_ = 0;
+};
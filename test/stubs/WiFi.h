@@ -0,0 +1,72 @@
+// Host stand-in for the ESP32 WiFi library: station state is plain host
+// variables a test can flip, and WiFiClient is an interface the HTTP and
+// WebSocket stand-ins implement.
+#pragma once
+
+#include <Arduino.h>
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum {
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3,
+} wifi_mode_t;
+
+namespace host {
+
+inline std::atomic<int> wifiStatus{WL_CONNECTED};
+inline std::atomic<int> wifiRssi{-55};
+
+// Station address of the current device: 192.168.1.(10 + host::device).
+inline IPAddress deviceIp(int device) {
+  return IPAddress(192, 168, 1, static_cast<uint8_t>(10 + device));
+}
+
+} // namespace host
+
+class WiFiClass {
+ public:
+  wl_status_t status() { return static_cast<wl_status_t>(host::wifiStatus.load()); }
+  int8_t RSSI() { return static_cast<int8_t>(host::wifiRssi.load()); }
+  String SSID() { return String("host"); }
+  IPAddress localIP() { return host::deviceIp(host::device); }
+  IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+  bool mode(wifi_mode_t mode) {
+    mode_ = mode;
+    return true;
+  }
+  wifi_mode_t getMode() { return mode_; }
+  bool setSleep(bool) { return true; }
+  wl_status_t begin() { return status(); }
+  wl_status_t begin(const char*, const char* = nullptr) { return status(); }
+  bool disconnect(bool = false) { return true; }
+
+ private:
+  wifi_mode_t mode_ = WIFI_OFF;
+};
+
+inline WiFiClass WiFi;
+
+class WiFiClient : public Stream {
+ public:
+  virtual uint8_t connected() { return 0; }
+  virtual void stop() {}
+  virtual int fd() const { return -1; }
+
+  int available() override { return 0; }
+  int read() override { return -1; }
+  size_t write(uint8_t) override { return 0; }
+  using Print::write;
+  size_t readBytes(uint8_t* buffer, size_t size) override { return Stream::readBytes(buffer, size); }
+  size_t readBytes(char* buffer, size_t size) { return readBytes(reinterpret_cast<uint8_t*>(buffer), size); }
+};
@@ -0,0 +1,36 @@
+// Host stand-in for tzapu WiFiManager: provisioning succeeds immediately.
+#pragma once
+
+#include <Arduino.h>
+
+#include <functional>
+
+namespace host {
+inline uint32_t wifiPortalStarts = 0;
+inline uint32_t wifiResets = 0;
+} // namespace host
+
+class WiFiManager {
+ public:
+  void setDebugOutput(bool) {}
+  void setConfigPortalTimeout(unsigned long) {}
+  void setConnectTimeout(unsigned long) {}
+  void setAPCallback(std::function<void(WiFiManager*)> callback) { apCallback_ = callback; }
+  void setSaveConfigCallback(std::function<void()> callback) { saveCallback_ = callback; }
+  bool startConfigPortal(const char* apName, const char* apPassword = nullptr) {
+    (void)apPassword;
+    ssid_ = apName ? apName : "";
+    ++host::wifiPortalStarts;
+    if (apCallback_) {
+      apCallback_(this);
+    }
+    return true;
+  }
+  String getConfigPortalSSID() { return ssid_; }
+  void resetSettings() { ++host::wifiResets; }
+
+ private:
+  std::function<void(WiFiManager*)> apCallback_;
+  std::function<void()> saveCallback_;
+  String ssid_;
+};
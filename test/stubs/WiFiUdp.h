@@ -0,0 +1,173 @@
+// Host stand-in for WiFiUDP: an in-process datagram network. Every socket
+// takes the station address of host::device at construction, unicast goes
+// to the socket bound to (address, port), multicast (224.0.0.0/4) to every
+// socket that joined (group, port). Tests send and receive with the same
+// class, so a "controller" is just another WiFiUDP on its own device number.
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+class WiFiUDP;
+
+namespace host {
+
+struct Datagram {
+  IPAddress from;
+  uint16_t fromPort;
+  std::vector<uint8_t> bytes;
+};
+
+inline std::recursive_mutex& udpLock() {
+  // Never destroyed: globals that outlive it use it from their destructors.
+  static std::recursive_mutex* lock = new std::recursive_mutex;
+  return *lock;
+}
+
+inline std::vector<WiFiUDP*>& udpSockets() {
+  static std::vector<WiFiUDP*>* sockets = new std::vector<WiFiUDP*>;
+  return *sockets;
+}
+
+inline uint32_t udpDelivered = 0;
+inline uint32_t udpUndeliverable = 0;
+
+} // namespace host
+
+class WiFiUDP {
+ public:
+  WiFiUDP() : localIp_(host::deviceIp(host::device)) {}
+  ~WiFiUDP() { stop(); }
+  WiFiUDP(const WiFiUDP&) = delete;
+  WiFiUDP& operator=(const WiFiUDP&) = delete;
+
+  uint8_t begin(uint16_t port) {
+    std::lock_guard<std::recursive_mutex> guard(host::udpLock());
+    stop();
+    port_ = port;
+    group_ = IPAddress();
+    registerSelf();
+    return 1;
+  }
+  uint8_t beginMulticast(IPAddress group, uint16_t port) {
+    std::lock_guard<std::recursive_mutex> guard(host::udpLock());
+    stop();
+    port_ = port;
+    group_ = group;
+    registerSelf();
+    return 1;
+  }
+  void stop() {
+    std::lock_guard<std::recursive_mutex> guard(host::udpLock());
+    auto& sockets = host::udpSockets();
+    for (size_t i = 0; i < sockets.size(); ++i) {
+      if (sockets[i] == this) {
+        sockets.erase(sockets.begin() + i);
+        break;
+      }
+    }
+    registered_ = false;
+    inbox_.clear();
+    current_.bytes.clear();
+    readPos_ = 0;
+  }
+
+  int beginPacket(IPAddress ip, uint16_t port) {
+    std::lock_guard<std::recursive_mutex> guard(host::udpLock());
+    if (!registered_) {
+      // Sending from an unbound socket binds an ephemeral port, as lwIP does.
+      port_ = nextEphemeral();
+      registerSelf();
+    }
+    outIp_ = ip;
+    outPort_ = port;
+    out_.clear();
+    return 1;
+  }
+  size_t write(uint8_t byte) { return write(&byte, 1); }
+  size_t write(const uint8_t* data, size_t size) {
+    out_.insert(out_.end(), data, data + size);
+    return size;
+  }
+  int endPacket() {
+    std::lock_guard<std::recursive_mutex> guard(host::udpLock());
+    const bool multicast = outIp_[0] >= 224 && outIp_[0] <= 239;
+    bool delivered = false;
+    for (WiFiUDP* socket : host::udpSockets()) {
+      if (socket->port_ != outPort_) {
+        continue;
+      }
+      const bool match = multicast ? socket->group_ == outIp_ : socket->localIp_ == outIp_;
+      if (match) {
+        socket->inbox_.push_back(host::Datagram{localIp_, port_, out_});
+        delivered = true;
+      }
+    }
+    if (delivered) {
+      ++host::udpDelivered;
+    } else {
+      ++host::udpUndeliverable;
+    }
+    out_.clear();
+    return 1;
+  }
+
+  int parsePacket() {
+    std::lock_guard<std::recursive_mutex> guard(host::udpLock());
+    if (inbox_.empty()) {
+      current_.bytes.clear();
+      readPos_ = 0;
+      return 0;
+    }
+    current_ = inbox_.front();
+    inbox_.pop_front();
+    readPos_ = 0;
+    return static_cast<int>(current_.bytes.size());
+  }
+  int available() { return static_cast<int>(current_.bytes.size() - readPos_); }
+  int read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+  int read(uint8_t* buffer, size_t len) {
+    const size_t left = current_.bytes.size() - readPos_;
+    const size_t n = len < left ? len : left;
+    memcpy(buffer, current_.bytes.data() + readPos_, n);
+    readPos_ += n;
+    return static_cast<int>(n);
+  }
+  int read(char* buffer, size_t len) { return read(reinterpret_cast<uint8_t*>(buffer), len); }
+  void flush() { readPos_ = current_.bytes.size(); }
+  IPAddress remoteIP() { return current_.from; }
+  uint16_t remotePort() { return current_.fromPort; }
+
+  // Host-only helpers.
+  IPAddress hostLocalIp() const { return localIp_; }
+  uint16_t hostLocalPort() const { return port_; }
+  size_t hostPending() const { return inbox_.size(); }
+
+ private:
+  static uint16_t nextEphemeral() {
+    static uint16_t next = 49152;
+    return next++;
+  }
+  void registerSelf() {
+    host::udpSockets().push_back(this);
+    registered_ = true;
+  }
+
+  IPAddress localIp_;
+  uint16_t port_ = 0;
+  IPAddress group_;
+  bool registered_ = false;
+  std::deque<host::Datagram> inbox_;
+  host::Datagram current_;
+  size_t readPos_ = 0;
+  IPAddress outIp_;
+  uint16_t outPort_ = 0;
+  std::vector<uint8_t> out_;
+};
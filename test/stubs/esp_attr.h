@@ -0,0 +1,7 @@
+// Host stand-in: RTC memory is ordinary memory; a test models a warm reset
+// by keeping the process alive and a power cycle by clearing the variable.
+#pragma once
+
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define IRAM_ATTR
@@ -0,0 +1,18 @@
+// Host stand-in for esp_heap_caps.h; reports the settable host heap figures.
+#pragma once
+
+#include <Arduino.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+
+inline size_t heap_caps_get_largest_free_block(uint32_t) {
+  return host::largestBlock;
+}
+
+inline size_t heap_caps_get_free_size(uint32_t) {
+  return host::freeHeap;
+}
+
+inline size_t heap_caps_get_minimum_free_size(uint32_t) {
+  return host::minFreeHeap;
+}
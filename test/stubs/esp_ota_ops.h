@@ -0,0 +1,52 @@
+// Host stand-in for esp_ota_ops.h: one running partition whose image state
+// a test sets to exercise the rollback check.
+#pragma once
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK 0
+#define ESP_FAIL -1
+#endif
+
+typedef enum {
+  ESP_OTA_IMG_NEW = 0x0,
+  ESP_OTA_IMG_PENDING_VERIFY = 0x1,
+  ESP_OTA_IMG_VALID = 0x2,
+  ESP_OTA_IMG_INVALID = 0x3,
+  ESP_OTA_IMG_ABORTED = 0x4,
+  ESP_OTA_IMG_UNDEFINED = 0xFFFFFFFF,
+} esp_ota_img_states_t;
+
+typedef struct {
+  char label[17];
+  uint32_t address;
+  uint32_t size;
+} esp_partition_t;
+
+namespace host {
+
+inline esp_ota_img_states_t otaImageState = ESP_OTA_IMG_VALID;
+inline int otaMarkedValid = 0;
+
+} // namespace host
+
+inline const esp_partition_t* esp_ota_get_running_partition() {
+  static const esp_partition_t app0 = {"app0", 0x10000, 0x180000};
+  return &app0;
+}
+
+inline esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* state) {
+  if (!partition || !state) {
+    return ESP_FAIL;
+  }
+  *state = host::otaImageState;
+  return ESP_OK;
+}
+
+inline esp_err_t esp_ota_mark_app_valid_cancel_rollback() {
+  ++host::otaMarkedValid;
+  host::otaImageState = ESP_OTA_IMG_VALID;
+  return ESP_OK;
+}
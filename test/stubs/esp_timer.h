@@ -0,0 +1,9 @@
+// Host stand-in: the high-resolution timer reads the same virtual clock as
+// micros().
+#pragma once
+
+#include <Arduino.h>
+
+inline int64_t esp_timer_get_time() {
+  return static_cast<int64_t>(host::nowUs.load());
+}
@@ -0,0 +1,12 @@
+// Host stand-in for esp_wifi.h.
+#pragma once
+
+typedef enum {
+  WIFI_PS_NONE,
+  WIFI_PS_MIN_MODEM,
+  WIFI_PS_MAX_MODEM,
+} wifi_ps_type_t;
+
+inline int esp_wifi_set_ps(wifi_ps_type_t) {
+  return 0;
+}
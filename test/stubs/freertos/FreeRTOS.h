@@ -0,0 +1,34 @@
+// Host stand-in for FreeRTOS: tasks are std::threads and critical sections
+// are spinlocks.
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+typedef void* TaskHandle_t;
+typedef uint32_t UBaseType_t;
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define tskIDLE_PRIORITY 0
+#define pdPASS 1
+#define pdFAIL 0
+#define pdMS_TO_TICKS(ms) (static_cast<TickType_t>(ms))
+
+struct portMUX_TYPE {
+  std::atomic<int> locked;
+};
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+inline void portENTER_CRITICAL(portMUX_TYPE* mux) {
+  int expected = 0;
+  while (!mux->locked.compare_exchange_weak(expected, 1, std::memory_order_acquire)) {
+    expected = 0;
+  }
+}
+
+inline void portEXIT_CRITICAL(portMUX_TYPE* mux) {
+  mux->locked.store(0, std::memory_order_release);
+}
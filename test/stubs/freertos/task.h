@@ -0,0 +1,51 @@
+// Host stand-in for FreeRTOS tasks. A task is a detached std::thread; its
+// handle is the address of a thread-local, so xTaskGetCurrentTaskHandle()
+// tells threads apart without allocating (it runs inside __wrap_malloc).
+// vTaskDelay() sleeps in real time, compressed to host::tickUs per tick, and
+// does not touch the virtual clock.
+#pragma once
+
+#include <chrono>
+#include <thread>
+
+#include "FreeRTOS.h"
+
+namespace host {
+inline std::atomic<uint32_t> tickUs{50};
+inline std::atomic<uint32_t> tasksStarted{0};
+} // namespace host
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+  static thread_local char self;
+  return &self;
+}
+
+inline TaskHandle_t xTaskGetHandle(const char*) {
+  return nullptr;
+}
+
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) {
+  return 4096;
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(void (*fn)(void*),
+                                          const char*,
+                                          uint32_t,
+                                          void* arg,
+                                          UBaseType_t,
+                                          TaskHandle_t* handle,
+                                          BaseType_t) {
+  std::thread thread(fn, arg);
+  if (handle) {
+    *handle = reinterpret_cast<TaskHandle_t>(static_cast<uintptr_t>(++host::tasksStarted));
+  }
+  thread.detach();
+  return pdPASS;
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::microseconds(static_cast<uint64_t>(ticks ? ticks : 1) * host::tickUs));
+}
+
+// Returning from the entry function ends the thread.
+inline void vTaskDelete(TaskHandle_t) {}
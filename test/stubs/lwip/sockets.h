@@ -0,0 +1,7 @@
+// Host stand-in: the POSIX socket API lwIP mirrors.
+#pragma once
+
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
@@ -0,0 +1,126 @@
+// Load shedding on loop overruns: the level rises one step per busy window,
+// falls one step only after kShedRecoverWindows quiet windows in a row, and
+// windows are timed from the first update even when that lands at 0 ms.
+#include <unity.h>
+
+#include "ptz_deadline.h"
+
+static constexpr uint32_t kLoopsPerWindow = 100;
+static constexpr uint32_t kBusyOverruns = 20;  // 200 permille
+static constexpr uint32_t kMiddleOverruns = 3; // between the exit and enter shares
+
+static_assert(kBusyOverruns * 1000 / kLoopsPerWindow >= ptz::kShedEnterPermille, "busy window must raise");
+static_assert(kMiddleOverruns * 1000 / kLoopsPerWindow < ptz::kShedEnterPermille &&
+                  kMiddleOverruns * 1000 / (kLoopsPerWindow + 1) >= ptz::kShedExitPermille,
+              "middle window must neither raise nor count as quiet");
+
+static ptz::PtzDeadline g_deadline;
+static uint32_t g_nowMs = 0;
+
+// One kShedWindowMs window of evenly spaced loops, the first `overruns` of
+// them over the deadline. Its last update closes it.
+static void window(uint32_t overruns) {
+  for (uint32_t i = 0; i < kLoopsPerWindow; ++i) {
+    g_nowMs += ptz::kShedWindowMs / kLoopsPerWindow;
+    g_deadline.update(i < overruns ? ptz::kLoopDeadlineUs + 1 : ptz::kLoopDeadlineUs / 2, g_nowMs);
+  }
+}
+
+void setUp() {
+  g_deadline = ptz::PtzDeadline();
+  g_nowMs = 1000;
+  g_deadline.update(ptz::kLoopDeadlineUs / 2, g_nowMs);
+}
+
+void tearDown() {}
+
+static void test_steps_up_one_level_per_busy_window() {
+  TEST_ASSERT_EQUAL(ptz::ShedLevel::Normal, g_deadline.level());
+  TEST_ASSERT_EQUAL_UINT32(ptz::kStatusIntervalMs, g_deadline.statusIntervalMs());
+  TEST_ASSERT_TRUE(g_deadline.rssiAllowed());
+
+  window(kBusyOverruns);
+  TEST_ASSERT_EQUAL(ptz::ShedLevel::Reduced, g_deadline.level());
+  TEST_ASSERT_EQUAL_UINT32(ptz::kStatusIntervalMs * 2, g_deadline.statusIntervalMs());
+  TEST_ASSERT_FALSE(g_deadline.rssiAllowed());
+  TEST_ASSERT_TRUE(g_deadline.logsDeferred());
+
+  window(kBusyOverruns);
+  TEST_ASSERT_EQUAL(ptz::ShedLevel::Minimal, g_deadline.level());
+  TEST_ASSERT_EQUAL_UINT32(ptz::kStatusMaxIntervalMs, g_deadline.statusIntervalMs());
+
+  window(kBusyOverruns);
+  TEST_ASSERT_EQUAL(ptz::ShedLevel::Minimal, g_deadline.level());
+  TEST_ASSERT_EQUAL_UINT32(2, g_deadline.stats().shedEvents);
+  TEST_ASSERT_EQUAL_UINT32(3 * kBusyOverruns, g_deadline.stats().overruns);
+}
+
+// A window between the exit and enter shares holds the level and restarts
+// the quiet count.
+static void test_middle_window_neither_raises_nor_recovers() {
+  window(kMiddleOverruns);
+  TEST_ASSERT_EQUAL(ptz::ShedLevel::Normal, g_deadline.level());
+
+  window(kBusyOverruns);
+  for (uint8_t i = 0; i < ptz::kShedRecoverWindows - 1; ++i) {
+    window(0);
+  }
+  window(kMiddleOverruns);
+  for (uint8_t i = 0; i < ptz::kShedRecoverWindows - 1; ++i) {
+    window(0);
+    TEST_ASSERT_EQUAL(ptz::ShedLevel::Reduced, g_deadline.level());
+  }
+  window(0);
+  TEST_ASSERT_EQUAL(ptz::ShedLevel::Normal, g_deadline.level());
+}
+
+// From Minimal, each level needs its own run of quiet windows, and a busy
+// window part-way through raises the level again and restarts the count.
+static void test_recovers_one_level_per_quiet_run() {
+  window(kBusyOverruns);
+  window(kBusyOverruns);
+  TEST_ASSERT_EQUAL(ptz::ShedLevel::Minimal, g_deadline.level());
+
+  for (uint8_t i = 0; i < ptz::kShedRecoverWindows - 1; ++i) {
+    window(0);
+    TEST_ASSERT_EQUAL(ptz::ShedLevel::Minimal, g_deadline.level());
+  }
+  window(0);
+  TEST_ASSERT_EQUAL(ptz::ShedLevel::Reduced, g_deadline.level());
+
+  for (uint8_t i = 0; i < ptz::kShedRecoverWindows - 1; ++i) {
+    window(0);
+  }
+  TEST_ASSERT_EQUAL(ptz::ShedLevel::Reduced, g_deadline.level());
+  window(kBusyOverruns);
+  TEST_ASSERT_EQUAL(ptz::ShedLevel::Minimal, g_deadline.level());
+
+  for (uint8_t i = 0; i < 2 * ptz::kShedRecoverWindows - 1; ++i) {
+    window(0);
+    TEST_ASSERT_TRUE(g_deadline.level() != ptz::ShedLevel::Normal);
+  }
+  window(0);
+  TEST_ASSERT_EQUAL(ptz::ShedLevel::Normal, g_deadline.level());
+  TEST_ASSERT_EQUAL_UINT32(3, g_deadline.stats().shedEvents);
+}
+
+// millis() reads 0 once every wrap; a window opened then still closes
+// kShedWindowMs later.
+static void test_window_opened_at_zero_ms() {
+  ptz::PtzDeadline deadline;
+  for (uint32_t ms = 0; ms < ptz::kShedWindowMs; ++ms) {
+    deadline.update(ptz::kLoopDeadlineUs + 1, ms);
+  }
+  TEST_ASSERT_EQUAL(ptz::ShedLevel::Normal, deadline.level());
+  deadline.update(ptz::kLoopDeadlineUs + 1, ptz::kShedWindowMs);
+  TEST_ASSERT_EQUAL(ptz::ShedLevel::Reduced, deadline.level());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_steps_up_one_level_per_busy_window);
+  RUN_TEST(test_middle_window_neither_raises_nor_recovers);
+  RUN_TEST(test_recovers_one_level_per_quiet_run);
+  RUN_TEST(test_window_opened_at_zero_ms);
+  return UNITY_END();
+}
@@ -0,0 +1,143 @@
+// FreeD output as a tracking receiver sees it: a second station listens on
+// the multicast group while the controlling client sets the target and rate.
+#include <unity.h>
+
+#include <vector>
+
+#include "head_rig.h"
+
+static const IPAddress kGroup(239, 255, 0, 1);
+static constexpr uint16_t kPort = 40001;
+
+static WiFiUDP* g_receiver = nullptr;
+static int g_client = -1;
+
+static std::vector<std::vector<uint8_t>> collect(uint32_t ms) {
+  std::vector<std::vector<uint8_t>> out;
+  const uint64_t endUs = host::nowUs + static_cast<uint64_t>(ms) * 1000;
+  while (host::nowUs < endUs) {
+    rig::pass();
+    while (int size = g_receiver->parsePacket()) {
+      std::vector<uint8_t> packet(static_cast<size_t>(size));
+      g_receiver->read(packet.data(), packet.size());
+      out.push_back(packet);
+    }
+  }
+  return out;
+}
+
+static int32_t readS24(const uint8_t* p) {
+  int32_t value = (static_cast<int32_t>(p[0]) << 16) | (p[1] << 8) | p[2];
+  return value & 0x800000 ? value - 0x1000000 : value;
+}
+
+static bool checksumValid(const std::vector<uint8_t>& packet) {
+  uint8_t sum = 0x40;
+  for (size_t i = 0; i + 1 < packet.size(); ++i) {
+    sum = static_cast<uint8_t>(sum - packet[i]);
+  }
+  return sum == packet.back();
+}
+
+void setUp() {
+  rig::boot();
+  if (!g_receiver) {
+    host::device = 1;
+    g_receiver = new WiFiUDP();
+    host::device = 0;
+    g_receiver->beginMulticast(kGroup, kPort);
+    g_client = rig::ws().hostConnect("/ws");
+  }
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"requestControl\"", "ack", reply));
+}
+
+void tearDown() {}
+
+static void test_output_is_off_by_default() {
+  TEST_ASSERT_FALSE(g_freed.enabled());
+  TEST_ASSERT_EQUAL(0, collect(200).size());
+}
+
+static void test_set_freed_streams_d1_at_requested_rate() {
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"setFreed\",\"ip\":\"239.255.0.1\",\"port\":40001,\"rateHz\":100",
+                                "freed", reply));
+  TEST_ASSERT_TRUE(reply["enabled"].as<bool>());
+  TEST_ASSERT_EQUAL_STRING("239.255.0.1", reply["ip"] | "");
+  TEST_ASSERT_EQUAL(kPort, reply["port"].as<int>());
+  TEST_ASSERT_EQUAL(100, reply["rateHz"].as<int>());
+
+  collect(10);
+  const std::vector<std::vector<uint8_t>> packets = collect(1000);
+  TEST_ASSERT_INT_WITHIN(2, 100, packets.size());
+  for (const std::vector<uint8_t>& packet : packets) {
+    TEST_ASSERT_EQUAL(29, packet.size());
+    TEST_ASSERT_EQUAL_HEX8(0xD1, packet[0]);
+    TEST_ASSERT_TRUE(checksumValid(packet));
+  }
+
+  // Pan angle follows the head (degrees * 32768).
+  const float panDegrees = g_motion.state().pos[ptz::kAxisPan] / ptz::kPanStepsPerDegree + ptz::kPanZeroDegrees;
+  TEST_ASSERT_INT_WITHIN(2, lroundf(panDegrees * 32768.0f), readS24(&packets.back()[2]));
+}
+
+static void test_invalid_target_or_rate_is_rejected() {
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"setFreed\",\"ip\":\"239.255.0\"", "error", reply));
+  TEST_ASSERT_EQUAL_STRING("invalid_payload", reply["code"] | "");
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"setFreed\",\"ip\":\"239.255.0.1\",\"rateHz\":1000", "error",
+                                reply));
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"setFreed\",\"ip\":\"239.255.0.1\",\"port\":0", "error", reply));
+  // The running stream keeps its settings.
+  TEST_ASSERT_EQUAL(100, g_freed.rateHz());
+  TEST_ASSERT_EQUAL(kPort, g_freed.port());
+  TEST_ASSERT_TRUE(g_freed.enabled());
+}
+
+static void test_metrics_reports_freed_jitter() {
+  rig::ws().hostDrain(g_client);
+  rig::ws().hostTake(g_client);
+  collect(500);
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"metrics\"", "metrics", reply));
+  TEST_ASSERT_TRUE(reply["freed"]["enabled"].as<bool>());
+  TEST_ASSERT_EQUAL_UINT32(g_freed.stats().sent, reply["freed"]["sent"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(g_freed.stats().skipped, reply["freed"]["skipped"].as<uint32_t>());
+  // A 100 us loop pass bounds how late a slot can be served.
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(rig::passUs, reply["freed"]["jitterMaxUs"].as<uint32_t>());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(reply["freed"]["jitterMaxUs"].as<uint32_t>(),
+                                   reply["freed"]["jitterP99Us"].as<uint32_t>());
+}
+
+static void test_slow_loop_counts_skipped_slots() {
+  // Line up with a send slot, then stall 25 ms at 100 Hz: the slot at
+  // +10 ms goes out late and the one at +20 ms is skipped.
+  const uint32_t sent = g_freed.stats().sent;
+  while (g_freed.stats().sent == sent) {
+    rig::pass();
+  }
+  const uint32_t skipped = g_freed.stats().skipped;
+  rig::pass(25000);
+  collect(100);
+  TEST_ASSERT_EQUAL_UINT32(skipped + 1, g_freed.stats().skipped);
+}
+
+static void test_disable_stops_output() {
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"setFreed\",\"enabled\":false", "freed", reply));
+  TEST_ASSERT_FALSE(reply["enabled"].as<bool>());
+  collect(20);
+  TEST_ASSERT_EQUAL(0, collect(300).size());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_output_is_off_by_default);
+  RUN_TEST(test_set_freed_streams_d1_at_requested_rate);
+  RUN_TEST(test_invalid_target_or_rate_is_rejected);
+  RUN_TEST(test_metrics_reports_freed_jitter);
+  RUN_TEST(test_slow_loop_counts_skipped_slots);
+  RUN_TEST(test_disable_stops_output);
+  return UNITY_END();
+}
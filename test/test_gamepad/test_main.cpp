@@ -0,0 +1,158 @@
+// Gamepad reports: a new report reaches the motion layer in the loop() pass
+// that picks it up, whatever the phase of the gamepad tick; unchanged
+// reports are skipped; and stick-to-first-step latencies land in the
+// stickToStepUs histogram buckets the metrics reply reports from.
+#include <unity.h>
+
+#include "head_rig.h"
+
+static Gamepad g_pad;
+static int g_client = -1;
+
+static void report(int32_t lx) {
+  g_pad.lx = lx;
+  BP32.hostMarkUpdated();
+}
+
+static float panCommand() {
+  return g_motion.velocityCommand().norm[ptz::kAxisPan];
+}
+
+// Centers the stick and runs until the head has stopped.
+static void centerAndSettle() {
+  report(0);
+  rig::pass();
+  for (int i = 0; i < 5000 && g_motion.isMoving(); ++i) {
+    rig::pass();
+  }
+  TEST_ASSERT_FALSE(g_motion.isMoving());
+}
+
+void setUp() {
+  rig::boot();
+  if (g_client < 0) {
+    BP32.hostConnect(&g_pad);
+    g_client = rig::ws().hostConnect("/ws?role=observer");
+  }
+  centerAndSettle();
+}
+
+void tearDown() {}
+
+// Every bucket's upper bound lies within 25% above the values it holds, the
+// first four buckets are exact, and values past the last bucket still
+// report their true maximum.
+static void test_latency_histogram_buckets() {
+  const uint32_t values[] = {0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 99, 1000, 1023, 1024, 2047, 2048, 2500, 65535, 1000000};
+  for (uint32_t value : values) {
+    ptz::LatencyHistogram histogram;
+    histogram.record(value);
+    histogram.record(0xFFFFFFFFu);
+    const uint32_t bound = histogram.quantile(0.0f);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32_MESSAGE(value, bound, "bound below value");
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(value + value / 4, bound, "bound over 25% above value");
+    if (value < 4) {
+      TEST_ASSERT_EQUAL_UINT32(value, bound);
+    }
+  }
+
+  ptz::LatencyHistogram histogram;
+  for (uint32_t us = 0; us < 100000; us += 7) {
+    histogram.record(us);
+  }
+  uint32_t previous = 0;
+  for (int percent = 0; percent <= 100; percent += 5) {
+    const uint32_t exact = (percent * (100000 / 7) / 100) * 7;
+    const uint32_t value = histogram.quantile(percent / 100.0f);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(previous, value);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(exact, value);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(exact + exact / 4 + 7, value);
+    previous = value;
+  }
+
+  ptz::LatencyHistogram huge;
+  huge.record(50000000);
+  TEST_ASSERT_EQUAL_UINT32(50000000, huge.quantile(0.5f));
+  TEST_ASSERT_EQUAL_UINT32(50000000, huge.max());
+}
+
+// A stick report is applied in the next pass, before any gamepad tick can
+// run, at every phase of the 4 ms tick.
+static void test_report_applied_in_the_same_pass() {
+  for (uint32_t phaseUs = 0; phaseUs < ptz::kGamepadTickUs; phaseUs += 500) {
+    host::advanceUs(phaseUs);
+    report(-400);
+    rig::pass();
+    TEST_ASSERT_EQUAL(Owner::Gamepad, g_owner.owner());
+    TEST_ASSERT_TRUE(panCommand() != 0.0f);
+    centerAndSettle();
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, panCommand());
+  }
+}
+
+// A report whose sticks did not move leaves the motion layer alone.
+static void test_unchanged_report_is_skipped() {
+  report(300);
+  rig::pass();
+  const float applied = panCommand();
+  TEST_ASSERT_TRUE(applied != 0.0f);
+  g_motion.setAxisVelocity(ptz::kAxisPan, applied / 2);
+  BP32.hostMarkUpdated();
+  rig::pass();
+  TEST_ASSERT_EQUAL_FLOAT(applied / 2, panCommand());
+  report(301);
+  rig::pass();
+  TEST_ASSERT_TRUE(panCommand() != applied / 2);
+}
+
+// Each time a stick leaves the deadzone one latency is recorded, from the
+// pass that picks up the report to the pass of the first step, and the
+// metrics reply reports the histogram of exactly those latencies. The first
+// drive wakes the drivers and waits kAxisWakeUs; later ones only ramp up.
+static void test_stick_latency_recorded_in_histogram() {
+  g_motion.setEnabled(false);
+  g_metrics.resetTiming();
+  ptz::LatencyHistogram expected;
+  for (int i = 0; i < 5; ++i) {
+    const float start = g_motion.state().pos[ptz::kAxisPan];
+    report(i % 2 ? 450 : -450);
+    const uint32_t reportUs = micros();
+    do {
+      rig::pass();
+    } while (g_motion.state().pos[ptz::kAxisPan] == start && micros() - reportUs < 100000);
+    const uint32_t latencyUs = micros() - rig::passUs - reportUs;
+    if (i == 0) {
+      TEST_ASSERT_GREATER_OR_EQUAL_UINT32(ptz::kAxisWakeUs, latencyUs);
+    }
+    expected.record(latencyUs);
+    rig::runForMs(20);
+    TEST_ASSERT_EQUAL_UINT32(i + 1, g_metrics.stickLatency().count());
+    report(i % 2 ? 460 : -460); // still out of the deadzone: no new probe
+    rig::runForMs(20);
+    TEST_ASSERT_EQUAL_UINT32(i + 1, g_metrics.stickLatency().count());
+    centerAndSettle();
+  }
+
+  const ptz::LatencyHistogram& latency = g_metrics.stickLatency();
+  TEST_ASSERT_EQUAL_UINT32(expected.max(), latency.max());
+  TEST_ASSERT_EQUAL_UINT32(expected.quantile(0.0f), latency.quantile(0.0f));
+  TEST_ASSERT_EQUAL_UINT32(expected.quantile(0.5f), latency.quantile(0.5f));
+  TEST_ASSERT_LESS_THAN_UINT32(expected.max(), latency.quantile(0.5f));
+
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"metrics\"", "metrics", reply));
+  JsonObject stick = reply["stickToStepUs"];
+  TEST_ASSERT_EQUAL_UINT32(5, stick["n"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(latency.quantile(0.5f), stick["p50"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(latency.quantile(0.99f), stick["p99"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(expected.max(), stick["max"].as<uint32_t>());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_latency_histogram_buckets);
+  RUN_TEST(test_report_applied_in_the_same_pass);
+  RUN_TEST(test_unchanged_report_is_skipped);
+  RUN_TEST(test_stick_latency_recorded_in_histogram);
+  return UNITY_END();
+}
@@ -0,0 +1,249 @@
+// Group control across several simulated heads on one host. Each head is its
+// own owner, motion, presets and group member on a separate host::device, so
+// it has its own station address and NVS; a controller on another device
+// drives them all with single multicast datagrams.
+#include <unity.h>
+
+#include <memory>
+#include <vector>
+
+#include "ptz_group.h"
+#include "ptz_serial.h"
+#include "ptz_wire.h"
+
+static constexpr uint8_t kGroup = 7;
+static constexpr int kControllerDevice = 100;
+
+struct SimHead {
+  ptz::PtzOwner owner;
+  ptz::PtzMotion motion;
+  ptz::PtzPresets presets;
+  ptz::PtzGroup group;
+};
+
+static std::vector<std::unique_ptr<SimHead>> g_heads;
+static WiFiUDP* g_controller = nullptr;
+static uint32_t g_seq = 1;
+
+// Heads 1..count on devices 1..count, all in group kGroup.
+static void makeHeads(size_t count) {
+  g_heads.clear();
+  for (size_t i = 0; i < count; ++i) {
+    host::device = static_cast<int>(i + 1);
+    std::unique_ptr<SimHead> head(new SimHead());
+    head->owner.begin();
+    head->motion.begin();
+    head->presets.begin();
+    head->group.begin(&head->owner, &head->motion, &head->presets);
+    head->group.setMembership(kGroup, static_cast<uint8_t>(i + 1));
+    g_heads.push_back(std::move(head));
+  }
+  host::device = 0;
+}
+
+// One loop pass on every head, then 1 ms of virtual time.
+static void passAll() {
+  const uint32_t nowMs = millis();
+  for (auto& head : g_heads) {
+    head->owner.update(nowMs);
+    head->group.loop(nowMs, true);
+    head->motion.update(0.001f);
+  }
+  host::advanceUs(1000);
+}
+
+static std::vector<uint8_t> header(uint8_t cmd, uint8_t group, uint8_t count) {
+  std::vector<uint8_t> datagram = {'P', 'G', 1, cmd, 0, 0, 0, 0, group, count};
+  ptz::writeU32(&datagram[4], g_seq++);
+  return datagram;
+}
+
+static void putI16(std::vector<uint8_t>& datagram, int16_t value) {
+  datagram.push_back(static_cast<uint8_t>(value));
+  datagram.push_back(static_cast<uint8_t>(static_cast<uint16_t>(value) >> 8));
+}
+
+static void putI32(std::vector<uint8_t>& datagram, int32_t value) {
+  uint8_t bytes[4];
+  ptz::writeU32(bytes, static_cast<uint32_t>(value));
+  datagram.insert(datagram.end(), bytes, bytes + 4);
+}
+
+static void sendGroup(const std::vector<uint8_t>& datagram) {
+  IPAddress address;
+  address.fromString(ptz::kGroupMulticastIp);
+  g_controller->beginPacket(address, ptz::kGroupPort);
+  g_controller->write(datagram.data(), datagram.size());
+  g_controller->endPacket();
+}
+
+// Pan velocity for head id `head`: a different value per head so a swapped
+// entry shows up.
+static int16_t panFor(size_t head) {
+  return static_cast<int16_t>(1000 * static_cast<int>(head));
+}
+
+static std::vector<uint8_t> velocityDatagram(size_t heads) {
+  std::vector<uint8_t> datagram = header(ptz::kSerialCmdSetVelocity, kGroup, static_cast<uint8_t>(heads));
+  for (size_t id = 1; id <= heads; ++id) {
+    datagram.push_back(static_cast<uint8_t>(id));
+    putI16(datagram, panFor(id));
+    putI16(datagram, -panFor(id));
+    putI16(datagram, 0);
+  }
+  return datagram;
+}
+
+void setUp() {
+  host::setTimeUs(1000000);
+  if (!g_controller) {
+    host::device = kControllerDevice;
+    g_controller = new WiFiUDP();
+    host::device = 0;
+  }
+  g_seq = 1;
+}
+
+void tearDown() {
+  g_heads.clear();
+}
+
+// One datagram per command however many heads there are, and every head
+// applies its own entry in the same loop pass.
+static void test_one_datagram_drives_every_head_in_one_pass() {
+  for (size_t count : {4, 8, 12}) {
+    makeHeads(count);
+    passAll(); // join
+    const uint32_t deliveredBefore = host::udpDelivered;
+    sendGroup(velocityDatagram(count));
+    passAll();
+    TEST_ASSERT_EQUAL_UINT32(deliveredBefore + 1, host::udpDelivered);
+    for (size_t i = 0; i < count; ++i) {
+      const SimHead& head = *g_heads[i];
+      const ptz::GroupStats stats = head.group.stats();
+      TEST_ASSERT_EQUAL_UINT32(1, stats.applied);
+      const ptz::VelocityCommand command = head.motion.velocityCommand();
+      TEST_ASSERT_FLOAT_WITHIN(1e-4f, ptz::normFromI16(panFor(i + 1)), command.norm[ptz::kAxisPan]);
+      TEST_ASSERT_FLOAT_WITHIN(1e-4f, ptz::normFromI16(-panFor(i + 1)), command.norm[ptz::kAxisTilt]);
+      TEST_ASSERT_EQUAL(ptz::Owner::App, head.owner.owner());
+      TEST_ASSERT_EQUAL_UINT32(ptz::kGroupClientIdBase + kGroup, head.owner.snapshot().controlClientId);
+    }
+  }
+}
+
+// moveTo carries a shared base plus a per-head offset; heads without their
+// own entry take the wildcard.
+static void test_move_to_applies_base_plus_offset() {
+  makeHeads(6);
+  passAll();
+  std::vector<uint8_t> datagram = header(ptz::kSerialCmdMoveTo, kGroup, 3);
+  putI32(datagram, 10000);
+  putI32(datagram, -2000);
+  putI32(datagram, 500);
+  for (uint8_t id : {2, 5}) {
+    datagram.push_back(id);
+    putI16(datagram, static_cast<int16_t>(id * 10));
+    putI16(datagram, static_cast<int16_t>(-id));
+    putI16(datagram, 0);
+  }
+  datagram.push_back(ptz::PtzGroup::kHeadAll);
+  putI16(datagram, 0);
+  putI16(datagram, 0);
+  putI16(datagram, 0);
+  sendGroup(datagram);
+  passAll();
+
+  for (size_t i = 0; i < g_heads.size(); ++i) {
+    const int id = static_cast<int>(i + 1);
+    const int offset = id == 2 || id == 5 ? id : 0;
+    const ptz::MotionState state = g_heads[i]->motion.state();
+    TEST_ASSERT_EQUAL_FLOAT(10000 + offset * 10, state.target[ptz::kAxisPan]);
+    TEST_ASSERT_EQUAL_FLOAT(-2000 - offset, state.target[ptz::kAxisTilt]);
+    TEST_ASSERT_EQUAL_FLOAT(500, state.target[ptz::kAxisZoom]);
+  }
+}
+
+// The group never preempts a local owner, takes a free head, and keeps it
+// only while datagrams keep coming.
+static void test_group_follows_owner_rules() {
+  makeHeads(3);
+  passAll();
+  g_heads[1]->owner.requestAppControl(1, millis());
+
+  sendGroup(velocityDatagram(3));
+  passAll();
+  TEST_ASSERT_EQUAL_UINT32(1, g_heads[0]->group.stats().applied);
+  TEST_ASSERT_EQUAL_UINT32(1, g_heads[1]->group.stats().rejected);
+  TEST_ASSERT_EQUAL_UINT32(1, g_heads[1]->owner.snapshot().controlClientId);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, g_heads[1]->motion.velocityCommand().norm[ptz::kAxisPan]);
+
+  // Datagrams act as the group's heartbeat.
+  for (uint32_t ms = 0; ms < ptz::kAppHeartbeatTimeoutMs * 2; ms += 100) {
+    sendGroup(velocityDatagram(3));
+    for (int i = 0; i < 100; ++i) {
+      passAll();
+    }
+  }
+  TEST_ASSERT_EQUAL(ptz::Owner::App, g_heads[0]->owner.owner());
+  TEST_ASSERT_EQUAL_UINT32(ptz::kGroupClientIdBase + kGroup, g_heads[0]->owner.snapshot().controlClientId);
+
+  // Silence hands the head back.
+  for (uint32_t ms = 0; ms <= ptz::kAppHeartbeatTimeoutMs + 10; ++ms) {
+    passAll();
+  }
+  TEST_ASSERT_EQUAL(ptz::Owner::None, g_heads[0]->owner.owner());
+}
+
+// Replays, other groups and heads left out of a datagram change nothing.
+static void test_ignored_datagrams() {
+  makeHeads(4);
+  passAll();
+  std::vector<uint8_t> datagram = velocityDatagram(2); // heads 1 and 2 only
+  sendGroup(datagram);
+  passAll();
+  sendGroup(datagram); // same sequence number
+  passAll();
+  std::vector<uint8_t> other = velocityDatagram(4);
+  other[8] = kGroup + 1;
+  sendGroup(other);
+  passAll();
+
+  TEST_ASSERT_EQUAL_UINT32(1, g_heads[0]->group.stats().applied);
+  TEST_ASSERT_EQUAL_UINT32(1, g_heads[0]->group.stats().stale);
+  TEST_ASSERT_EQUAL_UINT32(1, g_heads[0]->group.stats().otherGroup);
+  for (size_t i = 2; i < 4; ++i) {
+    const ptz::GroupStats stats = g_heads[i]->group.stats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.applied);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.notAddressed);
+    TEST_ASSERT_EQUAL(ptz::Owner::None, g_heads[i]->owner.owner());
+  }
+}
+
+// Recall moves each head to its own stored preset.
+static void test_preset_recall_uses_each_heads_preset() {
+  makeHeads(4);
+  for (size_t i = 0; i < g_heads.size(); ++i) {
+    ptz::MotionState state = {};
+    state.pos[ptz::kAxisPan] = static_cast<float>(100 * (i + 1));
+    TEST_ASSERT_TRUE(g_heads[i]->presets.save(2, state));
+  }
+  passAll();
+  std::vector<uint8_t> datagram = header(ptz::kSerialCmdPresetRecall, kGroup, 1);
+  datagram.push_back(ptz::PtzGroup::kHeadAll);
+  datagram.push_back(2);
+  sendGroup(datagram);
+  passAll();
+  for (size_t i = 0; i < g_heads.size(); ++i) {
+    TEST_ASSERT_EQUAL_FLOAT(100.0f * (i + 1), g_heads[i]->motion.state().target[ptz::kAxisPan]);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_one_datagram_drives_every_head_in_one_pass);
+  RUN_TEST(test_move_to_applies_base_plus_offset);
+  RUN_TEST(test_group_follows_owner_rules);
+  RUN_TEST(test_ignored_datagrams);
+  RUN_TEST(test_preset_recall_uses_each_heads_preset);
+  return UNITY_END();
+}
@@ -0,0 +1,186 @@
+// Tokenized logs end to end: the call sites below are built tokenized, their
+// frames captured from Serial, and tools/log_tokens.py builds a database from
+// this file and decodes the capture, which must match printf text line for
+// line. Also reports bytes on the wire against the text lines. The lines are
+// real call sites from src/ with typical arguments.
+//
+// Needs python3 on PATH (PTZ_PYTHON overrides) and runs from the project
+// directory, like test_ws_fuzz.
+#define PTZ_LOG_TOKENIZED 1
+
+#include <unity.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "ptz_log.h"
+#include "ptz_wire.h"
+
+static std::string g_expected;
+static size_t g_textBytes = 0;
+static size_t g_lines = 0;
+
+// The line the text build would print for the call just made.
+static void expect(const char* level, const char* tag, const char* fmt, ...) {
+  char message[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(message, sizeof(message), fmt, args);
+  va_end(args);
+  char line[320];
+  const int len = snprintf(line, sizeof(line), "[%s] %s | %s\n", level, tag, message);
+  g_expected += line;
+  g_textBytes += static_cast<size_t>(len);
+  ++g_lines;
+}
+
+static std::string runTool(const std::string& args) {
+  const char* python = getenv("PTZ_PYTHON");
+  const std::string command = std::string(python ? python : "python3") + " tools/log_tokens.py " + args + " 2>&1";
+  FILE* pipe = popen(command.c_str(), "r");
+  std::string out;
+  if (!pipe) {
+    return out;
+  }
+  char buffer[512];
+  size_t n = 0;
+  while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+    out.append(buffer, n);
+  }
+  pclose(pipe);
+  return out;
+}
+
+static void emitLines() {
+  PTZ_LOGI("WS", "Client disconnected id=%u", 3u);
+  expect("I", "WS", "Client disconnected id=%u", 3u);
+  PTZ_LOGI("WS", "Client connected id=%u%s", 3u, " (observer)");
+  expect("I", "WS", "Client connected id=%u%s", 3u, " (observer)");
+  PTZ_LOGW("WS", "TX queue full client=%u dropped=%lu", 4u, 1234ul);
+  expect("W", "WS", "TX queue full client=%u dropped=%lu", 4u, 1234ul);
+  PTZ_LOGW("WS", "Dropping slow client id=%u queued=%u dropped=%lu replaced=%lu", 5u, 3036u, 99ul, 57ul);
+  expect("W", "WS", "Dropping slow client id=%u queued=%u dropped=%lu replaced=%lu", 5u, 3036u, 99ul, 57ul);
+  PTZ_LOGI("OWNER", "App requested control client=%u", 2u);
+  expect("I", "OWNER", "App requested control client=%u", 2u);
+  PTZ_LOGW("UDP", "Stale datagram seq=%lu", 40213ul);
+  expect("W", "UDP", "Stale datagram seq=%lu", 40213ul);
+  PTZ_LOGI("PRESET", "Recalled preset %u", 4u);
+  expect("I", "PRESET", "Recalled preset %u", 4u);
+  PTZ_LOGI("RECORD", "Recorded slot %u ticks=%lu bytes=%u", 0u, 1200ul, 846u);
+  expect("I", "RECORD", "Recorded slot %u ticks=%lu bytes=%u", 0u, 1200ul, 846u);
+  PTZ_LOGW("SERIAL", "CRC error (%lu total)", 17ul);
+  expect("W", "SERIAL", "CRC error (%lu total)", 17ul);
+  PTZ_LOGW("MEM", "Free heap low: %lu bytes (min %lu)", 18320ul, 17012ul);
+  expect("W", "MEM", "Free heap low: %lu bytes (min %lu)", 18320ul, 17012ul);
+  PTZ_LOGI("OTA", "Update verified %lu bytes at %lu kB/s (paused %lu ms)", 1212416ul, 87ul, 0ul);
+  expect("I", "OTA", "Update verified %lu bytes at %lu kB/s (paused %lu ms)", 1212416ul, 87ul, 0ul);
+  PTZ_LOGE("OTA", "Failed to confirm image");
+  expect("E", "OTA", "Failed to confirm image");
+  PTZ_LOGI("RESUME", "Position restored from %s (axes 0x%02x)", "nvs", 5u);
+  expect("I", "RESUME", "Position restored from %s (axes 0x%02x)", "nvs", 5u);
+  PTZ_LOGW("LOAD", "Shed level %s -> %s (overruns %lu/%lu)", "normal", "reduced", 30ul, 100ul);
+  expect("W", "LOAD", "Shed level %s -> %s (overruns %lu/%lu)", "normal", "reduced", 30ul, 100ul);
+  PTZ_LOGI("PROFILE", "Shaper %s: %s %.1f Hz damping %.2f", "pan", "zvd", 6.5, 0.05);
+  expect("I", "PROFILE", "Shaper %s: %s %.1f Hz damping %.2f", "pan", "zvd", 6.5, 0.05);
+  PTZ_LOGI("WIFI", "Connected SSID=%s IP=%s RSSI=%d", "studio", "192.168.1.50", -61);
+  expect("I", "WIFI", "Connected SSID=%s IP=%s RSSI=%d", "studio", "192.168.1.50", -61);
+}
+
+void setUp() {
+  Serial.hostTakeOutput();
+  g_expected.clear();
+  g_textBytes = 0;
+  g_lines = 0;
+}
+
+void tearDown() {}
+
+// Frames interleaved with plain text and a serial control reply decode back
+// to exactly the text build's lines; the text and the reply are passed
+// through and skipped as before.
+static void test_capture_decodes_with_generated_database() {
+  char dir[] = "/tmp/ptz_log_tokensXXXXXX";
+  TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+  const std::string db = std::string(dir) + "/tokens.csv";
+  const std::string capture = std::string(dir) + "/capture.bin";
+  const std::string built = runTool("database test/test_log_tokens -o " + db);
+  if (built.find("tokens written") == std::string::npos) {
+    TEST_IGNORE_MESSAGE("python3 tools/log_tokens.py unavailable; run from the project directory");
+  }
+
+  Serial.print("ets Jun  8 2016 00:22:57\n");
+  g_expected += "ets Jun  8 2016 00:22:57\n";
+  emitLines();
+  uint8_t reply[] = {ptz::kSerialFrameSof, 1, 0x80, 7, 0x10, 0, 0};
+  const uint16_t crc = ptz::crc16(&reply[1], 4);
+  reply[5] = static_cast<uint8_t>(crc);
+  reply[6] = static_cast<uint8_t>(crc >> 8);
+  Serial.write(reply, sizeof(reply));
+  PTZ_LOGI("WS", "Client disconnected id=%u", 250u);
+  expect("I", "WS", "Client disconnected id=%u", 250u);
+
+  const std::vector<uint8_t> bytes = Serial.hostTakeOutput();
+  FILE* file = fopen(capture.c_str(), "wb");
+  TEST_ASSERT_NOT_NULL(file);
+  fwrite(bytes.data(), 1, bytes.size(), file);
+  fclose(file);
+  const std::string decoded = runTool("detokenize --db " + db + " " + capture);
+  TEST_ASSERT_EQUAL_STRING(g_expected.c_str(), decoded.c_str());
+  unlink(capture.c_str());
+  unlink(db.c_str());
+  rmdir(dir);
+}
+
+// Integer-only lines shrink six to seven times against their text, the
+// four-byte frame header being most of what is left; strings go out as
+// they are, so the mix of real call sites lands between four and five.
+static void test_bytes_on_the_wire() {
+  emitLines();
+  const size_t frameBytes = Serial.hostTakeOutput().size();
+  // The previous frame carried a length, type, sequence, 32-bit token and
+  // CRC: six bytes more per line.
+  const size_t previousBytes = frameBytes + 6 * g_lines;
+  printf("%u lines: %u bytes as text, %u tokenized (%.1fx), %u in the previous framing (%.1fx)\n",
+         static_cast<unsigned>(g_lines), static_cast<unsigned>(g_textBytes), static_cast<unsigned>(frameBytes),
+         static_cast<double>(g_textBytes) / frameBytes, static_cast<unsigned>(previousBytes),
+         static_cast<double>(g_textBytes) / previousBytes);
+  TEST_ASSERT_GREATER_OR_EQUAL(4 * frameBytes, g_textBytes);
+
+  setUp();
+  PTZ_LOGW("WS", "TX queue full client=%u dropped=%lu", 4u, 1234ul);
+  expect("W", "WS", "TX queue full client=%u dropped=%lu", 4u, 1234ul);
+  PTZ_LOGI("PRESET", "Recalled preset %u", 4u);
+  expect("I", "PRESET", "Recalled preset %u", 4u);
+  PTZ_LOGW("SERIAL", "CRC error (%lu total)", 17ul);
+  expect("W", "SERIAL", "CRC error (%lu total)", 17ul);
+  const size_t intBytes = Serial.hostTakeOutput().size();
+  printf("integer-only lines: %u bytes as text, %u tokenized (%.1fx)\n", static_cast<unsigned>(g_textBytes),
+         static_cast<unsigned>(intBytes), static_cast<double>(g_textBytes) / intBytes);
+  TEST_ASSERT_GREATER_OR_EQUAL(6 * intBytes, g_textBytes);
+}
+
+// Arguments that do not fit kLogTokenMaxPayload are not cut mid-varint: the
+// line goes out as the overflow token and its own token, without arguments.
+static void test_overflowing_arguments_send_the_token_alone() {
+  const char* longText = "abcdefghijklmnopqrstuvwxyz";
+  PTZ_LOGW("TEST", "%s %s %s %lu", longText, longText, longText, 4000000000ul);
+  const std::vector<uint8_t> bytes = Serial.hostTakeOutput();
+  TEST_ASSERT_EQUAL(7, bytes.size());
+  TEST_ASSERT_EQUAL_UINT8(ptz::kLogFrameSof, bytes[0]);
+  TEST_ASSERT_EQUAL_UINT8(0, bytes[1] | bytes[2] | bytes[3]);
+  const uint32_t token = bytes[4] | (bytes[5] << 8) | (static_cast<uint32_t>(bytes[6]) << 16);
+  TEST_ASSERT_EQUAL_UINT32(ptz::logToken("W", "TEST", "%s %s %s %lu"), token);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_capture_decodes_with_generated_database);
+  RUN_TEST(test_bytes_on_the_wire);
+  RUN_TEST(test_overflowing_arguments_send_the_token_alone);
+  return UNITY_END();
+}
@@ -0,0 +1,71 @@
+// Heap allocation attribution: every allocator entry point the firmware
+// uses is counted against the subsystem in scope on loopTask.
+#include <unity.h>
+
+#include <thread>
+
+#include "ptz_metrics.h"
+
+static ptz::PtzMetrics g_metrics;
+
+// Stored through a volatile so the compiler cannot elide the allocations.
+static void* volatile g_sink = nullptr;
+
+void setUp() {}
+void tearDown() {}
+
+static void test_malloc_calloc_and_realloc_are_counted() {
+  const uint32_t before = g_metrics.allocCount(ptz::kAllocJson);
+  {
+    ptz::AllocScope scope(ptz::kAllocJson);
+    g_sink = malloc(16);
+    free(g_sink);
+    g_sink = calloc(4, 16);
+    g_sink = realloc(g_sink, 256);
+    g_sink = realloc(g_sink, 4096);
+    free(g_sink);
+  }
+  TEST_ASSERT_EQUAL_UINT32(before + 4, g_metrics.allocCount(ptz::kAllocJson));
+}
+
+static void test_scope_restores_previous_subsystem() {
+  const uint32_t log = g_metrics.allocCount(ptz::kAllocLog);
+  const uint32_t ws = g_metrics.allocCount(ptz::kAllocWebSocket);
+  {
+    ptz::AllocScope outer(ptz::kAllocWebSocket);
+    {
+      ptz::AllocScope inner(ptz::kAllocLog);
+      g_sink = calloc(1, 8);
+      free(g_sink);
+    }
+    g_sink = realloc(nullptr, 8);
+    free(g_sink);
+  }
+  TEST_ASSERT_EQUAL_UINT32(log + 1, g_metrics.allocCount(ptz::kAllocLog));
+  TEST_ASSERT_EQUAL_UINT32(ws + 1, g_metrics.allocCount(ptz::kAllocWebSocket));
+}
+
+static void test_other_tasks_are_counted_separately() {
+  const uint32_t json = g_metrics.allocCount(ptz::kAllocJson);
+  const uint32_t tasks = g_metrics.allocCount(ptz::kAllocTasks);
+  std::thread worker([] {
+    g_sink = calloc(2, 32);
+    free(g_sink);
+  });
+  {
+    // The scope only applies to loopTask, whatever the worker is doing.
+    ptz::AllocScope scope(ptz::kAllocJson);
+    worker.join();
+  }
+  TEST_ASSERT_GREATER_OR_EQUAL(tasks + 1, g_metrics.allocCount(ptz::kAllocTasks));
+  TEST_ASSERT_EQUAL_UINT32(json, g_metrics.allocCount(ptz::kAllocJson));
+}
+
+int main() {
+  g_metrics.begin();
+  UNITY_BEGIN();
+  RUN_TEST(test_malloc_calloc_and_realloc_are_counted);
+  RUN_TEST(test_scope_restores_previous_subsystem);
+  RUN_TEST(test_other_tasks_are_counted_separately);
+  return UNITY_END();
+}
@@ -0,0 +1,274 @@
+// Observer load: 16 and 32 read-only clients on one head while a controller
+// streams setVelocity. Every observer must get every status frame, byte for
+// byte the same as every other observer (one serialization, fanned out),
+// without drops or superseded frames, while the loop stays inside its
+// deadline. Also covers switching roles on an open connection and shedding
+// a client that stops reading.
+#include <unity.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "head_rig.h"
+
+// Modelled costs, as in test_soak: a loop pass, each frame received and
+// each frame sent.
+static constexpr uint32_t kPassUs = 150;
+static constexpr uint32_t kReceiveUs = 60;
+static constexpr uint32_t kSendUs = 40;
+static constexpr uint32_t kRunMs = 10000;
+
+struct LoadResult {
+  uint32_t statusFrames = 0;
+  uint32_t loopP99Us = 0;
+  uint32_t loopMaxUs = 0;
+  uint32_t statusJitterP99Us = 0;
+  uint32_t overruns = 0;
+  uint32_t statusIntervalMs = 0;
+};
+
+static std::vector<int> g_connected;
+
+static void disconnectAll() {
+  for (int num : g_connected) {
+    rig::ws().hostClose(static_cast<uint8_t>(num));
+  }
+  g_connected.clear();
+  rig::pass();
+}
+
+static int connect(const char* url) {
+  const int num = rig::ws().hostConnect(url);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, num);
+  g_connected.push_back(num);
+  return num;
+}
+
+// Runs kRunMs with `observers` observers. With a controller, it holds control
+// and streams setVelocity at 50 Hz; without one the head is sent on a long
+// move so status frames keep changing.
+static LoadResult runLoad(uint32_t observers, bool controller) {
+  rig::boot();
+  host::wsReceiveCostUs = kReceiveUs;
+  host::wsSendCostUs = kSendUs;
+
+  int control = -1;
+  if (controller) {
+    control = connect("/ws");
+    JsonDocument reply;
+    TEST_ASSERT_TRUE(rig::request(control, "\"type\":\"requestControl\"", "ack", reply));
+  } else {
+    g_motion.moveAxisTo(ptz::kAxisPan, 200000);
+  }
+  std::vector<int> watchers;
+  for (uint32_t i = 0; i < observers; ++i) {
+    watchers.push_back(connect("/ws?role=observer"));
+  }
+  if (g_connected.size() == WEBSOCKETS_SERVER_CLIENT_MAX) {
+    TEST_ASSERT_EQUAL(-1, rig::ws().hostConnect("/ws?role=observer"));
+  }
+
+  std::vector<std::vector<std::string>> frames(observers);
+  uint32_t acks = 0;
+  uint32_t sent = 0;
+  g_metrics.resetTiming();
+  const uint32_t overrunsBefore = g_deadline.stats().overruns;
+  const uint64_t endUs = host::nowUs + static_cast<uint64_t>(kRunMs) * 1000;
+  uint64_t nextSendUs = host::nowUs;
+  while (host::nowUs < endUs) {
+    if (control >= 0 && host::nowUs >= nextSendUs) {
+      char body[96];
+      snprintf(body, sizeof(body), "\"type\":\"setVelocity\",\"pan\":%.2f,\"tilt\":0,\"zoom\":0",
+               (sent % 200) / 100.0f - 1.0f);
+      rig::send(static_cast<uint8_t>(control), body);
+      ++sent;
+      nextSendUs += 20000;
+    }
+    rig::pass(kPassUs);
+    for (uint32_t i = 0; i < observers; ++i) {
+      const uint8_t num = static_cast<uint8_t>(watchers[i]);
+      rig::ws().hostDrain(num);
+      for (std::string& text : rig::ws().hostTake(num)) {
+        frames[i].push_back(std::move(text));
+      }
+    }
+    if (control >= 0) {
+      rig::ws().hostDrain(static_cast<uint8_t>(control));
+      for (const std::string& text : rig::ws().hostTake(static_cast<uint8_t>(control))) {
+        acks += text.find("\"refType\":\"setVelocity\"") != std::string::npos;
+      }
+    }
+  }
+
+  LoadResult result;
+  result.statusFrames = static_cast<uint32_t>(frames[0].size());
+  result.loopP99Us = g_metrics.loopPeriod().quantile(0.99f);
+  result.loopMaxUs = g_metrics.loopPeriod().max();
+  result.statusJitterP99Us = g_metrics.statusJitter().quantile(0.99f);
+  result.overruns = g_deadline.stats().overruns - overrunsBefore;
+  result.statusIntervalMs = g_deadline.statusIntervalMs();
+
+  for (uint32_t i = 0; i < observers; ++i) {
+    const ptz::ClientTxStats stats = g_ws.txStats(static_cast<uint8_t>(watchers[i]));
+    TEST_ASSERT_TRUE(stats.observer);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.dropped);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.replaced);
+    // Observers only ever receive status, all from the one shared frame.
+    TEST_ASSERT_TRUE(frames[i] == frames[0]);
+  }
+  for (const std::string& text : frames[0]) {
+    TEST_ASSERT_TRUE(text.find("\"type\":\"status\"") != std::string::npos);
+  }
+  if (control >= 0) {
+    TEST_ASSERT_EQUAL_UINT32(sent, acks);
+    TEST_ASSERT_EQUAL_UINT32(static_cast<uint32_t>(control), g_owner.snapshot().controlClientId);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, g_ws.slowDisconnects());
+
+  printf("%2u observers%s: %u status frames in %u ms, loop p99 %u us max %u us, status jitter p99 %u us, %u overruns, "
+         "status every %u ms\n",
+         observers, controller ? " + controller" : "", result.statusFrames, kRunMs, result.loopP99Us, result.loopMaxUs,
+         result.statusJitterP99Us, result.overruns, result.statusIntervalMs);
+
+  g_motion.stop();
+  disconnectAll();
+  host::wsReceiveCostUs = 0;
+  host::wsSendCostUs = 0;
+  return result;
+}
+
+static void checkLoad(const LoadResult& result) {
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(kRunMs / ptz::kStatusIntervalMs - 1, result.statusFrames);
+  TEST_ASSERT_EQUAL_UINT32(ptz::kStatusIntervalMs, result.statusIntervalMs);
+  // The pass that fans a status frame out to every client is the longest.
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(ptz::kLoopDeadlineUs, result.loopMaxUs);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(2000, result.statusJitterP99Us);
+  TEST_ASSERT_EQUAL_UINT32(0, result.overruns);
+}
+
+void setUp() {}
+
+void tearDown() {
+  disconnectAll();
+}
+
+static void test_sixteen_observers_with_controller() {
+  checkLoad(runLoad(16, true));
+}
+
+// Every client slot in the host build is an observer.
+static void test_thirty_two_observers() {
+  checkLoad(runLoad(WEBSOCKETS_SERVER_CLIENT_MAX, false));
+}
+
+// setRole switches an open connection; becoming an observer gives up
+// control, and an observer's control commands are refused.
+static void test_set_role_promotes_and_demotes() {
+  rig::boot();
+  const int client = connect("/ws?role=observer");
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(client, "\"type\":\"requestControl\"", "error", reply));
+  TEST_ASSERT_EQUAL_STRING("observer", reply["code"] | "");
+
+  TEST_ASSERT_TRUE(rig::request(client, "\"type\":\"setRole\",\"role\":\"controller\"", "ack", reply));
+  TEST_ASSERT_EQUAL_STRING("setRole", reply["refType"] | "");
+  TEST_ASSERT_FALSE(g_ws.txStats(static_cast<uint8_t>(client)).observer);
+  TEST_ASSERT_TRUE(rig::request(client, "\"type\":\"requestControl\"", "ack", reply));
+  TEST_ASSERT_EQUAL(ptz::Owner::App, g_owner.owner());
+
+  TEST_ASSERT_TRUE(rig::request(client, "\"type\":\"setRole\",\"role\":\"admin\"", "error", reply));
+  TEST_ASSERT_EQUAL_STRING("invalid_payload", reply["code"] | "");
+  TEST_ASSERT_EQUAL(ptz::Owner::App, g_owner.owner());
+
+  TEST_ASSERT_TRUE(rig::request(client, "\"type\":\"setRole\",\"role\":\"observer\"", "ack", reply));
+  TEST_ASSERT_TRUE(g_ws.txStats(static_cast<uint8_t>(client)).observer);
+  TEST_ASSERT_EQUAL(ptz::Owner::None, g_owner.owner());
+  TEST_ASSERT_TRUE(rig::request(client, "\"type\":\"setVelocity\",\"pan\":0.5,\"tilt\":0,\"zoom\":0", "error", reply));
+  TEST_ASSERT_EQUAL_STRING("observer", reply["code"] | "");
+}
+
+// A controller that stops reading: its status frames replace each other
+// instead of queueing, replies that no longer fit are dropped and counted,
+// and after kWebsocketSlowClientMs it is disconnected and loses control.
+// An observer alongside it sees no gap and the loop no delay.
+static void test_stalled_client_is_shed() {
+  rig::boot();
+  host::wsReceiveCostUs = kReceiveUs;
+  host::wsSendCostUs = kSendUs;
+  const int watcher = connect("/ws?role=observer");
+  const int stalled = connect("/ws");
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(stalled, "\"type\":\"requestControl\"", "ack", reply));
+  rig::ws().hostDrain(static_cast<uint8_t>(watcher));
+  rig::ws().hostTake(static_cast<uint8_t>(watcher));
+  rig::ws().hostTake(static_cast<uint8_t>(stalled));
+  rig::ws().hostStall(static_cast<uint8_t>(stalled));
+
+  const ptz::ClientTxStats before = g_ws.txStats(static_cast<uint8_t>(stalled));
+  const uint32_t slowBefore = g_ws.slowDisconnects();
+  const uint32_t overrunsBefore = g_deadline.stats().overruns;
+  g_metrics.resetTiming();
+  uint32_t watched = 0;
+  uint32_t sent = 0;
+  uint32_t maxQueued = 0;
+  // Runs `ms` with the stalled client streaming setVelocity at 50 Hz.
+  auto run = [&](uint32_t ms) {
+    const uint64_t endUs = host::nowUs + static_cast<uint64_t>(ms) * 1000;
+    uint64_t nextSendUs = host::nowUs;
+    while (host::nowUs < endUs) {
+      if (host::nowUs >= nextSendUs && rig::ws().hostConnected(static_cast<uint8_t>(stalled))) {
+        rig::send(static_cast<uint8_t>(stalled), "\"type\":\"setVelocity\",\"pan\":0.3,\"tilt\":0,\"zoom\":0");
+        ++sent;
+        nextSendUs += 20000;
+      }
+      rig::pass(kPassUs);
+      maxQueued = std::max<uint32_t>(maxQueued, g_ws.txStats(static_cast<uint8_t>(stalled)).queued);
+      rig::ws().hostDrain(static_cast<uint8_t>(watcher));
+      watched += static_cast<uint32_t>(rig::ws().hostTake(static_cast<uint8_t>(watcher)).size());
+    }
+  };
+
+  const uint32_t stallMs = ptz::kWebsocketSlowClientMs - 100;
+  run(stallMs);
+  const ptz::ClientTxStats during = g_ws.txStats(static_cast<uint8_t>(stalled));
+  TEST_ASSERT_TRUE(rig::ws().hostConnected(static_cast<uint8_t>(stalled)));
+  TEST_ASSERT_EQUAL(0, rig::ws().hostTake(static_cast<uint8_t>(stalled)).size());
+  // One pending status frame at a time, each newer one replacing it.
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(before.replaced + stallMs / ptz::kStatusIntervalMs - 2, during.replaced);
+  // Acks fill the reply queue and the rest are dropped, not queued.
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(ptz::kWebsocketTxQueueBytes, maxQueued);
+  TEST_ASSERT_GREATER_THAN_UINT32(before.dropped + sent / 2, during.dropped);
+  TEST_ASSERT_EQUAL_UINT32(slowBefore, g_ws.slowDisconnects());
+  TEST_ASSERT_EQUAL(ptz::Owner::App, g_owner.owner());
+
+  run(500);
+  TEST_ASSERT_FALSE(rig::ws().hostConnected(static_cast<uint8_t>(stalled)));
+  TEST_ASSERT_FALSE(g_ws.txStats(static_cast<uint8_t>(stalled)).connected);
+  TEST_ASSERT_EQUAL_UINT32(slowBefore + 1, g_ws.slowDisconnects());
+  TEST_ASSERT_EQUAL(ptz::Owner::None, g_owner.owner());
+
+  const ptz::ClientTxStats watcherStats = g_ws.txStats(static_cast<uint8_t>(watcher));
+  printf("stalled client: %u status frames replaced, %u replies dropped, %u bytes queued at most; observer got %u "
+         "frames, loop max %u us\n",
+         during.replaced - before.replaced, during.dropped - before.dropped, maxQueued, watched,
+         g_metrics.loopPeriod().max());
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32((stallMs + 500) / ptz::kStatusIntervalMs - 1, watched);
+  TEST_ASSERT_EQUAL_UINT32(0, watcherStats.replaced);
+  TEST_ASSERT_EQUAL_UINT32(0, watcherStats.dropped);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(ptz::kLoopDeadlineUs, g_metrics.loopPeriod().max());
+  TEST_ASSERT_EQUAL_UINT32(overrunsBefore, g_deadline.stats().overruns);
+
+  g_motion.stop();
+  host::wsReceiveCostUs = 0;
+  host::wsSendCostUs = 0;
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sixteen_observers_with_controller);
+  RUN_TEST(test_thirty_two_observers);
+  RUN_TEST(test_set_role_promotes_and_demotes);
+  RUN_TEST(test_stalled_client_is_shed);
+  return UNITY_END();
+}
@@ -0,0 +1,389 @@
+// Network update against a local stand-in HTTP server: the OTA task is a real
+// thread like the ESP32's core 0 task, the head runs loop() passes in
+// virtual time, and the test decides when the server sends, truncates or
+// refuses and when the head moves.
+#include <HTTPClient.h>
+#include <Update.h>
+#include <esp_ota_ops.h>
+#include <mbedtls/sha256.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "head_rig.h"
+
+static constexpr const char* kUrl = "http://192.168.1.2:8000/firmware.bin";
+
+static int g_client = -1;
+static uint64_t g_heartbeatUs = 0;
+
+static std::vector<uint8_t> image(size_t size) {
+  std::vector<uint8_t> bytes(size);
+  uint32_t x = 0x12345678;
+  for (uint8_t& b : bytes) {
+    x = x * 1664525u + 1013904223u;
+    b = static_cast<uint8_t>(x >> 24);
+  }
+  return bytes;
+}
+
+static std::string sha256Hex(const std::vector<uint8_t>& bytes) {
+  mbedtls_sha256_context sha;
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts(&sha, 0);
+  mbedtls_sha256_update(&sha, bytes.data(), bytes.size());
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&sha, digest);
+  char hex[65];
+  for (int i = 0; i < 32; ++i) {
+    snprintf(hex + i * 2, 3, "%02x", digest[i]);
+  }
+  return hex;
+}
+
+static void serve(const std::vector<uint8_t>& body, size_t closeAfter = SIZE_MAX) {
+  host::HttpResponse response;
+  response.body = body;
+  response.closeAfter = closeAfter;
+  host::httpServe(kUrl, response);
+}
+
+static size_t flashed() {
+  std::lock_guard<std::mutex> guard(host::updateLock());
+  return host::updateState().image.size();
+}
+
+// One loop pass by a controller that keeps up and keeps control, then
+// roughly the pass's worth of real time for the OTA thread, which sleeps in
+// real time.
+static void step() {
+  if (host::nowUs - g_heartbeatUs > 500 * 1000) {
+    rig::send(static_cast<uint8_t>(g_client), "\"type\":\"queueStatus\"");
+    g_heartbeatUs = host::nowUs;
+  }
+  rig::pass();
+  rig::ws().hostDrain(static_cast<uint8_t>(g_client));
+  std::this_thread::sleep_for(std::chrono::microseconds(rig::passUs / 2));
+}
+
+// Runs passes until the next motion tick has run; that tick is what tells
+// the download whether the head moves.
+static void motionTick() {
+  rig::pass(ptz::kMotionTickUs);
+  rig::pass();
+}
+
+// Virtual time with a client that keeps up; no real time passes.
+static void idle(uint32_t ms, uint32_t costUs) {
+  const uint64_t endUs = host::nowUs + static_cast<uint64_t>(ms) * 1000;
+  while (host::nowUs < endUs) {
+    rig::pass(costUs);
+    rig::ws().hostDrain(static_cast<uint8_t>(g_client));
+  }
+}
+
+// Runs the head until `done` holds or ten wall-clock seconds pass.
+template <typename Done>
+static bool runUntil(Done done) {
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!done()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    step();
+  }
+  return true;
+}
+
+static bool finished() {
+  return g_ota.status().state != ptz::OtaState::Downloading;
+}
+
+static void startOta(const std::string& sha) {
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(
+      rig::request(g_client, "\"type\":\"otaStart\",\"url\":\"" + std::string(kUrl) + "\",\"sha256\":\"" + sha + "\"",
+                   "ack", reply));
+}
+
+static void drive(float pan) {
+  char body[80];
+  snprintf(body, sizeof(body), "\"type\":\"setVelocity\",\"pan\":%.2f,\"tilt\":0,\"zoom\":0", pan);
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, body, "ack", reply));
+  motionTick();
+}
+
+static void brake() {
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"stop\"", "ack", reply));
+  TEST_ASSERT_TRUE(runUntil([] { return !g_motion.isMoving(); }));
+  motionTick();
+}
+
+static JsonDocument otaStatus() {
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"otaStatus\"", "ota", reply));
+  return reply;
+}
+
+void setUp() {
+  rig::boot();
+  if (g_client < 0) {
+    g_client = rig::ws().hostConnect("/ws");
+  }
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"requestControl\"", "ack", reply));
+  host::httpReset();
+  host::httpSentBytes = SIZE_MAX;
+  std::lock_guard<std::mutex> guard(host::updateLock());
+  host::updateState().image.clear();
+}
+
+void tearDown() {
+  g_ota.abort();
+  host::httpSentBytes = SIZE_MAX;
+  runUntil(finished);
+}
+
+// Booted from an unconfirmed image: it is confirmed after kOtaHealthyMs of
+// uptime with WiFi up, not before.
+static void test_new_image_confirms_after_healthy_uptime() {
+  TEST_ASSERT_TRUE(g_ota.pendingVerify());
+  TEST_ASSERT_TRUE(otaStatus()["pendingVerify"].as<bool>());
+  idle(ptz::kOtaHealthyMs - millis() - 1000, 1000);
+  TEST_ASSERT_EQUAL(0, host::otaMarkedValid);
+  idle(2000, 1000);
+  TEST_ASSERT_EQUAL(1, host::otaMarkedValid);
+  TEST_ASSERT_FALSE(g_ota.pendingVerify());
+}
+
+static void test_download_writes_verified_image() {
+  const std::vector<uint8_t> body = image(200 * 1024);
+  serve(body);
+  const uint64_t startUs = host::nowUs;
+  startOta(sha256Hex(body));
+  TEST_ASSERT_TRUE(runUntil(finished));
+  const uint64_t elapsedMs = (host::nowUs - startUs) / 1000;
+
+  TEST_ASSERT_EQUAL_STRING("ready", ptz::PtzOta::stateName(g_ota.status().state));
+  {
+    std::lock_guard<std::mutex> guard(host::updateLock());
+    TEST_ASSERT_TRUE(host::updateState().finished);
+    TEST_ASSERT_TRUE(host::updateState().image == body);
+  }
+  // Throughput is bytes over the time spent receiving, and every
+  // millisecond of the download is either active or paused.
+  const JsonDocument status = otaStatus();
+  TEST_ASSERT_EQUAL_UINT32(body.size(), status["bytes"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(body.size(), status["total"].as<uint32_t>());
+  const uint32_t activeMs = status["activeMs"].as<uint32_t>();
+  TEST_ASSERT_EQUAL_UINT32(0, status["pausedMs"].as<uint32_t>());
+  TEST_ASSERT_UINT32_WITHIN(20, elapsedMs, activeMs);
+  TEST_ASSERT_EQUAL_UINT32(activeMs ? body.size() / activeMs : 0, status["kBps"].as<uint32_t>());
+}
+
+static void test_sha_mismatch_leaves_partition_unbootable() {
+  const std::vector<uint8_t> body = image(64 * 1024);
+  serve(body);
+  std::vector<uint8_t> other = body;
+  other[1000] ^= 1;
+  startOta(sha256Hex(other));
+  TEST_ASSERT_TRUE(runUntil(finished));
+
+  const JsonDocument status = otaStatus();
+  TEST_ASSERT_EQUAL_STRING("failed", status["state"] | "");
+  TEST_ASSERT_EQUAL_STRING("sha256", status["error"] | "");
+  {
+    std::lock_guard<std::mutex> guard(host::updateLock());
+    TEST_ASSERT_TRUE(host::updateState().aborted);
+    TEST_ASSERT_FALSE(host::updateState().finished);
+  }
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"otaReboot\"", "error", reply));
+  TEST_ASSERT_EQUAL_STRING("ota_not_ready", reply["code"] | "");
+}
+
+static void test_truncated_download_fails() {
+  const std::vector<uint8_t> body = image(64 * 1024);
+  serve(body, 40 * 1024);
+  startOta(sha256Hex(body));
+  TEST_ASSERT_TRUE(runUntil(finished));
+  const JsonDocument status = otaStatus();
+  TEST_ASSERT_EQUAL_STRING("truncated", status["error"] | "");
+  TEST_ASSERT_EQUAL_UINT32(40 * 1024, status["bytes"].as<uint32_t>());
+}
+
+static void test_refused_and_missing_images_fail() {
+  const std::vector<uint8_t> body = image(4096);
+  startOta(sha256Hex(body));
+  TEST_ASSERT_TRUE(runUntil(finished));
+  TEST_ASSERT_EQUAL_STRING("http", g_ota.status().error);
+
+  host::HttpResponse missing;
+  missing.code = HTTP_CODE_NOT_FOUND;
+  host::httpServe(kUrl, missing);
+  startOta(sha256Hex(body));
+  TEST_ASSERT_TRUE(runUntil(finished));
+  TEST_ASSERT_EQUAL_STRING("http", g_ota.status().error);
+
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"otaStart\",\"url\":\"http://x/fw.bin\",\"sha256\":\"abc\"",
+                                "error", reply));
+  TEST_ASSERT_EQUAL_STRING("ota_failed", reply["code"] | "");
+}
+
+// Nothing reaches flash while the head moves; the time waiting is reported
+// as paused, and the download completes once the head is at rest.
+static void test_download_pauses_while_moving() {
+  const std::vector<uint8_t> body = image(128 * 1024);
+  serve(body);
+  drive(0.5f);
+  TEST_ASSERT_TRUE(runUntil([] { return g_motion.isMoving(); }));
+
+  startOta(sha256Hex(body));
+  TEST_ASSERT_TRUE(runUntil([] { return g_ota.status().pausedMs >= 300; }));
+  TEST_ASSERT_EQUAL(0, flashed());
+  JsonDocument status = otaStatus();
+  TEST_ASSERT_EQUAL_STRING("downloading", status["state"] | "");
+  TEST_ASSERT_EQUAL_UINT32(0, status["bytes"].as<uint32_t>());
+
+  brake();
+  TEST_ASSERT_TRUE(runUntil(finished));
+  status = otaStatus();
+  TEST_ASSERT_EQUAL_STRING("ready", status["state"] | "");
+  TEST_ASSERT_GREATER_OR_EQUAL(300, status["pausedMs"].as<uint32_t>());
+  TEST_ASSERT_GREATER_THAN(0, status["activeMs"].as<uint32_t>());
+  TEST_ASSERT_TRUE(flashed() == body.size());
+}
+
+// A move that starts while data is flowing lets at most the chunk already in
+// hand reach flash once the motion tick has told the download.
+static void test_move_mid_download_stops_flash_writes_within_a_chunk() {
+  const std::vector<uint8_t> body = image(512 * 1024);
+  serve(body);
+  host::httpSentBytes = 0;
+  startOta(sha256Hex(body));
+
+  // The server stays 8 kB ahead of flash, so data is waiting when the move
+  // starts.
+  auto feed = [&] { host::httpSentBytes = std::min(flashed() + 8 * 1024, body.size()); };
+  TEST_ASSERT_TRUE(runUntil([&] {
+    feed();
+    return flashed() >= 64 * 1024;
+  }));
+  rig::send(static_cast<uint8_t>(g_client), "\"type\":\"setVelocity\",\"pan\":0.5,\"tilt\":0,\"zoom\":0");
+  TEST_ASSERT_TRUE(runUntil([&] {
+    feed();
+    return g_motion.isMoving();
+  }));
+  motionTick();
+  const size_t atGate = flashed();
+  for (int i = 0; i < 2000; ++i) {
+    feed();
+    step();
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(ptz::kOtaChunkBytes, flashed() - atGate);
+  TEST_ASSERT_GREATER_OR_EQUAL(4096, host::httpSentBytes.load() - flashed());
+
+  host::httpSentBytes = SIZE_MAX;
+  brake();
+  TEST_ASSERT_TRUE(runUntil(finished));
+  TEST_ASSERT_EQUAL_STRING("ready", ptz::PtzOta::stateName(g_ota.status().state));
+}
+
+static void test_abort_stops_download() {
+  const std::vector<uint8_t> body = image(64 * 1024);
+  serve(body);
+  host::httpSentBytes = 8 * 1024;
+  startOta(sha256Hex(body));
+  TEST_ASSERT_TRUE(runUntil([] { return flashed() == 8 * 1024; }));
+
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"otaAbort\"", "ack", reply));
+  TEST_ASSERT_TRUE(runUntil(finished));
+  TEST_ASSERT_EQUAL_STRING("aborted", g_ota.status().error);
+  std::lock_guard<std::mutex> guard(host::updateLock());
+  TEST_ASSERT_TRUE(host::updateState().aborted);
+}
+
+// The claim behind running on core 0: the download costs the control loop
+// nothing but a status read per pass. loop() is timed on the wall clock
+// with the head idle and again while a 1 MB image streams in on the other
+// thread; the median pass must not move.
+static void test_download_does_not_slow_the_loop() {
+  constexpr int kPasses = 20000;
+  const std::vector<uint8_t> body = image(1024 * 1024);
+  serve(body);
+
+  auto timePasses = [&](bool feed) {
+    std::vector<uint32_t> ns;
+    ns.reserve(kPasses);
+    for (int i = 0; i < kPasses; ++i) {
+      if (feed) {
+        host::httpSentBytes = static_cast<size_t>(i + 1) * body.size() / kPasses;
+      }
+      const auto start = std::chrono::steady_clock::now();
+      loop();
+      const auto end = std::chrono::steady_clock::now();
+      ns.push_back(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+      host::advanceUs(rig::passUs);
+      rig::ws().hostDrain(static_cast<uint8_t>(g_client));
+      if (i % 2000 == 0) {
+        rig::send(static_cast<uint8_t>(g_client), "\"type\":\"queueStatus\""); // heartbeat
+      }
+    }
+    std::sort(ns.begin(), ns.end());
+    return std::make_pair(ns[ns.size() / 2], ns[ns.size() * 99 / 100]);
+  };
+
+  const auto idle = timePasses(false);
+  host::httpSentBytes = 0;
+  startOta(sha256Hex(body));
+  const auto busy = timePasses(true);
+  const size_t streamed = flashed();
+  host::httpSentBytes = SIZE_MAX;
+  TEST_ASSERT_TRUE(runUntil(finished));
+
+  printf("loop() wall time idle p50 %.2f us p99 %.2f us, downloading p50 %.2f us p99 %.2f us (%zu kB during)\n",
+         idle.first / 1000.0, idle.second / 1000.0, busy.first / 1000.0, busy.second / 1000.0, streamed / 1024);
+  TEST_ASSERT_GREATER_THAN(body.size() / 2, streamed);
+  TEST_ASSERT_EQUAL_STRING("ready", ptz::PtzOta::stateName(g_ota.status().state));
+  TEST_ASSERT_LESS_OR_EQUAL(idle.first * 3 / 2 + 2000, busy.first);
+}
+
+static void test_reboot_waits_for_rest() {
+  const std::vector<uint8_t> body = image(16 * 1024);
+  serve(body);
+  startOta(sha256Hex(body));
+  TEST_ASSERT_TRUE(runUntil(finished));
+
+  drive(0.5f);
+  TEST_ASSERT_TRUE(runUntil([] { return g_motion.isMoving(); }));
+  const uint32_t before = host::restarts;
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"otaReboot\"", "ack", reply));
+  TEST_ASSERT_EQUAL(before, host::restarts);
+  brake();
+  TEST_ASSERT_GREATER_THAN(before, host::restarts);
+}
+
+int main() {
+  host::otaImageState = ESP_OTA_IMG_PENDING_VERIFY;
+  UNITY_BEGIN();
+  RUN_TEST(test_new_image_confirms_after_healthy_uptime);
+  RUN_TEST(test_download_writes_verified_image);
+  RUN_TEST(test_sha_mismatch_leaves_partition_unbootable);
+  RUN_TEST(test_truncated_download_fails);
+  RUN_TEST(test_refused_and_missing_images_fail);
+  RUN_TEST(test_download_pauses_while_moving);
+  RUN_TEST(test_move_mid_download_stops_flash_writes_within_a_chunk);
+  RUN_TEST(test_abort_stops_download);
+  RUN_TEST(test_download_does_not_slow_the_loop);
+  RUN_TEST(test_reboot_waits_for_rest);
+  return UNITY_END();
+}
@@ -0,0 +1,172 @@
+// Driver power per axis: the idle timeout under each hold rule (Free,
+// WhileOwned, Always), the kAxisWakeUs hold on the first step after a
+// sleeping driver is woken, and the energized time updatePower accounts.
+#include <unity.h>
+
+#include "ptz_motion.h"
+
+static constexpr uint32_t kIdleMs = 500;
+static constexpr uint32_t kRunUs = 50; // run() spacing, well under a step at maxSps
+
+// Runs the control loop for `ms`: run() every kRunUs, update() and
+// updatePower() every millisecond, as loop() does.
+static void runForMs(ptz::PtzMotion& motion, uint32_t ms, bool owned) {
+  for (uint32_t i = 0; i < ms; ++i) {
+    for (uint32_t us = 0; us < 1000; us += kRunUs) {
+      host::advanceUs(kRunUs);
+      motion.run();
+    }
+    motion.update(0.001f);
+    motion.updatePower(millis(), owned);
+  }
+}
+
+// Runs until the axis is de-energized; returns the milliseconds that took,
+// or limitMs when it stayed on.
+static uint32_t msUntilAsleep(ptz::PtzMotion& motion, uint8_t axis, bool owned, uint32_t limitMs) {
+  for (uint32_t ms = 0; ms < limitMs; ++ms) {
+    if (!motion.axisEnabled(axis)) {
+      return ms;
+    }
+    runForMs(motion, 1, owned);
+  }
+  return limitMs;
+}
+
+// Microseconds from now to the axis's first step, or limitUs.
+static uint32_t usUntilFirstStep(ptz::PtzMotion& motion, uint8_t axis, uint32_t limitUs) {
+  const float start = motion.state().pos[axis];
+  const uint32_t sinceUs = micros();
+  uint32_t nextUpdateUs = sinceUs + 1000;
+  while (micros() - sinceUs < limitUs) {
+    host::advanceUs(kRunUs);
+    motion.run();
+    if (motion.state().pos[axis] != start) {
+      return micros() - sinceUs;
+    }
+    if (static_cast<int32_t>(micros() - nextUpdateUs) >= 0) {
+      nextUpdateUs += 1000;
+      motion.update(0.001f);
+    }
+  }
+  return limitUs;
+}
+
+void setUp() {
+  host::setTimeUs(10000000);
+}
+
+void tearDown() {}
+
+// The shipped table keeps every driver energized, as before per-axis power.
+static void test_default_table_never_sleeps() {
+  ptz::PtzMotion motion;
+  motion.begin();
+  motion.setEnabled(true);
+  runForMs(motion, 60000, false);
+  for (uint8_t axis = 0; axis < ptz::kAxisCount; ++axis) {
+    TEST_ASSERT_EQUAL_UINT32(0, ptz::kAxes[axis].idleMs);
+    TEST_ASSERT_TRUE_MESSAGE(motion.axisEnabled(axis), ptz::kAxes[axis].name);
+  }
+}
+
+// Free sleeps kIdleMs after the axis stops, owned or not, and never while
+// it moves however long the move takes.
+static void test_free_sleeps_after_idle_timeout() {
+  ptz::PtzMotion motion;
+  motion.begin();
+  motion.setAxisPower(ptz::kAxisZoom, kIdleMs, ptz::AxisHold::Free);
+  motion.moveAxisTo(ptz::kAxisZoom, 4000.0f);
+  uint32_t movingMs = 0;
+  while (motion.isMoving()) {
+    TEST_ASSERT_TRUE(motion.axisEnabled(ptz::kAxisZoom));
+    runForMs(motion, 1, true);
+    ++movingMs;
+  }
+  TEST_ASSERT_GREATER_THAN(kIdleMs, movingMs);
+  TEST_ASSERT_EQUAL_FLOAT(4000.0f, motion.state().pos[ptz::kAxisZoom]);
+  TEST_ASSERT_UINT32_WITHIN(2, kIdleMs, msUntilAsleep(motion, ptz::kAxisZoom, true, 2 * kIdleMs));
+}
+
+// WhileOwned stays on as long as anyone controls the head and sleeps
+// kIdleMs after control is released.
+static void test_while_owned_sleeps_only_once_released() {
+  ptz::PtzMotion motion;
+  motion.begin();
+  motion.setAxisPower(ptz::kAxisPan, kIdleMs, ptz::AxisHold::WhileOwned);
+  motion.setAxisEnabled(ptz::kAxisPan, true);
+  runForMs(motion, 4 * kIdleMs, true);
+  TEST_ASSERT_TRUE(motion.axisEnabled(ptz::kAxisPan));
+  TEST_ASSERT_UINT32_WITHIN(2, kIdleMs, msUntilAsleep(motion, ptz::kAxisPan, false, 2 * kIdleMs));
+}
+
+// Always never sleeps on its own; an explicit disable still turns it off.
+static void test_always_holds() {
+  ptz::PtzMotion motion;
+  motion.begin();
+  motion.setAxisPower(ptz::kAxisTilt, kIdleMs, ptz::AxisHold::Always);
+  motion.setAxisEnabled(ptz::kAxisTilt, true);
+  TEST_ASSERT_EQUAL_UINT32(4 * kIdleMs, msUntilAsleep(motion, ptz::kAxisTilt, false, 4 * kIdleMs));
+  motion.setEnabled(false);
+  TEST_ASSERT_FALSE(motion.axisEnabled(ptz::kAxisTilt));
+}
+
+// A move to a sleeping axis energizes it at once but holds the first step
+// for kAxisWakeUs, for position moves and velocity drives alike; an axis
+// woken ahead of time steps without that wait.
+static void test_first_step_waits_for_wake() {
+  ptz::PtzMotion motion;
+  motion.begin();
+  TEST_ASSERT_FALSE(motion.enabled());
+
+  motion.moveAxisTo(ptz::kAxisZoom, 100.0f);
+  TEST_ASSERT_TRUE(motion.axisEnabled(ptz::kAxisZoom));
+  const uint32_t moveUs = usUntilFirstStep(motion, ptz::kAxisZoom, 20000);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(ptz::kAxisWakeUs, moveUs);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(ptz::kAxisWakeUs + 1000, moveUs);
+
+  motion.setAxisVelocity(ptz::kAxisPan, 1.0f);
+  TEST_ASSERT_TRUE(motion.axisEnabled(ptz::kAxisPan));
+  const uint32_t driveUs = usUntilFirstStep(motion, ptz::kAxisPan, 20000);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(ptz::kAxisWakeUs, driveUs);
+  // The ramp starts after the wake, so the first steps come from standstill.
+  TEST_ASSERT_LESS_OR_EQUAL_FLOAT(ptz::kAxes[ptz::kAxisPan].slewSps2 * 0.002f, fabsf(motion.stepRate(ptz::kAxisPan)));
+
+  motion.setAxisEnabled(ptz::kAxisTilt, true);
+  runForMs(motion, 5, true);
+  motion.moveAxisTo(ptz::kAxisTilt, -100.0f);
+  TEST_ASSERT_LESS_THAN_UINT32(ptz::kAxisWakeUs, usUntilFirstStep(motion, ptz::kAxisTilt, 20000));
+}
+
+// energizedMs adds up the time each driver was on, across sleep and wake.
+static void test_energized_time_accounting() {
+  ptz::PtzMotion motion;
+  motion.begin();
+  motion.updatePower(millis(), false);
+  motion.setAxisPower(ptz::kAxisZoom, kIdleMs, ptz::AxisHold::Free);
+  motion.setAxisPower(ptz::kAxisTilt, kIdleMs, ptz::AxisHold::Always);
+  motion.setAxisEnabled(ptz::kAxisZoom, true);
+  motion.setAxisEnabled(ptz::kAxisTilt, true);
+
+  runForMs(motion, 3 * kIdleMs, false);
+  TEST_ASSERT_FALSE(motion.axisEnabled(ptz::kAxisZoom));
+  TEST_ASSERT_UINT32_WITHIN(2, kIdleMs, motion.energizedMs(ptz::kAxisZoom));
+  TEST_ASSERT_UINT32_WITHIN(2, 3 * kIdleMs, motion.energizedMs(ptz::kAxisTilt));
+  TEST_ASSERT_EQUAL_UINT32(0, motion.energizedMs(ptz::kAxisPan));
+
+  motion.setAxisEnabled(ptz::kAxisZoom, true);
+  runForMs(motion, 3 * kIdleMs, false);
+  TEST_ASSERT_UINT32_WITHIN(4, 2 * kIdleMs, motion.energizedMs(ptz::kAxisZoom));
+  TEST_ASSERT_UINT32_WITHIN(2, 6 * kIdleMs, motion.energizedMs(ptz::kAxisTilt));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_default_table_never_sleeps);
+  RUN_TEST(test_free_sleeps_after_idle_timeout);
+  RUN_TEST(test_while_owned_sleeps_only_once_released);
+  RUN_TEST(test_always_holds);
+  RUN_TEST(test_first_step_waits_for_wake);
+  RUN_TEST(test_energized_time_accounting);
+  return UNITY_END();
+}
@@ -0,0 +1,228 @@
+// Rate-group scheduler on a virtual clock: the clock is a counter the test
+// advances between polls and the callbacks advance to model their cost, so
+// every due time, lateness and overrun is exact.
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "ptz_rates.h"
+
+static uint32_t g_nowUs = 0;
+
+static uint32_t virtualClock() {
+  return g_nowUs;
+}
+
+struct Call {
+  char task;
+  uint32_t dueUs;
+  uint32_t atUs;
+};
+
+static std::vector<Call> g_calls;
+static uint32_t g_costUs[4] = {};
+
+template <char Name, int Cost>
+static void record(uint32_t dueUs) {
+  g_calls.push_back(Call{Name, dueUs, g_nowUs});
+  g_nowUs += g_costUs[Cost];
+}
+
+static std::string order() {
+  std::string names;
+  for (const Call& call : g_calls) {
+    names += call.task;
+  }
+  return names;
+}
+
+static std::vector<uint32_t> dueTimes(char task) {
+  std::vector<uint32_t> due;
+  for (const Call& call : g_calls) {
+    if (call.task == task) {
+      due.push_back(call.dueUs);
+    }
+  }
+  return due;
+}
+
+// Polls every stepUs until untilUs, like loop() passes of a fixed cost.
+static void runUntil(ptz::PtzRateGroups& rates, uint32_t untilUs, uint32_t stepUs = 100) {
+  while (static_cast<int32_t>(untilUs - g_nowUs) > 0) {
+    rates.poll();
+    g_nowUs += stepUs;
+  }
+}
+
+void setUp() {
+  g_nowUs = 1000000;
+  g_calls.clear();
+  for (uint32_t& cost : g_costUs) {
+    cost = 0;
+  }
+}
+
+void tearDown() {}
+
+// Each group runs at its own fixed rate with due times a whole period apart,
+// however the polls fall.
+static void test_groups_run_at_fixed_rates() {
+  ptz::PtzRateGroups rates;
+  rates.begin(&virtualClock);
+  rates.add("motion", 1000, 0, 50, &record<'m', 0>);
+  rates.add("gamepad", 4000, 1, 0, &record<'g', 0>);
+  rates.add("housekeeping", 100000, 4, 0, &record<'h', 0>);
+  const uint32_t startUs = g_nowUs;
+  runUntil(rates, startUs + 1000000, 70);
+
+  const uint32_t periods[] = {1000, 4000, 100000};
+  const char names[] = {'m', 'g', 'h'};
+  for (int i = 0; i < 3; ++i) {
+    const std::vector<uint32_t> due = dueTimes(names[i]);
+    TEST_ASSERT_EQUAL(1000000 / periods[i], due.size());
+    for (uint32_t n = 0; n < due.size(); ++n) {
+      TEST_ASSERT_EQUAL_UINT32(startUs + n * periods[i], due[n]);
+    }
+    const ptz::RateTaskInfo info = rates.info(static_cast<uint8_t>(i));
+    TEST_ASSERT_EQUAL_UINT32(due.size(), info.stats.runs);
+    TEST_ASSERT_EQUAL_UINT32(0, info.stats.skipped);
+    TEST_ASSERT_LESS_THAN_UINT32(70, info.stats.maxLateUs);
+  }
+}
+
+// Everything due runs highest priority first, whatever the registration
+// order, and a task that falls due again during a slower one goes first.
+static void test_priority_order() {
+  ptz::PtzRateGroups rates;
+  rates.begin(&virtualClock);
+  rates.add("status", 50000, 3, 0, &record<'s', 1>);
+  rates.add("motion", 1000, 0, 50, &record<'m', 0>);
+  rates.add("gamepad", 4000, 1, 0, &record<'g', 2>);
+  g_costUs[1] = 2500; // status spans two motion ticks
+  rates.poll();
+  TEST_ASSERT_EQUAL_STRING("mgsmm", order().c_str());
+  TEST_ASSERT_EQUAL_UINT32(1500, rates.info(1).stats.maxLateUs);
+}
+
+// After a stall a task runs its oldest due period, then replays up to
+// maxCatchUp of the most recent ones; the periods between are dropped whole,
+// so the phase is kept.
+static void test_stall_catch_up_and_skip() {
+  ptz::PtzRateGroups rates;
+  rates.begin(&virtualClock);
+  rates.add("motion", 1000, 0, 5, &record<'m', 0>);
+  rates.add("gamepad", 4000, 1, 0, &record<'g', 0>);
+  const uint32_t startUs = g_nowUs;
+  rates.poll();
+  g_calls.clear();
+
+  g_nowUs = startUs + 20500; // 20.5 ms stall
+  runUntil(rates, g_nowUs + 150);
+  const std::vector<uint32_t> due = dueTimes('m');
+  // Polls are capped at kRatePollBurst runs per task, so the catch-up spreads
+  // over two passes here.
+  TEST_ASSERT_EQUAL(6, due.size());
+  TEST_ASSERT_EQUAL_UINT32(startUs + 1000, due[0]);
+  for (uint32_t n = 1; n < due.size(); ++n) {
+    TEST_ASSERT_EQUAL_UINT32(startUs + (15 + n) * 1000, due[n]);
+  }
+  TEST_ASSERT_EQUAL_UINT32(14, rates.info(0).stats.skipped);
+  TEST_ASSERT_EQUAL_UINT32(19500, rates.info(0).stats.maxLateUs);
+  // No catch-up for gamepad: one run, on its own phase.
+  TEST_ASSERT_EQUAL(1, dueTimes('g').size());
+  TEST_ASSERT_EQUAL_UINT32(startUs + 4000, dueTimes('g')[0]);
+  TEST_ASSERT_EQUAL_UINT32(4, rates.info(1).stats.skipped);
+  g_calls.clear();
+  runUntil(rates, startUs + 24001);
+  TEST_ASSERT_EQUAL_UINT32(startUs + 24000, dueTimes('g')[0]);
+}
+
+static void test_burst_limit_per_poll() {
+  ptz::PtzRateGroups rates;
+  rates.begin(&virtualClock);
+  rates.add("motion", 1000, 0, 50, &record<'m', 0>);
+  g_nowUs += 10000;
+  TEST_ASSERT_EQUAL(ptz::kRatePollBurst, rates.poll());
+  TEST_ASSERT_EQUAL(ptz::kRatePollBurst, rates.poll());
+  TEST_ASSERT_EQUAL(11 - 2 * ptz::kRatePollBurst, rates.poll());
+  TEST_ASSERT_EQUAL(0, rates.poll());
+}
+
+static void test_run_time_and_overrun_stats() {
+  ptz::PtzRateGroups rates;
+  rates.begin(&virtualClock);
+  rates.add("record", 10000, 2, 0, &record<'r', 3>);
+  g_costUs[3] = 3000;
+  runUntil(rates, g_nowUs + 30000);
+  g_costUs[3] = 12000;
+  rates.poll();
+  ptz::RateTaskStats stats = rates.info(0).stats;
+  TEST_ASSERT_EQUAL_UINT32(4, stats.runs);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.overruns);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.skipped);
+  TEST_ASSERT_EQUAL_UINT32(12000, stats.maxRunUs);
+  TEST_ASSERT_EQUAL_UINT32(3 * 3000 + 12000, static_cast<uint32_t>(stats.totalRunUs));
+
+  rates.resetStats();
+  stats = rates.info(0).stats;
+  TEST_ASSERT_EQUAL_UINT32(0, stats.runs);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.maxRunUs);
+}
+
+// A new status rate applies from the next due time.
+static void test_set_period() {
+  ptz::PtzRateGroups rates;
+  rates.begin(&virtualClock);
+  const int8_t id = rates.add("status", 100000, 3, 0, &record<'s', 0>);
+  const uint32_t startUs = g_nowUs;
+  rates.poll();
+  rates.setPeriod(id, 20000);
+  runUntil(rates, startUs + 160001);
+  const std::vector<uint32_t> due = dueTimes('s');
+  TEST_ASSERT_EQUAL(5, due.size());
+  for (uint32_t n = 1; n < due.size(); ++n) {
+    TEST_ASSERT_EQUAL_UINT32(startUs + 100000 + (n - 1) * 20000, due[n]);
+  }
+}
+
+// The 32-bit microsecond clock wraps every 71 minutes.
+static void test_clock_wrap_keeps_phase() {
+  g_nowUs = 0xFFFFFFFFu - 2500;
+  ptz::PtzRateGroups rates;
+  rates.begin(&virtualClock);
+  rates.add("motion", 1000, 0, 50, &record<'m', 0>);
+  const uint32_t startUs = g_nowUs;
+  runUntil(rates, startUs + 6000);
+  const std::vector<uint32_t> due = dueTimes('m');
+  TEST_ASSERT_EQUAL(6, due.size());
+  for (uint32_t n = 0; n < due.size(); ++n) {
+    TEST_ASSERT_EQUAL_UINT32(startUs + n * 1000, due[n]);
+  }
+}
+
+static void test_add_refuses_bad_tasks() {
+  ptz::PtzRateGroups rates;
+  TEST_ASSERT_EQUAL(-1, rates.add("early", 1000, 0, 0, &record<'x', 0>)); // no clock yet
+  rates.begin(&virtualClock);
+  TEST_ASSERT_EQUAL(-1, rates.add("zero", 0, 0, 0, &record<'x', 0>));
+  TEST_ASSERT_EQUAL(-1, rates.add("none", 1000, 0, 0, nullptr));
+  for (uint8_t i = 0; i < ptz::kRateMaxTasks; ++i) {
+    TEST_ASSERT_EQUAL(i, rates.add("task", 1000, 0, 0, &record<'x', 0>));
+  }
+  TEST_ASSERT_EQUAL(-1, rates.add("full", 1000, 0, 0, &record<'x', 0>));
+  TEST_ASSERT_EQUAL(ptz::kRateMaxTasks, rates.count());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_groups_run_at_fixed_rates);
+  RUN_TEST(test_priority_order);
+  RUN_TEST(test_stall_catch_up_and_skip);
+  RUN_TEST(test_burst_limit_per_poll);
+  RUN_TEST(test_run_time_and_overrun_stats);
+  RUN_TEST(test_set_period);
+  RUN_TEST(test_clock_wrap_keeps_phase);
+  RUN_TEST(test_add_refuses_bad_tasks);
+  return UNITY_END();
+}
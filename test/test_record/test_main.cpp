@@ -0,0 +1,208 @@
+// Recording stream and export: the run-length/zigzag encoding PtzRecorder
+// writes, decoded the way tools/record_export.py decodes it, and the
+// exportRecording chunks a host reassembles it from.
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "head_rig.h"
+
+using Sample = std::vector<int32_t>; // quantized velocity per axis
+
+static int g_client = -1;
+
+// The decoder in tools/record_export.py, tick for tick.
+static std::vector<Sample> decodeStream(const uint8_t* data, size_t size, uint32_t ticks) {
+  std::vector<Sample> out;
+  Sample prev(ptz::kAxisCount, 0);
+  size_t pos = 0;
+  while (out.size() < ticks) {
+    TEST_ASSERT_LESS_THAN(size, pos);
+    const uint8_t tag = data[pos++];
+    if (tag < 0x80) {
+      out.insert(out.end(), tag + 1u, prev);
+      continue;
+    }
+    for (uint8_t axis = 0; axis < ptz::kAxisCount; ++axis) {
+      if (!(tag & (1u << axis))) {
+        continue;
+      }
+      uint32_t zz = 0;
+      uint8_t shift = 0;
+      uint8_t byte = 0;
+      do {
+        TEST_ASSERT_LESS_THAN(size, pos);
+        byte = data[pos++];
+        zz |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        shift += 7;
+      } while (byte & 0x80);
+      prev[axis] += static_cast<int32_t>(zz >> 1) ^ -static_cast<int32_t>(zz & 1);
+    }
+    out.push_back(prev);
+  }
+  TEST_ASSERT_EQUAL(size, pos);
+  TEST_ASSERT_EQUAL(ticks, out.size());
+  return out;
+}
+
+static Sample quantized(const float (&norm)[ptz::kAxisCount]) {
+  Sample sample(ptz::kAxisCount);
+  for (uint8_t axis = 0; axis < ptz::kAxisCount; ++axis) {
+    sample[axis] = static_cast<int32_t>(lroundf(norm[axis] * ptz::kRecordQuantization));
+  }
+  return sample;
+}
+
+// Velocity for record tick n: holds longer than one run byte covers, steps
+// of every size (one-byte and multi-byte varints, both signs) and ticks
+// where only some axes change.
+static void profileAt(uint32_t n, float (&norm)[ptz::kAxisCount]) {
+  for (uint8_t axis = 0; axis < ptz::kAxisCount; ++axis) {
+    norm[axis] = 0.0f;
+  }
+  if (n < 40) {
+    return;
+  }
+  if (n < 340) {
+    norm[ptz::kAxisPan] = 1.0f; // a 300-tick hold
+    return;
+  }
+  if (n < 400) {
+    norm[ptz::kAxisPan] = -1.0f + (n - 340) / 30.0f;
+    norm[ptz::kAxisTilt] = (n % 7) / 7.0f - 0.5f;
+    return;
+  }
+  if (n < 460) {
+    norm[ptz::kAxisZoom] = (n % 2) ? 0.001f : -0.001f;
+    return;
+  }
+  norm[ptz::kAxisTilt] = -0.25f;
+}
+
+static std::vector<JsonDocument> exportChunks(uint8_t slot) {
+  std::vector<JsonDocument> chunks;
+  uint32_t offset = 0;
+  for (;;) {
+    JsonDocument reply;
+    TEST_ASSERT_TRUE(rig::request(static_cast<uint8_t>(g_client),
+                                  "\"type\":\"exportRecording\",\"slot\":" + std::to_string(slot) +
+                                      ",\"offset\":" + std::to_string(offset),
+                                  "recording", reply));
+    TEST_ASSERT_EQUAL_UINT32(offset, reply["offset"].as<uint32_t>());
+    const size_t hexLength = strlen(reply["data"] | "");
+    chunks.push_back(reply);
+    offset += hexLength / 2;
+    if (hexLength == 0 || offset >= reply["size"].as<uint32_t>()) {
+      return chunks;
+    }
+  }
+}
+
+static std::vector<uint8_t> unhex(const std::vector<JsonDocument>& chunks) {
+  std::vector<uint8_t> bytes;
+  for (const JsonDocument& chunk : chunks) {
+    const std::string hex = chunk["data"] | "";
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+      bytes.push_back(static_cast<uint8_t>(std::stoul(hex.substr(i, 2), nullptr, 16)));
+    }
+  }
+  return bytes;
+}
+
+void setUp() {
+  rig::boot();
+  if (g_client < 0) {
+    g_client = rig::ws().hostConnect("/ws");
+  }
+}
+
+void tearDown() {}
+
+// Every recorded tick decodes back to the quantized command it recorded.
+static void test_stream_round_trips() {
+  ptz::PtzOwner owner;
+  ptz::PtzMotion motion;
+  motion.begin();
+  ptz::PtzRecorder recorder;
+  recorder.begin(&owner, &motion);
+  TEST_ASSERT_TRUE(recorder.startRecording(2));
+
+  std::vector<Sample> expected;
+  const uint32_t ticks = 600;
+  for (uint32_t n = 0; n < ticks; ++n) {
+    float norm[ptz::kAxisCount];
+    profileAt(n, norm);
+    motion.setVelocity(norm);
+    expected.push_back(quantized(norm));
+    recorder.tick(millis());
+  }
+  recorder.stopRecording();
+
+  const ptz::RecordingInfo info = recorder.info(2);
+  TEST_ASSERT_TRUE(info.valid);
+  TEST_ASSERT_EQUAL_UINT32(ticks, info.ticks);
+  const std::vector<Sample> decoded = decodeStream(recorder.data(2), info.bytes, info.ticks);
+  for (uint32_t n = 0; n < ticks; ++n) {
+    TEST_ASSERT_EQUAL_INT32_ARRAY(expected[n].data(), decoded[n].data(), ptz::kAxisCount);
+  }
+  // Runs and deltas keep the stream well under one byte per tick.
+  TEST_ASSERT_LESS_THAN(ticks, info.bytes);
+}
+
+// Chunks requested at successive offsets reassemble the slot byte for byte.
+static void test_export_reassembles_the_slot() {
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"requestControl\"", "ack", reply));
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"recordStart\",\"slot\":0", "ack", reply));
+  for (int n = 0; n < 120; ++n) {
+    const float pan = (n * 37 % 61) / 61.0f - 0.5f;
+    const float tilt = (n * 17 % 23) / 23.0f - 0.5f;
+    rig::send(g_client, "\"type\":\"setVelocity\",\"pan\":" + std::to_string(pan) +
+                            ",\"tilt\":" + std::to_string(tilt) + ",\"zoom\":0");
+    rig::runForMs(ptz::kRecordTickUs / 1000);
+    rig::ws().hostDrain(g_client);
+    rig::ws().hostTake(g_client);
+  }
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"recordStop\"", "ack", reply));
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"stop\"", "ack", reply));
+
+  const ptz::RecordingInfo info = g_recorder.info(0);
+  TEST_ASSERT_GREATER_THAN(ptz::kRecordExportChunkBytes, info.bytes);
+  const std::vector<JsonDocument> chunks = exportChunks(0);
+  TEST_ASSERT_GREATER_THAN(1, chunks.size());
+  const std::vector<uint8_t> bytes = unhex(chunks);
+  TEST_ASSERT_EQUAL(info.bytes, bytes.size());
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(g_recorder.data(0), bytes.data(), info.bytes);
+  TEST_ASSERT_EQUAL_UINT32(info.ticks, chunks[0]["ticks"].as<uint32_t>());
+  decodeStream(bytes.data(), bytes.size(), info.ticks);
+
+  // The end of the stream is a valid offset with no data.
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"exportRecording\",\"slot\":0,\"offset\":" +
+                                              std::to_string(info.bytes),
+                                "recording", reply));
+  TEST_ASSERT_EQUAL_STRING("", reply["data"] | "?");
+}
+
+// Offsets outside 0..size, or not integers, are refused rather than
+// truncated into range.
+static void test_export_rejects_bad_offsets() {
+  const uint16_t size = g_recorder.info(0).bytes;
+  TEST_ASSERT_GREATER_THAN(0, size);
+  const std::string bad[] = {"-1", std::to_string(size + 1), "65536", "70000", "1.5", "\"8\"", "true"};
+  for (const std::string& offset : bad) {
+    JsonDocument reply;
+    TEST_ASSERT_TRUE_MESSAGE(
+        rig::request(g_client, "\"type\":\"exportRecording\",\"slot\":0,\"offset\":" + offset, "error", reply),
+        offset.c_str());
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("invalid_payload", reply["code"] | "", offset.c_str());
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_stream_round_trips);
+  RUN_TEST(test_export_reassembles_the_slot);
+  RUN_TEST(test_export_rejects_bad_offsets);
+  return UNITY_END();
+}
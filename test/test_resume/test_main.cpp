@@ -0,0 +1,300 @@
+// Position resume across simulated reboots. A head is a PtzMotion and a
+// PtzResume on its own host::device; a reboot builds a new pair on the same
+// NVS with the chosen reset reason, and the RTC copy lives on in the process
+// as it does in RTC memory. The last test runs the whole head for the recall
+// timing in the metrics reply.
+#include <esp_system.h>
+#include <unity.h>
+
+#include <memory>
+
+#include "head_rig.h"
+
+static constexpr int kHeadDevice = 1;
+
+struct Head {
+  ptz::PtzMotion motion;
+  ptz::PtzResume resume;
+};
+
+static std::unique_ptr<Head> g_head;
+
+static const uint8_t kAllAxes = static_cast<uint8_t>((1u << ptz::kAxisCount) - 1);
+
+// Axes a power cycle may not restore: gravity-loaded ones drop unpowered.
+static uint8_t alwaysHeld() {
+  uint8_t mask = 0;
+  for (uint8_t i = 0; i < ptz::kAxisCount; ++i) {
+    if (ptz::kAxes[i].hold == ptz::AxisHold::Always) {
+      mask |= static_cast<uint8_t>(1u << i);
+    }
+  }
+  return mask;
+}
+
+static void headMotionStarting() {
+  g_head->resume.invalidate();
+}
+
+// Drops the running head without any shutdown, then boots a new one.
+static void reboot(esp_reset_reason_t reason) {
+  g_head.reset();
+  host::resetReason = reason;
+  host::device = kHeadDevice;
+  g_head.reset(new Head());
+  g_head->motion.begin();
+  g_head->resume.begin(&g_head->motion);
+  g_head->motion.setStartHook(&headMotionStarting);
+  host::device = 0;
+}
+
+// Motion ticks every ms, housekeeping every 100 ms and step passes every
+// 100 us, as in main.cpp. No NVS write may land while the head moves: it
+// would stall step generation.
+static void runForMs(uint32_t ms) {
+  for (uint32_t n = 0; n < ms; ++n) {
+    const uint32_t nowMs = millis();
+    const uint32_t nvsWrites = host::nvsWrites;
+    const bool moving = g_head->motion.isMoving();
+    g_head->motion.update(ptz::kMotionTickUs * 1e-6f);
+    g_head->resume.tick(nowMs, 0);
+    if (nowMs % 100 == 0) {
+      g_head->resume.loop(nowMs);
+    }
+    for (int pass = 0; pass < 10; ++pass) {
+      g_head->motion.run();
+      host::advanceUs(100);
+    }
+    if (moving || g_head->motion.isMoving()) {
+      TEST_ASSERT_EQUAL_UINT32_MESSAGE(nvsWrites, host::nvsWrites, "NVS write while moving");
+    }
+  }
+}
+
+static void runUntilStopped() {
+  for (uint32_t ms = 0; ms < 20000 && g_head->motion.isMoving(); ++ms) {
+    runForMs(1);
+  }
+  TEST_ASSERT_FALSE(g_head->motion.isMoving());
+  runForMs(1); // a motion tick at rest
+}
+
+static void moveTo(float pan, float tilt, float zoom) {
+  g_head->motion.moveAxisTo(ptz::kAxisPan, pan);
+  g_head->motion.moveAxisTo(ptz::kAxisTilt, tilt);
+  g_head->motion.moveAxisTo(ptz::kAxisZoom, zoom);
+  runForMs(1);
+  TEST_ASSERT_TRUE(g_head->motion.isMoving());
+}
+
+static float pos(uint8_t axis) {
+  return g_head->motion.state().pos[axis];
+}
+
+static uint32_t writes() {
+  return g_head->resume.stats().writes;
+}
+
+// Fresh flash, then a settled move to (pan, tilt, zoom) and its clean record.
+static void settleAt(float pan, float tilt, float zoom) {
+  host::nvsErase();
+  reboot(ESP_RST_POWERON);
+  TEST_ASSERT_EQUAL(ptz::ResumeSource::None, g_head->resume.stats().source);
+  TEST_ASSERT_EQUAL_UINT8(0, g_head->resume.stats().suspectMask);
+  moveTo(pan, tilt, zoom);
+  runUntilStopped();
+  runForMs(ptz::kResumeSettleMs + 200);
+  TEST_ASSERT_EQUAL_UINT32(1, writes()); // no record to invalidate as it moved
+}
+
+void setUp() {
+  host::setTimeUs(1000000);
+}
+
+void tearDown() {
+  g_head.reset();
+  host::resetReason = ESP_RST_POWERON;
+}
+
+static void test_settled_position_survives_power_cycle() {
+  settleAt(4000, -3000, 2500);
+  reboot(ESP_RST_POWERON);
+  const ptz::ResumeStats stats = g_head->resume.stats();
+  TEST_ASSERT_EQUAL(ptz::ResumeSource::Stored, stats.source);
+  TEST_ASSERT_EQUAL_UINT8(alwaysHeld(), stats.suspectMask);
+  TEST_ASSERT_EQUAL_UINT8(kAllAxes & ~alwaysHeld(), stats.restoredMask);
+  TEST_ASSERT_EQUAL_FLOAT(4000, pos(ptz::kAxisPan));
+  TEST_ASSERT_EQUAL_FLOAT(0, pos(ptz::kAxisTilt)); // AxisHold::Always
+  TEST_ASSERT_EQUAL_FLOAT(2500, pos(ptz::kAxisZoom));
+}
+
+// No supply sense: the record left from the last rest must not be trusted
+// after power is lost part-way through the next move.
+static void test_power_cut_mid_move_is_not_trusted() {
+  settleAt(4000, -3000, 2500);
+  moveTo(-6000, 1000, 0);
+  runForMs(200);
+  TEST_ASSERT_TRUE(g_head->motion.isMoving());
+  TEST_ASSERT_EQUAL_UINT32(2, writes());
+
+  reboot(ESP_RST_POWERON);
+  const ptz::ResumeStats stats = g_head->resume.stats();
+  TEST_ASSERT_EQUAL(ptz::ResumeSource::None, stats.source);
+  TEST_ASSERT_EQUAL_UINT8(kAllAxes, stats.suspectMask);
+  TEST_ASSERT_EQUAL_UINT8(0, stats.restoredMask);
+  TEST_ASSERT_EQUAL_FLOAT(0, pos(ptz::kAxisPan));
+
+  // A brownout loses the RTC copy too, so it is a power cycle.
+  settleAt(4000, -3000, 2500);
+  moveTo(-6000, 1000, 0);
+  runForMs(200);
+  reboot(ESP_RST_BROWNOUT);
+  TEST_ASSERT_EQUAL(ptz::ResumeSource::None, g_head->resume.stats().source);
+}
+
+// The clean record is invalidated inside the command that starts a move,
+// before its first step, for moves and velocity drives alike; the move
+// itself writes nothing. A command that moves nothing keeps the record.
+static void test_record_invalidated_before_first_step() {
+  settleAt(4000, -3000, 2500);
+  g_head->motion.moveAxisTo(ptz::kAxisPan, 4000);
+  TEST_ASSERT_EQUAL_UINT32(1, writes());
+
+  const uint32_t nvsWrites = host::nvsWrites;
+  g_head->motion.moveAxisTo(ptz::kAxisPan, 6000);
+  TEST_ASSERT_EQUAL_UINT32(2, writes());
+  TEST_ASSERT_EQUAL_UINT32(nvsWrites + 1, host::nvsWrites);
+  TEST_ASSERT_EQUAL_FLOAT(4000, pos(ptz::kAxisPan));
+  g_head->motion.moveAxisTo(ptz::kAxisZoom, 0);
+  TEST_ASSERT_EQUAL_UINT32(2, writes());
+  runUntilStopped();
+  runForMs(ptz::kResumeMinWriteMs + ptz::kResumeSettleMs);
+  TEST_ASSERT_EQUAL_UINT32(3, writes());
+
+  g_head->motion.setAxisVelocity(ptz::kAxisZoom, 0.5f);
+  TEST_ASSERT_EQUAL_UINT32(4, writes());
+  runForMs(500);
+  g_head->motion.setAxisVelocity(ptz::kAxisZoom, -0.5f);
+  runForMs(500);
+  g_head->motion.setAxisVelocity(ptz::kAxisZoom, 0.0f);
+  runUntilStopped();
+  TEST_ASSERT_EQUAL_UINT32(4, writes());
+
+  reboot(ESP_RST_POWERON);
+  TEST_ASSERT_EQUAL(ptz::ResumeSource::None, g_head->resume.stats().source);
+}
+
+// One invalidation per move cycle however many moves it holds, one settle
+// write per rest, and nothing while the head stays put.
+static void test_writes_per_move_cycle() {
+  settleAt(1000, 0, 0);
+  runForMs(ptz::kResumeMinWriteMs * 2);
+  TEST_ASSERT_EQUAL_UINT32(1, writes());
+
+  moveTo(2000, 0, 0);
+  TEST_ASSERT_EQUAL_UINT32(2, writes());
+  runUntilStopped();
+  TEST_ASSERT_EQUAL_UINT32(2, writes());
+  runForMs(ptz::kResumeSettleMs + 200);
+  TEST_ASSERT_EQUAL_UINT32(3, writes());
+
+  // Two moves inside the minimum write interval: the record stays invalid
+  // in between and is written clean once the interval has passed.
+  moveTo(2500, 0, 0);
+  runUntilStopped();
+  runForMs(ptz::kResumeSettleMs + 200);
+  moveTo(3000, 0, 0);
+  runUntilStopped();
+  TEST_ASSERT_EQUAL_UINT32(4, writes());
+  runForMs(ptz::kResumeMinWriteMs);
+  TEST_ASSERT_EQUAL_UINT32(5, writes());
+
+  reboot(ESP_RST_POWERON);
+  TEST_ASSERT_EQUAL(ptz::ResumeSource::Stored, g_head->resume.stats().source);
+  TEST_ASSERT_EQUAL_FLOAT(3000, pos(ptz::kAxisPan));
+
+  // Back to the stored position still rewrites the record it invalidated.
+  moveTo(3500, 0, 0);
+  runUntilStopped();
+  moveTo(3000, 0, 0);
+  runUntilStopped();
+  runForMs(ptz::kResumeMinWriteMs);
+  TEST_ASSERT_EQUAL_UINT32(2, writes());
+  reboot(ESP_RST_POWERON);
+  TEST_ASSERT_EQUAL(ptz::ResumeSource::Stored, g_head->resume.stats().source);
+}
+
+// A software reset or watchdog uses the RTC copy, newer than NVS and with
+// every axis, but only if the head was at rest.
+static void test_warm_reset_uses_rtc_copy() {
+  settleAt(4000, -3000, 2500);
+  moveTo(5000, -2000, 2000);
+  runUntilStopped();
+  reboot(ESP_RST_TASK_WDT);
+  ptz::ResumeStats stats = g_head->resume.stats();
+  TEST_ASSERT_EQUAL(ptz::ResumeSource::Warm, stats.source);
+  TEST_ASSERT_EQUAL_UINT8(kAllAxes, stats.restoredMask);
+  TEST_ASSERT_EQUAL_UINT8(0, stats.suspectMask);
+  TEST_ASSERT_EQUAL_FLOAT(5000, pos(ptz::kAxisPan));
+  TEST_ASSERT_EQUAL_FLOAT(-2000, pos(ptz::kAxisTilt));
+
+  moveTo(0, 0, 0);
+  runForMs(100);
+  reboot(ESP_RST_SW);
+  stats = g_head->resume.stats();
+  TEST_ASSERT_EQUAL(ptz::ResumeSource::None, stats.source);
+  TEST_ASSERT_EQUAL_UINT8(kAllAxes, stats.suspectMask);
+}
+
+// recallSettledMs counts from boot and includes however long the operator
+// waited; recallDurationMs is the recall itself.
+static void test_metrics_report_recall_duration() {
+  rig::boot();
+  const uint32_t bootMs = millis();
+  rig::runForMs(5000);
+  ptz::MotionState preset = {};
+  preset.pos[ptz::kAxisPan] = 8000;
+  TEST_ASSERT_TRUE(g_presets.save(1, preset));
+
+  const int client = rig::ws().hostConnect("/ws");
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(client, "\"type\":\"requestControl\"", "ack", reply));
+  const uint32_t recallMs = millis();
+  TEST_ASSERT_TRUE(rig::request(client, "\"type\":\"recallPreset\",\"index\":1", "ack", reply));
+  rig::pass();
+  // The record written at rest was invalidated by the recall itself.
+  TEST_ASSERT_GREATER_THAN_UINT32(0, g_resume.stats().writes);
+  const uint32_t nvsWrites = host::nvsWrites;
+  while (g_motion.isMoving()) {
+    rig::send(client, "\"type\":\"queueStatus\"");
+    rig::runForMs(100);
+    rig::ws().hostDrain(client);
+    rig::ws().hostTake(client);
+  }
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(nvsWrites, host::nvsWrites, "NVS write while moving");
+  rig::runForMs(10);
+  const uint32_t movedMs = millis() - recallMs;
+
+  TEST_ASSERT_TRUE(rig::request(client, "\"type\":\"metrics\"", "metrics", reply));
+  JsonObject resume = reply["resume"];
+  const uint32_t requested = resume["recallMs"].as<uint32_t>();
+  const uint32_t settled = resume["recallSettledMs"].as<uint32_t>();
+  const uint32_t duration = resume["recallDurationMs"].as<uint32_t>();
+  printf("recall at %u ms after boot, settled at %u ms, took %u ms\n", requested - bootMs, settled - bootMs, duration);
+  TEST_ASSERT_EQUAL_UINT32(settled - requested, duration);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(bootMs + 5000, requested);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(movedMs, duration);
+  // 8000 steps at 4000 steps/s with 20000 steps/s^2 ramps take at least 2.2 s.
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(2200, duration);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_settled_position_survives_power_cycle);
+  RUN_TEST(test_power_cut_mid_move_is_not_trusted);
+  RUN_TEST(test_record_invalidated_before_first_step);
+  RUN_TEST(test_writes_per_move_cycle);
+  RUN_TEST(test_warm_reset_uses_rtc_copy);
+  RUN_TEST(test_metrics_report_recall_duration);
+  return UNITY_END();
+}
@@ -0,0 +1,177 @@
+// Position samples in status frames: the ring between the sampling grid and
+// the status task, the delta encoding clients decode, and the trimming that
+// keeps an oversized batch from cutting a frame short.
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "head_rig.h"
+
+static int g_observer = -1;
+
+struct Decoded {
+  uint32_t lost = 0;
+  std::vector<ptz::PositionSample> samples;
+};
+
+// Rebuilds absolute samples from t0/p0 and the flat delta list.
+static Decoded decode(JsonObject batch) {
+  Decoded out;
+  out.lost = batch["lost"] | 0u;
+  ptz::PositionSample sample;
+  sample.timeUs = batch["t0"].as<uint32_t>();
+  JsonArray p0 = batch["p0"];
+  TEST_ASSERT_EQUAL(ptz::kAxisCount, p0.size());
+  for (uint8_t axis = 0; axis < ptz::kAxisCount; ++axis) {
+    sample.pos[axis] = p0[axis].as<int32_t>();
+  }
+  out.samples.push_back(sample);
+  JsonArray deltas = batch["d"];
+  TEST_ASSERT_EQUAL(0, deltas.size() % (ptz::kAxisCount + 1));
+  for (size_t i = 0; i < deltas.size(); i += ptz::kAxisCount + 1) {
+    sample.timeUs += deltas[i].as<uint32_t>();
+    for (uint8_t axis = 0; axis < ptz::kAxisCount; ++axis) {
+      sample.pos[axis] += deltas[i + 1 + axis].as<int32_t>();
+    }
+    out.samples.push_back(sample);
+  }
+  return out;
+}
+
+static std::vector<JsonDocument> statusFrames() {
+  std::vector<JsonDocument> frames;
+  rig::ws().hostDrain(static_cast<uint8_t>(g_observer));
+  for (const std::string& text : rig::ws().hostTake(static_cast<uint8_t>(g_observer))) {
+    JsonDocument doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, text));
+    if (strcmp(doc["type"] | "", "status") == 0) {
+      frames.push_back(doc);
+    }
+  }
+  return frames;
+}
+
+void setUp() {
+  rig::boot();
+  if (g_observer < 0) {
+    g_observer = rig::ws().hostConnect("/ws?role=observer");
+  }
+  statusFrames();
+}
+
+void tearDown() {}
+
+// The ring keeps the newest kSampleRingSize samples and reports the ones it
+// overwrote once, with the drain that follows them.
+static void test_ring_overflow_reports_lost_samples() {
+  ptz::PtzMotion motion;
+  motion.begin();
+  ptz::PtzSampleRing ring;
+  const uint32_t startUs = 5000000;
+  const uint32_t taken = ptz::kSampleRingSize + 5;
+  for (uint32_t n = 0; n < taken; ++n) {
+    ring.sample(startUs + n * ptz::kSampleIntervalUs, motion);
+  }
+  ptz::PositionSample out[ptz::kSampleRingSize];
+  uint32_t lost = 0;
+  TEST_ASSERT_EQUAL(ptz::kSampleRingSize, ring.drain(out, ptz::kSampleRingSize, &lost));
+  TEST_ASSERT_EQUAL_UINT32(5, lost);
+  TEST_ASSERT_EQUAL_UINT32(5, ring.dropped());
+  TEST_ASSERT_EQUAL_UINT32(startUs + 5 * ptz::kSampleIntervalUs, out[0].timeUs);
+  TEST_ASSERT_EQUAL_UINT32(startUs + (taken - 1) * ptz::kSampleIntervalUs, out[ptz::kSampleRingSize - 1].timeUs);
+  TEST_ASSERT_EQUAL(0, ring.drain(out, ptz::kSampleRingSize, &lost));
+  TEST_ASSERT_EQUAL_UINT32(0, lost);
+}
+
+// At the lowest status rate, with the status tick a few samples late, the
+// ring still holds everything since the previous frame.
+static void test_ring_covers_lowest_status_rate() {
+  ptz::PtzMotion motion;
+  motion.begin();
+  ptz::PtzSampleRing ring;
+  const uint32_t spanUs = ptz::kStatusMaxIntervalMs * 1000 + 3 * ptz::kSampleIntervalUs;
+  for (uint32_t t = 0; t <= spanUs; t += 100) {
+    ring.sample(t, motion);
+  }
+  ptz::PositionSample out[ptz::kSampleRingSize];
+  uint32_t lost = 0;
+  TEST_ASSERT_EQUAL(spanUs / ptz::kSampleIntervalUs + 1, ring.drain(out, ptz::kSampleRingSize, &lost));
+  TEST_ASSERT_EQUAL_UINT32(0, lost);
+}
+
+// Decoded batches from consecutive frames of a moving head join up on the
+// sampling grid with nothing lost between frames.
+static void test_delta_encoding_round_trips() {
+  g_motion.moveAxisTo(ptz::kAxisPan, g_motion.state().pos[ptz::kAxisPan] + 20000);
+  rig::runForMs(100);
+  statusFrames();
+  std::vector<ptz::PositionSample> all;
+  for (int i = 0; i < 10; ++i) {
+    rig::runForMs(ptz::kStatusIntervalMs);
+    for (JsonDocument& frame : statusFrames()) {
+      JsonObject batch = frame["samples"];
+      TEST_ASSERT_FALSE(batch.isNull());
+      const Decoded decoded = decode(batch);
+      TEST_ASSERT_EQUAL_UINT32(0, decoded.lost);
+      all.insert(all.end(), decoded.samples.begin(), decoded.samples.end());
+    }
+  }
+  g_motion.stop();
+  TEST_ASSERT_GREATER_THAN(ptz::kSampleRingSize, all.size());
+  int32_t travelled = 0;
+  for (size_t i = 1; i < all.size(); ++i) {
+    const uint32_t dtUs = all[i].timeUs - all[i - 1].timeUs;
+    TEST_ASSERT_UINT32_WITHIN(rig::passUs, ptz::kSampleIntervalUs, dtUs);
+    travelled += all[i].pos[ptz::kAxisPan] - all[i - 1].pos[ptz::kAxisPan];
+  }
+  TEST_ASSERT_GREATER_THAN(1000, travelled);
+  rig::runForMs(1000);
+}
+
+// A batch too large for the status buffer loses its oldest samples, never
+// its newest or the frame's tail, and the loss is reported in the batch and
+// in metrics.
+static void test_oversized_batch_is_trimmed() {
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_observer, "\"type\":\"metrics\"", "metrics", reply));
+  const uint32_t trimmedBefore = reply["status"]["samplesTrimmed"].as<uint32_t>();
+  const uint32_t lostBefore = reply["status"]["samplesLost"].as<uint32_t>();
+  statusFrames();
+
+  std::vector<ptz::PositionSample> samples(ptz::kSampleRingSize);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    samples[i].timeUs = 1000000000u + static_cast<uint32_t>(i) * 7777777u;
+    for (uint8_t axis = 0; axis < ptz::kAxisCount; ++axis) {
+      samples[i].pos[axis] = (i % 2 ? 1 : -1) * 900000000 + static_cast<int32_t>(i * axis);
+    }
+  }
+  g_ws.broadcastStatus(millis(), g_motion, g_owner, false, true, -60, samples.data(), samples.size(), 2);
+  std::vector<JsonDocument> frames = statusFrames();
+  TEST_ASSERT_EQUAL(1, frames.size());
+  const Decoded decoded = decode(frames[0]["samples"]);
+  const size_t trimmed = samples.size() - decoded.samples.size();
+  TEST_ASSERT_GREATER_THAN(0, trimmed);
+  TEST_ASSERT_EQUAL_UINT32(2 + trimmed, decoded.lost);
+  for (size_t i = 0; i < decoded.samples.size(); ++i) {
+    const ptz::PositionSample& expected = samples[trimmed + i];
+    TEST_ASSERT_EQUAL_UINT32(expected.timeUs, decoded.samples[i].timeUs);
+    TEST_ASSERT_EQUAL_INT32(expected.pos[ptz::kAxisZoom], decoded.samples[i].pos[ptz::kAxisZoom]);
+  }
+  TEST_ASSERT_FALSE(frames[0][ptz::kAxes[ptz::kAxisZoom].name].isNull());
+
+  TEST_ASSERT_TRUE(rig::request(g_observer, "\"type\":\"metrics\"", "metrics", reply));
+  TEST_ASSERT_EQUAL_UINT32(trimmedBefore + trimmed, reply["status"]["samplesTrimmed"].as<uint32_t>());
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(lostBefore + 2 + trimmed, reply["status"]["samplesLost"].as<uint32_t>());
+  TEST_ASSERT_LESS_THAN_UINT32(ptz::kStatusFrameBytes, reply["status"]["bytes"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(0, reply["status"]["oversized"].as<uint32_t>());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_ring_overflow_reports_lost_samples);
+  RUN_TEST(test_ring_covers_lowest_status_rate);
+  RUN_TEST(test_delta_encoding_round_trips);
+  RUN_TEST(test_oversized_batch_is_trimmed);
+  return UNITY_END();
+}
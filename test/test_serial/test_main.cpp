@@ -0,0 +1,253 @@
+// Binary serial protocol through a pseudo terminal: the test is the host
+// tool on the master side, the firmware reads and writes the slave side.
+#include <poll.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "head_rig.h"
+#include "ptz_wire.h"
+
+using ptz::kSerialFrameSof;
+
+static int g_pty = -1;
+static uint8_t g_seq = 0;
+static std::vector<uint8_t> g_rx;
+
+struct Frame {
+  uint8_t cmd;
+  uint8_t seq;
+  std::vector<uint8_t> payload;
+};
+
+static std::vector<uint8_t> encode(uint8_t cmd, uint8_t seq, const std::vector<uint8_t>& payload) {
+  std::vector<uint8_t> frame = {kSerialFrameSof, static_cast<uint8_t>(payload.size()), cmd, seq};
+  frame.insert(frame.end(), payload.begin(), payload.end());
+  const uint16_t crc = ptz::crc16(&frame[1], payload.size() + 3);
+  frame.push_back(static_cast<uint8_t>(crc));
+  frame.push_back(static_cast<uint8_t>(crc >> 8));
+  return frame;
+}
+
+static void writeAll(const std::vector<uint8_t>& bytes) {
+  size_t sent = 0;
+  while (sent < bytes.size()) {
+    const ssize_t n = write(g_pty, bytes.data() + sent, bytes.size() - sent);
+    if (n > 0) {
+      sent += static_cast<size_t>(n);
+    } else {
+      rig::pass();
+    }
+  }
+}
+
+static uint8_t sendFrame(uint8_t cmd, const std::vector<uint8_t>& payload = {}) {
+  const uint8_t seq = g_seq++;
+  writeAll(encode(cmd, seq, payload));
+  return seq;
+}
+
+// Pulls whatever the pty holds and extracts complete, CRC-valid frames;
+// log text between frames is skipped the way a host tool resynchronises.
+static std::vector<Frame> readFrames() {
+  uint8_t buffer[512];
+  for (;;) {
+    const ssize_t n = read(g_pty, buffer, sizeof(buffer));
+    if (n <= 0) {
+      break;
+    }
+    g_rx.insert(g_rx.end(), buffer, buffer + n);
+  }
+  std::vector<Frame> frames;
+  size_t i = 0;
+  while (i < g_rx.size()) {
+    if (g_rx[i] != kSerialFrameSof) {
+      ++i;
+      continue;
+    }
+    if (i + 2 > g_rx.size()) {
+      break;
+    }
+    const size_t size = g_rx[i + 1] + 6u;
+    if (i + size > g_rx.size()) {
+      break;
+    }
+    const uint16_t crc = ptz::crc16(&g_rx[i + 1], size - 3);
+    if ((crc & 0xFF) != g_rx[i + size - 2] || (crc >> 8) != g_rx[i + size - 1]) {
+      ++i;
+      continue;
+    }
+    frames.push_back(Frame{g_rx[i + 2], g_rx[i + 3],
+                           std::vector<uint8_t>(g_rx.begin() + i + 4, g_rx.begin() + i + size - 2)});
+    i += size;
+  }
+  g_rx.erase(g_rx.begin(), g_rx.begin() + i);
+  return frames;
+}
+
+// Loop passes until a reply for seq arrives; returns the reply command or 0.
+static uint8_t awaitReply(uint8_t seq, uint32_t maxPasses = 2000) {
+  for (uint32_t i = 0; i < maxPasses; ++i) {
+    rig::pass();
+    for (const Frame& frame : readFrames()) {
+      if ((frame.cmd == ptz::kSerialMsgAck || frame.cmd == ptz::kSerialMsgError) && frame.seq == seq) {
+        return frame.cmd;
+      }
+    }
+    // The pty hands bytes over asynchronously; give it a moment.
+    pollfd pfd = {g_pty, POLLIN, 0};
+    poll(&pfd, 1, i < 10 ? 0 : 1);
+  }
+  return 0;
+}
+
+static std::vector<uint8_t> velocityPayload(int16_t pan, int16_t tilt, int16_t zoom) {
+  std::vector<uint8_t> payload(6);
+  ptz::writeU16(&payload[0], static_cast<uint16_t>(pan));
+  ptz::writeU16(&payload[2], static_cast<uint16_t>(tilt));
+  ptz::writeU16(&payload[4], static_cast<uint16_t>(zoom));
+  return payload;
+}
+
+void setUp() {
+  rig::boot();
+  readFrames();
+  g_rx.clear();
+}
+
+void tearDown() {
+  Serial.hostSetTxSpace(128);
+}
+
+static void test_request_control_is_acked() {
+  const uint8_t seq = sendFrame(ptz::kSerialCmdRequestControl);
+  TEST_ASSERT_EQUAL_HEX8(ptz::kSerialMsgAck, awaitReply(seq));
+  TEST_ASSERT_EQUAL_UINT32(ptz::kSerialClientId, g_owner.snapshot().controlClientId);
+}
+
+// Back-to-back frames are all acked, without CRC errors or drops, faster
+// than the UART can deliver them.
+static void test_throughput_and_latency() {
+  const uint8_t control = sendFrame(ptz::kSerialCmdRequestControl);
+  TEST_ASSERT_EQUAL_HEX8(ptz::kSerialMsgAck, awaitReply(control));
+  const ptz::SerialStats before = g_serial.stats();
+
+  constexpr int kFrames = 2000;
+  std::vector<double> latencyUs;
+  latencyUs.reserve(kFrames);
+  const auto wallStart = std::chrono::steady_clock::now();
+  const uint64_t virtualStart = host::nowUs;
+  for (int i = 0; i < kFrames; ++i) {
+    const int16_t speed = static_cast<int16_t>((i % 200) * 100 - 10000);
+    const auto sent = std::chrono::steady_clock::now();
+    const uint8_t seq = sendFrame(ptz::kSerialCmdSetVelocity, velocityPayload(speed, -speed, 0));
+    TEST_ASSERT_EQUAL_HEX8(ptz::kSerialMsgAck, awaitReply(seq));
+    latencyUs.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sent).count());
+  }
+  const double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  const double virtualS = (host::nowUs - virtualStart) * 1e-6;
+
+  const ptz::SerialStats after = g_serial.stats();
+  TEST_ASSERT_EQUAL_UINT32(kFrames, after.framesOk - before.framesOk);
+  TEST_ASSERT_EQUAL_UINT32(before.crcErrors, after.crcErrors);
+  TEST_ASSERT_EQUAL_UINT32(before.txDropped, after.txDropped);
+
+  std::sort(latencyUs.begin(), latencyUs.end());
+  char line[160];
+  snprintf(line, sizeof(line), "%d frames: %.0f msg/s wall, %.0f msg/s virtual; pty round trip p50 %.0f us p99 %.0f us",
+           kFrames, kFrames / wallS, kFrames / virtualS, latencyUs[kFrames / 2], latencyUs[kFrames * 99 / 100]);
+  TEST_MESSAGE(line);
+  // 115200 baud carries about 960 twelve-byte frames per second; the
+  // firmware side must not be the limit.
+  TEST_ASSERT_GREATER_THAN(960, static_cast<long>(kFrames / virtualS));
+
+  const uint8_t stop = sendFrame(ptz::kSerialCmdStop);
+  TEST_ASSERT_EQUAL_HEX8(ptz::kSerialMsgAck, awaitReply(stop));
+}
+
+// A burst larger than one pass's byte budget is worked off over following
+// passes without losing frames.
+static void test_burst_spans_passes() {
+  const ptz::SerialStats before = g_serial.stats();
+  std::vector<uint8_t> burst;
+  for (int i = 0; i < 60; ++i) {
+    const std::vector<uint8_t> frame = encode(ptz::kSerialCmdHeartbeat, g_seq++, {});
+    burst.insert(burst.end(), frame.begin(), frame.end());
+  }
+  TEST_ASSERT_GREATER_THAN(ptz::kSerialMaxBytesPerLoop, burst.size());
+  writeAll(burst);
+  for (int i = 0; i < 200 && g_serial.stats().framesOk - before.framesOk < 60; ++i) {
+    rig::pass();
+    pollfd pfd = {g_pty, POLLIN, 0};
+    poll(&pfd, 1, 1);
+  }
+  TEST_ASSERT_EQUAL_UINT32(60, g_serial.stats().framesOk - before.framesOk);
+}
+
+static void test_corrupt_frames_are_counted() {
+  const ptz::SerialStats before = g_serial.stats();
+
+  std::vector<uint8_t> bad = encode(ptz::kSerialCmdHeartbeat, g_seq++, {});
+  bad.back() ^= 0xFF;
+  writeAll(bad);
+  // Length above kSerialMaxPayload.
+  writeAll({kSerialFrameSof, static_cast<uint8_t>(ptz::kSerialMaxPayload + 1)});
+  rig::runForMs(5);
+  // A partial frame that never completes.
+  writeAll({kSerialFrameSof, 4, ptz::kSerialCmdHeartbeat});
+  rig::runForMs(ptz::kSerialFrameTimeoutMs + 5);
+
+  const ptz::SerialStats after = g_serial.stats();
+  TEST_ASSERT_EQUAL_UINT32(before.crcErrors + 1, after.crcErrors);
+  TEST_ASSERT_EQUAL_UINT32(before.overruns + 1, after.overruns);
+  TEST_ASSERT_EQUAL_UINT32(before.timeouts + 1, after.timeouts);
+
+  // The link recovers straight away.
+  const uint8_t seq = sendFrame(ptz::kSerialCmdStatusStream, {0, 0});
+  TEST_ASSERT_EQUAL_HEX8(ptz::kSerialMsgAck, awaitReply(seq));
+}
+
+static void test_full_uart_drops_instead_of_blocking() {
+  const ptz::SerialStats before = g_serial.stats();
+  Serial.hostSetTxSpace(4);
+  const uint8_t seq = sendFrame(ptz::kSerialCmdHeartbeat);
+  rig::runForMs(5);
+  Serial.hostSetTxSpace(128);
+  TEST_ASSERT_EQUAL_HEX8(0, awaitReply(seq, 20));
+  TEST_ASSERT_GREATER_THAN(before.txDropped, g_serial.stats().txDropped);
+}
+
+static void test_metrics_reports_serial_stats() {
+  const int client = rig::ws().hostConnect("/ws");
+  TEST_ASSERT_GREATER_OR_EQUAL(0, client);
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(client, "\"type\":\"metrics\"", "metrics", reply));
+  const ptz::SerialStats stats = g_serial.stats();
+  TEST_ASSERT_EQUAL_UINT32(stats.framesOk, reply["serial"]["framesOk"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(stats.crcErrors, reply["serial"]["crcErrors"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(stats.timeouts, reply["serial"]["timeouts"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(stats.overruns, reply["serial"]["overruns"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(stats.txDropped, reply["serial"]["txDropped"].as<uint32_t>());
+  rig::ws().hostClose(client);
+  rig::pass();
+}
+
+int main() {
+  g_pty = Serial.attachPty();
+  if (g_pty < 0) {
+    printf("no pseudo terminal available\n");
+    return 1;
+  }
+  fcntl(g_pty, F_SETFL, O_NONBLOCK);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_request_control_is_acked);
+  RUN_TEST(test_throughput_and_latency);
+  RUN_TEST(test_burst_spans_passes);
+  RUN_TEST(test_corrupt_frames_are_counted);
+  RUN_TEST(test_full_uart_drops_instead_of_blocking);
+  RUN_TEST(test_metrics_reports_serial_stats);
+  return UNITY_END();
+}
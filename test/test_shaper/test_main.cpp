@@ -0,0 +1,171 @@
+// Input shaper math against reference impulse responses: the published
+// closed forms for ZV, ZVD and EI (Singhose), the impulse train the running
+// shaper actually produces, and the residual vibration of a damped mode
+// driven through it.
+#include <math.h>
+#include <unity.h>
+
+#include "ptz_shaper.h"
+
+using ptz::InputShaper;
+using ptz::ShaperConfig;
+using ptz::ShaperType;
+
+static constexpr float kSampleS = ptz::kShaperSampleUs * 1e-6f;
+static constexpr float kTickS = ptz::kMotionTickUs * 1e-6f;
+
+struct Reference {
+  ShaperConfig config;
+  uint8_t count;
+  float amplitude[InputShaper::kMaxImpulses];
+  float timeS[InputShaper::kMaxImpulses];
+};
+
+// K = exp(-zeta * pi / sqrt(1 - zeta^2)), Td = 1 / (f * sqrt(1 - zeta^2)).
+// ZV: 1, K over 1 + K at 0, Td/2. ZVD: 1, 2K, K^2 over (1 + K)^2 at 0, Td/2,
+// Td. Undamped EI: (1 + V)/4, (1 - V)/2, (1 + V)/4 at 0, T/2, T.
+static const Reference kReferences[] = {
+    {{ShaperType::Zv, 10.0f, 0.0f}, 2, {0.5f, 0.5f}, {0.0f, 0.05f}},
+    {{ShaperType::Zv, 10.0f, 0.1f}, 2, {0.57829f, 0.42171f}, {0.0f, 0.050252f}},
+    {{ShaperType::Zvd, 5.0f, 0.05f}, 3, {0.29078f, 0.49692f, 0.21230f}, {0.0f, 0.100125f, 0.20025f}},
+    {{ShaperType::Zvd, 20.0f, 0.2f}, 3, {0.42908f, 0.45192f, 0.11900f}, {0.0f, 0.025516f, 0.051031f}},
+    {{ShaperType::Ei, 8.0f, 0.0f}, 3, {0.2625f, 0.475f, 0.2625f}, {0.0f, 0.0625f, 0.125f}},
+};
+
+void setUp() {}
+void tearDown() {}
+
+static void test_impulses_match_reference() {
+  for (const Reference& ref : kReferences) {
+    float amplitude[InputShaper::kMaxImpulses];
+    float timeS[InputShaper::kMaxImpulses];
+    uint8_t count = 0;
+    TEST_ASSERT_TRUE(InputShaper::impulses(ref.config, amplitude, timeS, &count));
+    TEST_ASSERT_EQUAL_UINT8(ref.count, count);
+    for (uint8_t i = 0; i < count; ++i) {
+      TEST_ASSERT_FLOAT_WITHIN(2e-5f, ref.amplitude[i], amplitude[i]);
+      TEST_ASSERT_FLOAT_WITHIN(2e-6f, ref.timeS[i], timeS[i]);
+    }
+  }
+}
+
+static void test_out_of_range_configs_are_refused() {
+  const ShaperConfig bad[] = {
+      {ShaperType::Zv, ptz::kShaperMinHz - 0.1f, 0.0f},
+      {ShaperType::Zv, ptz::kShaperMaxHz + 1.0f, 0.0f},
+      {ShaperType::Zvd, 10.0f, ptz::kShaperMaxDamping + 0.01f},
+      {ShaperType::Ei, 10.0f, -0.01f},
+      {ShaperType::Zv, NAN, 0.0f},
+      {ShaperType::Zv, 10.0f, NAN},
+  };
+  for (const ShaperConfig& config : bad) {
+    InputShaper shaper;
+    TEST_ASSERT_FALSE(shaper.configure(config));
+    TEST_ASSERT_EQUAL(ShaperType::None, shaper.config().type);
+  }
+  // The slowest, most damped ZVD still fits the history.
+  InputShaper shaper;
+  TEST_ASSERT_TRUE(shaper.configure({ShaperType::Zvd, ptz::kShaperMinHz, ptz::kShaperMaxDamping}));
+}
+
+// A pulse one history sample long into the running shaper comes out as the
+// reference impulse train: the area around each impulse time is that
+// impulse's share of the pulse.
+static void test_running_shaper_reproduces_impulse_train() {
+  for (const Reference& ref : kReferences) {
+    InputShaper shaper;
+    TEST_ASSERT_TRUE(shaper.configure(ref.config));
+    shaper.reset(0.0f);
+    const uint32_t ticks = static_cast<uint32_t>((ref.timeS[ref.count - 1] + 0.05f) / kTickS);
+    const uint32_t pulseTicks = ptz::kShaperSampleUs / ptz::kMotionTickUs;
+    float area[InputShaper::kMaxImpulses] = {};
+    float total = 0.0f;
+    for (uint32_t n = 0; n < ticks; ++n) {
+      const float out = shaper.apply(n < pulseTicks ? 1.0f : 0.0f, kTickS) / pulseTicks;
+      const float t = n * kTickS;
+      total += out;
+      for (uint8_t i = 0; i < ref.count; ++i) {
+        if (t >= ref.timeS[i] - kSampleS && t <= ref.timeS[i] + 3 * kSampleS) {
+          area[i] += out;
+        }
+      }
+    }
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 1.0f, total);
+    for (uint8_t i = 0; i < ref.count; ++i) {
+      TEST_ASSERT_FLOAT_WITHIN(1e-3f, ref.amplitude[i], area[i]);
+    }
+    TEST_ASSERT_TRUE(shaper.settled());
+  }
+}
+
+// Residual vibration of a camera on a damped mode (freqHz, damping) after a
+// full-speed stop: the velocity stream runs through the shaper, the base
+// follows it and the camera hangs off the base. Returns the largest
+// deflection once the shaped stream has come to rest.
+static float residual(const ShaperConfig& config, float freqHz, float damping) {
+  InputShaper shaper;
+  TEST_ASSERT_TRUE(shaper.configure(config));
+  shaper.reset(0.0f);
+  const float omega = 2.0f * 3.14159265f * freqHz;
+  const uint32_t kSubsteps = 20;
+  const float h = kTickS / kSubsteps;
+  double base = 0.0, camera = 0.0, cameraVel = 0.0;
+  float worst = 0.0f;
+  // 300 ms at full speed, then stop; measure from 0.6 s, after the slowest
+  // shaper used here has finished.
+  for (uint32_t n = 0; n < 2000; ++n) {
+    const float t = n * kTickS;
+    const float velocity = shaper.apply(t < 0.3f ? 1.0f : 0.0f, kTickS);
+    for (uint32_t s = 0; s < kSubsteps; ++s) {
+      base += velocity * h;
+      const double accel = -2.0 * damping * omega * (cameraVel - velocity) - omega * omega * (camera - base);
+      cameraVel += accel * h;
+      camera += cameraVel * h;
+    }
+    if (t >= 0.6f) {
+      worst = fmaxf(worst, static_cast<float>(fabs(camera - base)));
+    }
+  }
+  return worst;
+}
+
+static void test_shapers_cancel_the_tuned_mode() {
+  const float freqHz = 4.0f;
+  const float damping = 0.02f;
+  const float unshaped = residual({ShaperType::None, 0.0f, 0.0f}, freqHz, damping);
+  const float zv = residual({ShaperType::Zv, freqHz, damping}, freqHz, damping);
+  const float zvd = residual({ShaperType::Zvd, freqHz, damping}, freqHz, damping);
+  const float ei = residual({ShaperType::Ei, freqHz, damping}, freqHz, damping);
+  printf("residual at %.1f Hz: none %.5f zv %.5f zvd %.5f ei %.5f\n", freqHz, unshaped, zv, zvd, ei);
+  TEST_ASSERT_TRUE(unshaped > 0.0f);
+  TEST_ASSERT_LESS_THAN_FLOAT(0.02f * unshaped, zv);
+  TEST_ASSERT_LESS_THAN_FLOAT(0.02f * unshaped, zvd);
+  // EI trades exact cancellation for tolerance: at most V at the tuned mode.
+  TEST_ASSERT_LESS_THAN_FLOAT((ptz::kShaperEiTolerance + 0.02f) * unshaped, ei);
+}
+
+// Tuned 15% off the real mode, ZVD and EI still suppress more than ZV.
+static void test_zvd_and_ei_tolerate_frequency_error() {
+  const float tunedHz = 4.0f;
+  const float actualHz = 4.6f;
+  const float damping = 0.02f;
+  const float unshaped = residual({ShaperType::None, 0.0f, 0.0f}, actualHz, damping);
+  const float zv = residual({ShaperType::Zv, tunedHz, damping}, actualHz, damping);
+  const float zvd = residual({ShaperType::Zvd, tunedHz, damping}, actualHz, damping);
+  const float ei = residual({ShaperType::Ei, tunedHz, damping}, actualHz, damping);
+  printf("residual at %.1f Hz tuned %.1f Hz: none %.5f zv %.5f zvd %.5f ei %.5f\n", actualHz, tunedHz, unshaped, zv,
+         zvd, ei);
+  TEST_ASSERT_LESS_THAN_FLOAT(0.5f * unshaped, zv);
+  TEST_ASSERT_LESS_THAN_FLOAT(zv, zvd);
+  TEST_ASSERT_LESS_THAN_FLOAT(zv, ei);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_impulses_match_reference);
+  RUN_TEST(test_out_of_range_configs_are_refused);
+  RUN_TEST(test_running_shaper_reproduces_impulse_train);
+  RUN_TEST(test_shapers_cancel_the_tuned_mode);
+  RUN_TEST(test_zvd_and_ei_tolerate_frequency_error);
+  return UNITY_END();
+}
@@ -0,0 +1,269 @@
+// Soak: PTZ_SOAK_CLIENTS WebSocket clients (default 5) against one head for
+// PTZ_SOAK_MINUTES of virtual time (default 3). Controllers stream
+// setVelocity at PTZ_SOAK_RATE_HZ (default 50) whether or not they own the
+// head, grab control at random, and disconnect and come back; every fifth
+// client is an observer that only reads status. Clients keep up with their
+// sockets, so nobody is dropped as slow.
+//
+// Each pass checks ownership against a model of who last asked for control.
+// Each virtual minute prints loop period and status jitter percentiles, and
+// the run must stay inside the loop deadline, the status cadence and a
+// fixed heap budget. PTZ_SOAK_SEED changes the schedule.
+#include <malloc.h>
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "head_rig.h"
+
+// Modelled costs: a loop pass, each frame received and each frame sent.
+static constexpr uint32_t kPassUs = 150;
+static constexpr uint32_t kReceiveUs = 60;
+static constexpr uint32_t kSendUs = 40;
+
+// Status may be late by a loop pass plus a burst of frames from every client.
+static constexpr uint32_t kMaxStatusJitterP99Us = 2000;
+// mallinfo2() also counts chunks parked in glibc's per-thread cache, which
+// fills over a run; GLIBC_TUNABLES=glibc.malloc.tcache_count=0 gives the
+// exact figure, flat once warmed up.
+static constexpr size_t kMaxHeapGrowthBytes = 32 * 1024;
+
+struct SoakClient {
+  bool observer = false;
+  int num = -1;           // server slot while connected
+  bool requested = false; // sent requestControl on this connection
+  uint64_t nextSendUs = 0;
+  uint64_t nextGrabUs = 0;
+  uint64_t leaveUs = 0;
+  uint64_t rejoinUs = 0;
+};
+
+struct SoakTotals {
+  uint32_t sent = 0;
+  uint32_t grabs = 0;
+  uint32_t acks = 0;
+  uint32_t rejected = 0;
+  uint32_t reconnects = 0;
+  uint32_t statusFrames = 0;
+};
+
+static uint64_t g_rng = 0x2545F4914F6CDD1DULL;
+
+static uint32_t nextRandom() {
+  g_rng ^= g_rng << 13;
+  g_rng ^= g_rng >> 7;
+  g_rng ^= g_rng << 17;
+  return static_cast<uint32_t>(g_rng >> 16);
+}
+
+static uint64_t randomUs(uint32_t minMs, uint32_t maxMs) {
+  return (static_cast<uint64_t>(minMs) + nextRandom() % (maxMs - minMs + 1)) * 1000;
+}
+
+static uint32_t envOr(const char* name, uint32_t fallback) {
+  const char* value = getenv(name);
+  return value ? static_cast<uint32_t>(strtoul(value, nullptr, 10)) : fallback;
+}
+
+static std::vector<SoakClient> g_clients;
+static SoakTotals g_totals;
+// Slot of the client the head should be following, or -1.
+static int g_expectedOwner = -1;
+static uint32_t g_faults = 0;
+static std::string g_firstFault;
+
+static void fault(const std::string& what) {
+  if (g_faults++ == 0) {
+    char at[32];
+    snprintf(at, sizeof(at), " at %llu ms", static_cast<unsigned long long>(host::nowUs / 1000));
+    g_firstFault = what + at;
+  }
+}
+
+static void join(SoakClient& client) {
+  client.num = rig::ws().hostConnect(client.observer ? "/ws?role=observer" : "/ws");
+  TEST_ASSERT_GREATER_OR_EQUAL(0, client.num);
+  client.requested = false;
+  client.leaveUs = host::nowUs + randomUs(5000, 40000);
+  client.nextGrabUs = host::nowUs + randomUs(100, 6000);
+}
+
+static void leave(SoakClient& client) {
+  rig::ws().hostClose(static_cast<uint8_t>(client.num));
+  if (g_expectedOwner == client.num) {
+    g_expectedOwner = -1;
+  }
+  client.num = -1;
+  client.rejoinUs = host::nowUs + randomUs(100, 3000);
+}
+
+// One client's traffic due before the next pass.
+static void drive(SoakClient& client, uint32_t periodUs) {
+  if (client.num < 0) {
+    if (host::nowUs >= client.rejoinUs) {
+      join(client);
+      ++g_totals.reconnects;
+    }
+    return;
+  }
+  if (host::nowUs >= client.leaveUs) {
+    leave(client);
+    return;
+  }
+  if (client.observer) {
+    return;
+  }
+  const uint8_t num = static_cast<uint8_t>(client.num);
+  if (host::nowUs >= client.nextGrabUs) {
+    rig::send(num, "\"type\":\"requestControl\"");
+    client.requested = true;
+    g_expectedOwner = client.num;
+    client.nextGrabUs = host::nowUs + randomUs(1000, 6000);
+    ++g_totals.grabs;
+  }
+  if (host::nowUs >= client.nextSendUs) {
+    char body[96];
+    snprintf(body, sizeof(body), "\"type\":\"setVelocity\",\"pan\":%.2f,\"tilt\":%.2f,\"zoom\":0",
+             static_cast<int>(nextRandom() % 201 - 100) / 100.0f, static_cast<int>(nextRandom() % 201 - 100) / 100.0f);
+    rig::send(num, body);
+    client.nextSendUs += periodUs;
+    if (client.nextSendUs < host::nowUs) {
+      client.nextSendUs = host::nowUs + periodUs;
+    }
+    ++g_totals.sent;
+  }
+}
+
+// Reads what the client was sent like an app would.
+static void readReplies(SoakClient& client) {
+  if (client.num < 0) {
+    return;
+  }
+  const uint8_t num = static_cast<uint8_t>(client.num);
+  rig::ws().hostDrain(num);
+  for (const std::string& text : rig::ws().hostTake(num)) {
+    JsonDocument doc;
+    if (deserializeJson(doc, text)) {
+      fault("unparsable frame");
+      continue;
+    }
+    const char* type = doc["type"] | "";
+    if (strcmp(type, "status") == 0) {
+      ++g_totals.statusFrames;
+    } else if (strcmp(type, "ack") == 0) {
+      ++g_totals.acks;
+      if (strcmp(doc["refType"] | "", "setVelocity") == 0 && !client.requested) {
+        fault("setVelocity acked for a client that never asked for control");
+      }
+    } else if (strcmp(type, "error") == 0) {
+      ++g_totals.rejected;
+      const char* code = doc["code"] | "";
+      if (strcmp(code, "not_owner") != 0) {
+        fault(std::string("unexpected error ") + code);
+      }
+    }
+  }
+}
+
+// The head follows exactly the client that asked last, and only while that
+// client is connected.
+static void checkOwnership() {
+  const ptz::OwnerSnapshot snap = g_owner.snapshot();
+  if (g_expectedOwner < 0) {
+    if (snap.owner == ptz::Owner::App) {
+      fault("client " + std::to_string(snap.controlClientId) + " owns the head without asking");
+    }
+    return;
+  }
+  if (snap.owner != ptz::Owner::App || snap.controlClientId != static_cast<uint32_t>(g_expectedOwner)) {
+    fault("client " + std::to_string(g_expectedOwner) + " lost control it asked for");
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_clients_soak() {
+  const uint32_t clientCount = std::min<uint32_t>(envOr("PTZ_SOAK_CLIENTS", 5), WEBSOCKETS_SERVER_CLIENT_MAX);
+  const uint32_t minutes = envOr("PTZ_SOAK_MINUTES", 3);
+  // Slower than this and the owner's own stream stops counting as a
+  // heartbeat, which the ownership model does not follow.
+  const uint32_t rateHz = std::max<uint32_t>(envOr("PTZ_SOAK_RATE_HZ", 50), 5);
+  g_rng ^= envOr("PTZ_SOAK_SEED", 0);
+  const uint32_t periodUs = 1000000 / rateHz;
+
+  rig::boot();
+  host::wsReceiveCostUs = kReceiveUs;
+  host::wsSendCostUs = kSendUs;
+
+  g_clients.resize(clientCount);
+  for (uint32_t i = 0; i < clientCount; ++i) {
+    g_clients[i].observer = i % 5 == 4;
+    g_clients[i].nextSendUs = host::nowUs + nextRandom() % periodUs;
+    join(g_clients[i]);
+  }
+
+  printf("%u clients at %u Hz for %u virtual minutes\n", clientCount, rateHz, minutes);
+  printf("%6s %9s %9s %9s %9s %9s %9s %8s\n", "minute", "loop p50", "loop p99", "loop max", "stat p99",
+         "stat max", "owner chg", "overruns");
+
+  size_t heapAfterWarmup = 0;
+  uint32_t worstLoopP99 = 0;
+  uint32_t worstStatusP99 = 0;
+  uint32_t totalOverruns = 0;
+  for (uint32_t minute = 0; minute < minutes; ++minute) {
+    g_metrics.resetTiming();
+    const uint32_t overrunsBefore = g_deadline.stats().overruns;
+    const uint64_t endUs = host::nowUs + 60ULL * 1000000;
+    while (host::nowUs < endUs) {
+      for (SoakClient& client : g_clients) {
+        drive(client, periodUs);
+      }
+      rig::pass(kPassUs);
+      for (SoakClient& client : g_clients) {
+        readReplies(client);
+      }
+      checkOwnership();
+    }
+    // Captured log output is host-side; keep it out of the heap figures.
+    Serial.hostTakeOutput();
+
+    const ptz::LatencyHistogram& loopPeriod = g_metrics.loopPeriod();
+    const ptz::LatencyHistogram& statusJitter = g_metrics.statusJitter();
+    const uint32_t overruns = g_deadline.stats().overruns - overrunsBefore;
+    printf("%6u %9u %9u %9u %9u %9u %9u %8u\n", minute + 1, static_cast<unsigned>(loopPeriod.quantile(0.5f)),
+           static_cast<unsigned>(loopPeriod.quantile(0.99f)), static_cast<unsigned>(loopPeriod.max()),
+           static_cast<unsigned>(statusJitter.quantile(0.99f)), static_cast<unsigned>(statusJitter.max()),
+           static_cast<unsigned>(g_metrics.ownerChanges()), static_cast<unsigned>(overruns));
+    // The first minute warms up pools and histograms.
+    if (minute > 0) {
+      worstLoopP99 = std::max<uint32_t>(worstLoopP99, loopPeriod.quantile(0.99f));
+      worstStatusP99 = std::max<uint32_t>(worstStatusP99, statusJitter.quantile(0.99f));
+      totalOverruns += overruns;
+    } else {
+      heapAfterWarmup = mallinfo2().uordblks;
+    }
+  }
+  const size_t heapAtEnd = mallinfo2().uordblks;
+
+  printf("sent %u setVelocity, %u grabs, %u acks, %u not_owner, %u reconnects, %u status frames\n", g_totals.sent,
+         g_totals.grabs, g_totals.acks, g_totals.rejected, g_totals.reconnects, g_totals.statusFrames);
+  printf("heap in use %zu -> %zu bytes, %u slow disconnects\n", heapAfterWarmup, heapAtEnd,
+         static_cast<unsigned>(g_ws.slowDisconnects()));
+
+  TEST_ASSERT_EQUAL_MESSAGE(0, g_faults, g_firstFault.c_str());
+  TEST_ASSERT_EQUAL(0, g_ws.slowDisconnects());
+  TEST_ASSERT_GREATER_THAN(0, g_totals.grabs);
+  TEST_ASSERT_GREATER_THAN(0, g_totals.reconnects);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(ptz::kLoopDeadlineUs, worstLoopP99);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(kMaxStatusJitterP99Us, worstStatusP99);
+  TEST_ASSERT_EQUAL(0, totalOverruns);
+  TEST_ASSERT_LESS_OR_EQUAL(kMaxHeapGrowthBytes, heapAtEnd > heapAfterWarmup ? heapAtEnd - heapAfterWarmup : 0);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_clients_soak);
+  return UNITY_END();
+}
@@ -0,0 +1,263 @@
+// UDP control from a local client: VISCA over IP and the native "PZ"
+// datagrams, sent from a second station on the simulated network.
+#include <unity.h>
+
+#include <vector>
+
+#include "head_rig.h"
+#include "ptz_wire.h"
+
+static WiFiUDP* g_client = nullptr;
+// VISCA and native datagrams from one address share a sequence space.
+static uint32_t g_seq = 1;
+
+static IPAddress headIp() {
+  return host::deviceIp(0);
+}
+
+static void sendRaw(const std::vector<uint8_t>& datagram) {
+  g_client->beginPacket(headIp(), ptz::kUdpControlPort);
+  g_client->write(datagram.data(), datagram.size());
+  g_client->endPacket();
+}
+
+static void sendVisca(uint16_t type, uint32_t seq, const std::vector<uint8_t>& payload) {
+  std::vector<uint8_t> datagram = {
+      static_cast<uint8_t>(type >> 8), static_cast<uint8_t>(type),
+      static_cast<uint8_t>(payload.size() >> 8), static_cast<uint8_t>(payload.size()),
+      static_cast<uint8_t>(seq >> 24), static_cast<uint8_t>(seq >> 16),
+      static_cast<uint8_t>(seq >> 8), static_cast<uint8_t>(seq),
+  };
+  datagram.insert(datagram.end(), payload.begin(), payload.end());
+  sendRaw(datagram);
+}
+
+static void sendNative(uint8_t cmd, uint32_t seq, const std::vector<uint8_t>& payload = {}) {
+  std::vector<uint8_t> datagram = {'P', 'Z', 1, cmd, 0, 0, 0, 0};
+  ptz::writeU32(&datagram[4], seq);
+  datagram.insert(datagram.end(), payload.begin(), payload.end());
+  sendRaw(datagram);
+}
+
+// Replies collected over `passes` loop passes.
+static std::vector<std::vector<uint8_t>> replies(uint32_t passes = 3) {
+  std::vector<std::vector<uint8_t>> out;
+  for (uint32_t i = 0; i < passes; ++i) {
+    rig::pass();
+    while (int size = g_client->parsePacket()) {
+      std::vector<uint8_t> datagram(static_cast<size_t>(size));
+      g_client->read(datagram.data(), datagram.size());
+      out.push_back(datagram);
+    }
+  }
+  return out;
+}
+
+// Runs the head while heartbeating, so native control does not time out.
+static void holdForMs(uint32_t ms) {
+  for (uint32_t elapsed = 0; elapsed < ms; elapsed += 200) {
+    sendNative(ptz::kSerialCmdHeartbeat, g_seq++);
+    rig::runForMs(200);
+  }
+}
+
+static std::vector<uint8_t> viscaPayload(const std::vector<uint8_t>& reply) {
+  return std::vector<uint8_t>(reply.begin() + 8, reply.end());
+}
+
+static bool isUdpClientId(uint32_t id) {
+  return id > ptz::kUdpClientIdBase && id < ptz::kGroupClientIdBase;
+}
+
+void setUp() {
+  rig::boot();
+  if (!g_client) {
+    host::device = 1;
+    g_client = new WiFiUDP();
+    host::device = 0;
+    g_client->begin(50000);
+  }
+  replies(1);
+}
+
+void tearDown() {}
+
+static void test_visca_drive_takes_control_and_moves() {
+  sendVisca(0x0200, 0, {0x01});
+  std::vector<std::vector<uint8_t>> got = replies();
+  TEST_ASSERT_EQUAL(1, got.size());
+  TEST_ASSERT_EQUAL_HEX8(0x02, got[0][0]);
+  TEST_ASSERT_EQUAL_HEX8(0x01, got[0][1]);
+
+  // Pan right at full speed, tilt stop.
+  sendVisca(0x0100, g_seq++, {0x81, 0x01, 0x06, 0x01, 0x18, 0x14, 0x02, 0x03, 0xFF});
+  got = replies(1);
+  TEST_ASSERT_EQUAL(2, got.size());
+  TEST_ASSERT_TRUE(viscaPayload(got[0]) == std::vector<uint8_t>({0x90, 0x41, 0xFF}));
+  TEST_ASSERT_TRUE(viscaPayload(got[1]) == std::vector<uint8_t>({0x90, 0x51, 0xFF}));
+  TEST_ASSERT_EQUAL(ptz::Owner::App, g_owner.snapshot().owner);
+  TEST_ASSERT_TRUE(isUdpClientId(g_owner.snapshot().controlClientId));
+
+  const float start = g_motion.state().pos[ptz::kAxisPan];
+  rig::runForMs(300);
+  TEST_ASSERT_GREATER_THAN(50, fabsf(g_motion.state().pos[ptz::kAxisPan] - start));
+
+  // The latched drive keeps the head owned past the app heartbeat timeout.
+  rig::runForMs(ptz::kAppHeartbeatTimeoutMs + 100);
+  TEST_ASSERT_EQUAL(ptz::Owner::App, g_owner.snapshot().owner);
+
+  sendVisca(0x0100, g_seq++, {0x81, 0x01, 0x06, 0x01, 0x18, 0x14, 0x03, 0x03, 0xFF});
+  replies();
+  rig::runForMs(1500);
+  TEST_ASSERT_FALSE(g_motion.isMoving());
+}
+
+static void test_visca_position_inquiry() {
+  sendVisca(0x0110, g_seq++, {0x81, 0x09, 0x06, 0x12, 0xFF});
+  const std::vector<std::vector<uint8_t>> got = replies(1);
+  TEST_ASSERT_EQUAL(1, got.size());
+  const std::vector<uint8_t> reply = viscaPayload(got[0]);
+  TEST_ASSERT_EQUAL(11, reply.size());
+  const int16_t pan = static_cast<int16_t>((reply[2] << 12) | (reply[3] << 8) | (reply[4] << 4) | reply[5]);
+  TEST_ASSERT_EQUAL_INT(lroundf(g_motion.state().pos[ptz::kAxisPan] / ptz::kViscaPanStepsPerUnit), pan);
+}
+
+static void test_stale_and_malformed_datagrams_are_counted() {
+  const ptz::UdpStats before = g_udp.stats();
+  sendVisca(0x0110, g_seq - 1, {0x81, 0x09, 0x06, 0x12, 0xFF}); // repeated seq
+  sendRaw({0x01, 0x00, 0x00});                                     // too short
+  sendVisca(0x0100, g_seq, {});                               // empty payload
+  sendRaw(std::vector<uint8_t>(100, 0x81));                        // larger than any command
+  TEST_ASSERT_EQUAL(0, replies().size());
+
+  const ptz::UdpStats after = g_udp.stats();
+  TEST_ASSERT_EQUAL_UINT32(before.datagrams + 4, after.datagrams);
+  TEST_ASSERT_EQUAL_UINT32(before.stale + 1, after.stale);
+  TEST_ASSERT_EQUAL_UINT32(before.malformed + 3, after.malformed);
+}
+
+static void test_native_velocity_move_and_release() {
+  sendNative(ptz::kSerialCmdRequestControl, g_seq++);
+  std::vector<std::vector<uint8_t>> got = replies(1);
+  TEST_ASSERT_EQUAL(1, got.size());
+  TEST_ASSERT_EQUAL_HEX8(ptz::kSerialMsgAck, got[0][3]);
+
+  // Velocity datagrams are not acknowledged.
+  std::vector<uint8_t> velocity(6);
+  ptz::writeU16(&velocity[0], static_cast<uint16_t>(-16000));
+  sendNative(ptz::kSerialCmdSetVelocity, g_seq++, velocity);
+  TEST_ASSERT_EQUAL(0, replies(1).size());
+  TEST_ASSERT_TRUE(g_motion.velocityCommand().norm[ptz::kAxisPan] < 0.0f);
+  sendNative(ptz::kSerialCmdSetVelocity, g_seq++, std::vector<uint8_t>(6, 0));
+  replies(1);
+  holdForMs(1500);
+
+  std::vector<uint8_t> target(12, 0);
+  ptz::writeU32(&target[0], 400);
+  sendNative(ptz::kSerialCmdMoveTo, g_seq++, target);
+  got = replies(1);
+  TEST_ASSERT_EQUAL(1, got.size());
+  TEST_ASSERT_EQUAL_HEX8(ptz::kSerialMsgAck, got[0][3]);
+  TEST_ASSERT_EQUAL_UINT32(g_seq - 1, ptz::readU32(&got[0][4]));
+  holdForMs(2000);
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 400.0f, g_motion.state().pos[ptz::kAxisPan]);
+
+  sendNative(ptz::kSerialCmdReleaseControl, g_seq++);
+  got = replies(1);
+  TEST_ASSERT_EQUAL(1, got.size());
+  TEST_ASSERT_EQUAL_HEX8(ptz::kSerialMsgAck, got[0][3]);
+
+  // Without control, commands are refused.
+  sendNative(ptz::kSerialCmdStop, g_seq++);
+  got = replies(1);
+  TEST_ASSERT_EQUAL(1, got.size());
+  TEST_ASSERT_EQUAL_HEX8(ptz::kSerialMsgError, got[0][3]);
+  TEST_ASSERT_EQUAL_HEX8(ptz::kSerialErrNotOwner, got[0][9]);
+}
+
+// A datagram is handled, and answered, in the loop pass that receives it.
+static void test_reply_in_same_pass() {
+  for (int i = 0; i < 200; ++i) {
+    sendVisca(0x0110, g_seq++, {0x81, 0x09, 0x04, 0x47, 0xFF});
+    TEST_ASSERT_EQUAL(1, replies(1).size());
+  }
+}
+
+// Owner ids are per address and port: same last octet on another subnet, or
+// another port on the same host, is another client.
+static void test_peer_ids_key_on_address_and_port() {
+  ptz::UdpPeerTable peers;
+  const uint32_t lan = static_cast<uint32_t>(IPAddress(192, 168, 1, 20));
+  const uint32_t other = static_cast<uint32_t>(IPAddress(10, 0, 0, 20));
+  const uint32_t a = peers.clientId(lan, 52381, 0, 0);
+  const uint32_t b = peers.clientId(other, 52381, 0, 0);
+  const uint32_t c = peers.clientId(lan, 52382, 0, 0);
+  TEST_ASSERT_TRUE(isUdpClientId(a) && isUdpClientId(b) && isUdpClientId(c));
+  TEST_ASSERT_TRUE(a != b && a != c && b != c);
+  TEST_ASSERT_EQUAL_UINT32(a, peers.clientId(lan, 52381, 100, 0));
+
+  // A full table evicts the least recently heard peer, but never the owner,
+  // and the newcomer gets a fresh id rather than the evicted one.
+  uint32_t ids[ptz::kUdpMaxPeers + 1] = {a, b, c};
+  for (uint8_t i = 3; i < ptz::kUdpMaxPeers; ++i) {
+    ids[i] = peers.clientId(lan, static_cast<uint16_t>(60000 + i), 200 + i, 0);
+  }
+  const uint32_t newcomer = peers.clientId(other, 1, 1000, a);
+  for (uint8_t i = 0; i < ptz::kUdpMaxPeers; ++i) {
+    TEST_ASSERT_TRUE(newcomer != ids[i]);
+  }
+  TEST_ASSERT_EQUAL_UINT32(a, peers.clientId(lan, 52381, 1001, a));
+  TEST_ASSERT_TRUE(peers.clientId(other, 52381, 1002, a) != b); // b was evicted
+}
+
+// A second VISCA controller on the same host cannot drive a head the first
+// one holds.
+static void test_second_port_on_same_host_is_refused() {
+  sendVisca(0x0100, g_seq++, {0x81, 0x01, 0x06, 0x01, 0x18, 0x14, 0x03, 0x03, 0xFF});
+  replies();
+  const uint32_t owner = g_owner.snapshot().controlClientId;
+  TEST_ASSERT_TRUE(isUdpClientId(owner));
+
+  host::device = 1;
+  WiFiUDP second;
+  host::device = 0;
+  second.begin(50001);
+  const std::vector<uint8_t> drive = {0x81, 0x01, 0x06, 0x01, 0x18, 0x14, 0x01, 0x03, 0xFF};
+  std::vector<uint8_t> datagram = {0x01, 0x00, 0x00, static_cast<uint8_t>(drive.size()), 0, 0, 0, 1};
+  datagram.insert(datagram.end(), drive.begin(), drive.end());
+  second.beginPacket(headIp(), ptz::kUdpControlPort);
+  second.write(datagram.data(), datagram.size());
+  second.endPacket();
+  rig::pass();
+  std::vector<uint8_t> reply(static_cast<size_t>(second.parsePacket()));
+  TEST_ASSERT_EQUAL(12, reply.size());
+  second.read(reply.data(), reply.size());
+  TEST_ASSERT_TRUE(viscaPayload(reply) == std::vector<uint8_t>({0x90, 0x61, 0x41, 0xFF}));
+  TEST_ASSERT_EQUAL_UINT32(owner, g_owner.snapshot().controlClientId);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, g_motion.velocityCommand().norm[ptz::kAxisPan]);
+}
+
+static void test_metrics_reports_udp_stats() {
+  const int client = rig::ws().hostConnect("/ws");
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(client, "\"type\":\"metrics\"", "metrics", reply));
+  const ptz::UdpStats stats = g_udp.stats();
+  TEST_ASSERT_EQUAL_UINT32(stats.datagrams, reply["udp"]["datagrams"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(stats.stale, reply["udp"]["stale"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(stats.malformed, reply["udp"]["malformed"].as<uint32_t>());
+  rig::ws().hostClose(client);
+  rig::pass();
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_visca_drive_takes_control_and_moves);
+  RUN_TEST(test_visca_position_inquiry);
+  RUN_TEST(test_stale_and_malformed_datagrams_are_counted);
+  RUN_TEST(test_native_velocity_move_and_release);
+  RUN_TEST(test_reply_in_same_pass);
+  RUN_TEST(test_peer_ids_key_on_address_and_port);
+  RUN_TEST(test_second_port_on_same_host_is_refused);
+  RUN_TEST(test_metrics_reports_udp_stats);
+  return UNITY_END();
+}
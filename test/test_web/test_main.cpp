@@ -0,0 +1,108 @@
+// The control page server against the whole head: the web task is a real
+// thread like the ESP32's core 0 task, requests come from the stand-in
+// WebServer, and the loop keeps running passes in virtual time.
+#include <WebServer.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "head_rig.h"
+#include "ptz_web_assets.h"
+
+static int g_observer = -1;
+
+static WebServer& server() {
+  return *host::webServer(ptz::kWebPort);
+}
+
+static host::ServedResponse get(const std::string& uri, const std::map<std::string, std::string>& headers = {}) {
+  server().hostRequest(uri, headers);
+  const std::vector<host::ServedResponse> responses = server().hostTakeResponses(1);
+  TEST_ASSERT_EQUAL(1, responses.size());
+  return responses[0];
+}
+
+static JsonObject webMetrics(JsonDocument& reply) {
+  TEST_ASSERT_TRUE(rig::request(g_observer, "\"type\":\"metrics\"", "metrics", reply));
+  return reply["web"];
+}
+
+void setUp() {
+  rig::boot();
+  if (g_observer < 0) {
+    g_observer = rig::ws().hostConnect("/ws?role=observer");
+  }
+}
+
+void tearDown() {}
+
+static void test_serves_gzipped_page_with_etag() {
+  const ptz::WebAsset& index = ptz::kWebAssets[0];
+  JsonDocument reply;
+  const uint32_t requestsBefore = webMetrics(reply)["requests"].as<uint32_t>();
+  const uint32_t bytesBefore = reply["web"]["bytes"].as<uint32_t>();
+
+  const host::ServedResponse page = get("/");
+  TEST_ASSERT_EQUAL(200, page.code);
+  TEST_ASSERT_EQUAL_STRING("gzip", page.headers.at("Content-Encoding").c_str());
+  TEST_ASSERT_EQUAL_STRING(index.etag, page.headers.at("ETag").c_str());
+  TEST_ASSERT_EQUAL_STRING("no-cache", page.headers.at("Cache-Control").c_str());
+  TEST_ASSERT_EQUAL(index.size, page.bodyBytes);
+
+  const host::ServedResponse cached = get("/index.html", {{"If-None-Match", index.etag}});
+  TEST_ASSERT_EQUAL(304, cached.code);
+  TEST_ASSERT_EQUAL(0, cached.bodyBytes);
+  TEST_ASSERT_EQUAL(404, get("/missing.js").code);
+
+  JsonObject web = webMetrics(reply);
+  TEST_ASSERT_EQUAL_UINT32(requestsBefore + 3, web["requests"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(bytesBefore + index.size, web["bytes"].as<uint32_t>());
+  TEST_ASSERT_GREATER_OR_EQUAL(1, web["notModified"].as<uint32_t>());
+  TEST_ASSERT_GREATER_OR_EQUAL(1, web["notFound"].as<uint32_t>());
+}
+
+// Page loads run on the web task and share nothing with loop(). loop() is
+// timed on the wall clock for one second idle and one second with the
+// server kept busy with full page loads; the median pass must not move.
+static void test_page_loads_do_not_slow_the_loop() {
+  auto timePasses = [&](bool load) {
+    std::vector<uint32_t> ns;
+    const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    uint32_t queued = 0;
+    while (std::chrono::steady_clock::now() < end) {
+      if (load && queued <= g_web.stats().requests) {
+        server().hostRequest("/");
+        queued = g_web.stats().requests + 1;
+      }
+      const auto start = std::chrono::steady_clock::now();
+      loop();
+      const auto stop = std::chrono::steady_clock::now();
+      ns.push_back(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+      host::advanceUs(rig::passUs);
+      rig::ws().hostDrain(static_cast<uint8_t>(g_observer));
+      rig::ws().hostTake(static_cast<uint8_t>(g_observer));
+    }
+    std::sort(ns.begin(), ns.end());
+    return std::make_pair(ns[ns.size() / 2], ns[ns.size() * 99 / 100]);
+  };
+
+  const auto idle = timePasses(false);
+  const uint32_t before = g_web.stats().requests;
+  const auto busy = timePasses(true);
+  const uint32_t served = g_web.stats().requests - before;
+  server().hostTakeResponses(served, 100);
+
+  printf("loop() wall time idle p50 %.2f us p99 %.2f us, serving p50 %.2f us p99 %.2f us (%u page loads)\n",
+         idle.first / 1000.0, idle.second / 1000.0, busy.first / 1000.0, busy.second / 1000.0, served);
+  TEST_ASSERT_GREATER_THAN(50, served);
+  TEST_ASSERT_LESS_OR_EQUAL(idle.first * 3 / 2 + 2000, busy.first);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_serves_gzipped_page_with_etag);
+  RUN_TEST(test_page_loads_do_not_slow_the_loop);
+  return UNITY_END();
+}
@@ -0,0 +1,181 @@
+// Per-command cost of the WebSocket handler: every command type is delivered
+// PTZ_BENCH_ITERATIONS times (default 2000) with a valid payload and timed
+// on the wall clock around the handler alone; replies are flushed untimed
+// between messages. Prints messages/s, mean, p99 and worst case per command.
+// Host numbers rank commands and catch regressions; they are not ESP32
+// timings. With PTZ_BENCH_MAX_US set, any worst case above it fails.
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "head_rig.h"
+
+struct BenchCommand {
+  const char* body;
+  const char* reply;   // expected reply type
+  const char* cleanup; // untimed follow-up that restores state, or nullptr
+};
+
+static const BenchCommand kCommands[] = {
+    {"\"type\":\"metrics\"", "metrics", nullptr},
+    {"\"type\":\"commandStats\"", "commandStats", nullptr},
+    {"\"type\":\"txStats\"", "txStats", nullptr},
+    {"\"type\":\"listRecordings\"", "recordings", nullptr},
+    {"\"type\":\"listProfiles\"", "profiles", nullptr},
+    {"\"type\":\"listShapers\"", "shapers", nullptr},
+    {"\"type\":\"exportRecording\",\"slot\":0", "recording", nullptr},
+    {"\"type\":\"timeSync\",\"t0\":1000000", "timeSync", nullptr},
+    {"\"type\":\"otaStatus\"", "ota", nullptr},
+    {"\"type\":\"groupStatus\"", "group", nullptr},
+    {"\"type\":\"requestControl\"", "ack", nullptr},
+    {"\"type\":\"releaseControl\"", "ack", nullptr},
+    {"\"type\":\"setVelocity\",\"pan\":0.2,\"tilt\":-0.1,\"zoom\":0", "ack", nullptr},
+    {"\"type\":\"moveTo\",\"pan\":100,\"tilt\":50,\"zoom\":0", "ack", nullptr},
+    {"\"type\":\"stop\"", "ack", nullptr},
+    {"\"type\":\"queueMove\",\"points\":[[0,0,0],[200,100,0],[400,0,0]]", "queue", "\"type\":\"queueFlush\""},
+    {"\"type\":\"queueFlush\"", "queue", nullptr},
+    {"\"type\":\"queueStatus\"", "queue", nullptr},
+    {"\"type\":\"recordStart\",\"slot\":1", "ack", "\"type\":\"recordStop\""},
+    {"\"type\":\"recordStop\"", "ack", nullptr},
+    {"\"type\":\"playStart\",\"slot\":0", "ack", "\"type\":\"playStop\""},
+    {"\"type\":\"playStop\"", "ack", nullptr},
+    {"\"type\":\"selectProfile\",\"index\":0", "ack", nullptr},
+    {"\"type\":\"saveProfile\",\"index\":1,\"name\":\"bench\",\"pan\":{\"maxSps\":3000}", "ack", nullptr},
+    {"\"type\":\"otaStart\",\"url\":\"http://192.168.1.2/fw.bin\",\"sha256\":"
+     "\"0000000000000000000000000000000000000000000000000000000000000000\"",
+     "ack", "\"type\":\"otaAbort\""},
+    {"\"type\":\"otaAbort\"", "ack", nullptr},
+    {"\"type\":\"otaReboot\"", "error", nullptr},
+    {"\"type\":\"recallPreset\",\"index\":0", "ack", "\"type\":\"stop\""},
+    {"\"type\":\"scheduleCancel\"", "ack", nullptr},
+    {"\"type\":\"groupJoin\",\"group\":0,\"head\":1", "group", nullptr},
+    {"\"type\":\"setShaper\",\"pan\":{\"shaper\":\"zv\",\"freqHz\":8}", "shapers", nullptr},
+    {"\"type\":\"setFreed\",\"enabled\":false", "freed", nullptr},
+    {"\"type\":\"setRole\",\"role\":\"controller\"", "ack", nullptr},
+    {"\"type\":\"observe\"", "ack", nullptr},
+    {"\"type\":\"noSuchCommand\"", "error", nullptr},
+    {"{not json", "error", nullptr},
+};
+
+static int g_client = -1;
+static uint32_t g_worstUs = 0;
+
+static void deliver(const std::string& text) {
+  rig::ws().hostDeliver(static_cast<uint8_t>(g_client), reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+static std::string frame(const char* body) {
+  // The malformed entry is sent as is.
+  return body[0] == '{' ? std::string(body) : "{\"v\":1,\"source\":\"app\"," + std::string(body) + "}";
+}
+
+// Runs passes, reading like a client that keeps up, until every queued
+// reply is out.
+static void settle(uint32_t minPasses = 1) {
+  for (uint32_t i = 0; i < 1000 && (i < minPasses || g_ws.txStats(static_cast<uint8_t>(g_client)).queued > 0); ++i) {
+    rig::pass();
+    rig::ws().hostDrain(static_cast<uint8_t>(g_client));
+  }
+}
+
+// Connected as a controller again after observe (or anything else) changed it.
+static void resetClient() {
+  if (g_client >= 0 && rig::ws().hostConnected(static_cast<uint8_t>(g_client)) &&
+      !g_ws.txStats(static_cast<uint8_t>(g_client)).observer) {
+    return;
+  }
+  if (g_client >= 0) {
+    rig::ws().hostClose(static_cast<uint8_t>(g_client));
+    rig::pass();
+  }
+  g_client = rig::ws().hostConnect("/ws");
+  rig::pass();
+}
+
+static bool lastReplyIs(const char* type) {
+  for (const std::string& text : rig::ws().hostTake(static_cast<uint8_t>(g_client))) {
+    JsonDocument doc;
+    if (!deserializeJson(doc, text) && strcmp(doc["type"] | "", type) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_every_command_is_benchmarked() {
+  const char* env = getenv("PTZ_BENCH_ITERATIONS");
+  const uint32_t iterations = env ? static_cast<uint32_t>(strtoul(env, nullptr, 10)) : 2000;
+
+  // A recording in slot 0 for exportRecording and playStart.
+  resetClient();
+  deliver(frame("\"type\":\"requestControl\""));
+  deliver(frame("\"type\":\"recordStart\",\"slot\":0"));
+  deliver(frame("\"type\":\"setVelocity\",\"pan\":0.3,\"tilt\":0,\"zoom\":0"));
+  settle(2000);
+  deliver(frame("\"type\":\"stop\""));
+  deliver(frame("\"type\":\"recordStop\""));
+  settle();
+
+  printf("%-16s %12s %10s %10s %10s\n", "command", "msgs/s", "mean us", "p99 us", "worst us");
+  for (const BenchCommand& command : kCommands) {
+    const std::string text = frame(command.body);
+    std::vector<uint32_t> samples;
+    samples.reserve(iterations);
+    bool replied = true;
+    for (uint32_t i = 0; i < iterations; ++i) {
+      resetClient();
+      deliver(frame("\"type\":\"requestControl\""));
+      settle();
+      rig::ws().hostTake(static_cast<uint8_t>(g_client));
+
+      const auto start = std::chrono::steady_clock::now();
+      deliver(text);
+      const auto end = std::chrono::steady_clock::now();
+      samples.push_back(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+
+      settle();
+      if (i == 0) {
+        replied = lastReplyIs(command.reply);
+      }
+      if (command.cleanup) {
+        deliver(frame(command.cleanup));
+        settle();
+      }
+    }
+    TEST_ASSERT_TRUE_MESSAGE(replied, command.body);
+
+    uint64_t totalNs = 0;
+    for (uint32_t ns : samples) {
+      totalNs += ns;
+    }
+    std::sort(samples.begin(), samples.end());
+    const uint32_t p99Ns = samples[samples.size() * 99 / 100];
+    const uint32_t worstNs = samples.back();
+    const double meanNs = static_cast<double>(totalNs) / samples.size();
+    char name[17];
+    const char* type = strstr(command.body, "\"type\":\"");
+    snprintf(name, sizeof(name), "%.*s", type ? static_cast<int>(strcspn(type + 8, "\"")) : 10,
+             type ? type + 8 : command.body);
+    printf("%-16s %12.0f %10.2f %10.2f %10.2f\n", name, 1e9 / meanNs, meanNs / 1000.0, p99Ns / 1000.0,
+           worstNs / 1000.0);
+    g_worstUs = std::max(g_worstUs, worstNs / 1000);
+  }
+
+  const char* limit = getenv("PTZ_BENCH_MAX_US");
+  if (limit) {
+    TEST_ASSERT_LESS_OR_EQUAL(strtoul(limit, nullptr, 10), g_worstUs);
+  }
+}
+
+int main() {
+  rig::boot();
+  UNITY_BEGIN();
+  RUN_TEST(test_every_command_is_benchmarked);
+  return UNITY_END();
+}
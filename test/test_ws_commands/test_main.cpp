@@ -0,0 +1,131 @@
+// WebSocket command handling against the whole head: a rejected command
+// must leave every piece of state it would have touched unchanged.
+#include <unity.h>
+
+#include <string>
+
+#include "head_rig.h"
+
+static int g_client = -1;
+
+static std::string points(int count) {
+  std::string text = "[";
+  for (int i = 0; i < count; ++i) {
+    text += (i ? ",[" : "[") + std::to_string(i * 100) + ",0,0]";
+  }
+  return text + "]";
+}
+
+static void expectError(const std::string& body, const char* code) {
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, body, "error", reply));
+  TEST_ASSERT_EQUAL_STRING(code, reply["code"] | "");
+}
+
+static bool playing() {
+  return g_recorder.mode() == ptz::RecorderMode::Preroll || g_recorder.mode() == ptz::RecorderMode::Playing;
+}
+
+void setUp() {
+  rig::boot();
+  if (g_client < 0) {
+    g_client = rig::ws().hostConnect("/ws");
+  }
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"requestControl\"", "ack", reply));
+}
+
+void tearDown() {
+  JsonDocument reply;
+  rig::request(g_client, "\"type\":\"playStop\"", "ack", reply);
+  rig::request(g_client, "\"type\":\"queueFlush\"", "queue", reply);
+}
+
+static void test_queue_move_applies_tolerance_and_appends() {
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"queueMove\",\"tolerance\":40,\"pan\":500,\"tilt\":0,\"zoom\":0",
+                                "queue", reply));
+  TEST_ASSERT_EQUAL_FLOAT(40.0f, reply["tolerance"].as<float>());
+  TEST_ASSERT_EQUAL(1, reply["depth"].as<int>());
+}
+
+static void test_rejected_queue_move_leaves_playback_and_tolerance() {
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"recordStart\",\"slot\":0", "ack", reply));
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"setVelocity\",\"pan\":0.5,\"tilt\":0,\"zoom\":0", "ack", reply));
+  rig::runForMs(300);
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"setVelocity\",\"pan\":0,\"tilt\":0,\"zoom\":0", "ack", reply));
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"recordStop\"", "ack", reply));
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"playStart\",\"slot\":0", "ack", reply));
+  TEST_ASSERT_TRUE(playing());
+  const float tolerance = g_planner.blendTolerance();
+
+  expectError("\"type\":\"queueMove\",\"tolerance\":5,\"points\":[[1,2]]", "invalid_payload");
+  expectError("\"type\":\"queueMove\",\"tolerance\":5,\"points\":[[1,2,3],[4,\"x\",6]]", "invalid_payload");
+  expectError("\"type\":\"queueMove\",\"tolerance\":5,\"points\":" + points(ptz::kPathQueueSize + 1), "queue_full");
+  expectError("\"type\":\"queueMove\",\"tolerance\":5,\"pan\":1,\"tilt\":2", "invalid_payload");
+
+  TEST_ASSERT_TRUE(playing());
+  TEST_ASSERT_EQUAL_FLOAT(tolerance, g_planner.blendTolerance());
+  TEST_ASSERT_EQUAL(0, g_planner.depth());
+
+  // A valid path takes over from playback.
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"queueMove\",\"tolerance\":5,\"points\":" + points(3), "queue",
+                                reply));
+  TEST_ASSERT_FALSE(playing());
+  TEST_ASSERT_EQUAL_FLOAT(5.0f, g_planner.blendTolerance());
+}
+
+static void test_full_queue_rejects_single_target_untouched() {
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"queueMove\",\"points\":" + points(ptz::kPathQueueSize), "queue",
+                                reply));
+  TEST_ASSERT_EQUAL(0, reply["free"].as<int>());
+  const float tolerance = g_planner.blendTolerance();
+  expectError("\"type\":\"queueMove\",\"tolerance\":77,\"pan\":9,\"tilt\":9,\"zoom\":9", "queue_full");
+  TEST_ASSERT_EQUAL_FLOAT(tolerance, g_planner.blendTolerance());
+}
+
+// Preset, profile and slot numbers are integers below their table size;
+// anything else used to be narrowed to uint8_t, so 256 selected entry 0.
+static void test_out_of_range_indices_are_rejected() {
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"saveProfile\",\"index\":1,\"name\":\"one\"", "ack", reply));
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"selectProfile\",\"index\":1", "ack", reply));
+  const ptz::MotionProfile before = *g_profiles.get(0);
+
+  for (const char* index : {"256", "-1", "1.5", "\"0\""}) {
+    const std::string field = std::string(",\"index\":") + index;
+    expectError("\"type\":\"recallPreset\"" + field, "invalid_payload");
+    expectError("\"type\":\"selectProfile\"" + field, "invalid_profile");
+    expectError("\"type\":\"saveProfile\",\"name\":\"clobbered\"" + field, "invalid_profile");
+    const std::string slot = std::string(",\"slot\":") + index;
+    expectError("\"type\":\"recordStart\"" + slot, "invalid_slot");
+    expectError("\"type\":\"playStart\"" + slot, "invalid_slot");
+  }
+  expectError("\"type\":\"selectProfile\"", "invalid_profile");
+
+  TEST_ASSERT_EQUAL(1, g_profiles.active());
+  TEST_ASSERT_EQUAL_STRING(before.name, g_profiles.get(0)->name);
+  TEST_ASSERT_EQUAL(ptz::RecorderMode::Idle, g_recorder.mode());
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"selectProfile\",\"index\":0", "ack", reply));
+}
+
+// A bad slot is refused before playback's path queue is flushed.
+static void test_play_start_with_bad_slot_keeps_queue() {
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(g_client, "\"type\":\"queueMove\",\"points\":" + points(3), "queue", reply));
+  const uint8_t depth = g_planner.depth();
+  expectError("\"type\":\"playStart\",\"slot\":256", "invalid_slot");
+  TEST_ASSERT_EQUAL(depth, g_planner.depth());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_queue_move_applies_tolerance_and_appends);
+  RUN_TEST(test_rejected_queue_move_leaves_playback_and_tolerance);
+  RUN_TEST(test_full_queue_rejects_single_target_untouched);
+  RUN_TEST(test_out_of_range_indices_are_rejected);
+  RUN_TEST(test_play_start_with_bad_slot_keeps_queue);
+  return UNITY_END();
+}
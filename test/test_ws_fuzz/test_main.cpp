@@ -0,0 +1,181 @@
+// Replays the WebSocket fuzz corpus (tools/fuzz/corpus/ws) and a fixed-seed
+// batch of mutations of it through the fuzz target, so every host test run
+// covers the fuzzer's entry point without clang. Each input must draw at
+// least one well-formed reply, and the head must keep serving afterwards.
+//
+// PTZ_FUZZ_CORPUS overrides the corpus directory, PTZ_FUZZ_ITERATIONS the
+// number of mutations (default 20000).
+#include <dirent.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ws_fuzz_target.h"
+
+static std::vector<std::string> g_corpus;
+static uint64_t g_rng = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t nextRandom() {
+  g_rng ^= g_rng << 13;
+  g_rng ^= g_rng >> 7;
+  g_rng ^= g_rng << 17;
+  return static_cast<uint32_t>(g_rng >> 16);
+}
+
+static std::vector<std::string> loadCorpus(const char* dir) {
+  std::vector<std::string> inputs;
+  DIR* handle = opendir(dir);
+  if (!handle) {
+    return inputs;
+  }
+  std::vector<std::string> names;
+  while (dirent* entry = readdir(handle)) {
+    if (entry->d_name[0] != '.') {
+      names.push_back(entry->d_name);
+    }
+  }
+  closedir(handle);
+  std::sort(names.begin(), names.end());
+  for (const std::string& name : names) {
+    std::ifstream file(std::string(dir) + "/" + name, std::ios::binary);
+    std::stringstream text;
+    text << file.rdbuf();
+    inputs.push_back(text.str());
+  }
+  return inputs;
+}
+
+static const char* const kTokens[] = {
+    "{", "}", "[", "]", ",", ":", "\"", "null", "true", "-1", "1e39", "256", "0.5", "\"type\"", "\"pan\"",
+    "\"slot\"", "\"index\"", "\"points\"", "\"at\"", "\\u0000", "\xff",
+};
+
+static std::string mutate(std::string input) {
+  const uint32_t rounds = 1 + nextRandom() % 4;
+  for (uint32_t r = 0; r < rounds; ++r) {
+    const size_t at = input.empty() ? 0 : nextRandom() % (input.size() + 1);
+    switch (nextRandom() % 6) {
+      case 0: // flip a bit
+        if (!input.empty()) {
+          input[at % input.size()] ^= static_cast<char>(1 << (nextRandom() % 8));
+        }
+        break;
+      case 1: // insert a token
+        input.insert(at, kTokens[nextRandom() % (sizeof(kTokens) / sizeof(kTokens[0]))]);
+        break;
+      case 2: // truncate
+        input.resize(at);
+        break;
+      case 3: { // delete a run
+        const size_t len = nextRandom() % 8;
+        input.erase(at, len);
+        break;
+      }
+      case 4: { // splice in part of another seed
+        const std::string& other = g_corpus[nextRandom() % g_corpus.size()];
+        const size_t from = other.empty() ? 0 : nextRandom() % other.size();
+        input.insert(at, other.substr(from, nextRandom() % 64));
+        break;
+      }
+      default: { // insert a random number
+        char number[16];
+        snprintf(number, sizeof(number), "%d", static_cast<int>(nextRandom()) >> (nextRandom() % 31));
+        input.insert(at, number);
+        break;
+      }
+    }
+  }
+  return input;
+}
+
+// Runs one input and checks its replies; returns false with a message on
+// the first malformed one.
+static bool runAndCheck(const std::string& input, std::string* why) {
+  const std::deque<std::string> replies =
+      fuzz::runOne(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+  bool answered = false;
+  for (const std::string& text : replies) {
+    JsonDocument doc;
+    if (deserializeJson(doc, text) || doc["v"].as<int>() != 1 || !doc["type"].is<const char*>()) {
+      *why = "malformed reply: " + text;
+      return false;
+    }
+    answered |= strcmp(doc["type"] | "", "status") != 0;
+  }
+  if (!answered) {
+    *why = "no reply";
+  }
+  return answered;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_corpus_replays_cleanly() {
+  TEST_ASSERT_TRUE_MESSAGE(g_corpus.size() > 10, "corpus not found; set PTZ_FUZZ_CORPUS");
+  for (const std::string& input : g_corpus) {
+    std::string why;
+    TEST_ASSERT_TRUE_MESSAGE(runAndCheck(input, &why), (why + " for " + input.substr(0, 200)).c_str());
+  }
+}
+
+static void test_mutations_replay_cleanly() {
+  const char* env = getenv("PTZ_FUZZ_ITERATIONS");
+  const uint32_t iterations = env ? static_cast<uint32_t>(strtoul(env, nullptr, 10)) : 20000;
+  for (uint32_t i = 0; i < iterations; ++i) {
+    const std::string input = mutate(g_corpus[nextRandom() % g_corpus.size()]);
+    std::string why;
+    if (!runAndCheck(input, &why)) {
+      // Print the input so it can be replayed with the standalone fuzzer.
+      printf("iteration %u input (%zu bytes): %s\n", i, input.size(), input.substr(0, 400).c_str());
+      TEST_FAIL_MESSAGE(why.c_str());
+    }
+  }
+}
+
+// Found by the fuzzer: 1e39 parses as a number but overflows float, and the
+// infinite target overflowed lroundf() in the motion layer.
+static void test_non_finite_targets_are_rejected() {
+  const float before = g_motion.state().target[ptz::kAxisPan];
+  const std::string input = "{\"v\":1,\"source\":\"app\",\"type\":\"moveTo\",\"pan\":1e39,\"tilt\":0,\"zoom\":0}";
+  bool rejected = false;
+  for (const std::string& text : fuzz::runOne(reinterpret_cast<const uint8_t*>(input.data()), input.size())) {
+    rejected |= text.find("\"invalid_payload\"") != std::string::npos;
+  }
+  TEST_ASSERT_TRUE(rejected);
+  TEST_ASSERT_EQUAL_FLOAT(before, g_motion.state().target[ptz::kAxisPan]);
+
+  // Direct callers are clamped to a range every target converts from.
+  g_motion.moveAxisTo(ptz::kAxisPan, INFINITY);
+  TEST_ASSERT_EQUAL_FLOAT(before, g_motion.state().target[ptz::kAxisPan]);
+  g_motion.moveAxisTo(ptz::kAxisPan, 3e9f);
+  TEST_ASSERT_EQUAL_FLOAT(ptz::kMaxTargetSteps, g_motion.state().target[ptz::kAxisPan]);
+  g_motion.stop();
+}
+
+static void test_head_still_serves_after_fuzzing() {
+  const int observer = rig::ws().hostConnect("/ws?role=observer");
+  TEST_ASSERT_GREATER_OR_EQUAL(0, observer);
+  JsonDocument reply;
+  TEST_ASSERT_TRUE(rig::request(observer, "\"type\":\"metrics\"", "metrics", reply));
+  TEST_ASSERT_TRUE(rig::await(observer, "status", reply, 500));
+  rig::ws().hostClose(observer);
+  rig::pass();
+}
+
+int main() {
+  const char* dir = getenv("PTZ_FUZZ_CORPUS");
+  g_corpus = loadCorpus(dir ? dir : "tools/fuzz/corpus/ws");
+  UNITY_BEGIN();
+  RUN_TEST(test_corpus_replays_cleanly);
+  if (!g_corpus.empty()) {
+    RUN_TEST(test_mutations_replay_cleanly);
+  }
+  RUN_TEST(test_non_finite_targets_are_rejected);
+  RUN_TEST(test_head_still_serves_after_fuzzing);
+  return UNITY_END();
+}
@@ -0,0 +1,63 @@
+// Fuzz entry for the WebSocket command handler (PtzWebSocket::handleText and
+// everything it dispatches to), built against the host stand-ins in
+// test/stubs. From the repository root, after one `pio test -e native` has
+// fetched ArduinoJson and generated the web assets:
+//
+//   libFuzzer (clang):
+//     SRC=$(ls src/*.cpp | grep -v main.cpp)
+//     clang++ -std=gnu++17 -g -O1 -fsanitize=fuzzer,address,undefined \
+//       -Isrc -Itest/stubs -Itest/host -I.pio/libdeps/native/ArduinoJson/src \
+//       -I.pio/build/native/web_assets \
+//       -DWEBSOCKETS_SERVER_CLIENT_MAX=32 $SRC tools/fuzz/ws_fuzz.cpp \
+//       -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc -pthread -o ws_fuzz
+//     ./ws_fuzz -max_len=1100 -dict=tools/fuzz/ws.dict tools/fuzz/corpus/ws
+//
+//   AFL++: the same command with afl-clang-fast++ and -fsanitize=fuzzer, or
+//   add -DPTZ_FUZZ_STANDALONE (any compiler) for a binary that reads one
+//   input from each file argument, or from stdin without arguments:
+//     afl-fuzz -i tools/fuzz/corpus/ws -o out -- ./ws_fuzz
+//
+// The standalone build also replays crash files. Virtual time advances one
+// loop pass per input, so long runs also cover micros() wrap-around.
+#include <stdio.h>
+
+#include <vector>
+
+#include "ws_fuzz_target.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  fuzz::runOne(data, size);
+  return 0;
+}
+
+#ifdef PTZ_FUZZ_STANDALONE
+
+static std::vector<uint8_t> readAll(FILE* file) {
+  std::vector<uint8_t> bytes;
+  uint8_t buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    bytes.insert(bytes.end(), buffer, buffer + n);
+  }
+  return bytes;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    const std::vector<uint8_t> input = readAll(stdin);
+    return LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+  for (int i = 1; i < argc; ++i) {
+    FILE* file = fopen(argv[i], "rb");
+    if (!file) {
+      perror(argv[i]);
+      return 1;
+    }
+    const std::vector<uint8_t> input = readAll(file);
+    fclose(file);
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+  return 0;
+}
+
+#endif
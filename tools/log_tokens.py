@@ -0,0 +1,273 @@
+#!/usr/bin/env python3
+"""Token database and detokenizer for PTZ_LOG_TOKENIZED firmware builds.
+
+  log_tokens.py database src -o log_tokens.csv
+  log_tokens.py detokenize --db log_tokens.csv capture.bin
+  log_tokens.py detokenize --db log_tokens.csv --port /dev/ttyUSB0
+
+Tokens are the low 24 bits of FNV-1a hashes of "<level><tag>|<fmt>",
+computed the same way as ptz::logToken() in src/ptz_log.h. A log frame is
+0xA6 | uint24 token | args, with no length: the format string says how many
+arguments follow and of which kind. Token 0 followed by a token marks a line
+whose arguments did not fit the frame. Serial control frames
+(0xA5 | len | cmd | seq | payload | crc16) are skipped, and text outside
+frames is passed through unchanged.
+"""
+
+import argparse
+import csv
+import os
+import re
+import struct
+import sys
+
+SOF = 0xA5
+LOG_SOF = 0xA6
+TOKEN_MASK = 0xFFFFFF
+TOKEN_OVERFLOW = 0
+MAX_PAYLOAD = 64  # kLogTokenMaxPayload, token included
+
+CALL_RE = re.compile(r'PTZ_LOG([EWID])\s*\(\s*"((?:[^"\\]|\\.)*)"\s*,\s*((?:"(?:[^"\\]|\\.)*"\s*)+)')
+LITERAL_RE = re.compile(r'"((?:[^"\\]|\\.)*)"')
+SPEC_RE = re.compile(r'%([-+ #0]*)(\d+|\*)?(?:\.(\d+|\*))?(hh|h|ll|l|L|z|j|t)?([diouxXeEfFgGcsp%])')
+ESCAPES = {'n': '\n', 't': '\t', 'r': '\r', '\\': '\\', '"': '"', "'": "'", '0': '\0'}
+
+
+def fnv1a(text):
+    value = 2166136261
+    for byte in text.encode('utf-8'):
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def token(level, tag, fmt):
+    return fnv1a(level + tag + '|' + fmt) & TOKEN_MASK
+
+
+def unescape(literal):
+    return re.sub(r'\\(.)', lambda m: ESCAPES.get(m.group(1), m.group(1)), literal)
+
+
+def scan(paths):
+    entries = {}
+    for root in paths:
+        files = [root] if os.path.isfile(root) else [
+            os.path.join(d, f) for d, _, names in os.walk(root) for f in names if f.endswith(('.cpp', '.h'))]
+        for path in sorted(files):
+            with open(path, encoding='utf-8') as source:
+                text = source.read()
+            for match in CALL_RE.finditer(text):
+                level = match.group(1)
+                tag = unescape(match.group(2))
+                fmt = ''.join(unescape(part) for part in LITERAL_RE.findall(match.group(3)))
+                value = token(level, tag, fmt)
+                if value == TOKEN_OVERFLOW:
+                    raise SystemExit('token 0 is reserved: reword %r' % fmt)
+                previous = entries.get(value)
+                if previous and previous != (level, tag, fmt):
+                    raise SystemExit('token collision 0x%08x: %r vs %r' % (value, previous, (level, tag, fmt)))
+                entries[value] = (level, tag, fmt)
+    return entries
+
+
+def write_database(paths, output):
+    entries = scan(paths)
+    with open(output, 'w', newline='', encoding='utf-8') as out:
+        writer = csv.writer(out)
+        for value in sorted(entries):
+            level, tag, fmt = entries[value]
+            writer.writerow(['%06x' % value, level, tag, fmt])
+    return len(entries)
+
+
+def read_database(path):
+    with open(path, newline='', encoding='utf-8') as source:
+        return {int(row[0], 16): (row[1], row[2], row[3]) for row in csv.reader(source)}
+
+
+class Truncated(Exception):
+    """The arguments run past the bytes received so far."""
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+    while pos < len(data):
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return (value >> 1) ^ -(value & 1), pos
+        if shift >= 70:
+            raise ValueError('varint too long')
+    raise Truncated()
+
+
+def take(data, pos, size):
+    if pos + size > len(data):
+        raise Truncated()
+    return data[pos:pos + size], pos + size
+
+
+def format_args(fmt, data):
+    """Returns the formatted message and the number of argument bytes used."""
+    pos = 0
+    out = []
+    last = 0
+    for spec in SPEC_RE.finditer(fmt):
+        out.append(fmt[last:spec.start()])
+        last = spec.end()
+        flags, width, precision, _, conv = spec.groups()
+        if conv == '%':
+            out.append('%')
+            continue
+        pyspec = '%' + flags + (width or '') + ('.' + precision if precision else '')
+        if conv == 's':
+            size, pos = take(data, pos, 1)
+            value, pos = take(data, pos, size[0])
+            out.append((pyspec + 's') % value.decode('utf-8', 'replace'))
+        elif conv in 'eEfFgG':
+            value, pos = take(data, pos, 4)
+            out.append((pyspec + conv) % struct.unpack('<f', value))
+        else:
+            value, pos = read_varint(data, pos)
+            if conv == 'c':
+                out.append(chr(value & 0xFF))
+            elif conv == 'p':
+                out.append('0x%08x' % (value & 0xFFFFFFFF))
+            else:
+                if conv in 'uoxX' and value < 0:
+                    value &= 0xFFFFFFFF
+                out.append((pyspec + ('d' if conv in 'iu' else conv)) % value)
+    out.append(fmt[last:])
+    return ''.join(out), pos
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def read_token(data, pos):
+    raw, pos = take(data, pos, 3)
+    return raw[0] | (raw[1] << 8) | (raw[2] << 16), pos
+
+
+class Detokenizer:
+    def __init__(self, database, write):
+        self.database = database
+        self.write = write
+        self.buffer = bytearray()
+
+    def feed(self, chunk):
+        self.buffer.extend(chunk)
+        while self.buffer:
+            if self.buffer[0] == LOG_SOF:
+                used = self.log()
+            elif self.buffer[0] == SOF:
+                used = self.control()
+            else:
+                used = self.text()
+            if used is None:
+                return
+            del self.buffer[:used]
+
+    def finish(self):
+        """Flushes bytes held for a frame that never completed."""
+        if self.buffer:
+            self.write(self.buffer.decode('utf-8', 'replace'))
+            self.buffer.clear()
+
+    def text(self):
+        ends = [i for i in (self.buffer.find(bytes([SOF])), self.buffer.find(bytes([LOG_SOF]))) if i > 0]
+        end = min(ends) if ends else len(self.buffer)
+        self.write(self.buffer[:end].decode('utf-8', 'replace'))
+        return end
+
+    # Returns the bytes used, or None to wait for more. A 0xA6 whose
+    # arguments do not parse is dropped and scanning resumes after it.
+    def log(self):
+        data = bytes(self.buffer)
+        try:
+            value, pos = read_token(data, 1)
+            overflow = value == TOKEN_OVERFLOW
+            if overflow:
+                value, pos = read_token(data, pos)
+            entry = self.database.get(value)
+            if not entry:
+                # A stale database: the arguments cannot be delimited, so
+                # whatever follows the token passes through as text.
+                self.write('[?] LOG | unknown token %06x\n' % value)
+                return pos
+            level, tag, fmt = entry
+            if overflow:
+                message = fmt + ' <arguments did not fit>'
+            else:
+                message, used = format_args(fmt, data[pos:])
+                pos += used
+        except Truncated:
+            if len(data) < MAX_PAYLOAD + 1:
+                return None
+            return 1
+        except (ValueError, TypeError):
+            return 1
+        self.write('[%s] %s | %s\n' % (level, tag, message))
+        return pos
+
+    def control(self):
+        if len(self.buffer) < 2 or len(self.buffer) < self.buffer[1] + 6:
+            return None
+        size = self.buffer[1]
+        frame = bytes(self.buffer[:size + 6])
+        if crc16(frame[1:size + 4]) != frame[size + 4] | (frame[size + 5] << 8):
+            return 1
+        return size + 6
+
+
+def detokenize(args):
+    database = read_database(args.db)
+    out = Detokenizer(database, lambda text: (sys.stdout.write(text), sys.stdout.flush()))
+    if args.port:
+        import serial  # pyserial
+        with serial.Serial(args.port, args.baud, timeout=0.1) as port:
+            while True:
+                out.feed(port.read(256))
+    source = sys.stdin.buffer if args.input in (None, '-') else open(args.input, 'rb')
+    with source:
+        while True:
+            chunk = source.read(4096)
+            if not chunk:
+                break
+            out.feed(chunk)
+    out.finish()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest='command', required=True)
+
+    db = commands.add_parser('database', help='scan sources and write the token database')
+    db.add_argument('paths', nargs='+')
+    db.add_argument('-o', '--output', default='log_tokens.csv')
+
+    detok = commands.add_parser('detokenize', help='decode a capture or a live serial port')
+    detok.add_argument('--db', required=True)
+    detok.add_argument('--port')
+    detok.add_argument('--baud', type=int, default=115200)
+    detok.add_argument('input', nargs='?')
+
+    args = parser.parse_args()
+    if args.command == 'database':
+        count = write_database(args.paths, args.output)
+        print('%d tokens written to %s' % (count, args.output))
+    else:
+        detokenize(args)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,14 @@
+# PlatformIO pre-script: regenerates the token database for tokenized-log
+# builds next to firmware.bin so it always matches the flashed image.
+Import("env")  # noqa: F821
+
+import os
+import sys
+
+sys.path.insert(0, os.path.join(env.subst("$PROJECT_DIR"), "tools"))  # noqa: F821
+import log_tokens  # noqa: E402
+
+build_dir = env.subst("$BUILD_DIR")  # noqa: F821
+os.makedirs(build_dir, exist_ok=True)
+count = log_tokens.write_database([env.subst("$PROJECT_SRC_DIR")], os.path.join(build_dir, "log_tokens.csv"))  # noqa: F821
+print("log_tokens: %d tokens" % count)
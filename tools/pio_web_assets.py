@@ -0,0 +1,68 @@
+# PlatformIO pre-script: gzips everything under web/ and emits it as const
+# arrays in $BUILD_DIR/web_assets/ptz_web_assets.h, which src/ptz_web.cpp
+# serves straight from flash.
+Import("env")  # noqa: F821
+
+import gzip
+import hashlib
+import os
+
+CONTENT_TYPES = {
+    ".html": "text/html; charset=utf-8",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+    ".json": "application/json",
+}
+
+project_dir = env.subst("$PROJECT_DIR")  # noqa: F821
+web_dir = os.path.join(project_dir, "web")
+out_dir = os.path.join(env.subst("$BUILD_DIR"), "web_assets")  # noqa: F821
+os.makedirs(out_dir, exist_ok=True)
+
+assets = []
+for root, _, names in os.walk(web_dir):
+    for name in sorted(names):
+        path = os.path.join(root, name)
+        with open(path, "rb") as source:
+            raw = source.read()
+        # mtime=0 keeps the output, and so the ETag, reproducible.
+        data = gzip.compress(raw, compresslevel=9, mtime=0)
+        url = "/" + os.path.relpath(path, web_dir).replace(os.sep, "/")
+        etag = '\\"%s\\"' % hashlib.sha256(data).hexdigest()[:16]
+        ctype = CONTENT_TYPES.get(os.path.splitext(name)[1], "application/octet-stream")
+        assets.append((url, ctype, data, etag, len(raw)))
+
+lines = [
+    "// Generated by tools/pio_web_assets.py from web/. Do not edit.",
+    "#pragma once",
+    "",
+    '#include "ptz_web.h"',
+    "",
+    "namespace ptz {",
+    "",
+]
+for index, (url, _, data, _, raw_size) in enumerate(assets):
+    lines.append("// %s: %u bytes, %u gzipped" % (url, raw_size, len(data)))
+    lines.append("static const uint8_t kWebAsset%u[] = {" % index)
+    for offset in range(0, len(data), 20):
+        lines.append("    " + ",".join("0x%02x" % b for b in data[offset:offset + 20]) + ",")
+    lines.append("};")
+    lines.append("")
+lines.append("static const WebAsset kWebAssets[] = {")
+for index, (url, ctype, _, etag, _) in enumerate(assets):
+    lines.append('    {"%s", "%s", kWebAsset%u, sizeof(kWebAsset%u), "%s"},' % (url, ctype, index, index, etag))
+lines.append("};")
+lines.append("static constexpr size_t kWebAssetCount = %u;" % len(assets))
+lines.append("")
+lines.append("} // namespace ptz")
+
+header = os.path.join(out_dir, "ptz_web_assets.h")
+text = "\n".join(lines) + "\n"
+if not os.path.exists(header) or open(header).read() != text:
+    with open(header, "w") as out:
+        out.write(text)
+env.Append(CPPPATH=[out_dir])  # noqa: F821
+print("web_assets: %d files, %d bytes gzipped" % (len(assets), sum(len(a[2]) for a in assets)))
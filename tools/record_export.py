@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""Fetch and decode PTZ head recordings for host-side replay.
+
+  record_export.py fetch --host 192.168.1.50 --slot 0 -o take.json
+  record_export.py decode take.json > take.csv
+
+fetch sends exportRecording at successive offsets until the slot's stream is
+complete and saves the chunks' metadata with the whole stream as hex. decode
+expands the stream to one CSV row per record tick: time and the normalized
+velocity of each axis, the same values playback feeds PtzMotion.
+
+Stream encoding (see PtzRecorder in src/ptz_record.h), one entry per tick:
+  0x00..0x7F  repeat the previous sample for (n + 1) ticks
+  0x80 | mask delta record; a zigzag varint follows for each axis whose bit
+              is set in mask (bit n = axis n)
+"""
+
+import argparse
+import csv
+import json
+import sys
+
+AXIS_NAMES = ['pan', 'tilt', 'zoom']  # PTZ_AXIS_LIST order; further axes print as axisN
+WS_PORT = 81
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+    while pos < len(data):
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return (value >> 1) ^ -(value & 1), pos
+    raise ValueError('truncated varint at byte %d' % pos)
+
+
+def decode_stream(data, ticks, axes):
+    """Returns one list of quantized per-axis values per tick."""
+    samples = []
+    prev = [0] * axes
+    pos = 0
+    while len(samples) < ticks:
+        if pos >= len(data):
+            raise ValueError('stream ends after %d of %d ticks' % (len(samples), ticks))
+        tag = data[pos]
+        pos += 1
+        if tag < 0x80:
+            samples.extend([list(prev)] * (tag + 1))
+            continue
+        for axis in range(axes):
+            if tag & (1 << axis):
+                delta, pos = read_varint(data, pos)
+                prev[axis] += delta
+        samples.append(list(prev))
+    if pos != len(data) or len(samples) != ticks:
+        raise ValueError('stream holds %d bytes and %d ticks past the recorded %d' %
+                         (len(data) - pos, len(samples) - ticks, ticks))
+    return samples
+
+
+def fetch(args):
+    import websocket  # websocket-client
+    ws = websocket.create_connection('ws://%s:%d/ws?role=observer' % (args.host, args.port), timeout=5)
+    recording = None
+    stream = bytearray()
+    try:
+        while recording is None or len(stream) < recording['size']:
+            ws.send(json.dumps({'v': 1, 'source': 'app', 'type': 'exportRecording',
+                                'slot': args.slot, 'offset': len(stream)}))
+            while True:
+                reply = json.loads(ws.recv())
+                if reply.get('type') == 'error':
+                    raise SystemExit('%s: %s' % (reply.get('code'), reply.get('message')))
+                if reply.get('type') == 'recording':
+                    break
+            chunk = bytes.fromhex(reply['data'])
+            if reply['offset'] != len(stream) or (not chunk and len(stream) < reply['size']):
+                raise SystemExit('unexpected chunk at offset %d' % reply['offset'])
+            stream.extend(chunk)
+            recording = reply
+    finally:
+        ws.close()
+    out = {key: recording[key] for key in ('slot', 'tickUs', 'quantization', 'ticks', 'start', 'size')}
+    out['data'] = stream.hex()
+    with open(args.output, 'w', encoding='utf-8') as dest:
+        json.dump(out, dest, indent=1)
+    print('slot %d: %d ticks, %d bytes written to %s' % (out['slot'], out['ticks'], out['size'], args.output))
+
+
+def decode(args):
+    source = sys.stdin if args.input in (None, '-') else open(args.input, encoding='utf-8')
+    with source:
+        recording = json.load(source)
+    axes = len(recording['start'])
+    samples = decode_stream(bytes.fromhex(recording['data']), recording['ticks'], axes)
+    writer = csv.writer(sys.stdout)
+    writer.writerow(['time_s'] + [AXIS_NAMES[i] if i < len(AXIS_NAMES) else 'axis%d' % i for i in range(axes)])
+    writer.writerow(['start'] + recording['start'])
+    tick_s = recording['tickUs'] / 1e6
+    for n, sample in enumerate(samples):
+        writer.writerow(['%.3f' % (n * tick_s)] + ['%.6g' % (v / recording['quantization']) for v in sample])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest='command', required=True)
+
+    get = commands.add_parser('fetch', help='download a recording slot over the WebSocket API')
+    get.add_argument('--host', required=True)
+    get.add_argument('--port', type=int, default=WS_PORT)
+    get.add_argument('--slot', type=int, required=True)
+    get.add_argument('-o', '--output', default='recording.json')
+
+    dec = commands.add_parser('decode', help='expand a fetched recording to per-tick velocities')
+    dec.add_argument('input', nargs='?')
+
+    args = parser.parse_args()
+    if args.command == 'fetch':
+        fetch(args)
+    else:
+        decode(args)
+
+
+if __name__ == '__main__':
+    main()